@@ -28,6 +28,7 @@
 #include "usbd_desc.h"
 #include "usbd_dfu.h"
 #include "usbd_dfu_flash.h"
+#include "update.h"
 
 extern PCD_HandleTypeDef hpcd;
 
@@ -59,6 +60,7 @@ int main( void )
     uint8_t regValue = 0;
     uint8_t status = 0;
     uint16_t offset = 0;
+    DeltaPatchStatus_t updateStatus;
 
     /* STM32L1xx HAL library initialization:
          - Configure the Flash prefetch
@@ -80,6 +82,9 @@ int main( void )
     GpioInit( &Led2, LED_2, PIN_OUTPUT, PIN_PUSH_PULL, PIN_NO_PULL, 1 );
     GpioInit( &Led3, LED_3, PIN_OUTPUT, PIN_PUSH_PULL, PIN_NO_PULL, 1 );
 
+    // Apply or resume a pending delta update of the application
+    updateStatus = UpdateApply( );
+
     // Init SAR
     SX9500Init( );
     DelayLoop( 100 );
@@ -97,7 +102,8 @@ int main( void )
     SX9500Read( SX9500_REG_OFFSETLSB, ( uint8_t* )&regValue );
     offset |= regValue;
 
-    if( offset < 2000 )
+    // A partially patched application must not be started
+    if( ( offset < 2000 ) && ( updateStatus != DELTA_PATCH_ERROR_IMAGE ) )
     { /* Test if user code is programmed starting from address 0x08007000 */
         if( ( ( *( volatile uint32_t* )USBD_DFU_APP_DEFAULT_ADD ) & 0x2FFE0000 ) == 0x20000000 )
         {
@@ -27,6 +27,7 @@
 #include "usbd_desc.h"
 #include "usbd_dfu.h"
 #include "usbd_dfu_flash.h"
+#include "update.h"
 
 extern PCD_HandleTypeDef hpcd;
 
@@ -61,6 +62,8 @@ static void DelayLoop( volatile uint32_t nCount )
 
 int main( void )
 {
+    DeltaPatchStatus_t updateStatus;
+
     /* STM32L1xx HAL library initialization:
          - Configure the Flash prefetch
          - Systick timer is configured by default as source of time base, but user
@@ -87,7 +90,11 @@ int main( void )
     GpioInit( &Led3, LED_3, PIN_OUTPUT, PIN_PUSH_PULL, PIN_NO_PULL, 1 );
     GpioInit( &Led4, LED_4, PIN_OUTPUT, PIN_PUSH_PULL, PIN_NO_PULL, 1 );
 
-    if( GpioRead( &RadioPushButton ) == 0 )
+    // Apply or resume a pending delta update of the application
+    updateStatus = UpdateApply( );
+
+    // A partially patched application must not be started
+    if( ( GpioRead( &RadioPushButton ) == 0 ) && ( updateStatus != DELTA_PATCH_ERROR_IMAGE ) )
     { /* Test if user code is programmed starting from address 0x08007000 */
         if( ( ( *( volatile uint32_t* )USBD_DFU_APP_DEFAULT_ADD ) & 0x2FFE0000 ) == 0x20000000 )
         {
@@ -0,0 +1,132 @@
+/*!
+ * \file      update.c
+ *
+ * \brief     Delta firmware update of the application image
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <string.h>
+#include "stm32l1xx.h"
+#include "usbd_conf.h"
+#include "update.h"
+
+/*!
+ * \brief Erases and writes a flash page
+ */
+static int8_t FlashWritePage( uint32_t addr, uint8_t *data, uint32_t size )
+{
+    FLASH_EraseInitTypeDef eraseInit;
+    uint32_t pageError = 0;
+    uint32_t word;
+    int8_t status = 0;
+
+    HAL_FLASH_Unlock( );
+
+    eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+    eraseInit.PageAddress = addr;
+    eraseInit.NbPages = 1;
+    if( HAL_FLASHEx_Erase( &eraseInit, &pageError ) != HAL_OK )
+    {
+        status = -1;
+    }
+
+    for( uint32_t i = 0; ( status == 0 ) && ( i < size ); i += 4 )
+    {
+        memcpy( &word, data + i, 4 );
+        if( ( HAL_FLASH_Program( FLASH_TYPEPROGRAM_WORD, addr + i, word ) != HAL_OK ) ||
+            ( *( volatile uint32_t* )( addr + i ) != word ) )
+        {
+            status = -1;
+        }
+    }
+
+    HAL_FLASH_Lock( );
+    return status;
+}
+
+static int8_t PatchRead( uint32_t offset, uint8_t *data, uint32_t size )
+{
+    if( ( offset + size ) > UPDATE_PATCH_SIZE )
+    {
+        return -1;
+    }
+    memcpy( data, ( const void* )( UPDATE_PATCH_ADD + offset ), size );
+    return 0;
+}
+
+static int8_t PatchClear( void )
+{
+    uint8_t page[FLASH_PAGE_SIZE];
+
+    memset( page, 0, sizeof( page ) );
+    return FlashWritePage( UPDATE_PATCH_ADD, page, FLASH_PAGE_SIZE );
+}
+
+static int8_t ImageRead( uint32_t offset, uint8_t *data, uint32_t size )
+{
+    memcpy( data, ( const void* )( USBD_DFU_APP_DEFAULT_ADD + offset ), size );
+    return 0;
+}
+
+static int8_t ImageWrite( uint32_t offset, uint8_t *data, uint32_t size )
+{
+    return FlashWritePage( USBD_DFU_APP_DEFAULT_ADD + offset, data, size );
+}
+
+static int8_t ScratchWrite( uint8_t *data, uint32_t size )
+{
+    return FlashWritePage( UPDATE_SCRATCH_ADD, data, size );
+}
+
+static int8_t ScratchRead( uint8_t *data, uint32_t size )
+{
+    memcpy( data, ( const void* )UPDATE_SCRATCH_ADD, size );
+    return 0;
+}
+
+static uint32_t ProgressRead( uint8_t index )
+{
+    return *( volatile uint32_t* )( UPDATE_PROGRESS_ADD + ( index * 4 ) );
+}
+
+static int8_t ProgressWrite( uint8_t index, uint32_t value )
+{
+    HAL_StatusTypeDef status;
+
+    HAL_FLASHEx_DATAEEPROM_Unlock( );
+    status = HAL_FLASHEx_DATAEEPROM_Program( FLASH_TYPEPROGRAMDATA_WORD, UPDATE_PROGRESS_ADD + ( index * 4 ), value );
+    HAL_FLASHEx_DATAEEPROM_Lock( );
+
+    return ( status == HAL_OK ) ? 0 : -1;
+}
+
+static DeltaPatchCallbacks_t UpdateCallbacks =
+{
+    .ImageMaxSize = UPDATE_SCRATCH_ADD - USBD_DFU_APP_DEFAULT_ADD,
+    .PatchRead = PatchRead,
+    .PatchClear = PatchClear,
+    .ImageRead = ImageRead,
+    .ImageWrite = ImageWrite,
+    .ScratchWrite = ScratchWrite,
+    .ScratchRead = ScratchRead,
+    .ProgressRead = ProgressRead,
+    .ProgressWrite = ProgressWrite,
+};
+
+DeltaPatchStatus_t UpdateApply( void )
+{
+    return DeltaPatchApply( &UpdateCallbacks );
+}
@@ -0,0 +1,58 @@
+/*!
+ * \file      update.h
+ *
+ * \brief     Delta firmware update of the application image
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * Flash layout of the application area:
+ *
+ *     USBD_DFU_APP_DEFAULT_ADD  application image, patched in place
+ *     UPDATE_SCRATCH_ADD        one page, copy of the block being written
+ *     UPDATE_PATCH_ADD          patch, see deltapatch.h, up to USBD_DFU_APP_END_ADD
+ *
+ * The addresses come from the usbd_conf.h of the board. The linker script of
+ * the applications, *_flash_offset.ld, ends their image at UPDATE_SCRATCH_ADD.
+ *
+ * The application downloads the patch, for instance with the fragmentation
+ * package of fragsession.h, to UPDATE_PATCH_ADD and writes the patch header
+ * last, then resets. The progress of the update is kept in the last words
+ * of the data EEPROM.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __UPDATE_H__
+#define __UPDATE_H__
+
+#include "deltapatch.h"
+
+/*!
+ * Size of the patch area [bytes]
+ */
+#define UPDATE_PATCH_SIZE                           0x4000
+
+#define UPDATE_PATCH_ADD                            ( USBD_DFU_APP_END_ADD - UPDATE_PATCH_SIZE )
+
+#define UPDATE_SCRATCH_ADD                          ( UPDATE_PATCH_ADD - FLASH_PAGE_SIZE )
+
+#define UPDATE_PROGRESS_ADD                         ( FLASH_EEPROM_END + 1 - ( DELTA_PATCH_PROGRESS_SIZE * 4 ) )
+
+/*!
+ * \brief Applies the pending patch to the application image
+ *
+ * \retval status DELTA_PATCH_ERROR_IMAGE when the application must not be started
+ */
+DeltaPatchStatus_t UpdateApply( void );
+
+#endif // __UPDATE_H__
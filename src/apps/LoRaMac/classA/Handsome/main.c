@@ -251,6 +251,7 @@ int main(void)
     while (1)
     {
         log_info("In Circle %d...\n", cnt++);
+        SerialioProcess();
         Replay(470000000);
         DelayMs(1100); //!!! have a rest~~
     }
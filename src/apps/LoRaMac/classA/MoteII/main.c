@@ -312,7 +312,7 @@ static void PrepareTxFrame( uint8_t port )
 /*!
  * \brief   Prepares the payload of the frame
  *
- * \retval  [0: frame could be send, 1: error]
+ * \retval  [0: frame queued, 1: error or uplink queue full]
  */
 static bool SendFrame( void )
 {
@@ -326,6 +326,7 @@ static bool SendFrame( void )
     {
         // Send empty frame in order to flush MAC commands
         mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fPort = 0;
         mcpsReq.Req.Unconfirmed.fBuffer = NULL;
         mcpsReq.Req.Unconfirmed.fBufferSize = 0;
         mcpsReq.Req.Unconfirmed.Datarate = LORAWAN_DEFAULT_DATARATE;
@@ -362,7 +363,8 @@ static bool SendFrame( void )
         }
     }
 
-    if( LoRaMacMcpsRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
+    // The MAC sends it as soon as it is idle and the duty cycle allows it
+    if( LoRaMacQueueRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
     {
         LoRaMacUplinkStatus.UplinkInProgress = true;
         LoRaMacDownlinkStatus.DownlinkInProgress = false;
@@ -896,7 +898,14 @@ int main( void )
                 LoRaMacDownlinkStatus.Rssi = -130;
                 LoRaMacDownlinkStatus.Snr = 0;
 
-                DeviceState = DEVICE_STATE_JOIN;
+                if( LoRaMacRestoreSession( ) == LORAMAC_STATUS_OK )
+                {// Session of the previous run, saved in the EEPROM
+                    DeviceState = DEVICE_STATE_SEND;
+                }
+                else
+                {
+                    DeviceState = DEVICE_STATE_JOIN;
+                }
                 break;
             }
             case DEVICE_STATE_JOIN:
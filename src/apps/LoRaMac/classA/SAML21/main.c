@@ -241,7 +241,7 @@ static void PrepareTxFrame( uint8_t port )
 /*!
  * \brief   Prepares the payload of the frame
  *
- * \retval  [0: frame could be send, 1: error]
+ * \retval  [0: frame queued, 1: error or uplink queue full]
  */
 static bool SendFrame( void )
 {
@@ -252,6 +252,7 @@ static bool SendFrame( void )
     {
         // Send empty frame in order to flush MAC commands
         mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fPort = 0;
         mcpsReq.Req.Unconfirmed.fBuffer = NULL;
         mcpsReq.Req.Unconfirmed.fBufferSize = 0;
         mcpsReq.Req.Unconfirmed.Datarate = LORAWAN_DEFAULT_DATARATE;
@@ -277,7 +278,8 @@ static bool SendFrame( void )
         }
     }
 
-    if( LoRaMacMcpsRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
+    // The MAC sends it as soon as it is idle and the duty cycle allows it
+    if( LoRaMacQueueRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
     {
         return false;
     }
@@ -746,7 +748,14 @@ int main( void )
                 LoRaMacMibSetRequestConfirm( &mibReq );
 #endif
 
-                DeviceState = DEVICE_STATE_JOIN;
+                if( LoRaMacRestoreSession( ) == LORAMAC_STATUS_OK )
+                {// Session of the previous run, saved in the EEPROM
+                    DeviceState = DEVICE_STATE_SEND;
+                }
+                else
+                {
+                    DeviceState = DEVICE_STATE_JOIN;
+                }
                 break;
             }
             case DEVICE_STATE_JOIN:
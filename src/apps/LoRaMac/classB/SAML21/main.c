@@ -29,6 +29,7 @@
 #include "board.h"
 #include "gpio.h"
 #include "LoRaMac.h"
+#include "LoRaMacClassBSwitch.h"
 #include "Commissioning.h"
 
 #ifndef ACTIVE_REGION
@@ -90,6 +91,12 @@
  */
 #define LORAWAN_APP_PORT                            2
 
+/*!
+ * Class B ping slot periodicity, 2^( 7 - periodicity ) ping slots every
+ * 128 s beacon period
+ */
+#define LORAWAN_PING_SLOT_PERIODICITY               5
+
 static uint8_t DevEui[] = LORAWAN_DEVICE_EUI;
 static uint8_t AppEui[] = LORAWAN_APPLICATION_EUI;
 static uint8_t AppKey[] = LORAWAN_APPLICATION_KEY;
@@ -241,7 +248,7 @@ static void PrepareTxFrame( uint8_t port )
 /*!
  * \brief   Prepares the payload of the frame
  *
- * \retval  [0: frame could be send, 1: error]
+ * \retval  [0: frame queued, 1: error or uplink queue full]
  */
 static bool SendFrame( void )
 {
@@ -252,6 +259,7 @@ static bool SendFrame( void )
     {
         // Send empty frame in order to flush MAC commands
         mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fPort = 0;
         mcpsReq.Req.Unconfirmed.fBuffer = NULL;
         mcpsReq.Req.Unconfirmed.fBufferSize = 0;
         mcpsReq.Req.Unconfirmed.Datarate = LORAWAN_DEFAULT_DATARATE;
@@ -277,7 +285,8 @@ static bool SendFrame( void )
         }
     }
 
-    if( LoRaMacMcpsRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
+    // The MAC sends it as soon as it is idle and the duty cycle allows it
+    if( LoRaMacQueueRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
     {
         return false;
     }
@@ -612,6 +621,8 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
  */
 static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
 {
+    LoRaMacClassBSwitchOnMlmeConfirm( mlmeConfirm );
+
     switch( mlmeConfirm->MlmeRequest )
     {
         case MLME_JOIN:
@@ -620,6 +631,7 @@ static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
             {
                 // Status is OK, node has joined the network
                 DeviceState = DEVICE_STATE_SEND;
+                LoRaMacClassBSwitchStart( );
             }
             else
             {
@@ -670,6 +682,8 @@ static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
  */
 static void MlmeIndication( MlmeIndication_t *mlmeIndication )
 {
+    LoRaMacClassBSwitchOnMlmeIndication( mlmeIndication );
+
     switch( mlmeIndication->MlmeIndication )
     {
         case MLME_SCHEDULE_UPLINK:
@@ -711,6 +725,7 @@ int main( void )
                 LoRaMacPrimitives.MacMlmeIndication = MlmeIndication;
                 LoRaMacCallbacks.GetBatteryLevel = BoardGetBatteryLevel;
                 LoRaMacInitialization( &LoRaMacPrimitives, &LoRaMacCallbacks, ACTIVE_REGION );
+                LoRaMacClassBSwitchInit( LORAWAN_PING_SLOT_PERIODICITY );
 
                 TimerInit( &TxNextPacketTimer, OnTxNextPacketTimerEvent );
 
@@ -746,7 +761,15 @@ int main( void )
                 LoRaMacMibSetRequestConfirm( &mibReq );
 #endif
 
-                DeviceState = DEVICE_STATE_JOIN;
+                if( LoRaMacRestoreSession( ) == LORAMAC_STATUS_OK )
+                {// Session of the previous run, saved in the EEPROM
+                    LoRaMacClassBSwitchStart( );
+                    DeviceState = DEVICE_STATE_SEND;
+                }
+                else
+                {
+                    DeviceState = DEVICE_STATE_JOIN;
+                }
                 break;
             }
             case DEVICE_STATE_JOIN:
@@ -803,6 +826,7 @@ int main( void )
                 mibReq.Param.IsNetworkJoined = true;
                 LoRaMacMibSetRequestConfirm( &mibReq );
 
+                LoRaMacClassBSwitchStart( );
                 DeviceState = DEVICE_STATE_SEND;
 #endif
                 break;
@@ -27,6 +27,7 @@
 #include "board.h"
 #include "gpio.h"
 #include "LoRaMac.h"
+#include "fragsession.h"
 #include "Commissioning.h"
 
 #ifndef ACTIVE_REGION
@@ -190,6 +191,52 @@ extern Gpio_t Led1;
 extern Gpio_t Led2;
 //extern Gpio_t Led3;
 
+/*!
+ * Largest data block received by the fragmentation package, kept in RAM
+ */
+#define FRAG_DATA_BLOCK_MAX_SIZE                    2048
+
+static uint8_t FragDataBlock[FRAG_DATA_BLOCK_MAX_SIZE];
+
+/*!
+ * Size of the last data block received, 0 when none
+ */
+static uint32_t FragDataBlockSize = 0;
+
+static int8_t FragDataWrite( uint32_t addr, uint8_t *data, uint32_t size )
+{
+    if( ( addr + size ) > FRAG_DATA_BLOCK_MAX_SIZE )
+    {
+        return -1;
+    }
+    memcpy1( FragDataBlock + addr, data, size );
+    return 0;
+}
+
+static int8_t FragDataRead( uint32_t addr, uint8_t *data, uint32_t size )
+{
+    if( ( addr + size ) > FRAG_DATA_BLOCK_MAX_SIZE )
+    {
+        return -1;
+    }
+    memcpy1( data, FragDataBlock + addr, size );
+    return 0;
+}
+
+static FragDecoderCallbacks_t FragDataCallbacks =
+{
+    .Write = FragDataWrite,
+    .Read = FragDataRead,
+};
+
+/*!
+ * \brief Called once a fragmentation session is finished
+ */
+static void OnFragSessionDone( FragSessionStatus_t status, uint32_t size )
+{
+    FragDataBlockSize = ( status == FRAG_SESSION_STATUS_OK ) ? size : 0;
+}
+
 /*!
  * \brief   Prepares the payload of the frame
  */
@@ -287,7 +334,7 @@ static void PrepareTxFrame( uint8_t port )
 /*!
  * \brief   Prepares the payload of the frame
  *
- * \retval  [0: frame could be send, 1: error]
+ * \retval  [0: frame queued, 1: error or uplink queue full]
  */
 static bool SendFrame( void )
 {
@@ -298,6 +345,7 @@ static bool SendFrame( void )
     {
         // Send empty frame in order to flush MAC commands
         mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fPort = 0;
         mcpsReq.Req.Unconfirmed.fBuffer = NULL;
         mcpsReq.Req.Unconfirmed.fBufferSize = 0;
         mcpsReq.Req.Unconfirmed.Datarate = LORAWAN_DEFAULT_DATARATE;
@@ -323,7 +371,8 @@ static bool SendFrame( void )
         }
     }
 
-    if( LoRaMacMcpsRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
+    // The MAC sends it as soon as it is idle and the duty cycle allows it
+    if( LoRaMacQueueRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
     {
         return false;
     }
@@ -500,6 +549,24 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
                 //AppLedStateOn = mcpsIndication->Buffer[0] & 0x01;
             }
             break;
+        case FRAG_SESSION_PORT:
+            {
+                McpsReq_t mcpsReq;
+                uint8_t answer[LORAWAN_APP_DATA_MAX_SIZE];
+                uint8_t answerSize = FragSessionProcess( mcpsIndication->Buffer, mcpsIndication->BufferSize,
+                                                         answer, sizeof( answer ) );
+
+                if( answerSize > 0 )
+                {// Copied by the uplink queue
+                    mcpsReq.Type = MCPS_UNCONFIRMED;
+                    mcpsReq.Req.Unconfirmed.fPort = FRAG_SESSION_PORT;
+                    mcpsReq.Req.Unconfirmed.fBuffer = answer;
+                    mcpsReq.Req.Unconfirmed.fBufferSize = answerSize;
+                    mcpsReq.Req.Unconfirmed.Datarate = LORAWAN_DEFAULT_DATARATE;
+                    LoRaMacQueueRequest( &mcpsReq );
+                }
+            }
+            break;
         case 224:
             if( ComplianceTest.Running == false )
             {
@@ -755,6 +822,8 @@ int main( void )
                 LoRaMacCallbacks.GetBatteryLevel = BoardGetBatteryLevel;
                 LoRaMacInitialization( &LoRaMacPrimitives, &LoRaMacCallbacks, ACTIVE_REGION );
 
+                FragSessionInit( &FragDataCallbacks, OnFragSessionDone );
+
                 TimerInit( &TxNextPacketTimer, OnTxNextPacketTimerEvent );
 
                 TimerInit( &Led1Timer, OnLed1TimerEvent );
@@ -778,7 +847,14 @@ int main( void )
                 mibReq.Param.Class = CLASS_C;
                 LoRaMacMibSetRequestConfirm( &mibReq );
 
-                DeviceState = DEVICE_STATE_JOIN;
+                if( LoRaMacRestoreSession( ) == LORAMAC_STATUS_OK )
+                {// Session of the previous run, saved in the EEPROM
+                    DeviceState = DEVICE_STATE_SEND;
+                }
+                else
+                {
+                    DeviceState = DEVICE_STATE_JOIN;
+                }
                 break;
             }
             case DEVICE_STATE_JOIN:
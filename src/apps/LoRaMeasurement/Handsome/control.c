@@ -0,0 +1,390 @@
+/*!
+ * \file      control.c
+ *
+ * \brief     Over-the-air remote control of the measurement node State
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include "board.h"
+#include "utilities.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "control.h"
+
+/*!
+ * Largest control frame: a full slot table
+ */
+#define CONTROL_FRAME_MAX_SIZE          ( CONTROL_HDR_SIZE + 5 + SCHEDULER_MAX_SLOTS * CONTROL_SLOT_SIZE )
+
+/*!
+ * One step of an experiment schedule
+ */
+typedef struct sControlStep
+{
+    uint8_t sf;
+    uint8_t cr;
+    uint8_t bw;
+    uint8_t pw_index;
+    uint8_t freq_index;
+    uint8_t pkt_size;
+    uint8_t packets;
+}ControlStep_t;
+
+/*!
+ * Controlled node State
+ */
+static State *NodeState;
+
+/*!
+ * Control frame received by the radio and not yet applied
+ */
+static uint8_t PendingFrame[CONTROL_FRAME_MAX_SIZE];
+static uint16_t PendingFrameSize;
+static TimerTime_t PendingFrameTime;
+static volatile bool FramePending = false;
+
+/*!
+ * Sequence number of the last accepted frame
+ */
+static uint8_t LastSeq;
+static bool LastSeqValid = false;
+
+/*!
+ * Running schedule
+ */
+static ControlStep_t Schedule[CONTROL_SCHEDULE_MAX_STEPS];
+static uint8_t ScheduleSteps = 0;
+static uint8_t ScheduleIndex = 0;
+static uint8_t SchedulePacketsLeft = 0;
+static bool ScheduleRepeat = false;
+static bool ScheduleRunning = false;
+
+static bool IsRadioValid(uint8_t sf, uint8_t cr, uint8_t bw, uint8_t pw_index)
+{
+    return (sf <= 6) && (cr <= 3) && (bw <= 2) && (pw_index <= 7);
+}
+
+static bool IsPktSizeValid(uint8_t pkt_size)
+{
+    return (pkt_size >= CONTROL_PKT_SIZE_MIN) && (pkt_size <= CONTROL_PKT_SIZE_MAX);
+}
+
+static void ApplyStep(const ControlStep_t *step)
+{
+    NodeState->sf = step->sf;
+    NodeState->cr = step->cr;
+    NodeState->bw = step->bw;
+    NodeState->pw_index = step->pw_index;
+    NodeState->freq_index = step->freq_index;
+    NodeState->pkt_size = step->pkt_size;
+}
+
+static bool ProcessStateDelta(const uint8_t *body, uint16_t size)
+{
+    State next = *NodeState;
+    uint8_t mask;
+    uint16_t i = 0;
+
+    if (size < 1)
+    {
+        return false;
+    }
+    mask = body[i++];
+
+    // fields follow the mask in eControlField order
+    for (uint8_t field = 0x01; field != 0; field <<= 1)
+    {
+        if ((mask & field) == 0)
+        {
+            continue;
+        }
+        if (i >= size)
+        {
+            return false;
+        }
+        uint8_t value = body[i++];
+        switch (field)
+        {
+            case CONTROL_FIELD_IS_ON:
+                next.is_on = (value != 0) ? 1 : 0;
+                break;
+            case CONTROL_FIELD_SF:
+                if (value > 6) return false;
+                next.sf = value;
+                break;
+            case CONTROL_FIELD_CR:
+                if (value > 3) return false;
+                next.cr = value;
+                break;
+            case CONTROL_FIELD_BW:
+                if (value > 2) return false;
+                next.bw = value;
+                break;
+            case CONTROL_FIELD_PW_INDEX:
+                if (value > 7) return false;
+                next.pw_index = value;
+                break;
+            case CONTROL_FIELD_DC:
+                if ((value < CONTROL_DC_MIN) || (value > 127)) return false;
+                next.dc = value;
+                break;
+            case CONTROL_FIELD_FREQ_INDEX:
+                if (value >= CONTROL_FREQ_CHANNELS) return false;
+                next.freq_index = value;
+                break;
+            case CONTROL_FIELD_PKT_SIZE:
+                if (IsPktSizeValid(value) == false) return false;
+                next.pkt_size = value;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // the whole delta is applied or none of it
+    *NodeState = next;
+    return true;
+}
+
+static bool ProcessSchedule(const uint8_t *body, uint16_t size)
+{
+    ControlStep_t steps[CONTROL_SCHEDULE_MAX_STEPS];
+    uint8_t count;
+    uint8_t flags;
+
+    if (size < 2)
+    {
+        return false;
+    }
+    count = body[0];
+    flags = body[1];
+    body += 2;
+    if ((count == 0) || (count > CONTROL_SCHEDULE_MAX_STEPS) ||
+        (size < 2 + (uint16_t)count * CONTROL_STEP_SIZE))
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++, body += CONTROL_STEP_SIZE)
+    {
+        steps[i].sf = body[0] & 0x07;
+        steps[i].cr = (body[0] >> 3) & 0x03;
+        steps[i].bw = (body[0] >> 5) & 0x03;
+        steps[i].pw_index = body[1] & 0x07;
+        steps[i].freq_index = body[2];
+        steps[i].pkt_size = body[3];
+        steps[i].packets = body[4];
+
+        if ((IsRadioValid(steps[i].sf, steps[i].cr, steps[i].bw, steps[i].pw_index) == false) ||
+            (steps[i].freq_index >= CONTROL_FREQ_CHANNELS) ||
+            (IsPktSizeValid(steps[i].pkt_size) == false) ||
+            (steps[i].packets == 0))
+        {
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Schedule[i] = steps[i];
+    }
+    ScheduleSteps = count;
+    ScheduleIndex = 0;
+    ScheduleRepeat = (flags & CONTROL_SCHEDULE_FLAG_REPEAT) != 0;
+    ScheduleRunning = true;
+    SchedulePacketsLeft = Schedule[0].packets;
+    ApplyStep(&Schedule[0]);
+    return true;
+}
+
+static bool ProcessSlotTable(const uint8_t *body, uint16_t size)
+{
+    SchedulerSlot_t slots[SCHEDULER_MAX_SLOTS];
+    uint16_t slotLength;
+    uint16_t slotsPerFrame;
+    uint8_t count;
+
+    if (size < 5)
+    {
+        return false;
+    }
+    slotLength = body[0] | ((uint16_t)body[1] << 8);
+    slotsPerFrame = body[2] | ((uint16_t)body[3] << 8);
+    count = body[4];
+    body += 5;
+    if ((count > SCHEDULER_MAX_SLOTS) || (size < 5 + (uint16_t)count * CONTROL_SLOT_SIZE))
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++, body += CONTROL_SLOT_SIZE)
+    {
+        slots[i].Slot = body[0] | ((uint16_t)body[1] << 8);
+        slots[i].sf = body[2] & 0x07;
+        slots[i].cr = (body[2] >> 3) & 0x03;
+        slots[i].bw = (body[2] >> 5) & 0x03;
+        slots[i].pw_index = body[3] & 0x07;
+        slots[i].freq_index = body[4];
+        slots[i].pkt_size = body[5];
+
+        if ((IsRadioValid(slots[i].sf, slots[i].cr, slots[i].bw, slots[i].pw_index) == false) ||
+            (slots[i].freq_index >= CONTROL_FREQ_CHANNELS) ||
+            (IsPktSizeValid(slots[i].pkt_size) == false))
+        {
+            return false;
+        }
+    }
+
+    if (count == 0)
+    {
+        SchedulerStop();
+        return true;
+    }
+    if (SchedulerSetTable(slotLength, slotsPerFrame, slots, count) == false)
+    {
+        return false;
+    }
+    SchedulerStart();
+    return true;
+}
+
+static bool ProcessSync(const uint8_t *body, uint16_t size, TimerTime_t rxTime)
+{
+    if (size < 4)
+    {
+        return false;
+    }
+    SchedulerSyncBeacon(rxTime, body[0] | ((uint32_t)body[1] << 8) |
+                                ((uint32_t)body[2] << 16) | ((uint32_t)body[3] << 24));
+    return true;
+}
+
+void ControlInit(State *state)
+{
+    NodeState = state;
+    FramePending = false;
+    LastSeqValid = false;
+    ScheduleRunning = false;
+}
+
+bool ControlOnRxFrame(const uint8_t *payload, uint16_t size)
+{
+    if ((size < CONTROL_HDR_SIZE) || (payload[0] != CONTROL_MAGIC))
+    {
+        return false;
+    }
+    if ((payload[1] != NodeState->id) && (payload[1] != CONTROL_BROADCAST_ID))
+    {
+        return true;
+    }
+    if ((LastSeqValid == true) && (payload[2] == LastSeq))
+    {
+        return true;
+    }
+    if (size > CONTROL_FRAME_MAX_SIZE)
+    {
+        return true;
+    }
+    // the end of a beacon dates the epoch
+    PendingFrameTime = TimerGetCurrentTime();
+
+    // a newer frame replaces one which has not been applied yet
+    memcpy1(PendingFrame, payload, size);
+    PendingFrameSize = size;
+    FramePending = true;
+    return true;
+}
+
+bool ControlProcess(void)
+{
+    uint8_t frame[CONTROL_FRAME_MAX_SIZE];
+    uint16_t size;
+    TimerTime_t rxTime;
+    bool changed = false;
+
+    BoardDisableIrq();
+    if (FramePending == false)
+    {
+        BoardEnableIrq();
+        return false;
+    }
+    size = PendingFrameSize;
+    rxTime = PendingFrameTime;
+    memcpy1(frame, PendingFrame, size);
+    FramePending = false;
+    BoardEnableIrq();
+
+    switch (frame[3])
+    {
+        case CONTROL_CMD_STATE_DELTA:
+            changed = ProcessStateDelta(frame + CONTROL_HDR_SIZE, size - CONTROL_HDR_SIZE);
+            break;
+        case CONTROL_CMD_SCHEDULE:
+            changed = ProcessSchedule(frame + CONTROL_HDR_SIZE, size - CONTROL_HDR_SIZE);
+            break;
+        case CONTROL_CMD_SCHEDULE_STOP:
+            ScheduleRunning = false;
+            changed = true;
+            break;
+        case CONTROL_CMD_RESET_CNT:
+            NodeState->cnt = 0;
+            changed = true;
+            break;
+        case CONTROL_CMD_SLOT_TABLE:
+            changed = ProcessSlotTable(frame + CONTROL_HDR_SIZE, size - CONTROL_HDR_SIZE);
+            break;
+        case CONTROL_CMD_SYNC:
+            changed = ProcessSync(frame + CONTROL_HDR_SIZE, size - CONTROL_HDR_SIZE, rxTime);
+            break;
+        default:
+            break;
+    }
+
+    // malformed frames are not acknowledged so a corrected one may reuse the Seq
+    if (changed == true)
+    {
+        LastSeq = frame[2];
+        LastSeqValid = true;
+    }
+    return changed;
+}
+
+bool ControlNextCycle(void)
+{
+    if (ScheduleRunning == false)
+    {
+        return false;
+    }
+    if (SchedulePacketsLeft > 0)
+    {
+        SchedulePacketsLeft--;
+        return false;
+    }
+
+    ScheduleIndex++;
+    if (ScheduleIndex >= ScheduleSteps)
+    {
+        if (ScheduleRepeat == false)
+        {
+            ScheduleRunning = false;
+            return false;
+        }
+        ScheduleIndex = 0;
+    }
+    ApplyStep(&Schedule[ScheduleIndex]);
+    SchedulePacketsLeft = Schedule[ScheduleIndex].packets - 1;
+    return true;
+}
@@ -0,0 +1,229 @@
+/*!
+ * \file      control.h
+ *
+ * \brief     Over-the-air remote control of the measurement node State
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * Control frames are plain LoRa packets received on the control channel.
+ * All of them share a 4 bytes header:
+ *
+ * | Magic | Target | Seq | Cmd | Body... |
+ *
+ * - Magic  : CONTROL_MAGIC, anything else is handled as a measurement packet
+ * - Target : node id, or CONTROL_BROADCAST_ID for the whole fleet
+ * - Seq    : controller sequence number, repeated frames with the same Seq
+ *            are applied only once so the controller may broadcast blindly
+ * - Cmd    : eControlCmd
+ *
+ * CONTROL_CMD_STATE_DELTA body:
+ *
+ * | Mask | Field 0 | ... | Field n |
+ *
+ * One byte per bit set in Mask, in eControlField order. Fields which are not
+ * in Mask keep their current value.
+ *
+ * CONTROL_CMD_SCHEDULE body:
+ *
+ * | Count | Flags | Step 0 | ... | Step Count-1 |
+ *
+ * Each step is CONTROL_STEP_SIZE bytes:
+ *
+ * | Radio | Power | FreqIndex | PktSize | Packets |
+ *
+ * - Radio   : sf[2:0] | cr[4:3] | bw[6:5]
+ * - Power   : pw_index[2:0]
+ * - Packets : number of Replay cycles the step lasts
+ *
+ * CONTROL_CMD_SLOT_TABLE body, see scheduler.h:
+ *
+ * | SlotLength | SlotsPerFrame | Count | Slot 0 | ... | Slot Count-1 |
+ *
+ * SlotLength (ms) and SlotsPerFrame are 2 bytes, little endian. Each slot is
+ * CONTROL_SLOT_SIZE bytes:
+ *
+ * | Slot (2 bytes, little endian) | Radio | Power | FreqIndex | PktSize |
+ *
+ * A table with slots starts the slotted transmissions, an empty one stops
+ * them.
+ *
+ * CONTROL_CMD_SYNC body:
+ *
+ * | EpochTime (4 bytes, little endian) |
+ *
+ * Epoch time (ms) of the end of the frame, used as a beacon by nodes without
+ * GPS PPS.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// node state
+// LSB and MSB are implementation-specific
+typedef struct sState
+{
+    uint8_t id; // node id
+    uint8_t is_on : 1; // flag: send pkt (is_on == 1) or not (is_on == 0)
+    uint8_t sf : 3; // spreading factor [0:SF6, 1:SF7, 2:SF8, 3:SF9, 4:SF10, 5:SF11, 6:SF12]
+    uint8_t cr : 2; // coderate [0: 4/5, 1: 4/6, 2: 4/7, 3: 4/8], +1 when passed to SetTxConfig
+    uint8_t bw : 2; // bandwidth [0: 125 kHz, 1: 250 kHz, 2: 500 kHz, 3: Reserved]
+    uint8_t pw_index : 3; // power index [0:20, 1:16, 2:14, 3:12, 4:10, 5:7, 6:5, 7:2] (dBm)
+    uint8_t dc : 7; // tx dutycycle (>= 3s)
+    uint8_t freq_index; // freq index: 96 channels
+    uint8_t pkt_size; // packet size (>= 8 bytes)
+    uint32_t cnt : 24; // packet counter
+}State; // 8 bytes
+
+/*!
+ * First byte of every control frame
+ */
+#define CONTROL_MAGIC                   0xC5
+
+/*!
+ * Target id addressing every node
+ */
+#define CONTROL_BROADCAST_ID            0xFF
+
+/*!
+ * Control frame header size
+ */
+#define CONTROL_HDR_SIZE                4
+
+/*!
+ * Size of one schedule step
+ */
+#define CONTROL_STEP_SIZE               5
+
+/*!
+ * Maximum number of steps in a schedule batch
+ */
+#define CONTROL_SCHEDULE_MAX_STEPS      32
+
+/*!
+ * Size of one slot of a slot table
+ */
+#define CONTROL_SLOT_SIZE               6
+
+/*!
+ * Schedule flag: restart from the first step once the last one is done
+ */
+#define CONTROL_SCHEDULE_FLAG_REPEAT    0x01
+
+/*!
+ * Lowest channel of the 96 channels plan selected by State.freq_index
+ */
+#define CONTROL_FREQ_BASE               470300000
+
+/*!
+ * Channel spacing of the plan selected by State.freq_index
+ */
+#define CONTROL_FREQ_STEP               200000
+
+/*!
+ * Number of channels selectable by State.freq_index
+ */
+#define CONTROL_FREQ_CHANNELS           96
+
+/*!
+ * Minimum tx dutycycle accepted for State.dc (s)
+ */
+#define CONTROL_DC_MIN                  3
+
+/*!
+ * Minimum packet size accepted for State.pkt_size
+ */
+#define CONTROL_PKT_SIZE_MIN            8
+
+/*!
+ * Maximum packet size accepted for State.pkt_size
+ */
+#define CONTROL_PKT_SIZE_MAX            242
+
+/*!
+ * Converts State.freq_index into a frequency in Hz
+ */
+#define CONTROL_FREQ( index )           ( CONTROL_FREQ_BASE + ( uint32_t )( index ) * CONTROL_FREQ_STEP )
+
+/*!
+ * Control commands
+ */
+typedef enum eControlCmd
+{
+    CONTROL_CMD_STATE_DELTA = 0x01, // overwrite the State fields present in the mask
+    CONTROL_CMD_SCHEDULE = 0x02, // load a batch of steps, replaces the running one
+    CONTROL_CMD_SCHEDULE_STOP = 0x03, // abort the running schedule, keep current State
+    CONTROL_CMD_RESET_CNT = 0x04, // reset the packet counter
+    CONTROL_CMD_SLOT_TABLE = 0x05, // load the slotted transmissions table
+    CONTROL_CMD_SYNC = 0x06, // beacon carrying the epoch time
+}ControlCmd_t;
+
+/*!
+ * State fields selectable in a CONTROL_CMD_STATE_DELTA mask
+ */
+typedef enum eControlField
+{
+    CONTROL_FIELD_IS_ON = 0x01,
+    CONTROL_FIELD_SF = 0x02,
+    CONTROL_FIELD_CR = 0x04,
+    CONTROL_FIELD_BW = 0x08,
+    CONTROL_FIELD_PW_INDEX = 0x10,
+    CONTROL_FIELD_DC = 0x20,
+    CONTROL_FIELD_FREQ_INDEX = 0x40,
+    CONTROL_FIELD_PKT_SIZE = 0x80,
+}ControlField_t;
+
+/*!
+ * \brief Initializes the control module
+ *
+ * \param [IN] state node State controlled over the air
+ */
+void ControlInit(State *state);
+
+/*!
+ * \brief Checks a received packet and queues it when it is a control frame
+ *
+ * \remark Called from the radio RxDone callback. Only copies the frame, the
+ *         State is modified by ControlProcess.
+ *
+ * \param [IN] payload received payload
+ * \param [IN] size    payload size
+ * \retval isControl   true when the packet was a control frame (even if it
+ *                     was not addressed to this node or was a repetition)
+ */
+bool ControlOnRxFrame(const uint8_t *payload, uint16_t size);
+
+/*!
+ * \brief Applies the queued control frame to the State
+ *
+ * \remark Called from the main loop, between Replay cycles.
+ *
+ * \retval changed true when the State or the slot table has been modified
+ */
+bool ControlProcess(void);
+
+/*!
+ * \brief Advances the running schedule by one Replay cycle
+ *
+ * \remark Called right before each Replay, loads the next step into the
+ *         State once the current one has used its packets.
+ *
+ * \retval changed true when a new step has been loaded
+ */
+bool ControlNextCycle(void);
+
+#endif // __CONTROL_H__
@@ -19,13 +19,16 @@
  * \author    jkadbear( Tsinghua )
  */
 #include "board.h"
+#include "control.h"
 #include "delay.h"
 #include "gpio.h"
 #include "gps.h"
 #include "SHT2x.h"
 #include "radio.h"
+#include "scheduler.h"
 #include "serialio.h"
 #include "timer.h"
+#include "utilities.h"
 #include <inttypes.h>
 #include <math.h>
 #include <stdio.h>
@@ -53,36 +56,52 @@ static RadioEvents_t RadioEvents;
 
 uint8_t pw_map[] = {20, 16, 14, 12, 10, 7, 5, 2};
 
-// node state
-// LSB and MSB are implementation-specific
-typedef struct sState
-{
-    uint8_t id; // node id
-    uint8_t is_on : 1; // flag: send pkt (is_on == 1) or not (is_on == 0)
-    uint8_t sf : 3; // spreading factor [0:SF6, 1:SF7, 2:SF8, 3:SF9, 4:SF10, 5:SF11, 6:SF12]
-    uint8_t cr : 2; // coderate [0: 4/5, 1: 4/6, 2: 4/7, 3: 4/8], +1 when passed to SetTxConfig
-    uint8_t bw : 2; // bandwidth [0: 125 kHz, 1: 250 kHz, 2: 500 kHz, 3: Reserved]
-    uint8_t pw_index : 3; // power index [0:20, 1:16, 2:14, 3:12, 4:10, 5:7, 6:5, 7:2] (dBm)
-    uint8_t dc : 7; // tx dutycycle (>= 3s)
-    uint8_t freq_index; // freq index: 96 channels
-    uint8_t pkt_size; // packet size (>= 8 bytes)
-    uint32_t cnt : 24; // packet counter
-}State; // 8 bytes
+/*!
+ * Control channel, State updates and measurement triggers are received here
+ */
+#define CONTROL_RX_FREQ 480000000
 
+// defaults reproduce the former fixed Replay profile: SF11, 4/5, 125 kHz, 40 bytes
 State state =
 {
     .id = 1,
     .bw = 0,
     .cr = 0,
-    .sf = 6,
+    .sf = 5,
     .is_on = 0,
     .dc = 3,
-    .pw_index = 0,
-    .freq_index = 85,
-    .pkt_size = 240,
+    .pw_index = 7,
+    .freq_index = 73,
+    .pkt_size = 40,
     .cnt = 0
 };
 
+/*!
+ * Periodic transmission timer, runs every state.dc seconds while state.is_on
+ */
+static TimerEvent_t TxTimer;
+
+/*!
+ * Set from radio and timer events, served by the main loop
+ */
+static volatile bool ReplayRequested = false;
+static volatile bool RadioIdle = false;
+static volatile bool TxBusy = false;
+
+/*!
+ * Slotted transmissions, the radio is configured by the main loop and the
+ * packet is sent from the timer interrupt at the slot start
+ */
+static SchedulerEvents_t SchedulerCallbacks;
+static const SchedulerSlot_t *PendingSlot = NULL;
+static volatile bool SlotPrepareRequested = false;
+static volatile bool SlotPrepared = false;
+
+/*!
+ * Timer time of the latest PPS edge given to the scheduler
+ */
+static TimerTime_t LastPpsTime = 0;
+
 static uint8_t loc_node_id = 42;
 
 static void onFhssChangeChannel(uint8_t s)
@@ -140,9 +159,10 @@ static void PreparePacket()
     }
 }
 
-static void Replay(uint32_t targ_freq)
+static void PrepareTx(const State *profile)
 {
-    printf("Replay at %d...\n", targ_freq);
+    uint32_t targ_freq = CONTROL_FREQ(profile->freq_index);
+
     
     /*! void    ( *SetTxConfig )( RadioModems_t modem, int8_t power, uint32_t fdev,
         uint32_t bandwidth, uint32_t datarate,
@@ -152,12 +172,19 @@ static void Replay(uint32_t targ_freq)
     
     // Radio.Standby();
     Radio.SetChannel(targ_freq);
-    Radio.SetMaxPayloadLength(MODEM_LORA, state.pkt_size);
-    Radio.SetTxConfig(MODEM_LORA, 1, 0, 0,
-                        11, 1,
+    Radio.SetMaxPayloadLength(MODEM_LORA, profile->pkt_size);
+    Radio.SetTxConfig(MODEM_LORA, pw_map[profile->pw_index], 0, profile->bw,
+                        profile->sf + 6, profile->cr + 1,
                         8, false, true, false, 1, false, 3000);
     PreparePacket();
-    Radio.Send(AppData, 40);
+}
+
+static void Replay(void)
+{
+    printf("Replay at %d...\n", CONTROL_FREQ(state.freq_index));
+    PrepareTx(&state);
+    state.cnt++;
+    Radio.Send(AppData, state.pkt_size);
 }
 
 static void InitRx(uint32_t targ_freq)
@@ -186,34 +213,138 @@ static void OnRadioRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t
     // }
     // printf("\n");
 
-    Replay(485000000);
+    if (ControlOnRxFrame(payload, size) == true)
+    {
+        // State is updated by the main loop, between Replay cycles
+        RadioIdle = true;
+        return;
+    }
+    ReplayRequested = true;
 }
 
 static void OnRadioTxDone(void)
 {
     Radio.Sleep(); 
     printf("Radio Tx Done!\n");
-    InitRx(480000000); 
+    TxBusy = false;
+    RadioIdle = true;
 }
 
 static void OnRadioRxError(void)
 {
     Radio.Sleep();
     printf("Radio Rx Error!\n");
-    InitRx(480000000);
+    RadioIdle = true;
 }
 
 static void OnRadioTxTimeout(void)
 {
     Radio.Sleep();
     printf("Radio Tx Timeout!\n");
+    TxBusy = false;
+    RadioIdle = true;
 }
 
 static void OnRadioRxTimeout(void)
 {
     Radio.Sleep();
     printf("Radio Rx Timeout!\n");
-    InitRx(480000000);
+    RadioIdle = true;
+}
+
+static void OnSchedulerPrepare(const SchedulerSlot_t *slot)
+{
+    PendingSlot = slot;
+    SlotPrepareRequested = true;
+}
+
+static void OnSchedulerStart(const SchedulerSlot_t *slot)
+{
+    // sent from the interrupt so that the packet leaves at the slot start
+    if (SlotPrepared == true)
+    {
+        SlotPrepared = false;
+        state.cnt++;
+        Radio.Send(AppData, slot->pkt_size);
+    }
+}
+
+/*!
+ * \brief Configures the radio for the coming slot
+ */
+static void PrepareSlot(void)
+{
+    State profile = state;
+
+    SlotPrepareRequested = false;
+    if (TxBusy == true)
+    {
+        // still busy with the previous packet, the slot is skipped
+        return;
+    }
+    RadioIdle = false;
+    TxBusy = true;
+    // leave the control Rx, a frame received now would configure the radio
+    // back to it before the slot start
+    Radio.Sleep();
+
+    profile.sf = PendingSlot->sf;
+    profile.cr = PendingSlot->cr;
+    profile.bw = PendingSlot->bw;
+    profile.pw_index = PendingSlot->pw_index;
+    profile.freq_index = PendingSlot->freq_index;
+    profile.pkt_size = PendingSlot->pkt_size;
+    PrepareTx(&profile);
+    SlotPrepared = true;
+}
+
+/*!
+ * \brief Gives the latest GPS PPS edge to the scheduler
+ */
+static void SyncOnPps(void)
+{
+    TimerTime_t ppsTime;
+    uint32_t utcSeconds;
+
+    if ((GpsGetLatestPps(&ppsTime, &utcSeconds) == SUCCESS) && (ppsTime != LastPpsTime))
+    {
+        LastPpsTime = ppsTime;
+        SchedulerSyncPps(ppsTime, utcSeconds);
+    }
+}
+
+static void OnTxTimerEvent(void)
+{
+    TimerStop(&TxTimer);
+    ReplayRequested = true;
+    TimerSetValue(&TxTimer, state.dc * 1000);
+    TimerStart(&TxTimer);
+}
+
+/*!
+ * \brief Starts or stops the periodic transmissions after a State change,
+ *        slotted transmissions take precedence over them
+ */
+static void UpdateTxTimer(void)
+{
+    TimerStop(&TxTimer);
+    if (SchedulerIsRunning() == false)
+    {
+        // drop a slot prepared before the scheduler was stopped
+        BoardDisableIrq();
+        if (SlotPrepared == true)
+        {
+            SlotPrepared = false;
+            TxBusy = false;
+            RadioIdle = true;
+        }
+        BoardEnableIrq();
+    }
+    if ((state.is_on == 1) && (SchedulerIsRunning() == false))
+    {
+        TimerSetValue(&TxTimer, state.dc * 1000);
+        TimerStart(&TxTimer);
+    }
 }
 
 
@@ -243,13 +374,50 @@ int main(void)
     // Radio.SetRxConfig(MODEM_LORA, 0, 11, 1, 0, 8, 5000, false, 0, true, 0, 0, false, false);
     // Radio.StartCad();
 
-    InitRx(480000000);
+    SchedulerCallbacks.Prepare = OnSchedulerPrepare;
+    SchedulerCallbacks.Start = OnSchedulerStart;
+    SchedulerInit(&SchedulerCallbacks);
 
-    // uint32_t cnt = 0;
-    // while (1)
-    // {
-    //     log_info("In Circle %d...\n", cnt++);
-    //     Replay(480000000);
-    //     DelayMs(3000); // have a rest~~
-    // }
+    ControlInit(&state);
+    TimerInit(&TxTimer, OnTxTimerEvent);
+    UpdateTxTimer();
+
+    InitRx(CONTROL_RX_FREQ);
+
+    while (1)
+    {
+        SerialioProcess();
+        SyncOnPps();
+
+        // the slot start is close, serve it first
+        if (SlotPrepareRequested == true)
+        {
+            PrepareSlot();
+        }
+
+        // a Replay cycle is over when the radio is back from Tx, apply the
+        // controller updates before starting the next one
+        if (ControlProcess() == true)
+        {
+            printf("State updated: sf:%d,bw:%d,cr:%d,pw:%d,freq:%d,size:%d,on:%d,slotted:%d\n",
+                state.sf, state.bw, state.cr, state.pw_index,
+                state.freq_index, state.pkt_size, state.is_on, SchedulerIsRunning());
+            UpdateTxTimer();
+        }
+
+        if ((ReplayRequested == true) && (TxBusy == false))
+        {
+            ReplayRequested = false;
+            RadioIdle = false;
+            TxBusy = true;
+            ControlNextCycle();
+            Replay();
+        }
+        else if ((RadioIdle == true) && (TxBusy == false))
+        {
+            // not while a slot is prepared, InitRx shares its modem config
+            RadioIdle = false;
+            InitRx(CONTROL_RX_FREQ);
+        }
+    }
 }
@@ -0,0 +1,246 @@
+/*!
+ * \file      scheduler.c
+ *
+ * \brief     Slotted transmissions against a shared epoch
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include "board.h"
+#include "scheduler.h"
+
+/*!
+ * Time during which PPS synchronisation takes precedence over beacons [ms]
+ */
+#define SCHEDULER_PPS_HOLDOVER          3000
+
+static SchedulerEvents_t *SchedulerEvents;
+
+/*!
+ * Slots used by this node, sorted by slot number
+ */
+static SchedulerSlot_t Slots[SCHEDULER_MAX_SLOTS];
+static uint8_t SlotCount = 0;
+static uint16_t SlotLength = 0;
+static uint16_t SlotsPerFrame = 0;
+
+/*!
+ * Epoch time = timer time + EpochOffset
+ */
+static uint32_t EpochOffset = 0;
+static SchedulerSync_t Sync = SCHEDULER_SYNC_NONE;
+static TimerTime_t LastPpsTime = 0;
+
+static bool Running = false;
+static bool Armed = false;
+
+/*!
+ * Next slot to be served and the epoch time at which it starts
+ */
+static uint8_t NextIndex = 0;
+static uint32_t NextStart = 0;
+
+static TimerEvent_t PrepareTimer;
+static TimerEvent_t StartTimer;
+
+static uint32_t GetEpochTime(void)
+{
+    return TimerGetCurrentTime() + EpochOffset;
+}
+
+/*!
+ * \brief Arms the prepare timer for the first slot which can still be prepared
+ */
+static void ScheduleNext(void)
+{
+    uint32_t epoch;
+    uint32_t earliest;
+    uint32_t frameLength;
+    uint32_t frameStart;
+
+    TimerStop(&PrepareTimer);
+    TimerStop(&StartTimer);
+    Armed = false;
+
+    if ((Running == false) || (SlotCount == 0) || (Sync == SCHEDULER_SYNC_NONE))
+    {
+        return;
+    }
+
+    epoch = GetEpochTime();
+    earliest = epoch + SCHEDULER_PREPARE_TIME + 1;
+    frameLength = (uint32_t)SlotLength * SlotsPerFrame;
+    frameStart = epoch - (epoch % frameLength);
+
+    // the first slot of the next frame is always far enough
+    for (uint8_t frame = 0; (frame < 2) && (Armed == false); frame++)
+    {
+        for (uint8_t i = 0; i < SlotCount; i++)
+        {
+            uint32_t start = frameStart + (uint32_t)Slots[i].Slot * SlotLength;
+
+            if ((int32_t)(start - earliest) >= 0)
+            {
+                NextIndex = i;
+                NextStart = start;
+                Armed = true;
+                break;
+            }
+        }
+        frameStart += frameLength;
+    }
+
+    if (Armed == true)
+    {
+        TimerSetValue(&PrepareTimer, NextStart - SCHEDULER_PREPARE_TIME - epoch);
+        TimerStart(&PrepareTimer);
+    }
+}
+
+static void OnPrepareTimerEvent(void)
+{
+    int32_t remaining;
+
+    TimerStop(&PrepareTimer);
+
+    // the epoch may have been corrected since the timer was armed
+    remaining = (int32_t)(NextStart - GetEpochTime());
+    if ((remaining <= 0) || (remaining > 2 * SCHEDULER_PREPARE_TIME))
+    {
+        ScheduleNext();
+        return;
+    }
+
+    if ((SchedulerEvents != NULL) && (SchedulerEvents->Prepare != NULL))
+    {
+        SchedulerEvents->Prepare(&Slots[NextIndex]);
+    }
+
+    // the radio configuration took some time, measure again
+    remaining = (int32_t)(NextStart - GetEpochTime());
+    TimerSetValue(&StartTimer, (remaining > 0) ? remaining : 1);
+    TimerStart(&StartTimer);
+}
+
+static void OnStartTimerEvent(void)
+{
+    TimerStop(&StartTimer);
+
+    if ((SchedulerEvents != NULL) && (SchedulerEvents->Start != NULL))
+    {
+        SchedulerEvents->Start(&Slots[NextIndex]);
+    }
+    ScheduleNext();
+}
+
+void SchedulerInit(SchedulerEvents_t *events)
+{
+    SchedulerEvents = events;
+    SlotCount = 0;
+    Sync = SCHEDULER_SYNC_NONE;
+    Running = false;
+    Armed = false;
+
+    TimerInit(&PrepareTimer, OnPrepareTimerEvent);
+    TimerInit(&StartTimer, OnStartTimerEvent);
+}
+
+bool SchedulerSetTable(uint16_t slotLength, uint16_t slotsPerFrame, const SchedulerSlot_t *slots, uint8_t count)
+{
+    if ((slotLength == 0) || (slotsPerFrame == 0) || (count > SCHEDULER_MAX_SLOTS))
+    {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (slots[i].Slot >= slotsPerFrame)
+        {
+            return false;
+        }
+    }
+
+    BoardDisableIrq();
+    SlotLength = slotLength;
+    SlotsPerFrame = slotsPerFrame;
+    // insertion sort, tables are small
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t j = i;
+
+        while ((j > 0) && (Slots[j - 1].Slot > slots[i].Slot))
+        {
+            Slots[j] = Slots[j - 1];
+            j--;
+        }
+        Slots[j] = slots[i];
+    }
+    SlotCount = count;
+    BoardEnableIrq();
+
+    if (Running == true)
+    {
+        ScheduleNext();
+    }
+    return true;
+}
+
+void SchedulerSyncPps(TimerTime_t ppsTime, uint32_t utcSeconds)
+{
+    EpochOffset = utcSeconds * 1000 - ppsTime;
+    LastPpsTime = ppsTime;
+    Sync = SCHEDULER_SYNC_PPS;
+
+    if ((Running == true) && (Armed == false))
+    {
+        ScheduleNext();
+    }
+}
+
+void SchedulerSyncBeacon(TimerTime_t rxTime, uint32_t epochTime)
+{
+    if ((Sync == SCHEDULER_SYNC_PPS) && (TimerGetElapsedTime(LastPpsTime) < SCHEDULER_PPS_HOLDOVER))
+    {
+        return;
+    }
+    EpochOffset = epochTime - rxTime;
+    Sync = SCHEDULER_SYNC_BEACON;
+
+    if ((Running == true) && (Armed == false))
+    {
+        ScheduleNext();
+    }
+}
+
+SchedulerSync_t SchedulerGetSync(void)
+{
+    return Sync;
+}
+
+void SchedulerStart(void)
+{
+    Running = true;
+    ScheduleNext();
+}
+
+void SchedulerStop(void)
+{
+    Running = false;
+    ScheduleNext();
+}
+
+bool SchedulerIsRunning(void)
+{
+    return Running;
+}
@@ -0,0 +1,145 @@
+/*!
+ * \file      scheduler.h
+ *
+ * \brief     Slotted transmissions against a shared epoch
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * The epoch time is the number of ms elapsed since the shared epoch. It is
+ * the UTC time of day when synchronised on GPS PPS, or the time announced by
+ * the controller when synchronised on a beacon. Time is cut in frames of
+ * SlotsPerFrame slots of SlotLength ms, frame 0 starting at the epoch. The
+ * frame length should divide a day so that slot numbers stay continuous
+ * across UTC midnight.
+ *
+ * Every node holds a table mapping slots of the frame to a radio profile.
+ * Nodes sharing the same epoch transmit in their slots without colliding, or
+ * collide on purpose when given the same slot.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "timer.h"
+
+/*!
+ * Maximum number of slots used by a node in a frame
+ */
+#define SCHEDULER_MAX_SLOTS             32
+
+/*!
+ * Time given to the application to configure the radio before a slot [ms]
+ */
+#define SCHEDULER_PREPARE_TIME          20
+
+/*!
+ * Slot of the frame and the radio profile used in it
+ */
+typedef struct sSchedulerSlot
+{
+    uint16_t Slot; // slot number in the frame
+    uint8_t sf : 3; // same encoding as State
+    uint8_t cr : 2;
+    uint8_t bw : 2;
+    uint8_t pw_index : 3;
+    uint8_t freq_index;
+    uint8_t pkt_size;
+}SchedulerSlot_t;
+
+/*!
+ * Synchronisation source of the epoch
+ */
+typedef enum eSchedulerSync
+{
+    SCHEDULER_SYNC_NONE = 0,
+    SCHEDULER_SYNC_PPS,
+    SCHEDULER_SYNC_BEACON,
+}SchedulerSync_t;
+
+/*!
+ * Scheduler callbacks, called from the timer interrupt
+ */
+typedef struct sSchedulerEvents
+{
+    /*!
+     * \brief Slot starts in SCHEDULER_PREPARE_TIME ms, configure the radio
+     */
+    void ( *Prepare )( const SchedulerSlot_t *slot );
+    /*!
+     * \brief Slot starts now, send the prepared packet
+     */
+    void ( *Start )( const SchedulerSlot_t *slot );
+}SchedulerEvents_t;
+
+/*!
+ * \brief Initializes the scheduler
+ *
+ * \param [IN] events scheduler callbacks
+ */
+void SchedulerInit(SchedulerEvents_t *events);
+
+/*!
+ * \brief Sets the frame layout and the slots used by this node
+ *
+ * \param [IN] slotLength    slot length [ms]
+ * \param [IN] slotsPerFrame number of slots in a frame
+ * \param [IN] slots         slots used by this node, any order
+ * \param [IN] count         number of slots
+ * \retval status            false when the table does not fit the frame
+ */
+bool SchedulerSetTable(uint16_t slotLength, uint16_t slotsPerFrame, const SchedulerSlot_t *slots, uint8_t count);
+
+/*!
+ * \brief Synchronises the epoch on a GPS PPS edge
+ *
+ * \param [IN] ppsTime    timer time of the edge
+ * \param [IN] utcSeconds UTC second of day marked by the edge
+ */
+void SchedulerSyncPps(TimerTime_t ppsTime, uint32_t utcSeconds);
+
+/*!
+ * \brief Synchronises the epoch on a beacon
+ *
+ * \remark Beacons only synchronise the epoch while no PPS has been seen for
+ *         a few seconds.
+ *
+ * \param [IN] rxTime    timer time at which the beacon ended
+ * \param [IN] epochTime epoch time of the end of the beacon [ms]
+ */
+void SchedulerSyncBeacon(TimerTime_t rxTime, uint32_t epochTime);
+
+/*!
+ * \brief Gets the current synchronisation source
+ */
+SchedulerSync_t SchedulerGetSync(void);
+
+/*!
+ * \brief Starts the slotted transmissions once the epoch is known
+ */
+void SchedulerStart(void);
+
+/*!
+ * \brief Stops the slotted transmissions
+ */
+void SchedulerStop(void);
+
+/*!
+ * \brief Indicates if slotted transmissions are running
+ */
+bool SchedulerIsRunning(void);
+
+#endif // __SCHEDULER_H__
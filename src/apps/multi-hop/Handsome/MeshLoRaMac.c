@@ -0,0 +1,2059 @@
+/*!
+ * \file      MeshLoRaMac.c
+ *
+ * \brief     Mesh LoRa MAC engine
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <stdio.h>
+#include <string.h>
+#include "utilities.h"
+#include "serialio.h"
+#include "MeshLoRaMac.h"
+
+/*
+* events, the radio and timer ones are posted from the interrupts
+*/
+typedef enum eMeshLoRaMacEvent
+{
+    MESH_EVENT_RX_DONE,
+    MESH_EVENT_RX_TIMEOUT,
+    MESH_EVENT_RX_ERROR,
+    MESH_EVENT_TX_DONE,
+    MESH_EVENT_TX_TIMEOUT,
+    MESH_EVENT_CAD_CLEAR,
+    MESH_EVENT_CAD_BUSY,
+    MESH_EVENT_ROUTER_TIMER,
+    MESH_EVENT_DATA_TIMER,
+    MESH_EVENT_BACKOFF_TIMER,
+    MESH_EVENT_DC_TIMER,
+    MESH_EVENT_CAD_TIMER,
+    MESH_EVENT_LPL_TIMER,
+    MESH_EVENT_LPL_CAD_CLEAR,   //CAD results of the low-power listening
+    MESH_EVENT_LPL_CAD_BUSY,
+    //MESH_EVENT_RX_DONE once the frame is classified
+    MESH_EVENT_RX_RTS0,
+    MESH_EVENT_RX_RTS1,
+    MESH_EVENT_RX_ACK0,
+    MESH_EVENT_RX_ACK1,
+    MESH_EVENT_RX_ACK_OTHER,    //ACK to another node
+    MESH_EVENT_RX_ROUTER,
+    MESH_EVENT_RX_DATA,
+    MESH_EVENT_RX_OTHER
+}MeshLoRaMacEvent_t;
+
+/*
+* states: frame exchange in progress, named after the last frame sent
+*/
+typedef enum eMeshLoRaMacState
+{
+    MESH_STATE_IDLE,
+    MESH_STATE_RTS,
+    MESH_STATE_ACK,
+    MESH_STATE_ROUTER,
+    MESH_STATE_DATA,
+    MESH_STATE_RELAY,
+    MESH_STATE_ANY              //table only, matches every state
+}MeshLoRaMacState_t;
+
+/*
+* duty-cycle states
+*/
+typedef enum
+{
+	AWAKE,
+	MID_SLEEP,  //sleep requested, waits for the end of the frame exchange
+	SLEEP
+}DcStates_t;
+
+/*
+* DATA expected after an ACK
+*/
+typedef enum
+{
+    WAIT_DATA_NONE,
+    WAIT_DATA_FIRST,
+    WAIT_DATA_SECOND    //a ROUTER came instead, one more try
+}WaitData_t;
+
+/*
+* link to a neighbour
+*/
+typedef struct sMeshLoRaLink
+{
+    int16_t Rssi;               //dBm, 1/16 units, smoothed
+    int16_t Snr;                //dB, 1/16 units, smoothed
+    uint16_t Pdr;               //RTS1 acknowledged, MESHLORA_LINK_PDR_ONE units, 0: never heard
+    uint8_t Etx;                //MESHLORA_ETX_SCALE per transmission
+}MeshLoRaLink_t;
+
+typedef struct sMeshLoRaMacTransition
+{
+    MeshLoRaMacEvent_t Event;
+    MeshLoRaMacState_t State;
+    void (*Handler)(void);
+}MeshLoRaMacTransition_t;
+
+static const MeshLoRaMacPort_t *Port;
+static MeshLoRaMacCallbacks_t Callbacks;
+static MeshLoRaMacParams_t Params;
+
+/*!
+ * Radio events function pointer
+ */
+static RadioEvents_t RadioEvents;
+
+/*
+* engine state, only changed by the event handlers and the radio callbacks
+*/
+static struct sMeshLoRaMacCtx
+{
+    MeshLoRaMacState_t State;
+    DcStates_t DcState;
+    WaitData_t WaitData;
+    uint8_t MisDataCount;       //frames received instead of the DATA
+    bool GotAck;                //the channel is reserved for our next frame
+    bool RxContinuous;          //radio in Rx(0), stopped before any other operation
+    bool RouterPending;         //a ROUTER packet is to be sent
+    bool ConnectedToGw;
+    bool RouterTimerStarted;
+    int8_t TxFreqInd;           //-1: Params.Frequency, otherwise freq_hop index
+    int8_t RxFreqInd;
+    uint8_t CadDetectTime;      //free CADs in a row
+    bool LplCad;                //the CAD in progress samples the channel for the low-power listening
+    uint8_t RtsAddr;            //destination of the last RTS
+    MeshLoRaRadioProfile_t Profile;     //packet format of the radio
+}Mac;
+
+/*
+* Trickle schedule of the ROUTER packets: each interval, the ROUTER is sent at
+* a random time of its second half unless ROUTER_REDUNDANCY consistent ones
+* were heard before. The interval doubles up to ROUTER_MAX_INTERVAL and goes
+* back to ROUTER_MIN_INTERVAL when the route changes.
+*/
+static struct sMeshLoRaTrickle
+{
+    uint32_t Interval;          //ms, I
+    uint32_t TxTime;            //ms from the start of the interval, t
+    uint8_t Counter;            //consistent ROUTERs heard during the interval, c
+    bool TxTimePassed;          //the timer runs to the end of the interval
+    uint32_t Suppressed;        //ROUTERs not sent, c reached ROUTER_REDUNDANCY
+}Trickle = { ROUTER_MIN_INTERVAL, 0, 0, false, 0 };
+static TimerEvent_t SendRouterTimer, SendDataTimer, BackOffTimer, DutyCycleTimer, CADAgainTimer, LplTimer;
+
+static int32_t relayDataNum[RELAY_NODES];
+static int32_t relaySendDataNum[RELAY_NODES];
+static int32_t nodeSendDataNum = 0;
+static int32_t nodeSendRouterNum = 0;
+
+static DcStats_t dcStats;
+static TimerTime_t dcCycleStart = 0;    //start of the current awake window
+static TimerTime_t dcSleepStart = 0;
+static bool dcSynced = false;
+static TimerTime_t dcParentStart = 0;   //one nominal awake start of the parent
+static TimerTime_t dcParentUpdate = 0;
+
+static const uint32_t freq_hop[HOP_NUM] = {471500000, 472500000, 473500000, 474500000, 476500000, 477500000,
+                          478500000, 479500000};
+
+static uint32_t meshLoRaRouterSequenceNum = 0;
+static int8_t meshLoRaCurrentIndLen = 0;    //indicate nums of dev_addrs
+static uint16_t meshLoRaCurrentInd[MESHLORA_ROUTER_TABLES_LENGTH];  //contain dev_addrs
+static uint16_t meshLoRaNxtAddr[MESHLORA_ROUTER_TABLES_LENGTH];
+static uint8_t  meshLoRaCost[MESHLORA_ROUTER_TABLES_LENGTH];     //path ETX, MESHLORA_ETX_SCALE per transmission
+static uint8_t  meshLoRaAdvCost[MESHLORA_ROUTER_TABLES_LENGTH];  //cost advertised by the next hop
+static MeshLoRaLink_t meshLoRaLinks[MESHLORA_ROUTER_TABLES_LENGTH];
+
+static uint8_t BufferSize = BUFFER_SIZE;
+static uint8_t Buffer[BUFFER_SIZE];  //for rx
+static uint8_t BufferSize_send = BUFFER_SIZE;
+static uint8_t Buffer_send[BUFFER_SIZE];  //for tx
+
+static uint8_t bf_save_data_now = 0, bf_save_data_have = 0, bf_save_relay_now = 0, bf_save_relay_have = 0;
+static uint16_t lost_data = 0, lost_relay = 0;
+static uint8_t Buffer_save_data_len[BUFFER_SAVE_DATA], Buffer_save_relay_len[BUFFER_SAVE_RELAY];
+static uint8_t Buffer_save_data[BUFFER_SAVE_DATA][BUFFER_SIZE], Buffer_save_relay[BUFFER_SAVE_RELAY][BUFFER_SIZE];
+static TimerTime_t Buffer_save_data_time[BUFFER_SAVE_DATA], Buffer_save_relay_time[BUFFER_SAVE_RELAY];  //creation, reception
+
+static int16_t RssiValue = 0;
+static int8_t SnrValue = 0;
+static TimerTime_t RxDoneTime = 0;     //end of the last reception, radio interrupt time
+
+static uint32_t meshLoRaDataSequenceNum = 0;
+
+static volatile uint8_t EventQueue[MESHLORA_EVENT_QUEUE_SIZE];
+static volatile uint8_t EventHead = 0, EventTail = 0;
+static MeshLoRaMacStats_t MacStats;
+
+/*
+* event queue
+*/
+static void MeshLoRaPostEvent(MeshLoRaMacEvent_t event)
+{
+    Port->DisableIrq();
+    if ((uint8_t)(EventTail - EventHead) < MESHLORA_EVENT_QUEUE_SIZE)
+    {
+        EventQueue[EventTail % MESHLORA_EVENT_QUEUE_SIZE] = event;
+        EventTail += 1;
+    }
+    else
+    {
+        MacStats.Dropped += 1;
+    }
+    Port->EnableIrq();
+}
+
+static bool MeshLoRaPopEvent(MeshLoRaMacEvent_t *event)
+{
+    bool found = false;
+
+    Port->DisableIrq();
+    if (EventHead != EventTail)
+    {
+        *event = (MeshLoRaMacEvent_t)EventQueue[EventHead % MESHLORA_EVENT_QUEUE_SIZE];
+        EventHead += 1;
+        found = true;
+    }
+    Port->EnableIrq();
+    return found;
+}
+
+/*
+* packets
+*/
+static bool isMeshLoRaPkts(void)
+{
+    MeshLoRaMacHeader_t mhdr;
+    mhdr.Value = Buffer[0];
+    if (mhdr.Bits.Major == 0 && mhdr.Bits.MType == 7 && mhdr.Bits.RFU == 1)
+    { //packets of mesh lora
+        return true;
+    }
+    return false;
+}
+//CRC-8, polynomial 0x07, seeded with the Mhdr so that other LoRa frames of 4 bytes are rejected
+static uint8_t MeshLoRaCtrlChecksum(const uint8_t *frame)
+{
+    MeshLoRaMacHeader_t mhdr;
+    mhdr.Bits.Major = 0;
+    mhdr.Bits.RFU = 1;
+    mhdr.Bits.MType = 7;
+
+    uint8_t crc = mhdr.Value;
+    for (uint8_t i = 0; i < MESHLORA_CTRL_SIZE - 1; i++)
+    {
+        crc ^= frame[i];
+        for (uint8_t j = 0; j < 8; j++)
+        {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+        }
+    }
+    return crc;
+}
+static bool isMeshLoRaCtrl(void)
+{
+    return BufferSize == MESHLORA_CTRL_SIZE && Buffer[MESHLORA_CTRL_SIZE - 1] == MeshLoRaCtrlChecksum(Buffer);
+}
+static bool isCtrlToDevice(void)
+{
+    return Buffer[1] == (Params.DeviceAddress & 0xFF);
+}
+static bool isToDevice(const uint8_t *addr)
+{
+    return addr[0] == (Params.DeviceAddress & 0xFF) && addr[1] == ((Params.DeviceAddress >> 8) & 0xFF);
+}
+static int isRouterOrData(void) //0 neither 1 router 2 data
+{
+    if (isMeshLoRaPkts())
+    {
+        if (Buffer[1] == 8)
+        {
+            return 1;
+        }
+        else if (Buffer[1] == 10 && isToDevice(&Buffer[7]))
+        {
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+//event of the received frame in Buffer
+static MeshLoRaMacEvent_t MeshLoRaClassifyFrame(void)
+{
+    if (isMeshLoRaCtrl())
+    {
+        switch (Buffer[0] & 0x0F)
+        {
+        case MESHLORA_CTRL_RTS0:
+            return MESH_EVENT_RX_RTS0;
+        case MESHLORA_CTRL_RTS1:
+            return isCtrlToDevice() ? MESH_EVENT_RX_RTS1 : MESH_EVENT_RX_OTHER;
+        case MESHLORA_CTRL_ACK0:
+            return isCtrlToDevice() ? MESH_EVENT_RX_ACK0 : MESH_EVENT_RX_ACK_OTHER;
+        case MESHLORA_CTRL_ACK1:
+            return isCtrlToDevice() ? MESH_EVENT_RX_ACK1 : MESH_EVENT_RX_ACK_OTHER;
+        default:
+            return MESH_EVENT_RX_OTHER;
+        }
+    }
+    switch (isRouterOrData())
+    {
+    case 1:
+        return MESH_EVENT_RX_ROUTER;
+    case 2:
+        return MESH_EVENT_RX_DATA;
+    default:
+        return MESH_EVENT_RX_OTHER;
+    }
+}
+
+/*
+* router table
+*/
+//the cost of the route follows the link to its next hop, which changes with each RTS
+static uint8_t MeshLoRaPathCost(uint8_t advCost, uint16_t nxtAddr)
+{
+    uint16_t etx = MESHLORA_ETX_SCALE;
+
+    if (nxtAddr < MESHLORA_ROUTER_TABLES_LENGTH && meshLoRaLinks[nxtAddr].Pdr != 0)
+    {
+        etx = meshLoRaLinks[nxtAddr].Etx;
+    }
+    return (advCost + etx > 0xFF) ? 0xFF : advCost + etx;
+}
+
+//true when the link to addr is better than the link to cur by its smoothed SNR, then RSSI
+static bool MeshLoRaLinkBetter(uint16_t addr, uint16_t cur)
+{
+    if (addr >= MESHLORA_ROUTER_TABLES_LENGTH || meshLoRaLinks[addr].Pdr == 0)
+    {
+        return false;
+    }
+    if (cur >= MESHLORA_ROUTER_TABLES_LENGTH || meshLoRaLinks[cur].Pdr == 0)
+    {
+        return true;
+    }
+    int16_t snrDiff = meshLoRaLinks[addr].Snr - meshLoRaLinks[cur].Snr;
+    if (snrDiff >= MESHLORA_LINK_SNR_HYSTERESIS * 16)
+    {
+        return true;
+    }
+    if (snrDiff <= -MESHLORA_LINK_SNR_HYSTERESIS * 16)
+    {
+        return false;
+    }
+    return meshLoRaLinks[addr].Rssi - meshLoRaLinks[cur].Rssi >= MESHLORA_LINK_RSSI_HYSTERESIS * 16;
+}
+
+//returns true when the route changed
+static bool MeshLoRaUpdateRouterTable(uint16_t srcAddr, uint16_t desAddr, uint8_t cost)
+{
+    if (desAddr == Params.DeviceAddress)
+    {
+        return false;
+    }
+
+    //only to sink path
+    if (desAddr != Params.GatewayAddress)
+    {
+        return false;
+    }
+
+    //find desAddr
+    int8_t desInd = -1;
+    for (uint8_t i = 0; i < meshLoRaCurrentIndLen; i++)
+    {
+        //to do sort then search will be more effect
+        if (meshLoRaCurrentInd[i] == desAddr)
+        {
+            desInd = i;
+            break;
+        }
+    }
+
+    uint8_t pathCost = MeshLoRaPathCost(cost, srcAddr);
+    if (desInd == -1)
+    { //don't have, just add
+        meshLoRaCurrentInd[meshLoRaCurrentIndLen] = desAddr;
+        meshLoRaCurrentIndLen += 1;
+    }
+    else if (srcAddr == meshLoRaNxtAddr[desAddr])
+    { //same next hop, its cost may have gone up as well as down
+        meshLoRaAdvCost[desAddr] = cost;
+        meshLoRaCost[desAddr] = pathCost;
+        return false;
+    }
+    else if (pathCost + MESHLORA_ROUTE_HYSTERESIS >= meshLoRaCost[desAddr] &&
+             (pathCost > meshLoRaCost[desAddr] || !MeshLoRaLinkBetter(srcAddr, meshLoRaNxtAddr[desAddr])))
+    { //not better enough to change, a route as cheap still wins by the signal of its next hop
+        return false;
+    }
+
+    meshLoRaNxtAddr[desAddr] = srcAddr;
+    meshLoRaAdvCost[desAddr] = cost;
+    meshLoRaCost[desAddr] = pathCost;
+    if (desAddr == Params.GatewayAddress)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("%d to GW by %d, cost %d\n", Params.DeviceAddress, srcAddr, pathCost);
+        }
+        Mac.RouterPending = true;
+    }
+    meshLoRaRouterSequenceNum = 0;
+    return true;
+}
+
+static void MeshLoRaAddRelayToRouterTable(void)
+{
+    meshLoRaCurrentIndLen += 1;
+    meshLoRaCurrentInd[meshLoRaCurrentIndLen - 1] = Params.GatewayAddress;
+    meshLoRaNxtAddr[Params.GatewayAddress] = Params.FixedRelayAddress;
+    meshLoRaCost[Params.GatewayAddress] = 0;
+    meshLoRaAdvCost[Params.GatewayAddress] = 0;
+}
+
+static void MeshLoRaRouterTableInit(void)
+{
+    meshLoRaCurrentIndLen += 1;
+    meshLoRaCurrentInd[meshLoRaCurrentIndLen - 1] = Params.DeviceAddress;
+    meshLoRaNxtAddr[Params.DeviceAddress] = Params.DeviceAddress;
+    meshLoRaCost[Params.DeviceAddress] = 0;
+    meshLoRaAdvCost[Params.DeviceAddress] = 0;
+}
+
+/*
+* ROUTER advertisement
+*/
+static void MeshLoRaTrickleNewInterval(void)
+{
+    Trickle.Counter = 0;
+    Trickle.TxTimePassed = false;
+    Trickle.TxTime = randr(Trickle.Interval / 2, Trickle.Interval - 1);
+    TimerStop(&SendRouterTimer);
+    TimerSetValue(&SendRouterTimer, Trickle.TxTime);
+    TimerStart(&SendRouterTimer);
+}
+
+//started by the first ROUTER sent or, with a fixed relay, heard
+static void MeshLoRaTrickleStart(void)
+{
+    if (Mac.RouterTimerStarted)
+    {
+        return;
+    }
+    Mac.RouterTimerStarted = true;
+    Trickle.Interval = ROUTER_MIN_INTERVAL;
+    MeshLoRaTrickleNewInterval();
+}
+
+//inconsistency: the route changed, advertise it quickly again
+static void MeshLoRaTrickleReset(void)
+{
+    if (!Mac.RouterTimerStarted || Trickle.Interval == ROUTER_MIN_INTERVAL)
+    {
+        return;
+    }
+    Trickle.Interval = ROUTER_MIN_INTERVAL;
+    MeshLoRaTrickleNewInterval();
+}
+
+/*
+* link estimator, neighbours indexed by address like the router table
+*/
+static uint8_t MeshLoRaLinkEtx(uint16_t pdr)
+{
+    uint32_t etx = (MESHLORA_ETX_SCALE * MESHLORA_LINK_PDR_ONE) / pdr;
+    return (etx > MESHLORA_ETX_MAX) ? MESHLORA_ETX_MAX : etx;
+}
+
+//a frame of addr was received, RssiValue and SnrValue are its signal
+static void MeshLoRaLinkHeard(uint16_t addr)
+{
+    if (addr >= MESHLORA_ROUTER_TABLES_LENGTH || addr == Params.DeviceAddress)
+    {
+        return;
+    }
+    MeshLoRaLink_t *link = &meshLoRaLinks[addr];
+    if (link->Pdr == 0)
+    { //first frame, the delivery ratio starts from the SNR margin
+        int16_t below = MESHLORA_LINK_SNR_GOOD - SnrValue;
+        link->Rssi = RssiValue * 16;
+        link->Snr = SnrValue * 16;
+        link->Pdr = MESHLORA_LINK_PDR_ONE;
+        if (below > 0)
+        {
+            link->Pdr = (below >= 7) ? MESHLORA_LINK_PDR_ONE / 8 : MESHLORA_LINK_PDR_ONE - below * (MESHLORA_LINK_PDR_ONE / 8);
+        }
+        link->Etx = MeshLoRaLinkEtx(link->Pdr);
+        return;
+    }
+    link->Rssi += (RssiValue * 16 - link->Rssi) / (1 << MESHLORA_LINK_SHIFT);
+    link->Snr += (SnrValue * 16 - link->Snr) / (1 << MESHLORA_LINK_SHIFT);
+}
+
+//RTS1 to addr acknowledged or not
+static void MeshLoRaLinkDelivery(uint16_t addr, bool acked)
+{
+    if (addr >= MESHLORA_ROUTER_TABLES_LENGTH)
+    {
+        return;
+    }
+    MeshLoRaLink_t *link = &meshLoRaLinks[addr];
+    if (link->Pdr == 0)
+    {
+        link->Pdr = MESHLORA_LINK_PDR_ONE;
+    }
+    link->Pdr -= link->Pdr / (1 << MESHLORA_LINK_SHIFT);
+    if (acked)
+    {
+        link->Pdr += MESHLORA_LINK_PDR_ONE / (1 << MESHLORA_LINK_SHIFT);
+    }
+    link->Etx = MeshLoRaLinkEtx(link->Pdr);
+
+    if (!Params.FixedRelay && Mac.ConnectedToGw && meshLoRaNxtAddr[Params.GatewayAddress] == addr)
+    {
+        meshLoRaCost[Params.GatewayAddress] = MeshLoRaPathCost(meshLoRaAdvCost[Params.GatewayAddress], addr);
+    }
+}
+
+//the control frames carry the neighbour address, the ROUTER its own
+static void MeshLoRaLinkHeardFrame(MeshLoRaMacEvent_t event)
+{
+    if (isMeshLoRaCtrl())
+    {
+        MeshLoRaLinkHeard(Buffer[2]);
+    }
+    else if (event == MESH_EVENT_RX_ROUTER)
+    {
+        MeshLoRaLinkHeard(Buffer[5] | (Buffer[6] << 8));
+    }
+}
+
+/*
+* duty-cycle
+*/
+//phase advertised in ROUTER packets: ms since the nominal start of the awake window
+static uint16_t MeshLoRaDcGetPhase(void)
+{
+    if (!DC_SYNC_ENABLE || Params.DeviceAddress == Params.GatewayAddress || Params.LplInterval != 0)
+    {
+        return DC_PHASE_ALWAYS_ON;
+    }
+    //synchronized nodes wake up DC_SYNC_GUARD ahead of the nominal start
+    TimerTime_t nominalStart = dcCycleStart + (dcSynced ? DC_SYNC_GUARD : 0);
+    return (Port->GetTime() + DC_PERIOD - nominalStart) % DC_PERIOD;
+}
+
+//time to sleep so that the next awake window starts on the schedule
+static uint32_t MeshLoRaDcSleepTime(TimerTime_t now)
+{
+    if (!DC_SYNC_ENABLE)
+    {
+        return SLEEPTIME;
+    }
+    //synchronized: DC_SYNC_GUARD before the parent, otherwise keep our own period
+    TimerTime_t wake = dcSynced ? dcParentStart - DC_SYNC_GUARD : dcCycleStart;
+    uint32_t sleepTime = DC_PERIOD - (now - wake) % DC_PERIOD;
+    if (sleepTime < DC_MIN_SLEEPTIME)
+    {
+        sleepTime += DC_PERIOD;
+    }
+    return sleepTime;
+}
+
+static void MeshLoRaDcStartSleep(void)
+{
+    TimerTime_t now = Port->GetTime();
+    dcStats.AwakeTime += now - dcCycleStart;
+    dcSleepStart = now;
+    TimerStop(&DutyCycleTimer);
+    TimerSetValue(&DutyCycleTimer, MeshLoRaDcSleepTime(now));
+    TimerStart(&DutyCycleTimer);
+}
+
+//every DC_REPORT_CYCLES duty-cycles, or as often with the low-power listening
+static void MeshLoRaReport(void)
+{
+    uint32_t latencyAvg = (dcStats.LatencyCnt > 0) ? dcStats.LatencySum / dcStats.LatencyCnt : 0;
+
+    if (Params.LplInterval != 0)
+    {
+        log_info("lpl cad %d, wake %d, rts %d/%d, lat avg %d max %dms\n", dcStats.LplSamples,
+               dcStats.LplWakeups, dcStats.RtsAcked, dcStats.RtsSent, latencyAvg, dcStats.LatencyMax);
+    }
+    else
+    {
+        log_info("dc awake %d/%dms, rts %d/%d, lat avg %d max %dms\n", dcStats.AwakeTime,
+               dcStats.AwakeTime + dcStats.SleepTime,
+               dcStats.RtsAcked, dcStats.RtsSent, latencyAvg, dcStats.LatencyMax);
+    }
+    log_info("mac evt %d, drop %d, max %dms, busy %dms\n", MacStats.Events, MacStats.Dropped,
+           MacStats.MaxTime, MacStats.BusyTime);
+    log_info("router sent %d, suppressed %d, interval %dms\n", nodeSendRouterNum, Trickle.Suppressed,
+           Trickle.Interval);
+    uint16_t nxtAddr = meshLoRaNxtAddr[Params.GatewayAddress];
+    if (Mac.ConnectedToGw && nxtAddr < MESHLORA_ROUTER_TABLES_LENGTH)
+    {
+        log_info("route by %d, cost %d, etx %d, rssi %d, snr %d\n", nxtAddr,
+               meshLoRaCost[Params.GatewayAddress], meshLoRaLinks[nxtAddr].Etx,
+               meshLoRaLinks[nxtAddr].Rssi / 16, meshLoRaLinks[nxtAddr].Snr / 16);
+    }
+    if (Callbacks.OnReport != NULL)
+    {
+        Callbacks.OnReport();
+    }
+}
+
+static void MeshLoRaDcStartAwake(void)
+{
+    TimerTime_t now = Port->GetTime();
+    dcStats.SleepTime += now - dcSleepStart;
+    dcStats.Cycles += 1;
+    dcCycleStart = now;
+
+    if (dcSynced && now - dcParentUpdate > DC_SYNC_TIMEOUT)
+    { //parent not heard for long, its phase is no longer trusted
+        dcSynced = false;
+        log_info("dc unsync\n");
+    }
+
+    if (dcStats.Cycles % DC_REPORT_CYCLES == 0)
+    {
+        MeshLoRaReport();
+    }
+
+    TimerSetValue(&DutyCycleTimer, dcSynced ? DC_SYNC_AWAKETIME + 2 * DC_SYNC_GUARD : AWAKETIME);
+    TimerStart(&DutyCycleTimer);
+}
+
+//the duty-cycle asked for sleep during a frame exchange, which is over
+static void MeshLoRaDcSleep(void)
+{
+    //begin duty-cycle
+    Mac.DcState = SLEEP;
+    log_info("(%d)sleep\n", Port->GetTime());
+    MeshLoRaDcStartSleep();
+}
+
+static bool MeshLoRaDcSleepIfRequested(void)
+{
+    if (Mac.DcState != MID_SLEEP)
+    {
+        return false;
+    }
+    MeshLoRaDcSleep();
+    return true;
+}
+
+//learn the awake window of the parent from its ROUTER packet in Buffer
+static void MeshLoRaDcLearnPhase(void)
+{
+    uint16_t srcAddr = Buffer[5] | (Buffer[6] << 8);
+    uint8_t phaseInd = 8 + Buffer[7] * 3;
+
+    if (!DC_SYNC_ENABLE || Params.DeviceAddress == Params.GatewayAddress || Params.LplInterval != 0)
+    {
+        return;
+    }
+    //older nodes do not advertise their phase
+    if (BufferSize < phaseInd + 2 || srcAddr != meshLoRaNxtAddr[Params.GatewayAddress])
+    {
+        return;
+    }
+    uint16_t phase = Buffer[phaseInd] | (Buffer[phaseInd + 1] << 8);
+    if (phase >= DC_PERIOD)
+    { //always-on parent, nothing to align on
+        return;
+    }
+
+    TimerTime_t parentStart = RxDoneTime - Port->Radio->TimeOnAir(MODEM_LORA, BufferSize) - phase;
+    uint32_t shift = (parentStart + DC_PERIOD - dcParentStart) % DC_PERIOD;
+    if (!dcSynced || (shift > DC_SYNC_TOLERANCE && shift < DC_PERIOD - DC_SYNC_TOLERANCE))
+    {
+        log_info("dc sync on %d, phase %d\n", srcAddr, phase);
+    }
+    bool wasSynced = dcSynced;
+    dcParentStart = parentStart;
+    dcParentUpdate = Port->GetTime();
+    dcSynced = true;
+
+    if (!wasSynced && Mac.DcState == SLEEP)
+    { //realign the current sleep
+        MeshLoRaDcStartSleep();
+    }
+}
+
+/*
+* prepare frame
+*/
+//control frame in Buffer_send, type in the low nibble, freq_hop index in the high one
+static void MeshLoRaPrepareCtrlFrame(uint8_t type, uint8_t desAddr)
+{
+    memset1(Buffer_send, 0, BUFFER_SIZE);
+    Buffer_send[0] = type;
+    Buffer_send[1] = desAddr;
+    Buffer_send[2] = Params.DeviceAddress & 0xFF;
+    Buffer_send[3] = MeshLoRaCtrlChecksum(Buffer_send);
+    BufferSize_send = MESHLORA_CTRL_SIZE;
+}
+
+static void MeshLoRaPrepareFrame(MeshLoRaMacState_t frame)
+{
+    if (frame == MESH_STATE_RTS)
+    {
+        memset1(Buffer_send, 0, BUFFER_SIZE);
+        BufferSize_send = 0;
+
+        if ((bf_save_relay_now != bf_save_relay_have) || (bf_save_data_now != bf_save_data_have))
+        {
+            Mac.RtsAddr = meshLoRaNxtAddr[Params.GatewayAddress] & 0xFF;
+            MeshLoRaPrepareCtrlFrame(MESHLORA_CTRL_RTS1, Mac.RtsAddr);
+        }
+        else if (Mac.RouterPending)
+        {
+            Mac.RtsAddr = MESHLORA_CTRL_BROADCAST;
+            MeshLoRaPrepareCtrlFrame(MESHLORA_CTRL_RTS0, MESHLORA_CTRL_BROADCAST);
+        }
+    }
+    else if (frame == MESH_STATE_ACK)
+    {
+        //RTS in Buffer, its source is the destination of the ACK
+        if ((Buffer[0] & 0x0F) == MESHLORA_CTRL_RTS0)
+        {
+            MeshLoRaPrepareCtrlFrame(MESHLORA_CTRL_ACK0, Buffer[2]);
+        }
+        else if ((Buffer[0] & 0x0F) == MESHLORA_CTRL_RTS1)
+        {
+            uint8_t freq_hop_ind = randr(0, HOP_NUM - 1);
+            Mac.RxFreqInd = freq_hop_ind;
+            MeshLoRaPrepareCtrlFrame(MESHLORA_CTRL_ACK1 | (freq_hop_ind << 4), Buffer[2]);
+        }
+    }
+    else if (frame == MESH_STATE_ROUTER)
+    {
+        memset1(Buffer_send, 0, BUFFER_SIZE);
+        BufferSize_send = 0;
+        //empty router table
+        if (meshLoRaCurrentIndLen == 0)
+        {
+            return;
+        }
+
+        MeshLoRaFrameHeader_t meshLoRaFrHd;
+        uint8_t i = 0;
+
+        //Mhdr
+        meshLoRaFrHd.Mhdr.Bits.Major = 0;
+        meshLoRaFrHd.Mhdr.Bits.RFU = 1;
+        meshLoRaFrHd.Mhdr.Bits.MType = 7;
+
+        if (Params.DeviceAddress == Params.GatewayAddress)
+        {
+            meshLoRaFrHd.FrameType = (1 << 8) | 8;
+        }
+        else
+        {
+            meshLoRaFrHd.FrameType = (0 << 8) | 8;
+        }
+
+        meshLoRaFrHd.FrameCnt = meshLoRaRouterSequenceNum % 255;
+        meshLoRaRouterSequenceNum += 1;
+
+        meshLoRaFrHd.FramePayloadLen = 3 * meshLoRaCurrentIndLen + 3 + 2;
+
+        //header
+        Buffer_send[BufferSize_send++] = meshLoRaFrHd.Mhdr.Value;
+        Buffer_send[BufferSize_send++] = meshLoRaFrHd.FrameType & 0xFF;
+        Buffer_send[BufferSize_send++] = (meshLoRaFrHd.FrameType >> 8) & 0xFF;
+        Buffer_send[BufferSize_send++] = meshLoRaFrHd.FrameCnt;
+        Buffer_send[BufferSize_send++] = meshLoRaFrHd.FramePayloadLen;
+
+        //payload
+        Buffer_send[BufferSize_send++] = Params.DeviceAddress & 0xFF;
+        Buffer_send[BufferSize_send++] = (Params.DeviceAddress >> 8) & 0xFF;
+        Buffer_send[BufferSize_send++] = meshLoRaCurrentIndLen;
+
+        //des addr
+        for (i = 0; i < meshLoRaCurrentIndLen; i++)
+        {
+            Buffer_send[BufferSize_send++] = meshLoRaCurrentInd[i] & 0xFF;
+            Buffer_send[BufferSize_send++] = (meshLoRaCurrentInd[i] >> 8) & 0xFF;
+        }
+
+        //cost
+        for (i = 0; i < meshLoRaCurrentIndLen; i++)
+        {
+            Buffer_send[BufferSize_send++] = meshLoRaCost[meshLoRaCurrentInd[i]];
+        }
+
+        //duty-cycle phase
+        uint16_t phase = MeshLoRaDcGetPhase();
+        Buffer_send[BufferSize_send++] = phase & 0xFF;
+        Buffer_send[BufferSize_send++] = (phase >> 8) & 0xFF;
+    }
+    else if (frame == MESH_STATE_DATA)
+    {
+        uint8_t buffer_tmp[BUFFER_SIZE];
+        uint8_t buffer_size_tmp = 0;
+        memset1(buffer_tmp, 0, BUFFER_SIZE);
+
+        MeshLoRaFrameHeader_t meshLoRaFrHd;
+        uint8_t appDataLen = 0;
+
+        if (Callbacks.GetAppData != NULL)
+        {
+            appDataLen = Callbacks.GetAppData(buffer_tmp + 9, MESHLORA_APPDATA_MAX_LENGTH);
+        }
+        if (appDataLen == 0 || appDataLen > MESHLORA_APPDATA_MAX_LENGTH)
+        {
+            return;
+        }
+
+        //Mhdr
+        meshLoRaFrHd.Mhdr.Bits.Major = 0;
+        meshLoRaFrHd.Mhdr.Bits.RFU = 1;
+        meshLoRaFrHd.Mhdr.Bits.MType = 7;
+
+        meshLoRaFrHd.FrameType = (0 << 8) | 10;
+
+        meshLoRaFrHd.FrameCnt = meshLoRaDataSequenceNum % 255;
+        meshLoRaDataSequenceNum += 1;
+
+        meshLoRaFrHd.FramePayloadLen = 4 + appDataLen;
+
+        //header
+        buffer_tmp[buffer_size_tmp++] = meshLoRaFrHd.Mhdr.Value;
+        buffer_tmp[buffer_size_tmp++] = meshLoRaFrHd.FrameType & 0xFF;
+        buffer_tmp[buffer_size_tmp++] = (meshLoRaFrHd.FrameType >> 8) & 0xFF;
+        buffer_tmp[buffer_size_tmp++] = meshLoRaFrHd.FrameCnt;
+        buffer_tmp[buffer_size_tmp++] = meshLoRaFrHd.FramePayloadLen;
+
+        //payload
+        buffer_tmp[buffer_size_tmp++] = Params.DeviceAddress & 0xFF;
+        buffer_tmp[buffer_size_tmp++] = (Params.DeviceAddress >> 8) & 0xFF;
+        //des addr
+        buffer_tmp[buffer_size_tmp++] = meshLoRaNxtAddr[Params.GatewayAddress] & 0xFF;
+        buffer_tmp[buffer_size_tmp++] = (meshLoRaNxtAddr[Params.GatewayAddress] >> 8) & 0xFF;
+
+        //AppData already in place
+        buffer_size_tmp += appDataLen;
+
+        //add to save buffer
+        if ((bf_save_data_have + 1) % BUFFER_SAVE_DATA == bf_save_data_now)
+        { //full
+            lost_data += 1;
+            log_info("lst data: %d\n", lost_data);
+        }
+        else
+        {
+            memset1(Buffer_save_data[bf_save_data_have], 0, BUFFER_SIZE);
+            memcpy1(Buffer_save_data[bf_save_data_have], buffer_tmp, buffer_size_tmp);
+            Buffer_save_data_len[bf_save_data_have] = buffer_size_tmp;
+            Buffer_save_data_time[bf_save_data_have] = Port->GetTime();
+            bf_save_data_have += 1;
+            bf_save_data_have = bf_save_data_have % BUFFER_SAVE_DATA;
+        }
+    }
+}
+
+/*
+* radio operations
+*/
+//-1 is the default channel, otherwise a freq_hop index given by an ACK1
+static void MeshLoRaSetChannel(int8_t freqInd)
+{
+    if (SHOW_FREQ_HOP)
+    {
+        log_debug("freq_ind %d\n", freqInd);
+    }
+    Port->Radio->SetChannel((freqInd == -1) ? Params.Frequency : freq_hop[freqInd]);
+}
+
+//only the registers of the packet format are written, and only when the profile changes
+static void MeshLoRaSetProfile(MeshLoRaRadioProfile_t profile)
+{
+    if (Port->SetProfile == NULL || Mac.Profile == profile)
+    {
+        return;
+    }
+    Port->SetProfile(profile);
+    Mac.Profile = profile;
+}
+
+//the idle nodes and the RTS use the wake-up preamble with the low-power listening
+static MeshLoRaRadioProfile_t MeshLoRaIdleProfile(void)
+{
+    return (Params.LplInterval != 0) ? MESHLORA_PROFILE_WAKEUP : MESHLORA_PROFILE_CONTROL;
+}
+
+static void MeshLoRaRx(uint32_t timeout, MeshLoRaRadioProfile_t profile)
+{
+    MeshLoRaSetProfile(profile);
+    MeshLoRaSetChannel(Mac.RxFreqInd);
+    Port->Radio->Rx(timeout);
+}
+
+static void MeshLoRaSend(uint8_t *buffer, uint8_t size, MeshLoRaRadioProfile_t profile)
+{
+    MeshLoRaSetProfile(profile);
+    if (SHOW_TIMEONAIR)
+    {
+        log_debug("TAir %d %dms\n", size, Port->Radio->TimeOnAir(MODEM_LORA, size));
+    }
+    Port->DelayMs(1);
+    MeshLoRaSetChannel(Mac.TxFreqInd);
+    Port->Radio->Send(buffer, size);
+}
+
+//the continuous reception is stopped before any other radio operation
+static void MeshLoRaStopRxContinuous(bool delay)
+{
+    if (Mac.RxContinuous)
+    {
+        //printf("stby\n");
+        if (Params.LplInterval != 0)
+        {
+            TimerStop(&LplTimer);
+            Mac.LplCad = false;
+        }
+        Port->Radio->Standby();
+        Mac.RxContinuous = false;
+        if (delay)
+        {
+            Port->DelayMs(1);
+        }
+    }
+}
+
+//sleeps and samples the channel every LplInterval until a preamble is found
+static void MeshLoRaLplStart(void)
+{
+    MeshLoRaSetProfile(MESHLORA_PROFILE_WAKEUP);
+    MeshLoRaSetChannel(Mac.RxFreqInd);
+    if (Port->Radio->SetRxDutyCycle != NULL)
+    { //the radio samples by itself and reports the frame, [15.625us steps]
+        Port->Radio->SetRxDutyCycle(LPL_SAMPLE_TIME * 64, (Params.LplInterval - LPL_SAMPLE_TIME) * 64);
+        return;
+    }
+    Port->Radio->Sleep();
+    TimerSetValue(&LplTimer, Params.LplInterval);
+    TimerStart(&LplTimer);
+}
+
+//listens until the next frame, unless the duty-cycle waits to sleep
+static void MeshLoRaRxContinuous(void)
+{
+    if (Mac.DcState == MID_SLEEP)
+    {
+        Port->Radio->Sleep();
+        MeshLoRaDcSleep();
+        return;
+    }
+    if (Params.LplInterval != 0 && Params.DeviceAddress != Params.GatewayAddress)
+    {
+        MeshLoRaLplStart();
+    }
+    else
+    {
+        MeshLoRaRx(0, MeshLoRaIdleProfile());
+    }
+    Mac.RxContinuous = true;
+}
+
+static void MeshLoRaSendAck(void)
+{
+    Mac.State = MESH_STATE_ACK;
+    MeshLoRaPrepareFrame(MESH_STATE_ACK);
+    Mac.WaitData = WAIT_DATA_FIRST;
+    Mac.MisDataCount = 0;
+    MeshLoRaSend(Buffer_send, BufferSize_send, MESHLORA_PROFILE_CONTROL);
+}
+
+static void MeshLoRaSendRts(void)
+{
+    Mac.State = MESH_STATE_RTS;
+    MeshLoRaPrepareFrame(MESH_STATE_RTS);
+    dcStats.RtsSent += 1;
+    MeshLoRaSend(Buffer_send, BufferSize_send, MeshLoRaIdleProfile());
+}
+
+//copies a saved DATA frame to Buffer_send and stamps the time it spent here,
+//since its creation or its reception; the saved copy stays as it is for the retries
+static void MeshLoRaStampFrame(const uint8_t *frame, uint8_t size, TimerTime_t since)
+{
+    uint32_t stamp = Port->GetTime() - since;
+
+    memcpy1(Buffer_send, frame, size);
+    BufferSize_send = size;
+    if (size + MESHLORA_HOP_STAMP_SIZE > BUFFER_SIZE)
+    {
+        return;
+    }
+    stamp = (stamp > 0xFFFF) ? 0xFFFF : stamp;
+    Buffer_send[BufferSize_send++] = stamp & 0xFF;
+    Buffer_send[BufferSize_send++] = (stamp >> 8) & 0xFF;
+}
+
+//the DATA frame in Buffer reached the gateway, returns the AppData size
+static uint8_t MeshLoRaDataInfo(MeshLoRaDataInfo_t *info)
+{
+    uint8_t appDataLen = (BufferSize > 9) ? BufferSize - 9 : 0;
+    uint8_t size = 5 + Buffer[4];
+
+    info->Seq = Buffer[3];
+    info->Hops = 0;
+    info->Stamps = Buffer + BufferSize;
+    info->Delay = 0;
+    info->Rssi = RssiValue;
+    info->Snr = SnrValue;
+    //FramePayloadLen ends the AppData, the stamps follow
+    if (Buffer[4] >= 4 && size <= BufferSize)
+    {
+        appDataLen = Buffer[4] - 4;
+        info->Hops = (BufferSize - size) / MESHLORA_HOP_STAMP_SIZE;
+        info->Stamps = Buffer + size;
+    }
+    //no common clock, each hop adds its stamp and the airtime of the frame it sent
+    for (uint8_t i = 0; i < info->Hops; i++)
+    {
+        size += MESHLORA_HOP_STAMP_SIZE;
+        info->Delay += info->Stamps[2 * i] | (info->Stamps[2 * i + 1] << 8);
+        info->Delay += Port->Radio->TimeOnAir(MODEM_LORA, size);
+    }
+    return appDataLen;
+}
+
+//sends the RELAY, DATA or ROUTER frame once an ACK reserved the channel,
+//otherwise starts the RTS/ACK handshake with a CAD
+static void MeshLoRaTransmit(MeshLoRaMacState_t frame)
+{
+    if (!Mac.GotAck)
+    {
+        MeshLoRaStopRxContinuous(true);
+        Port->Radio->StartCad();
+        return;
+    }
+
+    MeshLoRaStopRxContinuous(false);
+    Mac.State = frame;
+    if (frame == MESH_STATE_RELAY)
+    {
+        MeshLoRaStampFrame(Buffer_save_relay[bf_save_relay_now], Buffer_save_relay_len[bf_save_relay_now], Buffer_save_relay_time[bf_save_relay_now]);
+        MeshLoRaSend(Buffer_send, BufferSize_send, MESHLORA_PROFILE_DATA);
+    }
+    else if (frame == MESH_STATE_DATA)
+    {
+        MeshLoRaStampFrame(Buffer_save_data[bf_save_data_now], Buffer_save_data_len[bf_save_data_now], Buffer_save_data_time[bf_save_data_now]);
+        MeshLoRaSend(Buffer_send, BufferSize_send, MESHLORA_PROFILE_DATA);
+    }
+    else
+    {
+        MeshLoRaPrepareFrame(MESH_STATE_ROUTER);
+        MeshLoRaSend(Buffer_send, BufferSize_send, MESHLORA_PROFILE_DATA);
+    }
+}
+
+//relay first, then own data, then ROUTER, otherwise listen; id tells the callers apart in the logs
+static void MeshLoRaSendNext(uint8_t id)
+{
+    if (bf_save_relay_now != bf_save_relay_have)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("relayData\n");
+        }
+        MeshLoRaTransmit(MESH_STATE_RELAY);
+    }
+    else if (bf_save_data_now != bf_save_data_have && Mac.ConnectedToGw)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("sendData\n");
+        }
+        MeshLoRaTransmit(MESH_STATE_DATA);
+    }
+    else if (Mac.RouterPending)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("sendRouter\n");
+        }
+        MeshLoRaTransmit(MESH_STATE_ROUTER);
+    }
+    else if (Port->Radio->GetStatus() == RF_IDLE)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("rx%d 0\n", id);
+        }
+        MeshLoRaRxContinuous();
+    }
+    else
+    {
+        log_warn("stil%d %d\n", id, Port->Radio->GetStatus());
+    }
+}
+
+//decide how to do after rx data or not
+static void checkAndSendPkts(bool getData)
+{
+    if (getData && Mac.WaitData == WAIT_DATA_FIRST)
+    { //a ROUTER came instead of the DATA, wait once more
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("dt2 Rx %d\n", WAITFORDATATIME);
+        }
+        Mac.WaitData = WAIT_DATA_SECOND;
+        MeshLoRaRx(WAITFORDATATIME, MESHLORA_PROFILE_DATA);
+        return;
+    }
+    if (Mac.WaitData != WAIT_DATA_NONE)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            if (getData)
+            {
+                log_debug("dt0\n");
+            }
+            else
+            {
+                log_debug("mis\n");
+            }
+        }
+        Mac.WaitData = WAIT_DATA_NONE;
+    }
+    MeshLoRaSendNext(getData ? 1 : 2);
+}
+
+//an ACK was sent: other frames than ROUTER and DATA are ignored twice while waiting for the DATA
+static bool MeshLoRaKeepWaitingData(void)
+{
+    if (Mac.WaitData != WAIT_DATA_FIRST)
+    {
+        return false;
+    }
+    if (Mac.MisDataCount == 2)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("mis out\n");
+        }
+        Mac.MisDataCount = 0;
+        Mac.WaitData = WAIT_DATA_NONE;
+        Mac.RxFreqInd = -1;
+        return false;
+    }
+    Mac.MisDataCount += 1;
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("%d, mis %d\n", BufferSize, Mac.MisDataCount);
+    }
+    MeshLoRaRx(WAITFORDATATIME, MESHLORA_PROFILE_DATA);
+    return true;
+}
+
+/*
+* handlers of the received frames
+*/
+static void OnRxRts0(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("rx rts0\n");
+    }
+    MeshLoRaSendAck();
+}
+static void OnRxRts1(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("rx rts1\n");
+    }
+    if (bf_save_relay_now == (bf_save_relay_have + 1) % BUFFER_SAVE_RELAY)
+    { //already have frames to relay
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("fulRe\n");
+        }
+        MeshLoRaTransmit(MESH_STATE_RELAY);
+    }
+    else
+    {
+        //back ack
+        MeshLoRaSendAck();
+    }
+}
+static void OnRxAck0(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("(%d)rx ack0\n", Port->GetTime());
+    }
+    dcStats.RtsAcked += 1;
+    Mac.GotAck = true;
+    MeshLoRaTransmit(MESH_STATE_ROUTER);
+}
+static void OnRxAck1(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("(%d)rx ack1\n", Port->GetTime());
+    }
+    dcStats.RtsAcked += 1;
+    MeshLoRaLinkDelivery(Buffer[2], true);
+    Mac.GotAck = true;
+    if (bf_save_relay_now != bf_save_relay_have)
+    {
+        Mac.TxFreqInd = (Buffer[0] & 0xF0) >> 4;
+        MeshLoRaTransmit(MESH_STATE_RELAY);
+    }
+    else if (bf_save_data_now != bf_save_data_have)
+    {
+        Mac.TxFreqInd = (Buffer[0] & 0xF0) >> 4;
+        MeshLoRaTransmit(MESH_STATE_DATA);
+    }
+    else
+    {
+        log_err("err2\n");
+    }
+}
+//our RTS lost against another node
+static void OnRxAckOtherWaitingAck(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("back-off\n");
+    }
+    TimerStop(&BackOffTimer);
+    TimerSetValue(&BackOffTimer, randr(56, BACKOFFTIME));
+    TimerStart(&BackOffTimer);
+}
+static void OnRxAckOther(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("rx randr\n");
+    }
+    //an ACK0 announces a broadcast ROUTER on the default channel, listen to it
+    MeshLoRaRx(randr(56, BACKOFFTIME),
+               ((Buffer[0] & 0x0F) == MESHLORA_CTRL_ACK0) ? MESHLORA_PROFILE_DATA : MESHLORA_PROFILE_CONTROL);
+}
+static void OnRxRouter(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("rx router\n");
+    }
+    Mac.RxFreqInd = -1;
+    Mac.MisDataCount = 0;
+    bool routeChanged = false;
+    if (Params.FixedRelay)
+    {
+        MeshLoRaTrickleStart();
+    }
+    else
+    {
+        uint16_t srcAddr = Buffer[5] | (Buffer[6] << 8);
+        if (srcAddr != Params.DeviceAddress)
+        {
+            uint8_t desNum = Buffer[7];
+            //update router table
+            uint8_t desBeginInd = 8;
+            uint8_t cosBeginInd = 8 + desNum * 2;
+            for (int i = 0; i < desNum; i++)
+            {
+                uint16_t desAddr = Buffer[desBeginInd] | (Buffer[desBeginInd + 1] << 8);
+                uint8_t cost = Buffer[cosBeginInd];
+                desBeginInd += 2;
+                cosBeginInd += 1;
+                if (Mac.ConnectedToGw == false && desAddr == Params.GatewayAddress) //update 'ConnectedToGw'
+                {
+                    Mac.ConnectedToGw = true;
+                }
+                routeChanged |= MeshLoRaUpdateRouterTable(srcAddr, desAddr, cost);
+            }
+        }
+    }
+    //a ROUTER which leaves our route as it is makes ours redundant
+    if (routeChanged)
+    {
+        MeshLoRaTrickleReset();
+    }
+    else
+    {
+        Trickle.Counter += (Trickle.Counter < 0xFF) ? 1 : 0;
+    }
+    MeshLoRaDcLearnPhase();
+
+    checkAndSendPkts(true);
+}
+static void OnRxData(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("rx data\n");
+    }
+    Mac.RxFreqInd = -1;
+    Mac.MisDataCount = 0;
+    uint16_t addr = (Buffer[6] << 8) | Buffer[5];
+    if (Params.DeviceAddress == Params.GatewayAddress)
+    {
+        if (Callbacks.OnDataReceived != NULL)
+        {
+            MeshLoRaDataInfo_t info;
+            uint8_t appDataLen = MeshLoRaDataInfo(&info);
+            Callbacks.OnDataReceived(addr, Buffer + 9, appDataLen, &info);
+        }
+        checkAndSendPkts(true);
+        return;
+    }
+
+    if (addr > RELAY_NODES)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("(mot)%d%d\n", Buffer[6], Buffer[5]);
+        }
+        return;
+    }
+    relayDataNum[addr - 1] += 1;
+    log_info("relay: %d, cnt: %d\n", addr, relayDataNum[addr - 1]);
+    Mac.WaitData = WAIT_DATA_NONE;
+    Buffer[7] = meshLoRaNxtAddr[Params.GatewayAddress] & 0xFF;
+    Buffer[8] = (meshLoRaNxtAddr[Params.GatewayAddress] >> 8) & 0xFF;
+    if ((bf_save_relay_have + 1) % BUFFER_SAVE_RELAY == bf_save_relay_now)
+    { //full
+        lost_relay += 1;
+        log_info("lst relay: %d\n", lost_relay);
+    }
+    else
+    {
+        memset1(Buffer_save_relay[bf_save_relay_have], 0, BUFFER_SIZE);
+        memcpy1(Buffer_save_relay[bf_save_relay_have], Buffer, BufferSize);
+        Buffer_save_relay_len[bf_save_relay_have] = BufferSize;
+        Buffer_save_relay_time[bf_save_relay_have] = RxDoneTime;
+        bf_save_relay_have += 1;
+        bf_save_relay_have = bf_save_relay_have % BUFFER_SAVE_RELAY;
+    }
+    MeshLoRaTransmit(MESH_STATE_RELAY);
+}
+static void OnRxOther(void)
+{
+    //other pkts
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("other pkts %d\n", BufferSize);
+    }
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    checkAndSendPkts(false);
+}
+
+/*
+* handlers of the end of the transmissions
+*/
+static void OnTxDoneRts(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("(%d)send RTS\n", Port->GetTime());
+    }
+    MeshLoRaRx(RTSINTERVAL, MESHLORA_PROFILE_CONTROL);
+}
+static void OnTxDoneAck(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("(%d)send ACK\n", Port->GetTime());
+    }
+    if (Mac.WaitData == WAIT_DATA_FIRST)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("rx %d\n", WAITFORDATATIME);
+        }
+        MeshLoRaRx(WAITFORDATATIME, MESHLORA_PROFILE_DATA);
+    }
+    else
+    {
+        log_err("err3\n");
+    }
+}
+static void OnTxDoneRouter(void)
+{
+    Mac.TxFreqInd = -1;
+    Mac.RxFreqInd = -1;
+    nodeSendRouterNum += 1;
+    log_info("send Router, len %d, cnt %d\n", BufferSize_send, nodeSendRouterNum);
+    Mac.RouterPending = false;
+    Mac.GotAck = false;
+    MeshLoRaTrickleStart();
+
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    checkAndSendPkts(false);
+}
+static void OnTxDoneData(void)
+{
+    Mac.TxFreqInd = -1;
+    Mac.RxFreqInd = -1;
+    nodeSendDataNum += 1;
+    log_info("send Data, len %d, cnt %d\n", Buffer_save_data_len[bf_save_data_now], nodeSendDataNum);
+    Mac.GotAck = false;
+    uint32_t latency = Port->GetTime() - Buffer_save_data_time[bf_save_data_now];
+    dcStats.LatencySum += latency;
+    dcStats.LatencyCnt += 1;
+    dcStats.LatencyMax = (latency > dcStats.LatencyMax) ? latency : dcStats.LatencyMax;
+    bf_save_data_now += 1;
+    bf_save_data_now = bf_save_data_now % BUFFER_SAVE_DATA;
+
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    checkAndSendPkts(false);
+}
+static void OnTxDoneRelay(void)
+{
+    Mac.TxFreqInd = -1;
+    Mac.RxFreqInd = -1;
+    uint16_t addr = (Buffer_save_relay[bf_save_relay_now][6] << 8) | Buffer_save_relay[bf_save_relay_now][5];
+    if (addr > RELAY_NODES)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("(mot)%d%d\n", Buffer[6], Buffer[5]);
+        }
+    }
+    else
+    {
+        relaySendDataNum[addr - 1] += 1;
+    }
+    log_info("relay Data, len %d, cnt %d\n", Buffer_save_relay_len[bf_save_relay_now], relaySendDataNum[addr - 1]);
+    Mac.GotAck = false;
+
+    bf_save_relay_now += 1;
+    bf_save_relay_now = bf_save_relay_now % BUFFER_SAVE_RELAY;
+
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    checkAndSendPkts(false);
+}
+static void OnTxTimeoutEvent(void)
+{
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    //back-off to relax
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("back-off\n");
+    }
+    TimerStop(&BackOffTimer);
+    TimerSetValue(&BackOffTimer, BACKOFFTIME);
+    TimerStart(&BackOffTimer);
+}
+
+/*
+* handlers of the reception timeouts and errors
+*/
+//no ACK after our RTS, send it again
+static void OnRxTimeoutRts(void)
+{
+    Mac.RxFreqInd = -1;
+    if (Mac.RtsAddr != MESHLORA_CTRL_BROADCAST)
+    {
+        MeshLoRaLinkDelivery(Mac.RtsAddr, false);
+    }
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    MeshLoRaSendRts();
+}
+static void OnRxTimeoutEvent(void)
+{
+    Mac.RxFreqInd = -1;
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    checkAndSendPkts(false);
+}
+static void OnRxErrorRts(void)
+{
+    Mac.RxFreqInd = -1;
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("rx %d\n", RTSINTERVAL);
+    }
+    if (Port->Radio->GetStatus() == RF_IDLE)
+    {
+        MeshLoRaRx(RTSINTERVAL, MESHLORA_PROFILE_CONTROL);
+    }
+    else
+    {
+        log_warn("stil3 %d\n", Port->Radio->GetStatus());
+    }
+}
+static void OnRxErrorAck(void)
+{
+    Mac.RxFreqInd = -1;
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("rx %d\n", WAITFORDATATIME);
+    }
+    if (Port->Radio->GetStatus() == RF_IDLE)
+    {
+        MeshLoRaRx(WAITFORDATATIME, MESHLORA_PROFILE_DATA);
+    }
+    else
+    {
+        log_warn("stil4 %d\n", Port->Radio->GetStatus());
+    }
+}
+static void OnRxErrorEvent(void)
+{
+    Mac.RxFreqInd = -1;
+    if (MeshLoRaDcSleepIfRequested())
+    {
+        return;
+    }
+    if (Port->Radio->GetStatus() == RF_IDLE)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("rx3 0\n");
+        }
+        MeshLoRaRxContinuous();
+    }
+    else
+    {
+        log_warn("stil5 %d\n", Port->Radio->GetStatus());
+    }
+}
+
+/*
+* handlers of the CAD results
+*/
+static void OnCadBusy(void)
+{
+    Mac.CadDetectTime = 0;
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("cad rx\n");
+    }
+    MeshLoRaRx(randr(56, CAD_BACKOFF_TIME), MeshLoRaIdleProfile());
+}
+static void OnCadClear(void)
+{
+    Mac.CadDetectTime += 1;
+    if (Mac.CadDetectTime > 1)
+    {
+        Mac.CadDetectTime = 0;
+        MeshLoRaSendRts();
+    }
+    else
+    {
+        TimerSetValue(&CADAgainTimer, CAD_AGAIN_TIME);
+        TimerStart(&CADAgainTimer);
+    }
+}
+
+/*
+* handlers of the timers
+*/
+static void OnSendRouterTimerEvent(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("evt router\n");
+    }
+    TimerStop(&SendRouterTimer);
+
+    if (Trickle.TxTimePassed)
+    { //end of the interval
+        Trickle.Interval = (2 * Trickle.Interval > ROUTER_MAX_INTERVAL) ? ROUTER_MAX_INTERVAL : 2 * Trickle.Interval;
+        MeshLoRaTrickleNewInterval();
+        return;
+    }
+    Trickle.TxTimePassed = true;
+    TimerSetValue(&SendRouterTimer, Trickle.Interval - Trickle.TxTime);
+    TimerStart(&SendRouterTimer);
+
+    if (Trickle.Counter >= ROUTER_REDUNDANCY)
+    {
+        Trickle.Suppressed += 1;
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("router suppressed, %d heard\n", Trickle.Counter);
+        }
+        return;
+    }
+    if (Mac.RouterPending)
+    {
+        return;
+    }
+
+    Mac.RouterPending = true;
+
+    if (Mac.RxContinuous && Mac.DcState != MID_SLEEP)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("newCc router\n");
+        }
+        MeshLoRaTransmit(MESH_STATE_ROUTER);
+    }
+}
+static void OnSendDataTimerEvent(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("evt data\n");
+    }
+    TimerStop(&SendDataTimer);
+
+    if (Mac.ConnectedToGw)
+    {
+        MeshLoRaPrepareFrame(MESH_STATE_DATA);
+    }
+
+    TimerStart(&SendDataTimer);
+
+    if (Mac.RxContinuous && Mac.ConnectedToGw && Mac.DcState != MID_SLEEP && bf_save_data_now != bf_save_data_have)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("newCc Data\n");
+        }
+        MeshLoRaTransmit(MESH_STATE_DATA);
+    }
+}
+static void OnBackOffTimerEvent(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("evt back-off\n");
+    }
+    TimerStop(&BackOffTimer);
+    checkAndSendPkts(false);
+}
+static void OnDutyCycleTimerEvent(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("duty-cycle\n");
+    }
+    TimerStop(&DutyCycleTimer);
+    if (Mac.DcState == AWAKE)
+    {
+        Mac.DcState = MID_SLEEP;
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("to sleep\n");
+        }
+        //otherwise sleeps at the end of the frame exchange
+        if (Mac.RxContinuous)
+        {
+            MeshLoRaStopRxContinuous(true);
+            Port->Radio->Sleep();
+            MeshLoRaDcSleep();
+        }
+    }
+    else if (Mac.DcState == SLEEP)
+    {
+        Mac.DcState = AWAKE;
+        log_info("(%d)awake\n", Port->GetTime());
+        MeshLoRaDcStartAwake();
+        checkAndSendPkts(false);
+    }
+}
+static void OnCadAgainTimerEvent(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("cad-ag\n");
+    }
+    TimerStop(&CADAgainTimer);
+    Port->Radio->StartCad();
+}
+
+/*
+* handlers of the low-power listening, the continuous reception may have been
+* stopped since the timer or the CAD
+*/
+static void OnLplTimerEvent(void)
+{
+    if (!Mac.RxContinuous)
+    {
+        return;
+    }
+    dcStats.LplSamples += 1;
+    if (dcStats.LplSamples % (DC_REPORT_CYCLES * DC_PERIOD / Params.LplInterval) == 0)
+    {
+        MeshLoRaReport();
+    }
+    Mac.LplCad = true;
+    Port->Radio->StartCad();
+}
+static void OnLplCadClear(void)
+{
+    if (!Mac.RxContinuous)
+    {
+        return;
+    }
+    TimerSetValue(&LplTimer, Params.LplInterval);
+    TimerStart(&LplTimer);
+}
+static void OnLplCadBusy(void)
+{
+    if (!Mac.RxContinuous)
+    {
+        return;
+    }
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("(%d)lpl wake\n", Port->GetTime());
+    }
+    dcStats.LplWakeups += 1;
+    Mac.RxContinuous = false;
+    //not the RTS state of a former exchange, whose reception timeout sends a new RTS
+    Mac.State = MESH_STATE_IDLE;
+    MeshLoRaRx(Params.LplInterval + LPL_RX_MARGIN, MESHLORA_PROFILE_WAKEUP);
+}
+
+/*
+* event/state table, the first matching line handles the event, nothing
+* happens when no line matches
+*/
+static const MeshLoRaMacTransition_t MeshLoRaMacTable[] =
+{
+    { MESH_EVENT_RX_RTS0,       MESH_STATE_ANY,     OnRxRts0 },
+    { MESH_EVENT_RX_RTS1,       MESH_STATE_ANY,     OnRxRts1 },
+    { MESH_EVENT_RX_ACK0,       MESH_STATE_ANY,     OnRxAck0 },
+    { MESH_EVENT_RX_ACK1,       MESH_STATE_ANY,     OnRxAck1 },
+    { MESH_EVENT_RX_ACK_OTHER,  MESH_STATE_RTS,     OnRxAckOtherWaitingAck },
+    { MESH_EVENT_RX_ACK_OTHER,  MESH_STATE_ANY,     OnRxAckOther },
+    { MESH_EVENT_RX_ROUTER,     MESH_STATE_ANY,     OnRxRouter },
+    { MESH_EVENT_RX_DATA,       MESH_STATE_ANY,     OnRxData },
+    { MESH_EVENT_RX_OTHER,      MESH_STATE_ANY,     OnRxOther },
+    { MESH_EVENT_TX_DONE,       MESH_STATE_RTS,     OnTxDoneRts },
+    { MESH_EVENT_TX_DONE,       MESH_STATE_ACK,     OnTxDoneAck },
+    { MESH_EVENT_TX_DONE,       MESH_STATE_ROUTER,  OnTxDoneRouter },
+    { MESH_EVENT_TX_DONE,       MESH_STATE_DATA,    OnTxDoneData },
+    { MESH_EVENT_TX_DONE,       MESH_STATE_RELAY,   OnTxDoneRelay },
+    { MESH_EVENT_TX_TIMEOUT,    MESH_STATE_ANY,     OnTxTimeoutEvent },
+    { MESH_EVENT_RX_TIMEOUT,    MESH_STATE_RTS,     OnRxTimeoutRts },
+    { MESH_EVENT_RX_TIMEOUT,    MESH_STATE_ANY,     OnRxTimeoutEvent },
+    { MESH_EVENT_RX_ERROR,      MESH_STATE_RTS,     OnRxErrorRts },
+    { MESH_EVENT_RX_ERROR,      MESH_STATE_ACK,     OnRxErrorAck },
+    { MESH_EVENT_RX_ERROR,      MESH_STATE_ANY,     OnRxErrorEvent },
+    { MESH_EVENT_CAD_BUSY,      MESH_STATE_ANY,     OnCadBusy },
+    { MESH_EVENT_CAD_CLEAR,     MESH_STATE_ANY,     OnCadClear },
+    { MESH_EVENT_ROUTER_TIMER,  MESH_STATE_ANY,     OnSendRouterTimerEvent },
+    { MESH_EVENT_DATA_TIMER,    MESH_STATE_ANY,     OnSendDataTimerEvent },
+    { MESH_EVENT_BACKOFF_TIMER, MESH_STATE_ANY,     OnBackOffTimerEvent },
+    { MESH_EVENT_DC_TIMER,      MESH_STATE_ANY,     OnDutyCycleTimerEvent },
+    { MESH_EVENT_CAD_TIMER,     MESH_STATE_ANY,     OnCadAgainTimerEvent },
+    { MESH_EVENT_LPL_TIMER,     MESH_STATE_ANY,     OnLplTimerEvent },
+    { MESH_EVENT_LPL_CAD_CLEAR, MESH_STATE_ANY,     OnLplCadClear },
+    { MESH_EVENT_LPL_CAD_BUSY,  MESH_STATE_ANY,     OnLplCadBusy },
+};
+
+static void MeshLoRaDispatch(MeshLoRaMacEvent_t event)
+{
+    if (event == MESH_EVENT_RX_DONE)
+    {
+        event = MeshLoRaClassifyFrame();
+        MeshLoRaLinkHeardFrame(event);
+        if (event != MESH_EVENT_RX_ROUTER && event != MESH_EVENT_RX_DATA && MeshLoRaKeepWaitingData())
+        {
+            return;
+        }
+    }
+
+    for (uint8_t i = 0; i < sizeof(MeshLoRaMacTable) / sizeof(MeshLoRaMacTable[0]); i++)
+    {
+        if (MeshLoRaMacTable[i].Event == event &&
+            (MeshLoRaMacTable[i].State == Mac.State || MeshLoRaMacTable[i].State == MESH_STATE_ANY))
+        {
+            MeshLoRaMacTable[i].Handler();
+            return;
+        }
+    }
+}
+
+/*
+* radio callbacks, interrupt context
+*/
+static void OnTxDone(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("(%d)txd\n", Port->GetTime());
+    }
+    Port->Radio->Sleep();
+    MeshLoRaPostEvent(MESH_EVENT_TX_DONE);
+}
+static void OnRxDone(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("(%d)rxd\n", Port->GetTime());
+    }
+    MeshLoRaStopRxContinuous(true);
+    BufferSize = (size > BUFFER_SIZE) ? BUFFER_SIZE : size;
+    memset1(Buffer, 0, BUFFER_SIZE);
+    memcpy1(Buffer, payload, BufferSize);
+    RssiValue = rssi;
+    SnrValue = snr;
+    RxDoneTime = RadioEvents.IrqTime;
+    Port->Radio->Sleep();
+    MeshLoRaPostEvent(MESH_EVENT_RX_DONE);
+}
+static void OnTxTimeout(void)
+{
+    log_warn("tx tmout\n");
+    Port->Radio->Sleep();
+    MeshLoRaPostEvent(MESH_EVENT_TX_TIMEOUT);
+}
+static void OnRxTimeout(void)
+{
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("rx tmout\n");
+    }
+    Port->Radio->Sleep();
+    MeshLoRaPostEvent(MESH_EVENT_RX_TIMEOUT);
+}
+static void OnRxError(void)
+{
+    log_warn("(%d)rx error\n", Port->GetTime());
+    MeshLoRaStopRxContinuous(true);
+    Port->Radio->Sleep();
+    MeshLoRaPostEvent(MESH_EVENT_RX_ERROR);
+}
+static void OnCadDone(bool channelActivityDetected)
+{ //MeshLoRaTransmit, the again cadTimer or the low-power listening
+    if (SHOW_DEBUG_DETAIL)
+    {
+        log_debug("CAD Done\n");
+    }
+    Port->Radio->Sleep();
+    if (Mac.LplCad)
+    {
+        Mac.LplCad = false;
+        MeshLoRaPostEvent(channelActivityDetected ? MESH_EVENT_LPL_CAD_BUSY : MESH_EVENT_LPL_CAD_CLEAR);
+        return;
+    }
+    MeshLoRaPostEvent(channelActivityDetected ? MESH_EVENT_CAD_BUSY : MESH_EVENT_CAD_CLEAR);
+}
+
+/*
+* timer callbacks, interrupt context
+*/
+static void OnSendRouterTimer(void)
+{
+    MeshLoRaPostEvent(MESH_EVENT_ROUTER_TIMER);
+}
+static void OnSendDataTimer(void)
+{
+    MeshLoRaPostEvent(MESH_EVENT_DATA_TIMER);
+}
+static void OnBackOffTimer(void)
+{
+    MeshLoRaPostEvent(MESH_EVENT_BACKOFF_TIMER);
+}
+static void OnDutyCycleTimer(void)
+{
+    MeshLoRaPostEvent(MESH_EVENT_DC_TIMER);
+}
+static void OnCadAgainTimer(void)
+{
+    MeshLoRaPostEvent(MESH_EVENT_CAD_TIMER);
+}
+static void OnLplTimer(void)
+{
+    MeshLoRaPostEvent(MESH_EVENT_LPL_TIMER);
+}
+
+/*
+* init
+*/
+static void MeshLoRaPacketTimerInit(void)
+{
+    TimerInit(&SendRouterTimer, OnSendRouterTimer);
+
+    if (Params.DeviceAddress != Params.GatewayAddress)
+    {
+        TimerInit(&SendDataTimer, OnSendDataTimer);
+        TimerSetValue(&SendDataTimer, DATAINTERVAL);
+        TimerStart(&SendDataTimer);
+    }
+
+    TimerInit(&BackOffTimer, OnBackOffTimer);
+    TimerInit(&DutyCycleTimer, OnDutyCycleTimer);
+    TimerInit(&CADAgainTimer, OnCadAgainTimer);
+    TimerInit(&LplTimer, OnLplTimer);
+}
+
+void MeshLoRaMacInit(const MeshLoRaMacPort_t *port, const MeshLoRaMacCallbacks_t *callbacks, const MeshLoRaMacParams_t *params)
+{
+    Port = port;
+    Callbacks = *callbacks;
+    Params = *params;
+    if (Params.LplInterval != 0 && Port->SetProfile == NULL)
+    {
+        log_warn("lpl needs the wake-up profile\n");
+        Params.LplInterval = 0;
+    }
+
+    memset1((uint8_t *)&Mac, 0, sizeof(Mac));
+    Mac.State = MESH_STATE_IDLE;
+    Mac.DcState = AWAKE;
+    Mac.WaitData = WAIT_DATA_NONE;
+    Mac.TxFreqInd = -1;
+    Mac.RxFreqInd = -1;
+    Mac.Profile = MESHLORA_PROFILE_DATA;
+
+    RadioEvents.TxDone = OnTxDone;
+    RadioEvents.RxDone = OnRxDone;
+    RadioEvents.TxTimeout = OnTxTimeout;
+    RadioEvents.RxTimeout = OnRxTimeout;
+    RadioEvents.RxError = OnRxError;
+    RadioEvents.CadDone = OnCadDone;
+    Port->Radio->Init(&RadioEvents);
+
+    // Packet-timer init
+    MeshLoRaPacketTimerInit();
+    // Router Table init
+    if (Params.FixedRelay)
+    {
+        MeshLoRaAddRelayToRouterTable();
+        if (Params.DeviceAddress != Params.GatewayAddress)
+        {
+            Mac.ConnectedToGw = true;
+        }
+    }
+    if (Params.DeviceAddress == Params.GatewayAddress)
+    {
+        if (!Params.FixedRelay)
+        {
+            MeshLoRaRouterTableInit();
+        }
+        Mac.RouterPending = true;
+    }
+}
+
+//airtime of the RTS/ACK handshake, former explicit header frames against the control frames
+static void MeshLoRaReportCtrlAirtime(void)
+{
+    if (Port->SetProfile == NULL)
+    {
+        return;
+    }
+    MeshLoRaSetProfile(MESHLORA_PROFILE_DATA);
+    uint32_t explicitTime = Port->Radio->TimeOnAir(MODEM_LORA, RTS1_SIZE) +
+                            Port->Radio->TimeOnAir(MODEM_LORA, RTS0_ACKS_SIZE);
+    MeshLoRaSetProfile(MESHLORA_PROFILE_CONTROL);
+    uint32_t ackTime = Port->Radio->TimeOnAir(MODEM_LORA, MESHLORA_CTRL_SIZE);
+    log_info("handshake airtime %d -> %dms\n", explicitTime, 2 * ackTime);
+    if (Params.LplInterval != 0)
+    { //the wake-up RTS bounds the latency added on each hop
+        MeshLoRaSetProfile(MESHLORA_PROFILE_WAKEUP);
+        log_info("lpl %dms, handshake airtime %dms\n", Params.LplInterval,
+                 Port->Radio->TimeOnAir(MODEM_LORA, MESHLORA_CTRL_SIZE) + ackTime);
+    }
+}
+
+void MeshLoRaMacStart(void)
+{
+    MeshLoRaReportCtrlAirtime();
+
+    if (Mac.RouterPending)
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("sendRouter\n");
+        }
+        MeshLoRaTransmit(MESH_STATE_ROUTER);
+    }
+    else
+    {
+        if (SHOW_DEBUG_DETAIL)
+        {
+            log_debug("rx 0\n");
+        }
+        MeshLoRaRxContinuous();
+    }
+
+    //begin duty-cycle, the low-power listening replaces it
+    if (Params.DeviceAddress != Params.GatewayAddress && Params.LplInterval == 0)
+    {
+        dcSleepStart = Port->GetTime();
+        MeshLoRaDcStartAwake();
+    }
+}
+
+void MeshLoRaMacProcess(void)
+{
+    MeshLoRaMacEvent_t event;
+
+    while (MeshLoRaPopEvent(&event))
+    {
+        TimerTime_t start = Port->GetTime();
+        MeshLoRaDispatch(event);
+        uint32_t elapsed = Port->GetTime() - start;
+
+        MacStats.Events += 1;
+        MacStats.BusyTime += elapsed;
+        MacStats.MaxTime = (elapsed > MacStats.MaxTime) ? elapsed : MacStats.MaxTime;
+    }
+}
+
+bool MeshLoRaMacHasPendingEvent(void)
+{
+    return EventHead != EventTail;
+}
+
+void MeshLoRaMacGetDcStats(DcStats_t *stats)
+{
+    *stats = dcStats;
+}
+
+void MeshLoRaMacGetStats(MeshLoRaMacStats_t *stats)
+{
+    *stats = MacStats;
+}
@@ -0,0 +1,378 @@
+/*!
+ * \file      MeshLoRaMac.h
+ *
+ * \brief     Mesh LoRa MAC engine
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * The radio callbacks and the timers of the MAC only post an event to a
+ * small queue. MeshLoRaMacProcess, called from the main loop, runs each event
+ * to completion: a received frame is first classified (RTS, ACK, ROUTER,
+ * DATA...), then the handler is looked up in a table by event and by the
+ * frame exchange in progress, the MAC state.
+ *
+ * The engine only reaches the hardware through MeshLoRaMacPort_t, so the same
+ * code runs on the board, on a host simulator providing its own Radio_s, or
+ * under a benchmark feeding events.
+ *
+ * The RTS/ACK handshake uses compact control frames of MESHLORA_CTRL_SIZE
+ * bytes, sent with the control profile of the radio when the port provides
+ * SetProfile: implicit header, no PHY CRC, short preamble. The nodes listen
+ * with the control profile and only switch to the data profile while a
+ * ROUTER, DATA or RELAY frame is expected after a handshake.
+ *
+ *     | type, hop index | destination | source | checksum |
+ *     | 4 bits, 4 bits  | 1           | 1      | 1        |
+ *
+ * The addresses are the low byte of the node addresses, which already index
+ * the router table, 0xFF is the broadcast destination of the RTS0. The
+ * checksum is a CRC-8 seeded with the mesh Mhdr.
+ *
+ * With the low-power listening (MeshLoRaMacParams_t LplInterval), the idle
+ * nodes sleep instead of listening and sample the channel every LplInterval,
+ * with a CAD driven by a timer or with the Rx duty-cycle of the radio when it
+ * has one (SX126x SetRxDutyCycle). The RTS starting an exchange are sent with
+ * the wake-up profile, whose preamble lasts longer than LplInterval, so every
+ * sampling node finds it. The fixed AWAKE/SLEEP duty-cycle is not used then.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __MESHLORAMAC_H__
+#define __MESHLORAMAC_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "timer.h"
+#include "radio.h"
+
+#define BUFFER_SIZE                                 64         // Define the payload size here
+
+/*
+* define Timer
+*/
+#define ROUTER_MIN_INTERVAL                         8000      //ms, Trickle Imin
+#define ROUTER_MAX_INTERVAL                         300000    //ms, Trickle Imax
+#define ROUTER_REDUNDANCY                           3         //Trickle k, consistent ROUTERs heard which suppress ours
+#define DATAINTERVAL                                5000
+#define RTSINTERVAL                                 300
+#define WAITFORDATATIME                             300
+#define BACKOFFTIME                                 150
+#define CAD_BACKOFF_TIME                            150
+#define CAD_AGAIN_TIME                              30
+
+#define AWAKETIME                                   3000
+#define SLEEPTIME                                   1000
+
+/*
+* synchronized duty-cycle: nodes learn the wake-up phase of their parent from
+* its ROUTER packets and wake up with it, so the awake time can be shortened
+*/
+#define DC_SYNC_ENABLE                              true
+#define DC_PERIOD                                   ( AWAKETIME + SLEEPTIME )
+#define DC_SYNC_AWAKETIME                           1000      //awake time once aligned on the parent
+#define DC_SYNC_GUARD                               30        //wake-up ahead of the parent, covers clock drift
+#define DC_SYNC_TOLERANCE                           10        //smaller misalignments are not reported
+#define DC_SYNC_TIMEOUT                             ( 2 * ROUTER_MAX_INTERVAL )
+#define DC_MIN_SLEEPTIME                            50
+#define DC_PHASE_ALWAYS_ON                          0xFFFF    //advertised by nodes without duty-cycle
+#define DC_REPORT_CYCLES                            75
+
+/*
+* low-power listening
+*/
+#define LPL_SAMPLE_TIME                             4         //ms, reception window of the radio Rx duty-cycle
+#define LPL_RX_MARGIN                               100       //ms, reception after a detected preamble, beyond LplInterval
+
+#define SHOW_DEBUG_DETAIL                            false
+#define SHOW_TIMEONAIR                               false
+#define SHOW_FREQ_HOP                                false
+
+//acount relayed pkts
+#define RELAY_NODES                                  26
+
+//freq hopping
+#define HOP_NUM                                      8
+
+/*
+* define pts size, RTS0_ACKS_SIZE and RTS1_SIZE are the sizes of the former
+* explicit header RTS/ACK, kept to report the airtime saved
+*/
+#define RTS0_ACKS_SIZE                                4
+#define RTS1_SIZE                                     6
+#define MESHLORA_CTRL_SIZE                            4
+
+/*
+* control frames
+*/
+#define MESHLORA_CTRL_RTS0                            0
+#define MESHLORA_CTRL_RTS1                            1
+#define MESHLORA_CTRL_ACK0                            2
+#define MESHLORA_CTRL_ACK1                            3
+#define MESHLORA_CTRL_BROADCAST                       0xFF
+
+/*
+* DATA frames: each node which transmits one appends the time it spent there,
+* uint16 ms little endian, after the AppData. Room is kept for
+* MESHLORA_HOP_STAMPS_MAX of them, a frame which is full goes on unstamped.
+*/
+#define MESHLORA_HOP_STAMP_SIZE                       2
+#define MESHLORA_HOP_STAMPS_MAX                       8
+
+/*
+* define max length of AppData
+*/
+#define MESHLORA_APPDATA_MAX_LENGTH                   ( BUFFER_SIZE - 9 - MESHLORA_HOP_STAMPS_MAX * MESHLORA_HOP_STAMP_SIZE )
+
+/*
+* router table, the cost of a route is its ETX: the expected number of
+* transmissions to the destination, MESHLORA_ETX_SCALE per transmission. The
+* ETX of a link starts from the SNR of the first frame heard and follows the
+* RTS1 acknowledged by the neighbour. A route only changes for one cheaper by
+* MESHLORA_ROUTE_HYSTERESIS. Within that band, a route which is not more
+* expensive takes over when the smoothed SNR of its next hop is better by
+* MESHLORA_LINK_SNR_HYSTERESIS or, at a similar SNR, its smoothed RSSI by
+* MESHLORA_LINK_RSSI_HYSTERESIS.
+*/
+#define MESHLORA_ROUTER_TABLES_LENGTH                 50
+#define MESHLORA_ETX_SCALE                            4
+#define MESHLORA_ETX_MAX                              ( 16 * MESHLORA_ETX_SCALE )
+#define MESHLORA_ROUTE_HYSTERESIS                     ( MESHLORA_ETX_SCALE / 2 )
+#define MESHLORA_LINK_PDR_ONE                         256
+#define MESHLORA_LINK_SHIFT                           3         //smoothing of the link, 1/8 of each new sample
+#define MESHLORA_LINK_SNR_GOOD                        0         //dB, above the PDR starts at 1, 1/8 less per dB below
+#define MESHLORA_LINK_SNR_HYSTERESIS                  3         //dB
+#define MESHLORA_LINK_RSSI_HYSTERESIS                 6         //dB
+
+//Buffer to save pkts wait to send, only data pkts
+#define BUFFER_SAVE_DATA                             10
+#define BUFFER_SAVE_RELAY                            10
+
+/*!
+ * Size of the event queue, a power of 2
+ */
+#define MESHLORA_EVENT_QUEUE_SIZE                    8
+
+typedef union uMeshLoRaMacHeader
+{
+    /*!
+     * Byte-access to the bits
+     */
+    uint8_t Value;
+    /*!
+     * Structure containing single access to header bits
+     */
+    struct sMeshLoRaHdrBits
+    {
+        /*!
+         * Major version
+         */
+        uint8_t Major           : 2;
+        /*!
+         * RFU
+         */
+        uint8_t RFU             : 3;
+        /*!
+         * Message type
+         */
+        uint8_t MType           : 3;
+    }Bits;
+}MeshLoRaMacHeader_t;
+
+typedef struct uMeshLoRaFrameHeader
+{
+	MeshLoRaMacHeader_t Mhdr;
+	uint16_t FrameType;
+	int8_t FrameCnt;
+	uint8_t FramePayloadLen;
+}MeshLoRaFrameHeader_t;
+
+/*!
+ * Packet formats of the radio, the modulation is the same
+ */
+typedef enum eMeshLoRaRadioProfile
+{
+    /*!
+     * Explicit header and CRC, ROUTER, DATA and RELAY frames
+     */
+    MESHLORA_PROFILE_DATA,
+    /*!
+     * Implicit header of MESHLORA_CTRL_SIZE bytes, no CRC, RTS/ACK frames
+     */
+    MESHLORA_PROFILE_CONTROL,
+    /*!
+     * Control profile with a preamble longer than the low-power listening
+     * interval, RTS and idle reception when LplInterval is set
+     */
+    MESHLORA_PROFILE_WAKEUP
+}MeshLoRaRadioProfile_t;
+
+/*!
+ * Hardware used by the engine
+ */
+typedef struct sMeshLoRaMacPort
+{
+    /*!
+     * Radio driver, its events are set by MeshLoRaMacInit. The reception
+     * time is taken from RadioEvents_t IrqTime.
+     */
+    const struct Radio_s *Radio;
+    /*!
+     * \brief Returns the current time [ms]
+     */
+    TimerTime_t (*GetTime)(void);
+    /*!
+     * \brief Blocking delay [ms]
+     */
+    void (*DelayMs)(uint32_t ms);
+    /*!
+     * \brief Disables / restores the interrupts around the event queue
+     */
+    void (*DisableIrq)(void);
+    void (*EnableIrq)(void);
+    /*!
+     * \brief Switches the packet format of the radio, called in sleep mode
+     *        and only when the profile changes. Optional, the radio keeps
+     *        the data profile otherwise.
+     *
+     * \remark The radio is in the data profile when MeshLoRaMacStart is
+     *         called.
+     */
+    void (*SetProfile)(MeshLoRaRadioProfile_t profile);
+}MeshLoRaMacPort_t;
+
+/*!
+ * Data frame received by the gateway
+ */
+typedef struct sMeshLoRaDataInfo
+{
+    uint8_t Seq;            //FrameCnt of the source, modulo 255
+    uint8_t Hops;           //number of stamps
+    const uint8_t *Stamps;  //ms spent in each node from the source, MESHLORA_HOP_STAMP_SIZE each
+    uint32_t Delay;         //ms from the creation of the frame, the stamps plus the airtime of each hop
+    int16_t Rssi;           //last hop
+    int8_t Snr;
+}MeshLoRaDataInfo_t;
+
+/*!
+ * Application side of the engine, all callbacks are optional
+ */
+typedef struct sMeshLoRaMacCallbacks
+{
+    /*!
+     * \brief Fills the payload of a new data frame, every DATAINTERVAL
+     *
+     * \param [OUT] buffer  payload
+     * \param [IN]  maxSize MESHLORA_APPDATA_MAX_LENGTH
+     * \retval      size    payload size, 0 sends nothing
+     */
+    uint8_t (*GetAppData)(uint8_t *buffer, uint8_t maxSize);
+    /*!
+     * \brief A data frame reached the gateway
+     *
+     * \param [IN] srcAddr address of the node which created it
+     * \param [IN] payload application payload
+     * \param [IN] size    payload size
+     * \param [IN] info    sequence, hops and delay of the frame
+     */
+    void (*OnDataReceived)(uint16_t srcAddr, uint8_t *payload, uint8_t size, const MeshLoRaDataInfo_t *info);
+    /*!
+     * \brief Called every DC_REPORT_CYCLES duty-cycles, after the MAC report
+     */
+    void (*OnReport)(void);
+}MeshLoRaMacCallbacks_t;
+
+/*!
+ * Node parameters
+ */
+typedef struct sMeshLoRaMacParams
+{
+    uint16_t DeviceAddress;
+    uint16_t GatewayAddress;
+    /*!
+     * The route to the gateway is FixedRelayAddress instead of being learnt
+     */
+    bool FixedRelay;
+    uint16_t FixedRelayAddress;
+    /*!
+     * Channel used out of the frequency hopping [Hz]
+     */
+    uint32_t Frequency;
+    /*!
+     * Channel sampling interval of the low-power listening [ms], 0 listens
+     * continuously. Needs the port SetProfile for the wake-up preamble.
+     */
+    uint16_t LplInterval;
+}MeshLoRaMacParams_t;
+
+//duty-cycle energy and latency
+typedef struct sDcStats
+{
+    uint32_t AwakeTime;     //ms spent awake
+    uint32_t SleepTime;     //ms spent asleep
+    uint32_t Cycles;
+    uint32_t RtsSent;
+    uint32_t RtsAcked;
+    uint32_t LatencySum;    //ms from data creation to its transmission
+    uint32_t LatencyMax;
+    uint32_t LatencyCnt;
+    uint32_t LplSamples;    //CADs of the low-power listening
+    uint32_t LplWakeups;    //of which found a preamble
+}DcStats_t;
+
+//event handling
+typedef struct sMeshLoRaMacStats
+{
+    uint32_t Events;        //events handled
+    uint32_t Dropped;       //events lost on a full queue
+    uint32_t MaxTime;       //ms, longest event handling
+    uint32_t BusyTime;      //ms, sum of the handling times
+}MeshLoRaMacStats_t;
+
+/*!
+ * \brief Initializes the engine and the radio events
+ *
+ * \remark The radio is configured by the application afterwards.
+ *
+ * \param [IN] port      hardware
+ * \param [IN] callbacks application callbacks
+ * \param [IN] params    node parameters
+ */
+void MeshLoRaMacInit(const MeshLoRaMacPort_t *port, const MeshLoRaMacCallbacks_t *callbacks, const MeshLoRaMacParams_t *params);
+
+/*!
+ * \brief Starts the first reception or ROUTER transmission and the duty-cycle
+ */
+void MeshLoRaMacStart(void);
+
+/*!
+ * \brief Handles all the queued events
+ */
+void MeshLoRaMacProcess(void);
+
+/*!
+ * \brief Checks if an event is waiting, to be called with the interrupts disabled
+ */
+bool MeshLoRaMacHasPendingEvent(void);
+
+/*!
+ * \brief Returns the duty-cycle statistics
+ */
+void MeshLoRaMacGetDcStats(DcStats_t *stats);
+
+/*!
+ * \brief Returns the event handling statistics
+ */
+void MeshLoRaMacGetStats(MeshLoRaMacStats_t *stats);
+
+#endif // __MESHLORAMAC_H__
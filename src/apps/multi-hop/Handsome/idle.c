@@ -0,0 +1,129 @@
+/*!
+ * \file      idle.c
+ *
+ * \brief     Tickless low power idle of the main loop
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include "stm32l0xx.h"
+#include "board.h"
+#include "utilities.h"
+#include "fifo.h"
+#include "uart.h"
+#include "timer.h"
+#include "rtc-board.h"
+#include "energy.h"
+#include "idle.h"
+
+extern Uart_t Uart1; // GPS
+extern Uart_t Uart2; // serialio
+
+static TimerTime_t StartTime = 0;
+static IdleStats_t Stats;
+
+/*!
+ * \brief Picks the deepest mode allowed by the pending activity
+ *
+ * \remark Called with the interrupts disabled
+ */
+static IdleMode_t IdleSelectMode(void)
+{
+    if (GetBoardPowerSource() != BATTERY_POWER)
+    {
+        return IDLE_MODE_SLEEP;
+    }
+    // the UART clocks are stopped in STOP mode, and the wake-up
+    // re-initialization flushes the serialio fifo
+    if ((IsFifoEmpty(&Uart2.FifoTx) == false) || ((USART2->ISR & USART_ISR_TC) == 0))
+    {
+        return IDLE_MODE_SLEEP;
+    }
+    // GPS sentences are being received
+    if (Uart1.IsInitialized == true)
+    {
+        return IDLE_MODE_SLEEP;
+    }
+    if (TimerGetNextEventTime() < IDLE_STOP_MIN_TIME)
+    {
+        return IDLE_MODE_SLEEP;
+    }
+    return IDLE_MODE_STOP;
+}
+
+static void IdleEnterSleepMode(void)
+{
+    HAL_SuspendTick();
+    HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+    HAL_ResumeTick();
+}
+
+void IdleInit(void)
+{
+    BoardDisableIrq();
+    memset1((uint8_t *)&Stats, 0, sizeof(Stats));
+    StartTime = RtcGetTimerValue();
+    BoardEnableIrq();
+}
+
+void IdleEnter(bool (*hasPendingWork)(void))
+{
+    IdleMode_t mode;
+    TimerTime_t enterTime;
+
+    BoardDisableIrq();
+    // a DIO or an alarm is already pending, WFI would return at once
+    if (((hasPendingWork != NULL) && (hasPendingWork() == true)) || (EXTI->PR != 0))
+    {
+        BoardEnableIrq();
+        return;
+    }
+
+    mode = IdleSelectMode();
+    enterTime = RtcGetTimerValue();
+    if (mode == IDLE_MODE_STOP)
+    {
+        EnergySetMcuState(ENERGY_MCU_STOP);
+        // WFI wakes the MCU up even with the interrupts disabled, they are
+        // serviced, and the MCU recovered, once enabled again
+        RtcEnterLowPowerStopMode();
+        if (__HAL_RCC_GET_SYSCLK_SOURCE() == RCC_SYSCLKSOURCE_STATUS_PLLCLK)
+        { // STOP refused by the RTC, the MCU is still running on the PLL
+            mode = IDLE_MODE_SLEEP;
+        }
+    }
+    if (mode == IDLE_MODE_SLEEP)
+    {
+        EnergySetMcuState(ENERGY_MCU_SLEEP);
+        IdleEnterSleepMode();
+    }
+    EnergySetMcuState(ENERGY_MCU_RUN);
+    BoardEnableIrq();
+
+    Stats.Residency[mode] += RtcGetTimerValue() - enterTime;
+    Stats.Entries[mode] += 1;
+}
+
+void IdleGetStats(IdleStats_t *stats)
+{
+    TimerTime_t total;
+
+    BoardDisableIrq();
+    *stats = Stats;
+    total = RtcGetTimerValue() - StartTime;
+    BoardEnableIrq();
+
+    stats->Residency[IDLE_MODE_RUN] = total - stats->Residency[IDLE_MODE_SLEEP] - stats->Residency[IDLE_MODE_STOP];
+}
@@ -0,0 +1,87 @@
+/*!
+ * \file      idle.h
+ *
+ * \brief     Tickless low power idle of the main loop
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * When the main loop has nothing to do, the MCU sleeps until the next
+ * interrupt: the RTC alarm of the next timer, a radio DIO or a UART. The
+ * deepest mode compatible with the pending activity is chosen:
+ *
+ * - STOP  : everything but the RTC and the EXTI lines is stopped, the MCU is
+ *           re-initialized on wake-up. Used when the next timer is far enough
+ *           and no UART is active.
+ * - SLEEP : only the CPU is stopped, the SysTick is suspended so that the
+ *           MCU is not woken up every ms.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __IDLE_H__
+#define __IDLE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*!
+ * Shortest time to the next timer event worth entering STOP mode [ms]
+ *
+ * \remark Below this the wake-up re-initialization costs more than it saves,
+ *         and the RTC refuses to enter STOP anyway.
+ */
+#define IDLE_STOP_MIN_TIME              50
+
+/*!
+ * MCU modes accounted by the idle statistics
+ */
+typedef enum eIdleMode
+{
+    IDLE_MODE_RUN = 0,
+    IDLE_MODE_SLEEP,
+    IDLE_MODE_STOP,
+    IDLE_MODE_COUNT,
+}IdleMode_t;
+
+/*!
+ * Time spent in each mode since IdleInit
+ */
+typedef struct sIdleStats
+{
+    uint32_t Residency[IDLE_MODE_COUNT]; // [ms]
+    uint32_t Entries[IDLE_MODE_COUNT]; // number of times the mode was entered
+}IdleStats_t;
+
+/*!
+ * \brief Initializes the idle statistics
+ */
+void IdleInit(void);
+
+/*!
+ * \brief Sleeps until the next interrupt
+ *
+ * \remark hasPendingWork is checked with the interrupts disabled, so an event
+ *         flagged by an interrupt right before the call is never missed.
+ *
+ * \param [IN] hasPendingWork returns true when the main loop has to run
+ */
+void IdleEnter(bool (*hasPendingWork)(void));
+
+/*!
+ * \brief Gets the time spent in each mode
+ *
+ * \param [OUT] stats residency and entries of each mode
+ */
+void IdleGetStats(IdleStats_t *stats);
+
+#endif // __IDLE_H__
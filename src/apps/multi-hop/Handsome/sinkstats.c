@@ -0,0 +1,329 @@
+/*!
+ * \file      sinkstats.c
+ *
+ * \brief     Statistics of the data frames received by the mesh gateway
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include "board.h"
+#include "utilities.h"
+#include "timer.h"
+#include "serialio.h"
+#include "sinkstats.h"
+
+#if (SINK_STATS_NODES > 32)
+#error "SINK_STATS_NODES above the bits of PendingNodes"
+#endif
+
+/*!
+ * Modulo of the FrameCnt of the data frames
+ */
+#define SINK_SEQ_MODULO                 255
+
+/*!
+ * Frames of a source older than the last one which are still tracked
+ */
+#define SINK_SEQ_HISTORY                32
+
+/*!
+ * State of a source, the counters are cleared once its WINDOW record is sent
+ */
+typedef struct sSinkStatsNode
+{
+    bool Seen;
+    uint8_t Last;           // last sequence
+    uint32_t Bitmap;        // bit i: sequence Last - i received
+    uint16_t Received;
+    uint16_t Lost;
+    uint16_t Duplicates;
+    uint16_t DelayMax;
+    uint32_t DelaySum;
+    uint32_t Bytes;
+    uint8_t Hops;           // last frame
+    int8_t Snr;
+    int16_t Rssi;
+}SinkStatsNode_t;
+
+/*!
+ * Counters of all the sources during the window
+ */
+typedef struct sSinkStatsTotals
+{
+    uint16_t Received;
+    uint16_t Lost;
+    uint16_t Duplicates;
+    uint16_t RecordsLost;   // PACKET records which found the log ring full
+    uint16_t Unknown;
+    uint32_t Bytes;
+}SinkStatsTotals_t;
+
+static SinkStatsNode_t Nodes[SINK_STATS_NODES];
+static SinkStatsTotals_t Totals;
+static TimerEvent_t WindowTimer;
+static TimerTime_t WindowStart = 0;
+static volatile bool WindowEnded = false;
+
+static uint8_t Summary[SERIALIO_RECORD_MAX];
+static uint8_t SummarySize = 0;     // 0 when sent
+static uint32_t PendingNodes = 0;   // WINDOW records to send
+
+static void OnWindowTimer(void)
+{
+    TimerStart(&WindowTimer);
+    WindowEnded = true;
+}
+
+//writes the size low bytes of value to record[index], returns the next index
+static uint8_t SinkPut(uint8_t *record, uint8_t index, uint32_t value, uint8_t size)
+{
+    for (uint8_t i = 0; i < size; i++)
+    {
+        record[index++] = (value >> (8 * i)) & 0xFF;
+    }
+    return index;
+}
+
+static uint16_t SinkSat16(uint32_t value)
+{
+    return (value > 0xFFFF) ? 0xFFFF : value;
+}
+
+//sequences a - b, both below SINK_SEQ_MODULO
+static uint8_t SinkSeqDiff(uint8_t a, uint8_t b)
+{
+    return (a + SINK_SEQ_MODULO - b) % SINK_SEQ_MODULO;
+}
+
+//a late frame was counted as lost
+static void SinkUnlose(SinkStatsNode_t *node)
+{
+    node->Lost -= (node->Lost > 0) ? 1 : 0;
+    Totals.Lost -= (Totals.Lost > 0) ? 1 : 0;
+}
+
+//updates the sequence tracking of node, returns the PACKET flags
+static uint8_t SinkTrackSeq(SinkStatsNode_t *node, uint8_t seq)
+{
+    uint8_t diff = SinkSeqDiff(seq, node->Last);
+    uint8_t back = SINK_SEQ_MODULO - diff;
+
+    if (!node->Seen)
+    {
+        node->Seen = true;
+        node->Last = seq;
+        node->Bitmap = 1;
+        return 0;
+    }
+    if (diff == 0)
+    {
+        return SINK_FLAG_DUPLICATE;
+    }
+    if (diff < SINK_SEQ_MODULO / 2)
+    {
+        node->Lost += diff - 1;
+        Totals.Lost += diff - 1;
+        node->Bitmap = (diff < SINK_SEQ_HISTORY) ? (node->Bitmap << diff) | 1 : 1;
+        node->Last = seq;
+        return 0;
+    }
+    if (back < SINK_SEQ_HISTORY)
+    {
+        if (node->Bitmap & (1UL << back))
+        {
+            return SINK_FLAG_DUPLICATE;
+        }
+        node->Bitmap |= 1UL << back;
+        SinkUnlose(node);
+        return SINK_FLAG_LATE;
+    }
+    //too far back to be late, the source restarted
+    node->Last = seq;
+    node->Bitmap = 1;
+    return SINK_FLAG_RESYNC;
+}
+
+static void SinkSendPacket(uint16_t srcAddr, uint8_t size, const MeshLoRaDataInfo_t *info, uint8_t flags)
+{
+    uint8_t record[SERIALIO_RECORD_MAX];
+    uint8_t n = 0;
+
+    n = SinkPut(record, n, SINK_RECORD_PACKET, 1);
+    n = SinkPut(record, n, srcAddr, 1);
+    n = SinkPut(record, n, info->Seq, 1);
+    n = SinkPut(record, n, flags, 1);
+    n = SinkPut(record, n, info->Hops, 1);
+    n = SinkPut(record, n, SinkSat16(info->Delay), 2);
+    n = SinkPut(record, n, (uint16_t)info->Rssi, 2);
+    n = SinkPut(record, n, (uint8_t)info->Snr, 1);
+    n = SinkPut(record, n, size, 1);
+    for (uint8_t i = 0; (i < info->Hops) && (n + MESHLORA_HOP_STAMP_SIZE <= SERIALIO_RECORD_MAX); i++)
+    {
+        record[n++] = info->Stamps[2 * i];
+        record[n++] = info->Stamps[2 * i + 1];
+    }
+    if (!SerialioRecord(record, n))
+    {
+        Totals.RecordsLost += 1;
+    }
+}
+
+//closes the window: the SUMMARY record and the sources to report
+static void SinkCloseWindow(void)
+{
+    TimerTime_t now = TimerGetCurrentTime();
+    uint32_t duration = now - WindowStart;
+    uint8_t sources = 0;
+    uint8_t n = 0;
+
+    for (uint8_t i = 0; i < SINK_STATS_NODES; i++)
+    {
+        if (Nodes[i].Received || Nodes[i].Lost || Nodes[i].Duplicates)
+        {
+            PendingNodes |= 1UL << i;
+            sources += 1;
+        }
+    }
+    n = SinkPut(Summary, n, SINK_RECORD_SUMMARY, 1);
+    n = SinkPut(Summary, n, now, 4);
+    n = SinkPut(Summary, n, duration, 4);
+    n = SinkPut(Summary, n, Totals.Received, 2);
+    n = SinkPut(Summary, n, Totals.Lost, 2);
+    n = SinkPut(Summary, n, Totals.Duplicates, 2);
+    n = SinkPut(Summary, n, Totals.Bytes, 4);
+    n = SinkPut(Summary, n, sources, 1);
+    n = SinkPut(Summary, n, Totals.RecordsLost, 2);
+    n = SinkPut(Summary, n, Totals.Unknown, 2);
+    SummarySize = n;
+
+    log_info("sink %d sources, rx %d, lost %d, dup %d, %dB/min\n", sources, Totals.Received,
+             Totals.Lost, Totals.Duplicates, (duration != 0) ? (Totals.Bytes * 60000) / duration : 0);
+    memset1((uint8_t *)&Totals, 0, sizeof(Totals));
+    WindowStart = now;
+}
+
+//sends the WINDOW record of a source, false when the log ring is full
+static bool SinkSendWindow(uint8_t src)
+{
+    SinkStatsNode_t *node = &Nodes[src];
+    uint8_t record[SERIALIO_RECORD_MAX];
+    uint8_t n = 0;
+
+    n = SinkPut(record, n, SINK_RECORD_WINDOW, 1);
+    n = SinkPut(record, n, src, 1);
+    n = SinkPut(record, n, node->Received, 2);
+    n = SinkPut(record, n, node->Lost, 2);
+    n = SinkPut(record, n, node->Duplicates, 2);
+    n = SinkPut(record, n, node->Bytes, 4);
+    n = SinkPut(record, n, (node->Received != 0) ? SinkSat16(node->DelaySum / node->Received) : 0, 2);
+    n = SinkPut(record, n, node->DelayMax, 2);
+    n = SinkPut(record, n, node->Hops, 1);
+    n = SinkPut(record, n, (uint16_t)node->Rssi, 2);
+    n = SinkPut(record, n, (uint8_t)node->Snr, 1);
+    if (!SerialioRecord(record, n))
+    {
+        return false;
+    }
+    // frames received before this record count in the window it closes
+    node->Received = 0;
+    node->Lost = 0;
+    node->Duplicates = 0;
+    node->DelayMax = 0;
+    node->DelaySum = 0;
+    node->Bytes = 0;
+    return true;
+}
+
+void SinkStatsInit(void)
+{
+    memset1((uint8_t *)Nodes, 0, sizeof(Nodes));
+    memset1((uint8_t *)&Totals, 0, sizeof(Totals));
+    SummarySize = 0;
+    PendingNodes = 0;
+    WindowEnded = false;
+    WindowStart = TimerGetCurrentTime();
+
+    TimerInit(&WindowTimer, OnWindowTimer);
+    TimerSetValue(&WindowTimer, SINK_STATS_WINDOW);
+    TimerStart(&WindowTimer);
+}
+
+void SinkStatsOnData(uint16_t srcAddr, uint8_t size, const MeshLoRaDataInfo_t *info)
+{
+    SinkStatsNode_t *node;
+    uint8_t flags;
+
+    if (srcAddr >= SINK_STATS_NODES)
+    {
+        Totals.Unknown += 1;
+        return;
+    }
+    node = &Nodes[srcAddr];
+    flags = SinkTrackSeq(node, info->Seq);
+    if (flags & SINK_FLAG_DUPLICATE)
+    {
+        node->Duplicates += 1;
+        Totals.Duplicates += 1;
+    }
+    else
+    {
+        node->Received += 1;
+        node->Bytes += size;
+        node->DelaySum += info->Delay;
+        node->DelayMax = MAX(node->DelayMax, SinkSat16(info->Delay));
+        node->Hops = info->Hops;
+        node->Rssi = info->Rssi;
+        node->Snr = info->Snr;
+        Totals.Received += 1;
+        Totals.Bytes += size;
+    }
+    SinkSendPacket(srcAddr, size, info, flags);
+}
+
+void SinkStatsProcess(void)
+{
+    uint8_t src;
+
+    if (WindowEnded)
+    {
+        WindowEnded = false;
+        SinkCloseWindow();
+    }
+    if (SummarySize != 0)
+    {
+        if (!SerialioRecord(Summary, SummarySize))
+        {
+            return;
+        }
+        SummarySize = 0;
+    }
+    for (src = 0; PendingNodes != 0; src++)
+    {
+        if ((PendingNodes & (1UL << src)) == 0)
+        {
+            continue;
+        }
+        if (!SinkSendWindow(src))
+        {
+            return;
+        }
+        PendingNodes &= ~(1UL << src);
+    }
+}
+
+bool SinkStatsHasPendingWork(void)
+{
+    return WindowEnded || (SummarySize != 0) || (PendingNodes != 0);
+}
@@ -0,0 +1,107 @@
+/*!
+ * \file      sinkstats.h
+ *
+ * \brief     Statistics of the data frames received by the mesh gateway
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * The gateway tracks the sequence of each source to count the frames lost,
+ * duplicated or late, and sums their size and delay over a window of
+ * SINK_STATS_WINDOW. The results are sent as binary records of
+ * SerialioRecord, decoded by tools/logdecode.py, so they need
+ * SERIALIO_DEFERRED. One INFO line per window sums them up in any build.
+ *
+ * Records, little endian, the first byte is the type:
+ *
+ *     PACKET   every frame received
+ *              Src uint8, Seq uint8, Flags uint8, Hops uint8, Delay uint16 ms,
+ *              Rssi int16, Snr int8, Size uint8, then the stamp of each hop,
+ *              uint16 ms, as many as fit in SERIALIO_RECORD_MAX
+ *     WINDOW   every window, one per source heard or missed during it
+ *              Src uint8, Received uint16, Lost uint16, Duplicates uint16,
+ *              Bytes uint32, DelayAvg uint16 ms, DelayMax uint16 ms, Hops uint8,
+ *              Rssi int16, Snr int8, the last three of the last frame
+ *     SUMMARY  every window, before the WINDOW records
+ *              Time uint32 ms, Duration uint32 ms, Received uint16, Lost uint16,
+ *              Duplicates uint16, Bytes uint32, Sources uint8,
+ *              RecordsLost uint16, Unknown uint16 frames of sources out of
+ *              the table
+ *
+ * The sequence is the FrameCnt of the frame, modulo 255, so a source which
+ * loses more than half of it in a row is taken for a restart.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __SINKSTATS_H__
+#define __SINKSTATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "MeshLoRaMac.h"
+
+/*!
+ * Sources tracked, addresses 0 to SINK_STATS_NODES - 1
+ */
+#ifndef SINK_STATS_NODES
+#define SINK_STATS_NODES                26
+#endif
+
+/*!
+ * Statistics window [ms]
+ */
+#ifndef SINK_STATS_WINDOW
+#define SINK_STATS_WINDOW               60000
+#endif
+
+/*!
+ * Record types
+ */
+#define SINK_RECORD_PACKET              1
+#define SINK_RECORD_WINDOW              2
+#define SINK_RECORD_SUMMARY             3
+
+/*!
+ * Flags of the PACKET record
+ */
+#define SINK_FLAG_DUPLICATE             0x01    // already received, not counted
+#define SINK_FLAG_LATE                  0x02    // older than the last one, no longer lost
+#define SINK_FLAG_RESYNC                0x04    // sequence restarted
+
+/*!
+ * \brief Clears the statistics and starts the first window
+ */
+void SinkStatsInit(void);
+
+/*!
+ * \brief Accounts a data frame which reached the gateway, sends its PACKET
+ *        record
+ *
+ * \param [IN] srcAddr address of the node which created it
+ * \param [IN] size    application payload size
+ * \param [IN] info    sequence, hops and delay of the frame
+ */
+void SinkStatsOnData(uint16_t srcAddr, uint8_t size, const MeshLoRaDataInfo_t *info);
+
+/*!
+ * \brief Closes the window when it ended, queues its records as long as the
+ *        log ring has room, to be called from the main loop
+ */
+void SinkStatsProcess(void);
+
+/*!
+ * \brief Checks if SinkStatsProcess has records to queue
+ */
+bool SinkStatsHasPendingWork(void);
+
+#endif // __SINKSTATS_H__
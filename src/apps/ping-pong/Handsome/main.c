@@ -245,6 +245,8 @@ int main( void )
     
     while( 1 )
     {
+        SerialioProcess( );
+
         if(isSleep){
             continue;
         }
@@ -0,0 +1,1115 @@
+/*!
+ * \file      benchmark.c
+ *
+ * \brief     Host benchmark of the stack kernels
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ *     benchmark [-t min_time_ms] [name_filter] > result.json
+ *
+ * Each kernel is run with a doubling number of iterations until one run lasts
+ * min_time_ms, then that run is repeated and the fastest one is kept. The
+ * results are printed on stdout as JSON:
+ *
+ *     {"benchmarks":[{"name":"aes_encrypt","param":"16","iterations":...,"ns_per_op":...},...]}
+ *
+ * tools/benchcmp.py compares two results and fails on a slower kernel. The
+ * absolute times are the host ones, only their changes are meaningful.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "utilities.h"
+#include "aes.h"
+#include "cmac.h"
+#include "timer.h"
+#include "gps.h"
+#include "fragdecoder.h"
+#include "radio.h"
+#include "sx1276.h"
+#include "LoRaMac.h"
+#include "LoRaMacCrypto.h"
+#include "Region.h"
+#include "RegionAS923.h"
+#include "RegionAU915.h"
+#include "RegionCN470.h"
+#include "RegionCN779.h"
+#include "RegionEU433.h"
+#include "RegionEU868.h"
+#include "RegionKR920.h"
+#include "RegionIN865.h"
+#include "RegionUS915.h"
+#include "RegionUS915-Hybrid.h"
+#include "host-board.h"
+
+/*!
+ * Default shortest duration of a measured run [ms]
+ */
+#define BENCH_MIN_TIME                              100
+
+/*!
+ * Number of measured runs, the fastest one is reported
+ */
+#define BENCH_REPEAT                                3
+
+/*!
+ * Downlinks built ahead of a measured batch of OnRadioRxDone calls
+ */
+#define BENCH_RX_FRAMES                             256
+
+/*!
+ * Device address of the downlinks
+ */
+#define BENCH_DEV_ADDR                              0x26011BDA
+
+/*!
+ * Copies of the recorded GPS output in the fuzzed stream, see BenchNmeaFuzz
+ */
+#define BENCH_NMEA_FUZZ_PASSES                      64
+
+/*!
+ * Largest stream of the GpsParseGpsByte benchmark
+ */
+#define BENCH_NMEA_STREAM_SIZE                      ( BENCH_NMEA_FUZZ_PASSES * 1024 )
+
+/*!
+ * Data block of the FragDecoderProcess benchmark, fragments and their size
+ */
+#define BENCH_FRAG_NB                               128
+#define BENCH_FRAG_SIZE                             50
+
+/*!
+ * Coded fragments sent after the uncoded ones
+ */
+#define BENCH_FRAG_CODED                            ( FRAG_DECODER_MAX_REDUNDANCY + 32 )
+
+/*!
+ * \brief Runs a kernel
+ *
+ * \param [IN] param      Parameter of the kernel, see Benchmark_t
+ * \param [IN] iterations Number of operations
+ * \retval     elapsed    Time spent in the operations [ns], 0 on failure
+ */
+typedef uint64_t ( *BenchRun_t )( uint32_t param, uint32_t iterations );
+
+/*!
+ * Benchmark description
+ */
+typedef struct sBenchmark
+{
+    /*!
+     * Name of the kernel
+     */
+    const char *Name;
+    BenchRun_t Run;
+    /*!
+     * Parameters the kernel is run with, terminated by BENCH_PARAM_END
+     */
+    uint32_t Params[12];
+    /*!
+     * Names of the parameters, their value when NULL
+     */
+    const char * const *ParamNames;
+}Benchmark_t;
+
+/*!
+ * End of the parameters of a benchmark
+ */
+#define BENCH_PARAM_END                             0xFFFFFFFF
+
+static const uint8_t BenchKey[16] =
+{
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+static const uint8_t BenchAppKey[16] =
+{
+    0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB, 0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B
+};
+
+static const char * const RegionNames[] =
+{
+    "AS923", "AU915", "CN470", "CN779", "EU433", "EU868", "KR920", "IN865", "US915", "US915_HYBRID"
+};
+
+/*!
+ * Datarates of a region, see BenchRxWindowCheck
+ */
+typedef struct sBenchRegionDatarates
+{
+    /*!
+     * Spreading factors, or kbps for FSK
+     */
+    const uint8_t *Datarates;
+    /*!
+     * Bandwidths [Hz], 0 for FSK and for the unused datarates
+     */
+    const uint32_t *Bandwidths;
+    /*!
+     * Highest RX datarate
+     */
+    int8_t RxMaxDatarate;
+}BenchRegionDatarates_t;
+
+/*!
+ * Datarates of the regions, in the order of LoRaMacRegion_t
+ */
+static const BenchRegionDatarates_t RegionDatarates[] =
+{
+    { DataratesAS923, BandwidthsAS923, AS923_RX_MAX_DATARATE },
+    { DataratesAU915, BandwidthsAU915, AU915_RX_MAX_DATARATE },
+    { DataratesCN470, BandwidthsCN470, CN470_RX_MAX_DATARATE },
+    { DataratesCN779, BandwidthsCN779, CN779_RX_MAX_DATARATE },
+    { DataratesEU433, BandwidthsEU433, EU433_RX_MAX_DATARATE },
+    { DataratesEU868, BandwidthsEU868, EU868_RX_MAX_DATARATE },
+    { DataratesKR920, BandwidthsKR920, KR920_RX_MAX_DATARATE },
+    { DataratesIN865, BandwidthsIN865, IN865_RX_MAX_DATARATE },
+    { DataratesUS915, BandwidthsUS915, US915_RX_MAX_DATARATE },
+    { DataratesUS915_HYBRID, BandwidthsUS915_HYBRID, US915_HYBRID_RX_MAX_DATARATE },
+};
+
+static const char * const NmeaSentenceNames[] =
+{
+    "GGA", "RMC"
+};
+
+/*!
+ * NMEA sentences without checksum, see BenchNmeaSentence
+ */
+static const char * const NmeaSentences[] =
+{
+    "GPGGA,092750.000,3959.9716,N,11619.3892,E,1,8,1.03,61.7,M,55.2,M,,",
+    "GPRMC,092750.000,A,3959.9716,N,11619.3892,E,0.02,31.66,280511,,,A"
+};
+
+static const char * const NmeaStreamNames[] =
+{
+    "replay", "fuzz"
+};
+
+/*!
+ * Recorded GPS output, sentences without checksum, see BenchNmeaSentence. The
+ * GGA, RMC and GSA sentences are decoded, the others are skipped.
+ */
+static const char * const NmeaReplay[] =
+{
+    "GPGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,",
+    "GPGSA,A,3,10,07,05,02,29,04,08,13,,,,,1.72,1.03,1.38",
+    "GPGSV,3,1,11,10,63,137,17,07,61,098,15,05,59,290,20,08,54,157,30",
+    "GPRMC,092750.000,A,5321.6802,N,00630.3372,W,0.02,31.66,280511,,,A",
+    "GNGGA,092751.000,5321.6803,N,00630.3371,W,1,9,0.98,61.9,M,55.2,M,,",
+    "GNRMC,092751.000,A,5321.6803,N,00630.3371,W,0.03,31.66,280511,,,A",
+    "GPVTG,31.66,T,,M,0.02,N,0.04,K,A",
+};
+
+/*!
+ * Streams of the GpsParseGpsByte benchmark, in the order of NmeaStreamNames
+ */
+static char NmeaStreams[2][BENCH_NMEA_STREAM_SIZE];
+static uint32_t NmeaStreamSizes[2];
+
+/*!
+ * Sentences of each stream the parser has to decode
+ */
+static uint32_t NmeaStreamDecoded[2];
+
+/*!
+ * Downlinks of the OnRadioRxDone benchmark
+ */
+static uint8_t RxFrames[BENCH_RX_FRAMES][255];
+
+/*!
+ * Downlink counter of the last downlink built
+ */
+static uint32_t RxDownLinkCounter = 0;
+
+/*!
+ * Data block of the FragDecoderProcess benchmark, its coded fragments and the
+ * storage the decoder rebuilds it into
+ */
+static uint8_t FragBlock[BENCH_FRAG_NB * BENCH_FRAG_SIZE];
+static uint8_t FragCoded[BENCH_FRAG_CODED][BENCH_FRAG_SIZE];
+static uint8_t FragStorage[BENCH_FRAG_NB * BENCH_FRAG_SIZE];
+
+static uint8_t BenchBuffer[256];
+
+/*!
+ * Keeps the results alive
+ */
+static volatile uint32_t BenchSink;
+
+/*!
+ * \brief Reads the host monotonic clock
+ *
+ * \retval time Time [ns]
+ */
+static uint64_t BenchGetTime( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint64_t )ts.tv_sec * 1000000000ULL + ( uint64_t )ts.tv_nsec;
+}
+
+static uint64_t BenchAesEncrypt( uint32_t param, uint32_t iterations )
+{
+    aes_context ctx;
+    uint64_t start;
+
+    aes_set_key( BenchKey, 16, &ctx );
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        aes_encrypt( BenchBuffer, BenchBuffer, &ctx );
+    }
+    BenchSink = BenchBuffer[0];
+    return BenchGetTime( ) - start;
+}
+
+static uint64_t BenchAesCmac( uint32_t param, uint32_t iterations )
+{
+    AES_CMAC_CTX ctx;
+    uint8_t digest[AES_CMAC_DIGEST_LENGTH];
+    uint64_t start = BenchGetTime( );
+
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        AES_CMAC_Init( &ctx );
+        AES_CMAC_SetKey( &ctx, BenchKey );
+        AES_CMAC_Update( &ctx, BenchBuffer, param );
+        AES_CMAC_Final( digest, &ctx );
+    }
+    BenchSink = digest[0];
+    return BenchGetTime( ) - start;
+}
+
+static uint64_t BenchPayloadEncrypt( uint32_t param, uint32_t iterations )
+{
+    uint64_t start = BenchGetTime( );
+
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        LoRaMacPayloadEncrypt( BenchBuffer, param, BenchKey, BENCH_DEV_ADDR, UP_LINK, i, BenchBuffer );
+    }
+    BenchSink = BenchBuffer[0];
+    return BenchGetTime( ) - start;
+}
+
+static uint64_t BenchComputeMic( uint32_t param, uint32_t iterations )
+{
+    uint32_t mic = 0;
+    uint64_t start = BenchGetTime( );
+
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        LoRaMacComputeMic( BenchBuffer, param, BenchKey, BENCH_DEV_ADDR, UP_LINK, i, &mic );
+    }
+    BenchSink = mic;
+    return BenchGetTime( ) - start;
+}
+
+static uint64_t BenchComputeMicPrekeyed( uint32_t param, uint32_t iterations )
+{
+    LoRaMacCryptoSessionKeys_t keys;
+    uint32_t mic = 0;
+    uint64_t start;
+
+    LoRaMacCryptoSetSessionKeys( BenchKey, BenchAppKey, &keys );
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        LoRaMacComputeMicPrekeyed( BenchBuffer, param, &keys, BENCH_DEV_ADDR, UP_LINK, i, &mic );
+    }
+    BenchSink = mic;
+    return BenchGetTime( ) - start;
+}
+
+static uint64_t BenchTimeOnAir( uint32_t param, uint32_t iterations )
+{
+    uint32_t timeOnAir = 0;
+    uint64_t start;
+
+    // 125 kHz, coding rate 4/5
+    SX1276SetTxConfig( MODEM_LORA, 14, 0, 0, param, 1, 8, false, true, 0, 0, false, 3000 );
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        timeOnAir += SX1276GetTimeOnAir( MODEM_LORA, ( uint8_t )( 13 + ( i & 0x3F ) ) );
+    }
+    BenchSink = timeOnAir;
+    return BenchGetTime( ) - start;
+}
+
+static void BenchTimerCallback( void )
+{
+}
+
+static uint64_t BenchTimerStartStop( uint32_t param, uint32_t iterations )
+{
+    static TimerEvent_t timers[256];
+    TimerEvent_t timer;
+    uint64_t start;
+    uint64_t elapsed;
+
+    // Active timers 1 s apart, the measured one is inserted in the middle
+    for( uint32_t i = 0; i < param; i++ )
+    {
+        TimerInit( &timers[i], BenchTimerCallback );
+        TimerSetValue( &timers[i], 1000000 + i * 1000 );
+        TimerStart( &timers[i] );
+    }
+    TimerInit( &timer, BenchTimerCallback );
+    TimerSetValue( &timer, 1000000 + param * 500 + 1 );
+
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        TimerStart( &timer );
+        TimerStop( &timer );
+    }
+    elapsed = BenchGetTime( ) - start;
+
+    for( uint32_t i = 0; i < param; i++ )
+    {
+        TimerStop( &timers[i] );
+    }
+    return elapsed;
+}
+
+static uint64_t BenchRegionNextChannel( uint32_t param, uint32_t iterations )
+{
+    NextChanParams_t nextChan;
+    uint8_t channel = 0;
+    TimerTime_t time = 0;
+    TimerTime_t aggregatedTimeOff = 0;
+    uint32_t channels = 0;
+    uint64_t start;
+
+    RegionInitDefaults( ( LoRaMacRegion_t )param, INIT_TYPE_INIT );
+
+    nextChan.AggrTimeOff = 0;
+    nextChan.LastAggrTx = 0;
+    nextChan.Datarate = DR_0;
+    nextChan.Joined = true;
+    nextChan.DutyCycleEnabled = false;
+
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        if( RegionNextChannel( ( LoRaMacRegion_t )param, &nextChan, &channel, &time, &aggregatedTimeOff ) != LORAMAC_STATUS_OK )
+        {
+            return 0;
+        }
+        channels += channel;
+    }
+    BenchSink = channels;
+    return BenchGetTime( ) - start;
+}
+
+/*!
+ * Tolerance of the rounding up of BenchRxWindowReference
+ */
+#define BENCH_RX_WINDOW_EPSILON                     1e-9
+
+/*!
+ * \brief Computes the RX window parameters the way the stack did in floating
+ *        point, before they were computed in integers
+ *
+ * The 0.16 ms symbol of the 50 kbps FSK is not exact in binary, so the
+ * floating point computation got one symbol more when the exact timeout is
+ * an integer. The values are rounded up with a tolerance to compare with the
+ * exact ones.
+ *
+ * \param [IN]  datarates     Datarates of the region
+ * \param [IN]  datarate      Datarate
+ * \param [IN]  minRxSymbols  Minimum number of symbols to detect a frame
+ * \param [IN]  rxError       Maximum timing error of the receiver [ms]
+ * \param [IN]  wakeUpTime    Wake up time of the radio [ms]
+ * \param [OUT] windowTimeout RX window timeout [symbols]
+ * \param [OUT] windowOffset  RX window offset [ms]
+ */
+static void BenchRxWindowReference( const BenchRegionDatarates_t *datarates, int8_t datarate, uint8_t minRxSymbols, uint32_t rxError,
+                                    uint32_t wakeUpTime, uint32_t *windowTimeout, int32_t *windowOffset )
+{
+    double tSymbol;
+
+    if( datarates->Bandwidths[datarate] == 0 )
+    { // FSK
+        tSymbol = 8.0 / ( double )datarates->Datarates[datarate];
+    }
+    else
+    { // LoRa
+        tSymbol = ( ( double )( 1 << datarates->Datarates[datarate] ) / ( double )datarates->Bandwidths[datarate] ) * 1000;
+    }
+    *windowTimeout = MAX( ( uint32_t )ceil( ( ( 2 * minRxSymbols - 8 ) * tSymbol + 2 * rxError ) / tSymbol - BENCH_RX_WINDOW_EPSILON ), minRxSymbols );
+    *windowOffset = ( int32_t )ceil( ( 4.0 * tSymbol ) - ( ( *windowTimeout * tSymbol ) / 2.0 ) - wakeUpTime - BENCH_RX_WINDOW_EPSILON );
+}
+
+/*!
+ * \brief Checks RegionComputeRxWindowParameters against the floating point
+ *        computation on every RX datarate of a region
+ *
+ * \param [IN] region Region
+ * \retval     status false on a mismatch
+ */
+static bool BenchRxWindowCheck( LoRaMacRegion_t region )
+{
+    const BenchRegionDatarates_t *datarates = &RegionDatarates[region];
+    RxConfigParams_t params;
+    uint32_t windowTimeout;
+    int32_t windowOffset;
+
+    for( int8_t dr = DR_0; dr <= datarates->RxMaxDatarate; dr++ )
+    {
+        if( ( datarates->Datarates[dr] == 0 ) || ( ( datarates->Bandwidths[dr] == 0 ) && ( datarates->Datarates[dr] != 50 ) ) )
+        { // Unused datarate
+            continue;
+        }
+        for( uint8_t minRxSymbols = 4; minRxSymbols <= 40; minRxSymbols++ )
+        {
+            for( uint32_t rxError = 0; rxError <= 200; rxError++ )
+            {
+                RegionComputeRxWindowParameters( region, dr, minRxSymbols, rxError, &params );
+                BenchRxWindowReference( datarates, dr, minRxSymbols, rxError, Radio.GetWakeupTime( ), &windowTimeout, &windowOffset );
+                if( ( params.WindowTimeout != windowTimeout ) || ( params.WindowOffset != windowOffset ) )
+                {
+                    fprintf( stderr, "%s DR_%d minRxSymbols %u rxError %lu: %lu %ld instead of %lu %ld\n",
+                             RegionNames[region], dr, minRxSymbols, ( unsigned long )rxError,
+                             ( unsigned long )params.WindowTimeout, ( long )params.WindowOffset,
+                             ( unsigned long )windowTimeout, ( long )windowOffset );
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static uint64_t BenchRxWindowParameters( uint32_t param, uint32_t iterations )
+{
+    static bool checked[sizeof( RegionDatarates ) / sizeof( RegionDatarates[0] )] = { false };
+    const BenchRegionDatarates_t *datarates = &RegionDatarates[param];
+    RxConfigParams_t params;
+    int8_t dr = DR_0;
+    uint32_t timeouts = 0;
+    uint64_t start;
+
+    if( checked[param] == false )
+    {
+        if( BenchRxWindowCheck( ( LoRaMacRegion_t )param ) == false )
+        {
+            return 0;
+        }
+        checked[param] = true;
+    }
+
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        RegionComputeRxWindowParameters( ( LoRaMacRegion_t )param, dr, 6, 10, &params );
+        timeouts += params.WindowTimeout;
+        dr = ( dr < datarates->RxMaxDatarate ) ? dr + 1 : DR_0;
+    }
+    BenchSink = timeouts;
+    return BenchGetTime( ) - start;
+}
+
+/*!
+ * \brief Builds an unconfirmed downlink
+ *
+ * \param [OUT] frame           Frame
+ * \param [IN]  size            Application payload size
+ * \param [IN]  downLinkCounter Downlink counter
+ * \retval      frameSize       Frame size
+ */
+static uint16_t BenchBuildDownlink( uint8_t *frame, uint8_t size, uint32_t downLinkCounter )
+{
+    uint16_t frameSize = 0;
+    uint32_t mic = 0;
+
+    frame[frameSize++] = FRAME_TYPE_DATA_UNCONFIRMED_DOWN << 5;
+    frame[frameSize++] = BENCH_DEV_ADDR & 0xFF;
+    frame[frameSize++] = ( BENCH_DEV_ADDR >> 8 ) & 0xFF;
+    frame[frameSize++] = ( BENCH_DEV_ADDR >> 16 ) & 0xFF;
+    frame[frameSize++] = ( BENCH_DEV_ADDR >> 24 ) & 0xFF;
+    frame[frameSize++] = 0x00;
+    frame[frameSize++] = downLinkCounter & 0xFF;
+    frame[frameSize++] = ( downLinkCounter >> 8 ) & 0xFF;
+    frame[frameSize++] = 1;
+    LoRaMacPayloadEncrypt( BenchBuffer, size, BenchAppKey, BENCH_DEV_ADDR, DOWN_LINK, downLinkCounter, frame + frameSize );
+    frameSize += size;
+
+    LoRaMacComputeMic( frame, frameSize, BenchKey, BENCH_DEV_ADDR, DOWN_LINK, downLinkCounter, &mic );
+    frame[frameSize++] = mic & 0xFF;
+    frame[frameSize++] = ( mic >> 8 ) & 0xFF;
+    frame[frameSize++] = ( mic >> 16 ) & 0xFF;
+    frame[frameSize++] = ( mic >> 24 ) & 0xFF;
+    return frameSize;
+}
+
+static void BenchMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+}
+
+static void BenchMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+}
+
+static void BenchMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+}
+
+static void BenchMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+}
+
+/*!
+ * \brief Initializes the MAC as an EU868 node joined by personalization
+ *
+ * \retval status false when the MAC could not be initialized
+ */
+static bool BenchInitMac( void )
+{
+    static LoRaMacPrimitives_t primitives =
+    {
+        BenchMcpsConfirm, BenchMcpsIndication, BenchMlmeConfirm, BenchMlmeIndication
+    };
+    static LoRaMacCallback_t callbacks;
+    static bool initialized = false;
+    MibRequestConfirm_t mibReq;
+
+    if( initialized == true )
+    {
+        return true;
+    }
+    if( LoRaMacInitialization( &primitives, &callbacks, LORAMAC_REGION_EU868 ) != LORAMAC_STATUS_OK )
+    {
+        return false;
+    }
+
+    mibReq.Type = MIB_NET_ID;
+    mibReq.Param.NetID = 0;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_DEV_ADDR;
+    mibReq.Param.DevAddr = BENCH_DEV_ADDR;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_NWK_SKEY;
+    mibReq.Param.NwkSKey = ( uint8_t* )BenchKey;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_APP_SKEY;
+    mibReq.Param.AppSKey = ( uint8_t* )BenchAppKey;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_NETWORK_JOINED;
+    mibReq.Param.IsNetworkJoined = true;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    initialized = true;
+    return true;
+}
+
+static uint64_t BenchRadioRxDone( uint32_t param, uint32_t iterations )
+{
+    static uint16_t frameSizes[BENCH_RX_FRAMES];
+    RadioEvents_t *events;
+    MibRequestConfirm_t mibReq;
+    uint64_t elapsed = 0;
+    uint64_t start;
+
+    if( BenchInitMac( ) == false )
+    {
+        return 0;
+    }
+    events = HostGetRadioEvents( );
+
+    while( iterations > 0 )
+    {
+        uint32_t batch = MIN( iterations, BENCH_RX_FRAMES );
+
+        // Each downlink has the next counter, else it is dropped as repeated
+        for( uint32_t i = 0; i < batch; i++ )
+        {
+            frameSizes[i] = BenchBuildDownlink( RxFrames[i], param, ++RxDownLinkCounter );
+        }
+
+        start = BenchGetTime( );
+        for( uint32_t i = 0; i < batch; i++ )
+        {
+            events->RxDone( RxFrames[i], frameSizes[i], -60, 40 );
+        }
+        elapsed += BenchGetTime( ) - start;
+        iterations -= batch;
+    }
+
+    // All the downlinks must have been accepted
+    mibReq.Type = MIB_DOWNLINK_COUNTER;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    if( mibReq.Param.DownLinkCounter != RxDownLinkCounter )
+    {
+        return 0;
+    }
+    return elapsed;
+}
+
+/*!
+ * \brief Completes an NMEA sentence with its delimiters and checksum
+ *
+ * \param [IN]  sentence Sentence between '$' and '*'
+ * \param [OUT] buffer   Complete sentence
+ * \retval      size     Size of the complete sentence
+ */
+static int32_t BenchNmeaSentence( const char *sentence, char *buffer )
+{
+    uint8_t checksum = 0;
+
+    for( const char *c = sentence; *c != '\0'; c++ )
+    {
+        checksum ^= ( uint8_t )*c;
+    }
+    return sprintf( buffer, "$%s*%02X\r\n", sentence, checksum );
+}
+
+/*!
+ * \brief Draws a pseudo random number, xorshift32
+ *
+ * \param [IN/OUT] seed State of the generator, not 0
+ * \retval         rnd  Random number
+ */
+static uint32_t BenchRandom( uint32_t *seed )
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+/*!
+ * \brief Checks if the parser decodes an NMEA sentence
+ *
+ * \param [IN] sentence Sentence between '$' and '*'
+ * \retval     status   true for the GGA, RMC and GSA sentences
+ */
+static bool BenchNmeaIsDecoded( const char *sentence )
+{
+    // Two characters of talker before the sentence type
+    return ( strncmp( sentence + 2, "GGA,", 4 ) == 0 ) || ( strncmp( sentence + 2, "RMC,", 4 ) == 0 ) ||
+           ( strncmp( sentence + 2, "GSA,", 4 ) == 0 );
+}
+
+/*!
+ * \brief Draws a printable character which can't delimit a sentence
+ *
+ * \param [IN/OUT] seed State of the generator
+ * \retval         c    Character
+ */
+static char BenchNmeaRandomChar( uint32_t *seed )
+{
+    char c;
+
+    do
+    {
+        c = ( char )( ' ' + BenchRandom( seed ) % 95 );
+    }while( ( c == '$' ) || ( c == '*' ) );
+    return c;
+}
+
+/*!
+ * \brief Builds the replayed stream and the fuzzed one
+ *
+ * The fuzzed stream repeats the recorded output, with one in two sentences
+ * mutated once between the '$' and the '*': a character replaced, dropped or
+ * inserted, or the sentence cut there. Each mutation changes the checksum of
+ * the sentence, so only the sentences left intact are decoded.
+ */
+static void BenchNmeaBuildStreams( void )
+{
+    uint32_t seed = 0x2545F491;
+    char sentence[128];
+
+    NmeaStreamSizes[0] = 0;
+    NmeaStreamDecoded[0] = 0;
+    for( uint8_t i = 0; i < ( sizeof( NmeaReplay ) / sizeof( NmeaReplay[0] ) ); i++ )
+    {
+        NmeaStreamSizes[0] += BenchNmeaSentence( NmeaReplay[i], NmeaStreams[0] + NmeaStreamSizes[0] );
+        NmeaStreamDecoded[0] += BenchNmeaIsDecoded( NmeaReplay[i] ) ? 1 : 0;
+    }
+
+    NmeaStreamSizes[1] = 0;
+    NmeaStreamDecoded[1] = 0;
+    for( uint8_t pass = 0; pass < BENCH_NMEA_FUZZ_PASSES; pass++ )
+    {
+        for( uint8_t i = 0; i < ( sizeof( NmeaReplay ) / sizeof( NmeaReplay[0] ) ); i++ )
+        {
+            int32_t size = BenchNmeaSentence( NmeaReplay[i], sentence );
+            // Position between the '$' and the '*', the checksum and CR LF follow
+            int32_t pos = 1 + BenchRandom( &seed ) % ( size - 6 );
+            char c = BenchNmeaRandomChar( &seed );
+
+            switch( BenchRandom( &seed ) % 8 )
+            {
+            case 0: // Replaced
+                while( c == sentence[pos] )
+                {
+                    c = BenchNmeaRandomChar( &seed );
+                }
+                sentence[pos] = c;
+                break;
+            case 1: // Dropped
+                memmove( sentence + pos, sentence + pos + 1, size - pos - 1 );
+                size--;
+                break;
+            case 2: // Inserted
+                memmove( sentence + pos + 1, sentence + pos, size - pos );
+                sentence[pos] = c;
+                size++;
+                break;
+            case 3: // Cut
+                size = pos;
+                break;
+            default:
+                NmeaStreamDecoded[1] += BenchNmeaIsDecoded( NmeaReplay[i] ) ? 1 : 0;
+                break;
+            }
+            memcpy( NmeaStreams[1] + NmeaStreamSizes[1], sentence, size );
+            NmeaStreamSizes[1] += size;
+        }
+    }
+}
+
+/*!
+ * \brief Feeds a stream to the parser
+ *
+ * \param [IN] stream Stream
+ * \retval     count  Number of sentences decoded
+ */
+static uint32_t BenchNmeaFeed( uint32_t stream )
+{
+    uint32_t count = 0;
+
+    for( uint32_t i = 0; i < NmeaStreamSizes[stream]; i++ )
+    {
+        count += ( GpsParseGpsByte( ( uint8_t )NmeaStreams[stream][i] ) == SUCCESS ) ? 1 : 0;
+    }
+    return count;
+}
+
+/*!
+ * \brief Checks the parser on a stream, then its data once the recorded
+ *        output is replayed
+ *
+ * \param [IN] stream Stream
+ * \retval     status false when the parser misses a sentence, decodes a
+ *                    mutated one or has wrong data
+ */
+static bool BenchNmeaCheck( uint32_t stream )
+{
+    NmeaGpsData_t data;
+
+    if( BenchNmeaFeed( stream ) != NmeaStreamDecoded[stream] )
+    {
+        return false;
+    }
+    // The parser recovers from the fuzzed stream
+    if( BenchNmeaFeed( 0 ) != NmeaStreamDecoded[0] )
+    {
+        return false;
+    }
+    // Last GNGGA and GNRMC, and the GPGSA
+    GpsGetLatestGpsData( &data );
+    return ( data.Sentence == NMEA_SENTENCE_RMC ) && ( data.UtcTime == 92751 ) && ( data.Date == 280511 ) &&
+           ( data.Latitude == 533613383 ) && ( data.Longitude == -65056183 ) && ( data.Altitude == 61 ) &&
+           ( data.FixQuality == 1 ) && ( data.FixType == 3 ) && ( data.SatelliteTracked == 9 ) &&
+           ( data.HorizontalDilution == 98 ) && ( data.PositionDilution == 172 ) && ( data.DataValid == true );
+}
+
+static uint64_t BenchGpsParseByte( uint32_t param, uint32_t iterations )
+{
+    static bool built = false;
+    static bool checked[2] = { false };
+    uint32_t count = 0;
+    uint32_t index = 0;
+    uint64_t start;
+
+    if( built == false )
+    {
+        BenchNmeaBuildStreams( );
+        built = true;
+    }
+    if( checked[param] == false )
+    {
+        if( BenchNmeaCheck( param ) == false )
+        {
+            return 0;
+        }
+        checked[param] = true;
+    }
+
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        count += GpsParseGpsByte( ( uint8_t )NmeaStreams[param][index] );
+        index = ( ( index + 1 ) < NmeaStreamSizes[param] ) ? index + 1 : 0;
+    }
+    BenchSink = count;
+    return BenchGetTime( ) - start;
+}
+
+static uint64_t BenchGpsParse( uint32_t param, uint32_t iterations )
+{
+    char sentence[128];
+    int32_t size = BenchNmeaSentence( NmeaSentences[param], sentence );
+    uint64_t start;
+
+    if( GpsParseGpsData( ( int8_t* )sentence, size ) != SUCCESS )
+    {
+        return 0;
+    }
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        GpsParseGpsData( ( int8_t* )sentence, size );
+    }
+    return BenchGetTime( ) - start;
+}
+
+static int8_t BenchFragWrite( uint32_t addr, uint8_t *data, uint32_t size )
+{
+    if( ( addr + size ) > sizeof( FragStorage ) )
+    {
+        return -1;
+    }
+    memcpy1( FragStorage + addr, data, size );
+    return 0;
+}
+
+static int8_t BenchFragRead( uint32_t addr, uint8_t *data, uint32_t size )
+{
+    if( ( addr + size ) > sizeof( FragStorage ) )
+    {
+        return -1;
+    }
+    memcpy1( data, FragStorage + addr, size );
+    return 0;
+}
+
+/*!
+ * \brief Fills the data block and builds its coded fragments
+ */
+static void BenchFragEncode( void )
+{
+    uint8_t row[( BENCH_FRAG_NB + 7 ) / 8];
+
+    for( uint16_t i = 0; i < sizeof( FragBlock ); i++ )
+    {
+        FragBlock[i] = ( uint8_t )( i * 7 + ( i >> 8 ) );
+    }
+    memset1( ( uint8_t* )FragCoded, 0, sizeof( FragCoded ) );
+    for( uint16_t n = 0; n < BENCH_FRAG_CODED; n++ )
+    {
+        FragDecoderGetParityMatrixRow( n + 1, BENCH_FRAG_NB, row );
+        for( uint16_t i = 0; i < BENCH_FRAG_NB; i++ )
+        {
+            if( ( row[i / 8] & ( 1 << ( i % 8 ) ) ) != 0 )
+            {
+                for( uint8_t j = 0; j < BENCH_FRAG_SIZE; j++ )
+                {
+                    FragCoded[n][j] ^= FragBlock[i * BENCH_FRAG_SIZE + j];
+                }
+            }
+        }
+    }
+}
+
+/*!
+ * Rebuilds the data block with param uncoded fragments lost, spread over the
+ * block, from the coded fragments which follow them
+ */
+static uint64_t BenchFragDecode( uint32_t param, uint32_t iterations )
+{
+    static FragDecoderCallbacks_t callbacks = { BenchFragWrite, BenchFragRead };
+    static bool encoded = false;
+    bool lost[BENCH_FRAG_NB] = { false };
+    int32_t status = FRAG_DECODER_ONGOING;
+    uint64_t start;
+
+    if( encoded == false )
+    {
+        BenchFragEncode( );
+        encoded = true;
+    }
+    for( uint32_t k = 0; k < param; k++ )
+    {
+        lost[k * BENCH_FRAG_NB / param] = true;
+    }
+
+    start = BenchGetTime( );
+    for( uint32_t i = 0; i < iterations; i++ )
+    {
+        FragDecoderInit( BENCH_FRAG_NB, BENCH_FRAG_SIZE, &callbacks );
+        for( uint16_t j = 0; j < BENCH_FRAG_NB; j++ )
+        {
+            if( lost[j] == false )
+            {
+                FragDecoderProcess( j + 1, FragBlock + j * BENCH_FRAG_SIZE );
+            }
+        }
+        status = FRAG_DECODER_ONGOING;
+        for( uint16_t n = 0; ( n < BENCH_FRAG_CODED ) && ( status == FRAG_DECODER_ONGOING ); n++ )
+        {
+            status = FragDecoderProcess( BENCH_FRAG_NB + n + 1, FragCoded[n] );
+        }
+    }
+    if( ( status != ( int32_t )param ) || ( memcmp( FragStorage, FragBlock, sizeof( FragBlock ) ) != 0 ) )
+    {
+        return 0;
+    }
+    return BenchGetTime( ) - start;
+}
+
+static const Benchmark_t Benchmarks[] =
+{
+    { "aes_encrypt", BenchAesEncrypt, { 16, BENCH_PARAM_END }, NULL },
+    { "AES_CMAC", BenchAesCmac, { 16, 64, 256, BENCH_PARAM_END }, NULL },
+    { "LoRaMacPayloadEncrypt", BenchPayloadEncrypt, { 16, 51, 115, 242, BENCH_PARAM_END }, NULL },
+    { "LoRaMacComputeMic", BenchComputeMic, { 16, 51, 115, 242, BENCH_PARAM_END }, NULL },
+    { "LoRaMacComputeMicPrekeyed", BenchComputeMicPrekeyed, { 16, 51, 115, 242, BENCH_PARAM_END }, NULL },
+    { "SX1276GetTimeOnAir", BenchTimeOnAir, { 7, 9, 12, BENCH_PARAM_END }, NULL },
+    { "TimerStartStop", BenchTimerStartStop, { 0, 4, 16, 64, 256, BENCH_PARAM_END }, NULL },
+    { "RegionNextChannel", BenchRegionNextChannel,
+      { LORAMAC_REGION_AS923, LORAMAC_REGION_AU915, LORAMAC_REGION_CN470, LORAMAC_REGION_CN779,
+        LORAMAC_REGION_EU433, LORAMAC_REGION_EU868, LORAMAC_REGION_KR920, LORAMAC_REGION_IN865,
+        LORAMAC_REGION_US915, LORAMAC_REGION_US915_HYBRID, BENCH_PARAM_END }, RegionNames },
+    { "RegionComputeRxWindowParameters", BenchRxWindowParameters,
+      { LORAMAC_REGION_AS923, LORAMAC_REGION_AU915, LORAMAC_REGION_CN470, LORAMAC_REGION_CN779,
+        LORAMAC_REGION_EU433, LORAMAC_REGION_EU868, LORAMAC_REGION_KR920, LORAMAC_REGION_IN865,
+        LORAMAC_REGION_US915, LORAMAC_REGION_US915_HYBRID, BENCH_PARAM_END }, RegionNames },
+    { "OnRadioRxDone", BenchRadioRxDone, { 1, 16, 51, BENCH_PARAM_END }, NULL },
+    { "GpsParseGpsData", BenchGpsParse, { 0, 1, BENCH_PARAM_END }, NmeaSentenceNames },
+    { "GpsParseGpsByte", BenchGpsParseByte, { 0, 1, BENCH_PARAM_END }, NmeaStreamNames },
+    { "FragDecoderProcess", BenchFragDecode, { 0, 4, 8, 16, 32, BENCH_PARAM_END }, NULL },
+};
+
+/*!
+ * \brief Measures a kernel
+ *
+ * \param [IN]  bench      Benchmark
+ * \param [IN]  param      Parameter
+ * \param [IN]  minTime    Shortest duration of a measured run [ns]
+ * \param [OUT] iterations Operations of a measured run
+ * \retval      nsPerOp    Time of an operation [ns], negative on failure
+ */
+static double BenchMeasure( const Benchmark_t *bench, uint32_t param, uint64_t minTime, uint32_t *iterations )
+{
+    uint64_t elapsed;
+    uint64_t best = UINT64_MAX;
+
+    *iterations = 1;
+    while( 1 )
+    {
+        elapsed = bench->Run( param, *iterations );
+        if( elapsed == 0 )
+        {
+            return -1.0;
+        }
+        if( ( elapsed >= minTime ) || ( *iterations >= ( 1UL << 30 ) ) )
+        {
+            break;
+        }
+        *iterations *= 2;
+    }
+
+    best = elapsed;
+    for( uint8_t i = 1; i < BENCH_REPEAT; i++ )
+    {
+        elapsed = bench->Run( param, *iterations );
+        if( elapsed == 0 )
+        {
+            return -1.0;
+        }
+        best = MIN( best, elapsed );
+    }
+    return ( double )best / *iterations;
+}
+
+int main( int argc, char *argv[] )
+{
+    uint64_t minTime = BENCH_MIN_TIME * 1000000ULL;
+    const char *filter = NULL;
+    const char *separator = "";
+    int status = EXIT_SUCCESS;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( ( strcmp( argv[i], "-t" ) == 0 ) && ( ( i + 1 ) < argc ) )
+        {
+            minTime = strtoull( argv[++i], NULL, 0 ) * 1000000ULL;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    for( uint16_t i = 0; i < sizeof( BenchBuffer ); i++ )
+    {
+        BenchBuffer[i] = ( uint8_t )i;
+    }
+
+    printf( "{\"benchmarks\":[" );
+    for( uint8_t i = 0; i < ( sizeof( Benchmarks ) / sizeof( Benchmarks[0] ) ); i++ )
+    {
+        const Benchmark_t *bench = &Benchmarks[i];
+
+        if( ( filter != NULL ) && ( strstr( bench->Name, filter ) == NULL ) )
+        {
+            continue;
+        }
+        for( uint8_t j = 0; bench->Params[j] != BENCH_PARAM_END; j++ )
+        {
+            char param[16];
+            uint32_t iterations;
+            double nsPerOp;
+
+            if( bench->ParamNames != NULL )
+            {
+                snprintf( param, sizeof( param ), "%s", bench->ParamNames[bench->Params[j]] );
+            }
+            else
+            {
+                snprintf( param, sizeof( param ), "%lu", ( unsigned long )bench->Params[j] );
+            }
+
+            nsPerOp = BenchMeasure( bench, bench->Params[j], minTime, &iterations );
+            if( nsPerOp < 0 )
+            {
+                fprintf( stderr, "%s %s: failed\n", bench->Name, param );
+                status = EXIT_FAILURE;
+                continue;
+            }
+            printf( "%s\n  {\"name\":\"%s\",\"param\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.1f}",
+                    separator, bench->Name, param, ( unsigned long )iterations, nsPerOp );
+            separator = ",";
+            fflush( stdout );
+        }
+    }
+    printf( "\n]}\n" );
+    return status;
+}
@@ -0,0 +1,293 @@
+/*!
+ * \file      host-board.c
+ *
+ * \brief     Host implementation of the board functions used by the
+ *            benchmark
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * The RTC counts milliseconds of the host monotonic clock, the alarms never
+ * fire. The SX1276 registers are kept in RAM behind SpiInOut, so the driver
+ * runs its usual register accesses. There is no device to wait for: the
+ * delays return at once and the channels are always free, so the listen
+ * before talk of AS923 and KR920 does not add its carrier sense time to the
+ * kernels.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <string.h>
+#include <time.h>
+#include "board.h"
+#include "board-config.h"
+#include "gpio.h"
+#include "spi.h"
+#include "rtc-board.h"
+#include "delay-board.h"
+#include "gps-board.h"
+#include "sx1276-board.h"
+#include "host-board.h"
+
+/*!
+ * SX1276 register file
+ */
+static uint8_t RadioRegisters[128];
+
+/*!
+ * Register address of the current SPI access, -1 until the address byte
+ */
+static int16_t RadioRegAddr = -1;
+
+/*!
+ * The current SPI access writes the registers
+ */
+static bool RadioRegWrite = false;
+
+/*!
+ * Start time of the current RTC alarm
+ */
+static TimerTime_t RtcAlarmStart = 0;
+
+/*!
+ * Events of the radio driver
+ */
+static RadioEvents_t *HostRadioEvents = NULL;
+
+/*!
+ * \brief Initializes the radio driver and keeps its events
+ *
+ * \param [IN] events Structure containing the driver callback functions
+ */
+static void HostRadioInit( RadioEvents_t *events );
+
+/*!
+ * \brief Checks if the channel is free, without the carrier sense
+ *
+ * \param [IN] modem               Radio modem to be used [0: FSK, 1: LoRa]
+ * \param [IN] freq                Channel RF frequency
+ * \param [IN] rssiThresh          RSSI threshold
+ * \param [IN] maxCarrierSenseTime Max time while the RSSI is measured
+ *
+ * \retval isFree                  Always true
+ */
+static bool HostIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime );
+
+/*!
+ * Radio driver structure initialization
+ */
+const struct Radio_s Radio =
+{
+    HostRadioInit,
+    SX1276GetStatus,
+    SX1276SetModem,
+    SX1276SetChannel,
+    HostIsChannelFree,
+    SX1276Random,
+    SX1276SetRxConfig,
+    SX1276SetTxConfig,
+    SX1276CheckRfFrequency,
+    SX1276GetTimeOnAir,
+    SX1276Send,
+    SX1276SetSleep,
+    SX1276SetStby,
+    SX1276SetRx,
+    SX1276StartCad,
+    SX1276SetTxContinuousWave,
+    SX1276ReadRssi,
+    SX1276Write,
+    SX1276Read,
+    SX1276WriteBuffer,
+    SX1276ReadBuffer,
+    SX1276SetMaxPayloadLength,
+    SX1276SetPublicNetwork,
+    SX1276GetWakeupTime
+};
+
+static void HostRadioInit( RadioEvents_t *events )
+{
+    HostRadioEvents = events;
+    SX1276Init( events );
+}
+
+static bool HostIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+{
+    return true;
+}
+
+RadioEvents_t* HostGetRadioEvents( void )
+{
+    return HostRadioEvents;
+}
+
+void BoardDisableIrq( void )
+{
+}
+
+void BoardEnableIrq( void )
+{
+}
+
+uint8_t GetBoardPowerSource( void )
+{
+    return USB_POWER;
+}
+
+void DelayMsMcu( uint32_t ms )
+{
+}
+
+void GpioWrite( Gpio_t *obj, uint32_t value )
+{
+    // Only the SX1276 NSS is driven, a rising edge ends the SPI access
+    if( value != 0 )
+    {
+        RadioRegAddr = -1;
+    }
+}
+
+uint16_t SpiInOut( Spi_t *obj, uint16_t outData )
+{
+    uint8_t inData = 0;
+
+    if( RadioRegAddr < 0 )
+    {
+        RadioRegWrite = ( outData & 0x80 ) != 0;
+        RadioRegAddr = outData & 0x7F;
+        return 0;
+    }
+    if( RadioRegWrite == true )
+    {
+        RadioRegisters[RadioRegAddr] = ( uint8_t )outData;
+    }
+    else
+    {
+        inData = RadioRegisters[RadioRegAddr];
+    }
+    // Burst accesses of the FIFO keep the address
+    if( RadioRegAddr != 0 )
+    {
+        RadioRegAddr = ( RadioRegAddr + 1 ) & 0x7F;
+    }
+    return inData;
+}
+
+/*!
+ * \brief Reads the host monotonic clock
+ *
+ * \retval time Time [ms]
+ */
+static TimerTime_t HostGetTime( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( TimerTime_t )( ts.tv_sec * 1000 + ts.tv_nsec / 1000000 );
+}
+
+void RtcSetTimeout( uint32_t timeout )
+{
+    RtcAlarmStart = HostGetTime( );
+}
+
+TimerTime_t RtcGetAdjustedTimeoutValue( uint32_t timeout )
+{
+    return timeout;
+}
+
+TimerTime_t RtcGetTimerValue( void )
+{
+    return HostGetTime( );
+}
+
+TimerTime_t RtcGetElapsedAlarmTime( void )
+{
+    return HostGetTime( ) - RtcAlarmStart;
+}
+
+TimerTime_t RtcComputeFutureEventTime( TimerTime_t futureEventInTime )
+{
+    return HostGetTime( ) + futureEventInTime;
+}
+
+TimerTime_t RtcComputeElapsedTime( TimerTime_t eventInTime )
+{
+    return HostGetTime( ) - eventInTime;
+}
+
+void BlockLowPowerDuringTask( bool status )
+{
+}
+
+void RtcEnterLowPowerStopMode( void )
+{
+}
+
+void RtcProcess( void )
+{
+}
+
+void GpsMcuInit( void )
+{
+}
+
+void GpsMcuStart( void )
+{
+}
+
+void GpsMcuStop( void )
+{
+}
+
+void GpsMcuProcess( void )
+{
+}
+
+void GpsMcuInvertPpsTrigger( void )
+{
+}
+
+void SX1276IoIrqInit( DioIrqHandler **irqHandlers )
+{
+}
+
+uint32_t SX1276GetDioIrqTime( void )
+{
+    return HostGetTime( );
+}
+
+void SX1276Reset( void )
+{
+    memset( RadioRegisters, 0, sizeof( RadioRegisters ) );
+}
+
+void SX1276SetRfTxPower( int8_t power )
+{
+}
+
+void SX1276SetAntSwLowPower( bool status )
+{
+}
+
+void SX1276SetAntSw( uint8_t opMode )
+{
+}
+
+bool SX1276CheckRfFrequency( uint32_t frequency )
+{
+    return true;
+}
+
+uint32_t SX1276GetBoardTcxoWakeupTime( void )
+{
+    return BOARD_TCXO_WAKEUP_TIME;
+}
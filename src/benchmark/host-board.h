@@ -0,0 +1,35 @@
+/*!
+ * \file      host-board.h
+ *
+ * \brief     Host implementation of the board functions used by the
+ *            benchmark
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __HOST_BOARD_H__
+#define __HOST_BOARD_H__
+
+#include "radio.h"
+
+/*!
+ * \brief Gets the events the MAC registered with Radio.Init, the benchmark
+ *        raises the radio interrupts through them
+ *
+ * \retval events Radio events, NULL before Radio.Init
+ */
+RadioEvents_t* HostGetRadioEvents( void );
+
+#endif // __HOST_BOARD_H__
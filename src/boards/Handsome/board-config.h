@@ -119,4 +119,23 @@
 #define TEST_POINT3                                 PB_14
 #define TEST_POINT4                                 PB_15
 
+/*!
+ * Currents drawn in every state, given to EnergyInit by the applications [uA]
+ */
+#define ENERGY_CURRENT_BASE                         20
+#define ENERGY_CURRENT_MCU_RUN                      4500
+#define ENERGY_CURRENT_MCU_SLEEP                    1000
+#define ENERGY_CURRENT_MCU_STOP                     1
+#define ENERGY_CURRENT_RADIO_SLEEP                  0
+#define ENERGY_CURRENT_RADIO_STANDBY                1600
+#define ENERGY_CURRENT_RADIO_SYNTH                  5800
+#define ENERGY_CURRENT_RADIO_RX                     10800
+#define ENERGY_CURRENT_RADIO_CAD                    10800
+
+/*!
+ * TX currents at the 470 MHz band, always on PA_BOOST [dBm, uA]
+ */
+#define ENERGY_CURRENT_RADIO_TX                     { { 2, 33000 }, { 5, 38000 }, { 7, 42000 }, { 10, 50000 }, \
+                                                      { 12, 56000 }, { 14, 64000 }, { 17, 87000 }, { 20, 120000 } }
+
 #endif // __BOARD_CONFIG_H__
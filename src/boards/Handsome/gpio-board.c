@@ -31,6 +31,21 @@
 
 static GpioIrqHandler *GpioIrq[16];
 
+/*!
+ * Time of the GPIO interrupt being served
+ */
+static TimerTime_t GpioIrqTime;
+
+/*!
+ * Index of the lowest bit set, by the de Bruijn sequence 0x077CB531 times
+ * that bit, see GpioMcuIrqDispatch
+ */
+static const uint8_t GpioLowestBit[32] =
+{
+    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+    31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
 void GpioMcuInit( Gpio_t *obj, PinNames pin, PinModes mode, PinConfigs config, PinTypes type, uint32_t value )
 {
     if( pin < IOE_0 )
@@ -314,52 +329,58 @@ uint32_t GpioMcuRead( Gpio_t *obj )
     }
 }
 
-void EXTI0_1_IRQHandler( void )
+/*!
+ * \brief Serves the pending EXTI lines of an interrupt vector
+ *
+ * The handlers are called straight from the pending register, lowest line
+ * first. The time is captured once, on entry, before the clocks are restored
+ * from STOP mode: the handlers read it with GpioMcuGetIrqTime.
+ *
+ * The Cortex-M0+ has no CLZ, __builtin_ctz would call __ctzsi2 of libgcc:
+ * the line is found by a multiply and a table lookup instead.
+ *
+ * \param [IN] lines EXTI lines of the vector
+ */
+static void GpioMcuIrqDispatch( uint32_t lines )
 {
+    uint32_t pending;
+
+    GpioIrqTime = RtcGetTimerValue( );
     RtcRecoverMcuStatus( );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_0 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_1 );
+
+    pending = EXTI->PR & EXTI->IMR & lines;
+    // write 1 to clear, edges raised while the handlers run trigger the vector again
+    EXTI->PR = pending;
+
+    while( pending != 0 )
+    {
+        uint32_t lowest = pending & ( ~pending + 1 );
+        uint8_t index = GpioLowestBit[( uint32_t )( lowest * 0x077CB531U ) >> 27];
+
+        pending &= pending - 1;
+        if( GpioIrq[index] != NULL )
+        {
+            GpioIrq[index]( );
+        }
+    }
 }
 
-void EXTI2_3_IRQHandler( void )
+uint32_t GpioMcuGetIrqTime( void )
 {
-    RtcRecoverMcuStatus( );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_2 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_3 );
+    return GpioIrqTime;
 }
 
-void EXTI4_15_IRQHandler( void )
+void EXTI0_1_IRQHandler( void )
 {
-    RtcRecoverMcuStatus( );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_4 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_5 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_6 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_7 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_8 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_9 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_10 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_11 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_12 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_13 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_14 );
-    HAL_GPIO_EXTI_IRQHandler( GPIO_PIN_15 );
+    GpioMcuIrqDispatch( GPIO_PIN_0 | GPIO_PIN_1 );
 }
 
-void HAL_GPIO_EXTI_Callback( uint16_t gpioPin )
+void EXTI2_3_IRQHandler( void )
 {
-    uint8_t callbackIndex = 0;
-
-    if( gpioPin > 0 )
-    {
-        while( gpioPin != 0x01 )
-        {
-            gpioPin = gpioPin >> 1;
-            callbackIndex++;
-        }
-    }
+    GpioMcuIrqDispatch( GPIO_PIN_2 | GPIO_PIN_3 );
+}
 
-    if( GpioIrq[callbackIndex] != NULL )
-    {
-        GpioIrq[callbackIndex]( );
-    }
+void EXTI4_15_IRQHandler( void )
+{
+    GpioMcuIrqDispatch( 0xFFF0 );
 }
@@ -20,7 +20,6 @@
  *
  * \author    Gregory Cristian ( Semtech )
  */
-#include <math.h>
 #include "stm32l0xx.h"
 #include "utilities.h"
 #include "board.h"
@@ -274,7 +273,6 @@ TimerTime_t RtcGetTimerValue( void )
 {
     TimerTime_t retVal = 0;
     retVal = RtcConvertCalendarTickToTimerTime( NULL );
-    RtcConvertTickToMs( retVal );
 
     return( RtcConvertTickToMs( retVal ) );
 }
@@ -683,18 +681,15 @@ static TimerTime_t RtcConvertCalendarTickToTimerTime( RtcCalendar_t *calendar )
     return ( timeCounter );
 }
 
+// Integer rounding, the conversions run in interrupts where the soft double is slow
 TimerTime_t RtcConvertMsToTick( TimerTime_t timeoutValue )
 {
-    double retVal = 0;
-    retVal = round( ( ( double )timeoutValue * CONV_DENOM ) / CONV_NUMER );
-    return( ( TimerTime_t )retVal );
+    return( ( TimerTime_t )( ( ( uint64_t )timeoutValue * CONV_DENOM + ( CONV_NUMER / 2 ) ) / CONV_NUMER ) );
 }
 
 TimerTime_t RtcConvertTickToMs( TimerTime_t timeoutValue )
 {
-    double retVal = 0.0;
-    retVal = round( ( ( double )timeoutValue * CONV_NUMER ) / CONV_DENOM );
-    return( ( TimerTime_t )retVal );
+    return( ( TimerTime_t )( ( ( uint64_t )timeoutValue * CONV_NUMER + ( CONV_DENOM / 2 ) ) / CONV_DENOM ) );
 }
 
 static RtcCalendar_t RtcGetCalendar( void )
@@ -50,3 +50,12 @@ uint8_t SerialioMcuGetChar( char *pdata )
     while (UartGetChar(&Uart2, (uint8_t *) pdata));
     return 1;
 }
+
+// free room in the transmission FIFO
+uint16_t SerialioMcuGetTxFree( void )
+{
+    Fifo_t *fifo = &Uart2.FifoTx;
+
+    // one slot is left empty to tell a full FIFO from an empty one
+    return ( fifo->Size - 1 ) - ( ( fifo->End + fifo->Size - fifo->Begin ) % fifo->Size );
+}
@@ -24,6 +24,7 @@
 #include "utilities.h"
 #include "board-config.h"
 #include "delay.h"
+#include "gpio-board.h"
 #include "radio.h"
 #include "sx1276-board.h"
 
@@ -124,6 +125,11 @@ static void SX1276SetBoardTcxo( uint8_t state )
 #endif
 }
 
+uint32_t SX1276GetDioIrqTime( void )
+{
+    return GpioMcuGetIrqTime( );
+}
+
 uint32_t SX1276GetBoardTcxoWakeupTime( void )
 {
     return BOARD_TCXO_WAKEUP_TIME;
@@ -37,16 +37,6 @@
 //uint8_t TxBuffer[FIFO_TX_SIZE];
 uint8_t RxBuffer[FIFO_RX_SIZE];
 
-/*!
- * \brief Buffer holding the  raw data received from the gps
- */
-uint8_t NmeaString[128];
-
-/*!
- * \brief Maximum number of data byte that we will accept from the GPS
- */
-uint8_t NmeaStringSize = 0;
-
 Gpio_t GpsPowerEn;
 
 bool GpsPowerEnInverted = false;
@@ -75,7 +65,6 @@ void GpsMcuInit( void )
 {
     Gpio_t ioPin;
 
-    NmeaStringSize = 0;
 
     switch( BoardGetVersion( ).Fields.Major )
     {
@@ -135,17 +124,10 @@ void GpsMcuIrqNotify( UartNotifyId_t id )
     {
         if( UartGetChar( &Uart1, &data ) == 0 )
         {
-            if( ( data == '$' ) || ( NmeaStringSize >= 127 ) )
-            {
-                NmeaStringSize = 0;
-            }
-
-            NmeaString[NmeaStringSize++] = ( int8_t )data;
+            GpsParseGpsByte( data );
 
             if( data == '\n' )
             {
-                NmeaString[NmeaStringSize++] = '\0';
-                GpsParseGpsData( ( int8_t* )NmeaString, NmeaStringSize );
                 UartDeInit( &Uart1 );
                 BlockLowPowerDuringTask ( false );
             }
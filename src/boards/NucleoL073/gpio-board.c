@@ -239,6 +239,12 @@ void GpioMcuRemoveInterrupt( Gpio_t *obj )
     }
 }
 
+uint32_t GpioMcuGetIrqTime( void )
+{
+    // The GPIO interrupts are not timestamped on this board
+    return RtcGetTimerValue( );
+}
+
 void GpioMcuWrite( Gpio_t *obj, uint32_t value )
 {
     if( obj->pin < IOE_0 )
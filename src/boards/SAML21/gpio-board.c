@@ -24,6 +24,7 @@
  */
 #include <hal_gpio.h>
 #include <hal_ext_irq.h>
+#include "rtc-board.h"
 #include "gpio-board.h"
 
 void GpioMcuInit( Gpio_t *obj, PinNames pin, PinModes mode, PinConfigs config, PinTypes type, uint32_t value )
@@ -65,6 +66,12 @@ void GpioMcuRemoveInterrupt( Gpio_t *obj )
     //ext_irq_register( obj->pin, NULL );
 }
 
+uint32_t GpioMcuGetIrqTime( void )
+{
+    // The GPIO interrupts are not timestamped on this board
+    return RtcGetTimerValue( );
+}
+
 void GpioMcuWrite( Gpio_t *obj, uint32_t value )
 {
 
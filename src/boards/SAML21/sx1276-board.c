@@ -27,6 +27,7 @@
 #include <hal_gpio.h>
 #include "board-config.h"
 #include "delay.h"
+#include "timer.h"
 #include "radio.h"
 #include "sx1276-board.h"
 
@@ -143,6 +144,12 @@ static void SX1276SetBoardTcxo( uint8_t state )
 #endif
 }
 
+uint32_t SX1276GetDioIrqTime( void )
+{
+    // The GPIO interrupts are not timestamped on this board
+    return TimerGetCurrentTime( );
+}
+
 uint32_t SX1276GetBoardTcxoWakeupTime( void )
 {
     return BOARD_TCXO_WAKEUP_TIME;
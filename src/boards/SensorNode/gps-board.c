@@ -36,16 +36,6 @@
 //uint8_t TxBuffer[FIFO_TX_SIZE];
 uint8_t RxBuffer[FIFO_RX_SIZE];
 
-/*!
- * \brief Buffer holding the  raw data received from the gps
- */
-uint8_t NmeaString[128];
-
-/*!
- * \brief Maximum number of data byte that we will accept from the GPS
- */
-uint8_t NmeaStringSize = 0;
-
 Gpio_t GpsPowerEn;
 Gpio_t GpsPps;
 
@@ -73,7 +63,6 @@ void GpsMcuInvertPpsTrigger( void )
 
 void GpsMcuInit( void )
 {
-    NmeaStringSize = 0;
     PpsTrigger = PpsTriggerIsFalling;
 
     GpioInit( &GpsPowerEn, GPS_POWER_ON, PIN_OUTPUT, PIN_PUSH_PULL, PIN_NO_PULL, 1 );
@@ -109,17 +98,10 @@ void GpsMcuIrqNotify( UartNotifyId_t id )
     {
         if( UartGetChar( &Uart1, &data ) == 0 )
         {
-            if( ( data == '$' ) || ( NmeaStringSize >= 127 ) )
-            {
-                NmeaStringSize = 0;
-            }
-
-            NmeaString[NmeaStringSize++] = ( int8_t )data;
+            GpsParseGpsByte( data );
 
             if( data == '\n' )
             {
-                NmeaString[NmeaStringSize++] = '\0';
-                GpsParseGpsData( ( int8_t* )NmeaString, NmeaStringSize );
                 UartDeInit( &Uart1 );
                 BlockLowPowerDuringTask ( false );
             }
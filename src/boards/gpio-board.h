@@ -58,6 +58,17 @@ void GpioMcuSetInterrupt( Gpio_t *obj, IrqModes irqMode, IrqPriorities irqPriori
  */
 void GpioMcuRemoveInterrupt( Gpio_t *obj );
 
+/*!
+ * \brief Gets the time of the GPIO interrupt being served
+ *
+ * \remark The boards which don't timestamp their GPIO interrupts return the
+ *         current time
+ *
+ * \retval time Time captured on the interrupt entry [ms], TimerGetCurrentTime
+ *              time base
+ */
+uint32_t GpioMcuGetIrqTime( void );
+
 /*!
  * \brief Writes the given value to the GPIO output
  *
@@ -31,4 +31,7 @@ uint8_t SerialioMcuPutChar( char data );
 // redirect stdin
 uint8_t SerialioMcuGetChar( char *pdata );
 
+// free room in the transmission FIFO
+uint16_t SerialioMcuGetTxFree( void );
+
 #endif // __SERIALIO_BOARD_H__
@@ -66,6 +66,13 @@ void SX1276IoInit( void );
  */
 void SX1276IoIrqInit( DioIrqHandler **irqHandlers );
 
+/*!
+ * \brief Gets the time of the DIO edge being served
+ *
+ * \retval time Edge time [ms], TimerGetCurrentTime time base
+ */
+uint32_t SX1276GetDioIrqTime( void );
+
 /*!
  * \brief De-initializes the radio I/Os pins interface.
  *
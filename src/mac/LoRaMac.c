@@ -32,6 +32,8 @@
 #include "LoRaMac.h"
 #include "LoRaMacCrypto.h"
 #include "LoRaMacTest.h"
+#include "LoRaMacClassB.h"
+#include "LoRaMacNvm.h"
 #include "serialio.h"
 
 // Measure the delay
@@ -127,6 +129,46 @@ static uint32_t LoRaMacDevAddr;
  */
 static MulticastParams_t *MulticastChannels = NULL;
 
+/*!
+ * Number of entries of the multicast channels lookup table
+ */
+#define LORAMAC_MULTICAST_TABLE_SIZE                ( 1 << LORAMAC_MULTICAST_TABLE_BITS )
+
+/*!
+ * Multicast channels lookup table, indexed by a hash of the address. The
+ * collisions are resolved by linear probing.
+ */
+static MulticastParams_t *MulticastTable[LORAMAC_MULTICAST_TABLE_SIZE];
+
+/*!
+ * Key schedules of a multicast channel
+ */
+typedef struct sMulticastKeys
+{
+    /*!
+     * Multicast channel owning the key schedules, NULL when unused
+     */
+    MulticastParams_t *Channel;
+    /*!
+     * Time of the last use, for the least recently used replacement
+     */
+    uint32_t LastUse;
+    /*!
+     * Session key schedules
+     */
+    LoRaMacCryptoSessionKeys_t Keys;
+}MulticastKeys_t;
+
+/*!
+ * Key schedules of the most recently active multicast channels
+ */
+static MulticastKeys_t MulticastKeys[LORAMAC_MULTICAST_KEY_CACHE_SIZE];
+
+/*!
+ * Clock of the multicast key schedules replacement, counts the frames
+ */
+static uint32_t MulticastKeysClock = 0;
+
 /*!
  * Actual device class
  */
@@ -237,6 +279,28 @@ static uint8_t MacCommandsBuffer[LORA_MAC_COMMAND_MAX_LENGTH];
  */
 static uint8_t MacCommandsBufferToRepeat[LORA_MAC_COMMAND_MAX_LENGTH];
 
+/*!
+ * Contains the current MacCommandsBufferDeferred index
+ */
+static uint8_t MacCommandsBufferDeferredIndex = 0;
+
+/*!
+ * Buffer containing the MAC layer commands which did not fit into the last
+ * uplink and wait for the next one
+ */
+static uint8_t MacCommandsBufferDeferred[LORA_MAC_COMMAND_MAX_LENGTH];
+
+/*!
+ * Buffer gathering all the MAC layer commands to be scheduled into an uplink
+ */
+static uint8_t MacCommandsBufferPending[LORA_MAC_COMMAND_MAX_LENGTH];
+
+/*!
+ * Number of uplinks saved by piggybacking the MAC commands on application
+ * payloads instead of sending them on port 0
+ */
+static uint32_t MacCommandsUplinksSaved = 0;
+
 /*!
  * LoRaMac parameters
  */
@@ -337,6 +401,96 @@ static RadioEvents_t RadioEvents;
  */
 static TimerEvent_t TxDelayedTimer;
 
+/*!
+ * Time-off computed by the last transmission attempt restricted by the duty
+ * cycle
+ */
+static TimerTime_t DutyCycleWaitTime = 0;
+
+/*!
+ * Uplink waiting in the uplink queue
+ */
+typedef struct sUplinkQueueEntry
+{
+    /*!
+     * Set to true, if the entry holds an uplink
+     */
+    bool Used;
+    /*!
+     * Position in the queue, lower is older
+     */
+    uint16_t Seq;
+    /*!
+     * Type of the MCPS-Request
+     */
+    Mcps_t Type;
+    /*!
+     * Frame port
+     */
+    uint8_t fPort;
+    /*!
+     * Requested datarate
+     */
+    int8_t Datarate;
+    /*!
+     * Number of trials of confirmed uplinks
+     */
+    uint8_t NbTrials;
+    /*!
+     * Priority of the fPort when queued
+     */
+    uint8_t Priority;
+    /*!
+     * Payload size
+     */
+    uint8_t Size;
+    /*!
+     * Payload
+     */
+    uint8_t Buffer[LORAMAC_UPLINK_QUEUE_MAX_PAYLOAD];
+}UplinkQueueEntry_t;
+
+/*!
+ * Uplink queue configuration of a fPort
+ */
+typedef struct sUplinkQueuePort
+{
+    /*!
+     * Set to true, if the configuration is used
+     */
+    bool Used;
+    /*!
+     * Frame port
+     */
+    uint8_t fPort;
+    /*!
+     * Priority, higher is sent first
+     */
+    uint8_t Priority;
+    /*!
+     * Set to true, if payloads are appended to a queued uplink
+     */
+    bool Coalesce;
+}UplinkQueuePort_t;
+
+/*!
+ * LoRaMac uplink queue
+ */
+static UplinkQueueEntry_t UplinkQueue[LORAMAC_UPLINK_QUEUE_SIZE];
+static UplinkQueuePort_t UplinkQueuePorts[LORAMAC_UPLINK_QUEUE_PORTS];
+static uint16_t UplinkQueueSeq = 0;
+
+/*!
+ * Set while the queue is modified, a drain attempted meanwhile from an
+ * interrupt is skipped and done by the modifier
+ */
+static volatile bool UplinkQueueLocked = false;
+
+/*!
+ * Uplink queue timer, expires when the duty cycle allows the next uplink
+ */
+static TimerEvent_t UplinkQueueTimer;
+
 /*!
  * LoRaMac reception windows timers
  */
@@ -357,6 +511,98 @@ static uint32_t RxWindow2Delay;
 static RxConfigParams_t RxWindow1Config;
 static RxConfigParams_t RxWindow2Config;
 
+/*!
+ * TX power reduction of each TX power index [dB]
+ */
+#define LORAMAC_DEVICE_ADR_TX_POWER_STEP            2
+
+/*!
+ * SNR above which the SNR reported by the radio saturates [dB]
+ */
+#define LORAMAC_DEVICE_ADR_SNR_SATURATION           8
+
+/*!
+ * Noise floor of a 125 kHz channel [dBm]
+ */
+#define LORAMAC_DEVICE_ADR_NOISE_FLOOR              -117
+
+/*!
+ * Link quality measured on a downlink
+ */
+typedef struct sDeviceAdrSample
+{
+    /*!
+     * Link SNR, referred to the maximum TX power [dB]
+     */
+    int8_t Snr;
+    /*!
+     * RSSI of the downlink [dBm]
+     */
+    int16_t Rssi;
+    /*!
+     * Margin above the demodulation floor, as measured [dB]
+     */
+    int8_t Margin;
+}DeviceAdrSample_t;
+
+/*!
+ * Indicates if the device side ADR is enabled
+ */
+static bool DeviceAdrOn = false;
+
+/*!
+ * Margin kept above the demodulation floor by the device side ADR [dB]
+ */
+static int8_t DeviceAdrMargin = LORAMAC_DEVICE_ADR_DEFAULT_MARGIN;
+
+/*!
+ * Ring of the last link quality measurements
+ */
+static DeviceAdrSample_t DeviceAdrHistory[LORAMAC_DEVICE_ADR_HISTORY_SIZE];
+static uint8_t DeviceAdrHistoryIndex = 0;
+static uint8_t DeviceAdrHistoryCount = 0;
+
+/*!
+ * Number of datarates of which the Rx windows parameters are cached
+ */
+#define LORAMAC_RX_WINDOW_CACHE_SIZE                16
+
+/*!
+ * Rx windows parameters computed for a datarate
+ */
+typedef struct sRxWindowParams
+{
+    /*!
+     * Set to true, once the parameters have been computed
+     */
+    bool Valid;
+    /*!
+     * RX datarate, after the regional boundary check
+     */
+    int8_t Datarate;
+    /*!
+     * RX bandwidth.
+     */
+    uint8_t Bandwidth;
+    /*!
+     * RX window timeout
+     */
+    uint32_t WindowTimeout;
+    /*!
+     * RX window offset
+     */
+    int32_t WindowOffset;
+}RxWindowParams_t;
+
+/*!
+ * LoRaMac Rx windows parameters cache, indexed by datarate
+ *
+ * \remark The parameters only depend on the datarate, MinRxSymbols and
+ *         SystemMaxRxError. The cache is cleared when one of the latter
+ *         changes.
+ */
+static RxWindowParams_t RxWindowParamsCache[LORAMAC_RX_WINDOW_CACHE_SIZE];
+
 /*!
  * Acknowledge timeout timer. Used for packet retransmissions.
  */
@@ -412,6 +658,16 @@ static LoRaMacRxSlot_t RxSlot;
  */
 LoRaMacFlags_t LoRaMacFlags;
 
+/*!
+ * Ping slot periodicity of the pending PingSlotInfoReq
+ */
+static uint8_t PingSlotPeriodicity = 0;
+
+/*!
+ * Callbacks of the class B module
+ */
+static LoRaMacClassBCallbacks_t ClassBCallbacks;
+
 /*!
  * \brief Function to be executed on Radio Tx Done event
  */
@@ -453,6 +709,11 @@ static void OnMacStateCheckTimerEvent( void );
  */
 static void OnTxDelayedTimerEvent( void );
 
+/*!
+ * \brief Function executed when the duty cycle allows the next queued uplink
+ */
+static void OnUplinkQueueTimerEvent( void );
+
 /*!
  * \brief Function executed on first Rx window timer event
  */
@@ -496,6 +757,14 @@ static void RxWindowSetup( bool rxContinuous, uint32_t maxRxWindow );
  */
 static bool IsStickyMacCommandPending( void );
 
+/*!
+ * \brief Gets the length of the MAC commands the next uplink carries in its
+ *        fOpts: the deferred ones, the new ones and the ones to re-send.
+ *
+ * \retval Length, at most LORA_MAC_COMMAND_MAX_FOPTS_LENGTH
+ */
+static uint8_t GetPendingMacCommandsLength( void );
+
 /*!
  * \brief Configures the events to trigger an MLME-Indication with
  *        a MLME type of MLME_SCHEDULE_UPLINK.
@@ -535,6 +804,56 @@ static LoRaMacStatus_t AddMacCommand( uint8_t cmd, uint8_t p1, uint8_t p2 );
  */
 static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint8_t* cmdBufOut );
 
+/*!
+ * \brief Gets the length of a MAC command sent by the end-device.
+ *
+ * \param [IN] cmd MAC command identifier
+ *
+ * \retval Length of the MAC command including its identifier, 0 when unknown.
+ */
+static uint8_t GetMacCommandLength( uint8_t cmd );
+
+/*!
+ * \brief Indicates if a MAC command may wait for a later uplink.
+ *
+ * \param [IN] cmd MAC command identifier
+ *
+ * \retval [true: the command may be deferred, false: the command must be sent
+ *          in the next uplink]
+ */
+static bool IsMacCommandLowPriority( uint8_t cmd );
+
+/*!
+ * \brief Packs the MAC commands into an uplink.
+ *
+ * \details The commands which must be sent in the next uplink are packed
+ *          first, then the low priority ones. A command which does not fit is
+ *          skipped, so that a shorter one behind it can still use the room
+ *          left. The relative order of the commands is kept within each
+ *          priority.
+ *
+ * \param [IN] cmdBufIn  Buffer which stores the MAC commands to send
+ * \param [IN] length  Length of the input buffer
+ * \param [IN] maxLength  Room available for the MAC commands in the uplink
+ * \param [OUT] cmdBufOut  Buffer which stores the MAC commands to send now
+ * \param [OUT] cmdBufDeferred  Buffer which stores the MAC commands which did
+ *                              not fit
+ * \param [OUT] deferredLength  Length of the deferred MAC commands
+ *
+ * \retval Length of the MAC commands to send now.
+ */
+static uint8_t ScheduleMacCommands( uint8_t* cmdBufIn, uint8_t length, uint8_t maxLength, uint8_t* cmdBufOut, uint8_t* cmdBufDeferred, uint8_t* deferredLength );
+
+/*!
+ * \brief Gets the maximum payload length of the frame, taking the datarate
+ *        into account.
+ *
+ * \param datarate Current datarate
+ *
+ * \retval Maximum length of the fOpts and the frame payload together
+ */
+static uint8_t GetMaxPayloadLength( int8_t datarate );
+
 /*!
  * \brief Validates if the payload fits into the frame, taking the datarate
  *        into account.
@@ -553,11 +872,87 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
  */
 static bool ValidatePayloadLength( uint8_t lenN, int8_t datarate, uint8_t fOptsLen );
 
+/*!
+ * \brief Gets the lowest SNR at which a datarate can be demodulated.
+ *
+ * \param datarate Datarate
+ *
+ * \retval Demodulation floor [dB], rounded up
+ */
+static int8_t GetDemodFloor( int8_t datarate );
+
+/*!
+ * \brief Clears the link quality history of the device side ADR
+ */
+static void DeviceAdrReset( void );
+
+/*!
+ * \brief Adds a link quality measured on a downlink to the history.
+ *
+ * \param [IN] rssi RSSI of the downlink [dBm]
+ * \param [IN] snr  SNR of the downlink, as reported by the radio [0.25 dB]
+ * \param [IN] datarate Datarate of the downlink
+ */
+static void DeviceAdrAddDownlinkSample( int16_t rssi, int8_t snr, int8_t datarate );
+
+/*!
+ * \brief Adds the margin of the last uplink, reported by a LinkCheckAns, to
+ *        the history.
+ *
+ * \param [IN] margin Demodulation margin [dB]
+ */
+static void DeviceAdrAddLinkCheckSample( uint8_t margin );
+
+/*!
+ * \brief Picks the fastest datarate, then the lowest TX power, which keep
+ *        the target margin on the best link SNR of the history.
+ *
+ * \param [IN/OUT] datarate Uplink datarate
+ * \param [IN/OUT] txPower  Uplink TX power
+ */
+static void DeviceAdrNext( int8_t* datarate, int8_t* txPower );
+
 /*!
  * \brief Decodes MAC commands in the fOpts field and in the payload
  */
 static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, uint8_t snr );
 
+/*!
+ * \brief Gets the multicast channel of an address.
+ *
+ * \param [IN] address Frame address
+ *
+ * \retval Multicast channel, NULL when the address is not a multicast one
+ */
+static MulticastParams_t* MulticastTableFind( uint32_t address );
+
+/*!
+ * \brief Adds a multicast channel to the lookup table.
+ *
+ * \param [IN] channel Multicast channel
+ *
+ * \retval [true: added, false: table full or address already used]
+ */
+static bool MulticastTableAdd( MulticastParams_t *channel );
+
+/*!
+ * \brief Removes a multicast channel from the lookup table and drops its key
+ *        schedules.
+ *
+ * \param [IN] channel Multicast channel
+ */
+static void MulticastTableRemove( MulticastParams_t *channel );
+
+/*!
+ * \brief Gets the key schedules of a multicast channel, they are computed when
+ *        the channel was not active recently.
+ *
+ * \param [IN] channel Multicast channel
+ *
+ * \retval Session key schedules
+ */
+static LoRaMacCryptoSessionKeys_t* MulticastGetKeys( MulticastParams_t *channel );
+
 /*!
  * \brief LoRaMAC layer generic send frame
  *
@@ -651,12 +1046,73 @@ static bool IsFPortAllowed( uint8_t fPort );
  */
 static void OpenContinuousRx2Window( void );
 
+/*!
+ * \brief Computes the Rx window parameters of a datarate, or gets them from
+ *        the cache
+ *
+ * \param [IN] datarate        Rx window datarate
+ * \param [OUT] rxConfigParams Updated Datarate, Bandwidth, WindowTimeout
+ *                             and WindowOffset
+ */
+static void ComputeRxWindowParameters( int8_t datarate, RxConfigParams_t *rxConfigParams );
+
+/*!
+ * \brief Clears the Rx window parameters cache
+ */
+static void ResetRxWindowParameters( void );
+
+/*!
+ * \brief Sends the next queued uplink if the MAC is idle
+ */
+static void UplinkQueueDrain( void );
+
+/*!
+ * \brief Opens a class B beacon or ping slot window
+ *
+ * \param [IN] rxConfig Window parameters
+ * \retval status       false when the MAC or the radio is busy
+ */
+static bool OpenClassBRxWindow( RxConfigParams_t *rxConfig );
+
+/*!
+ * \brief Confirms the class B beacon acquisition
+ *
+ * \param [IN] status Acquisition status
+ */
+static void OnClassBAcquisitionDone( LoRaMacEventInfoStatus_t status );
+
+/*!
+ * \brief Indicates a class B beacon received, missed or lost
+ *
+ * \param [IN] indication MLME_BEACON or MLME_BEACON_LOST
+ * \param [IN] status     Beacon status
+ * \param [IN] beaconTime GPS time of the beacon period start [s]
+ */
+static void OnClassBBeacon( Mlme_t indication, LoRaMacEventInfoStatus_t status, uint32_t beaconTime );
+
+#if defined( LORAMAC_NVM_SESSION )
+/*!
+ * \brief Saves the changes of the session in the EEPROM
+ */
+static void SaveSession( void );
+
+/*!
+ * \brief Saves the frame counters in the EEPROM
+ *
+ * \param [IN] upLinkCounter First uplink counter usable after a reset
+ * \param [IN] channel       Channel of the last uplink
+ */
+static void SaveCounters( uint32_t upLinkCounter, uint8_t channel );
+#endif
+
 static void OnRadioTxDone( void )
 {
     GetPhyParams_t getPhy;
     PhyParam_t phyParam;
     SetBandTxDoneParams_t txDone;
-    TimerTime_t curTime = TimerGetCurrentTime( );
+    // End of the transmission, the windows are relative to it
+    TimerTime_t curTime = RadioEvents.IrqTime;
+    TimerTime_t elapsed = TimerGetElapsedTime( curTime );
 
     if( LoRaMacDeviceClass != CLASS_C )
     {
@@ -670,18 +1126,18 @@ static void OnRadioTxDone( void )
     // Setup timers
     if( IsRxWindowsEnabled == true )
     {
-        TimerSetValue( &RxWindowTimer1, RxWindow1Delay );
+        TimerSetValue( &RxWindowTimer1, ( RxWindow1Delay > elapsed ) ? ( RxWindow1Delay - elapsed ) : 1 );
         TimerStart( &RxWindowTimer1 );
         if( LoRaMacDeviceClass != CLASS_C )
         {
-            TimerSetValue( &RxWindowTimer2, RxWindow2Delay );
+            TimerSetValue( &RxWindowTimer2, ( RxWindow2Delay > elapsed ) ? ( RxWindow2Delay - elapsed ) : 1 );
             TimerStart( &RxWindowTimer2 );
         }
         if( ( LoRaMacDeviceClass == CLASS_C ) || ( NodeAckRequested == true ) )
         {
             getPhy.Attribute = PHY_ACK_TIMEOUT;
             phyParam = RegionGetPhyParam( LoRaMacRegion, &getPhy );
-            TimerSetValue( &AckTimeoutTimer, RxWindow2Delay + phyParam.Value );
+            TimerSetValue( &AckTimeoutTimer, RxWindow2Delay + phyParam.Value - elapsed );
             TimerStart( &AckTimeoutTimer );
         }
     }
@@ -763,6 +1219,7 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
     uint32_t downLinkCounter = 0;
 
     MulticastParams_t *curMulticastParams = NULL;
+    LoRaMacCryptoSessionKeys_t *multicastKeys = NULL;
     uint8_t *nwkSKey = LoRaMacNwkSKey;
     uint8_t *appSKey = LoRaMacAppSKey;
 
@@ -770,6 +1227,13 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 
     bool isMicOk = false;
 
+    if( RxSlot == RX_SLOT_BEACON )
+    {
+        Radio.Sleep( );
+        LoRaMacClassBBeaconRxDone( payload, size, RadioEvents.IrqTime );
+        return;
+    }
+
     McpsConfirm.AckReceived = false;
     McpsIndication.Rssi = rssi;
     McpsIndication.Snr = snr;
@@ -884,26 +1348,17 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 
                 if( address != LoRaMacDevAddr )
                 {
-                    curMulticastParams = MulticastChannels;
-                    while( curMulticastParams != NULL )
-                    {
-                        if( address == curMulticastParams->Address )
-                        {
-                            multicast = 1;
-                            nwkSKey = curMulticastParams->NwkSKey;
-                            appSKey = curMulticastParams->AppSKey;
-                            downLinkCounter = curMulticastParams->DownLinkCounter;
-                            break;
-                        }
-                        curMulticastParams = curMulticastParams->Next;
-                    }
-                    if( multicast == 0 )
+                    curMulticastParams = MulticastTableFind( address );
+                    if( curMulticastParams == NULL )
                     {
                         // We are not the destination of this frame.
                         McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ADDRESS_FAIL;
                         PrepareRxDoneAbort( );
                         return;
                     }
+                    multicast = 1;
+                    multicastKeys = MulticastGetKeys( curMulticastParams );
+                    downLinkCounter = curMulticastParams->DownLinkCounter;
                 }
                 else
                 {
@@ -931,7 +1386,14 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                 if( sequenceCounterDiff < ( 1 << 15 ) )
                 {
                     downLinkCounter += sequenceCounterDiff;
-                    LoRaMacComputeMic( payload, size - LORAMAC_MFR_LEN, nwkSKey, address, DOWN_LINK, downLinkCounter, &mic );
+                    if( multicast == 1 )
+                    {
+                        LoRaMacComputeMicPrekeyed( payload, size - LORAMAC_MFR_LEN, multicastKeys, address, DOWN_LINK, downLinkCounter, &mic );
+                    }
+                    else
+                    {
+                        LoRaMacComputeMic( payload, size - LORAMAC_MFR_LEN, nwkSKey, address, DOWN_LINK, downLinkCounter, &mic );
+                    }
                     if( micRx == mic )
                     {
                         isMicOk = true;
@@ -941,7 +1403,14 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                 {
                     // check for sequence roll-over
                     uint32_t  downLinkCounterTmp = downLinkCounter + 0x10000 + ( int16_t )sequenceCounterDiff;
-                    LoRaMacComputeMic( payload, size - LORAMAC_MFR_LEN, nwkSKey, address, DOWN_LINK, downLinkCounterTmp, &mic );
+                    if( multicast == 1 )
+                    {
+                        LoRaMacComputeMicPrekeyed( payload, size - LORAMAC_MFR_LEN, multicastKeys, address, DOWN_LINK, downLinkCounterTmp, &mic );
+                    }
+                    else
+                    {
+                        LoRaMacComputeMic( payload, size - LORAMAC_MFR_LEN, nwkSKey, address, DOWN_LINK, downLinkCounterTmp, &mic );
+                    }
                     if( micRx == mic )
                     {
                         isMicOk = true;
@@ -974,6 +1443,11 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                     AdrAckCounter = 0;
                     MacCommandsBufferToRepeatIndex = 0;
 
+                    if( multicast == 0 )
+                    {
+                        DeviceAdrAddDownlinkSample( rssi, snr, McpsIndication.RxDatarate );
+                    }
+
                     // Update 32 bits downlink counter
                     if( multicast == 1 )
                     {
@@ -1056,13 +1530,26 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                             // Only allow frames which do not have fOpts
                             if( fCtrl.Bits.FOptsLen == 0 )
                             {
-                                LoRaMacPayloadDecrypt( payload + appPayloadStartIndex,
-                                                       frameLen,
-                                                       nwkSKey,
-                                                       address,
-                                                       DOWN_LINK,
-                                                       downLinkCounter,
-                                                       LoRaMacRxPayload );
+                                if( multicast == 1 )
+                                {
+                                    LoRaMacPayloadDecryptPrekeyed( payload + appPayloadStartIndex,
+                                                                   frameLen,
+                                                                   &multicastKeys->NwkSKey.rijndael,
+                                                                   address,
+                                                                   DOWN_LINK,
+                                                                   downLinkCounter,
+                                                                   LoRaMacRxPayload );
+                                }
+                                else
+                                {
+                                    LoRaMacPayloadDecrypt( payload + appPayloadStartIndex,
+                                                           frameLen,
+                                                           nwkSKey,
+                                                           address,
+                                                           DOWN_LINK,
+                                                           downLinkCounter,
+                                                           LoRaMacRxPayload );
+                                }
 
                                 // Decode frame payload MAC commands
                                 ProcessMacCommands( LoRaMacRxPayload, 0, frameLen, snr );
@@ -1083,13 +1570,26 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                                 ProcessMacCommands( payload, 8, appPayloadStartIndex - 1, snr );
                             }
 
-                            LoRaMacPayloadDecrypt( payload + appPayloadStartIndex,
-                                                   frameLen,
-                                                   appSKey,
-                                                   address,
-                                                   DOWN_LINK,
-                                                   downLinkCounter,
-                                                   LoRaMacRxPayload );
+                            if( multicast == 1 )
+                            {
+                                LoRaMacPayloadDecryptPrekeyed( payload + appPayloadStartIndex,
+                                                               frameLen,
+                                                               &multicastKeys->AppSKey,
+                                                               address,
+                                                               DOWN_LINK,
+                                                               downLinkCounter,
+                                                               LoRaMacRxPayload );
+                            }
+                            else
+                            {
+                                LoRaMacPayloadDecrypt( payload + appPayloadStartIndex,
+                                                       frameLen,
+                                                       appSKey,
+                                                       address,
+                                                       DOWN_LINK,
+                                                       downLinkCounter,
+                                                       LoRaMacRxPayload );
+                            }
 
                             McpsIndication.Buffer = LoRaMacRxPayload;
                             McpsIndication.BufferSize = frameLen;
@@ -1173,6 +1673,16 @@ static void OnRadioRxError( void )
         Radio.Sleep( );
     }
 
+    if( RxSlot == RX_SLOT_BEACON )
+    {
+        LoRaMacClassBBeaconRxFailed( );
+        return;
+    }
+    if( RxSlot == RX_SLOT_WIN_PING_SLOT )
+    {// Nothing received in the ping slot
+        return;
+    }
+
     if( RxSlot == RX_SLOT_WIN_1 )
     {
         if( NodeAckRequested == true )
@@ -1217,6 +1727,16 @@ static void OnRadioRxTimeout( void )
         Radio.Sleep( );
     }
 
+    if( RxSlot == RX_SLOT_BEACON )
+    {
+        LoRaMacClassBBeaconRxFailed( );
+        return;
+    }
+    if( RxSlot == RX_SLOT_WIN_PING_SLOT )
+    {// Nothing received in the ping slot
+        return;
+    }
+
     if( RxSlot == RX_SLOT_WIN_1 )
     {
         if( NodeAckRequested == true )
@@ -1298,6 +1818,10 @@ static void OnMacStateCheckTimerEvent( void )
                     }
                     LoRaMacState &= ~LORAMAC_TX_RUNNING;
                 }
+                else if( ( LoRaMacFlags.Bits.MlmeReq == 1 ) && ( MlmeConfirm.MlmeRequest == MLME_BEACON_ACQUISITION ) )
+                {// Procedure for the beacon acquisition, nothing was sent
+                    LoRaMacState &= ~LORAMAC_RX;
+                }
                 else
                 {// Procedure for all other frames
                     if( ( ChannelsNbRepCounter >= LoRaMacParams.ChannelsNbRep ) || ( LoRaMacFlags.Bits.McpsInd == 1 ) )
@@ -1405,6 +1929,14 @@ static void OnMacStateCheckTimerEvent( void )
     }
     if( LoRaMacState == LORAMAC_IDLE )
     {
+#if defined( LORAMAC_NVM_SESSION )
+        if( ( LoRaMacFlags.Bits.MacDone == 1 ) && ( IsLoRaMacNetworkJoined == true ) &&
+            ( IsUpLinkCounterFixed == false ) )
+        {// Join, MAC commands and downlink counter of the procedure
+            SaveSession( );
+        }
+#endif
+
         if( LoRaMacFlags.Bits.McpsReq == 1 )
         {
             LoRaMacFlags.Bits.McpsReq = 0;
@@ -1425,6 +1957,10 @@ static void OnMacStateCheckTimerEvent( void )
 
         // Procedure done. Reset variables.
         LoRaMacFlags.Bits.MacDone = 0;
+
+        // Send the next queued uplink, if the confirm handlers did not
+        // start a new procedure
+        UplinkQueueDrain( );
     }
     else
     {
@@ -1465,6 +2001,12 @@ static void OnTxDelayedTimerEvent( void )
     ScheduleTx( true );
 }
 
+static void OnUplinkQueueTimerEvent( void )
+{
+    TimerStop( &UplinkQueueTimer );
+    UplinkQueueDrain( );
+}
+
 static void OnRxWindow1TimerEvent( void )
 {
     TimerStop( &RxWindowTimer1 );
@@ -1575,12 +2117,10 @@ static void RxWindowSetup( bool rxContinuous, uint32_t maxRxWindow )
     }
 }
 
-static bool ValidatePayloadLength( uint8_t lenN, int8_t datarate, uint8_t fOptsLen )
+static uint8_t GetMaxPayloadLength( int8_t datarate )
 {
     GetPhyParams_t getPhy;
     PhyParam_t phyParam;
-    uint16_t maxN = 0;
-    uint16_t payloadSize = 0;
 
     // Setup PHY request
     getPhy.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
@@ -1593,26 +2133,57 @@ static bool ValidatePayloadLength( uint8_t lenN, int8_t datarate, uint8_t fOptsL
         getPhy.Attribute = PHY_MAX_PAYLOAD_REPEATER;
     }
     phyParam = RegionGetPhyParam( LoRaMacRegion, &getPhy );
-    maxN = phyParam.Value;
+
+    if( phyParam.Value > LORAMAC_PHY_MAXPAYLOAD )
+    {
+        return LORAMAC_PHY_MAXPAYLOAD;
+    }
+    return phyParam.Value;
+}
+
+static bool ValidatePayloadLength( uint8_t lenN, int8_t datarate, uint8_t fOptsLen )
+{
+    uint16_t maxN = GetMaxPayloadLength( datarate );
+    uint16_t payloadSize = 0;
 
     // Calculate the resulting payload size
     payloadSize = ( lenN + fOptsLen );
 
     // Validation of the application payload size
-    if( ( payloadSize <= maxN ) && ( payloadSize <= LORAMAC_PHY_MAXPAYLOAD ) )
+    if( payloadSize <= maxN )
     {
         return true;
     }
     return false;
 }
 
-static bool IsStickyMacCommandPending( void )
+static uint8_t GetPendingMacCommandsLength( void )
 {
-    if( MacCommandsBufferToRepeatIndex > 0 )
-    {
+    uint16_t length = MacCommandsBufferDeferredIndex + MacCommandsBufferIndex + MacCommandsBufferToRepeatIndex;
+
+    // The commands which don't fit into the fOpts are deferred again
+    return MIN( length, LORA_MAC_COMMAND_MAX_FOPTS_LENGTH );
+}
+
+static bool IsStickyMacCommandPending( void )
+{
+    uint8_t i = 0;
+
+    if( MacCommandsBufferToRepeatIndex > 0 )
+    {
         // Sticky MAC commands pending
         return true;
     }
+    while( i < MacCommandsBufferDeferredIndex )
+    {
+        if( IsMacCommandLowPriority( MacCommandsBufferDeferred[i] ) == false )
+        {
+            // MAC commands which must be sent as soon as possible did not fit
+            // into the last uplink
+            return true;
+        }
+        i += GetMacCommandLength( MacCommandsBufferDeferred[i] );
+    }
     return false;
 }
 
@@ -1625,8 +2196,9 @@ static void SetMlmeScheduleUplinkIndication( void )
 static LoRaMacStatus_t AddMacCommand( uint8_t cmd, uint8_t p1, uint8_t p2 )
 {
     LoRaMacStatus_t status = LORAMAC_STATUS_BUSY;
-    // The maximum buffer length must take MAC commands to re-send into account.
-    uint8_t bufLen = LORA_MAC_COMMAND_MAX_LENGTH - MacCommandsBufferToRepeatIndex;
+    // The maximum buffer length must take MAC commands to re-send and deferred
+    // MAC commands into account.
+    uint8_t bufLen = LORA_MAC_COMMAND_MAX_LENGTH - MacCommandsBufferToRepeatIndex - MacCommandsBufferDeferredIndex;
 
     switch( cmd )
     {
@@ -1717,6 +2289,36 @@ static LoRaMacStatus_t AddMacCommand( uint8_t cmd, uint8_t p1, uint8_t p2 )
                 status = LORAMAC_STATUS_OK;
             }
             break;
+        case MOTE_MAC_DEVICE_TIME_REQ:
+            if( MacCommandsBufferIndex < bufLen )
+            {
+                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
+                // No payload for this command
+                status = LORAMAC_STATUS_OK;
+            }
+            break;
+        case MOTE_MAC_PING_SLOT_INFO_REQ:
+            if( MacCommandsBufferIndex < ( bufLen - 1 ) )
+            {
+                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
+                // Periodicity
+                MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
+                status = LORAMAC_STATUS_OK;
+            }
+            break;
+        case MOTE_MAC_PING_SLOT_CHANNEL_ANS:
+            if( MacCommandsBufferIndex < ( bufLen - 1 ) )
+            {
+                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
+                // Status: Datarate OK, Channel frequency OK
+                MacCommandsBuffer[MacCommandsBufferIndex++] = p1;
+
+                // This is a sticky MAC command answer. Setup indication
+                SetMlmeScheduleUplinkIndication( );
+
+                status = LORAMAC_STATUS_OK;
+            }
+            break;
         default:
             return LORAMAC_STATUS_SERVICE_UNKNOWN;
     }
@@ -1744,6 +2346,7 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
             // STICKY
             case MOTE_MAC_DL_CHANNEL_ANS:
             case MOTE_MAC_RX_PARAM_SETUP_ANS:
+            case MOTE_MAC_PING_SLOT_CHANNEL_ANS:
             { // 1 byte payload
                 cmdBufOut[cmdCount++] = cmdBufIn[i++];
                 cmdBufOut[cmdCount++] = cmdBufIn[i];
@@ -1762,6 +2365,7 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
             }
             case MOTE_MAC_LINK_ADR_ANS:
             case MOTE_MAC_NEW_CHANNEL_ANS:
+            case MOTE_MAC_PING_SLOT_INFO_REQ:
             { // 1 byte payload
                 i++;
                 break;
@@ -1769,6 +2373,7 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
             case MOTE_MAC_TX_PARAM_SETUP_ANS:
             case MOTE_MAC_DUTY_CYCLE_ANS:
             case MOTE_MAC_LINK_CHECK_REQ:
+            case MOTE_MAC_DEVICE_TIME_REQ:
             { // 0 byte payload
                 break;
             }
@@ -1780,6 +2385,342 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
     return cmdCount;
 }
 
+static uint8_t GetMacCommandLength( uint8_t cmd )
+{
+    switch( cmd )
+    {
+        case MOTE_MAC_DEV_STATUS_ANS:
+            // 2 bytes payload
+            return 3;
+        case MOTE_MAC_LINK_ADR_ANS:
+        case MOTE_MAC_RX_PARAM_SETUP_ANS:
+        case MOTE_MAC_NEW_CHANNEL_ANS:
+        case MOTE_MAC_DL_CHANNEL_ANS:
+        case MOTE_MAC_PING_SLOT_INFO_REQ:
+        case MOTE_MAC_PING_SLOT_CHANNEL_ANS:
+            // 1 byte payload
+            return 2;
+        case MOTE_MAC_LINK_CHECK_REQ:
+        case MOTE_MAC_DUTY_CYCLE_ANS:
+        case MOTE_MAC_RX_TIMING_SETUP_ANS:
+        case MOTE_MAC_TX_PARAM_SETUP_ANS:
+        case MOTE_MAC_DEVICE_TIME_REQ:
+            // 0 byte payload
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static bool IsMacCommandLowPriority( uint8_t cmd )
+{
+    switch( cmd )
+    {
+        // The network server does not wait for these answers to apply a
+        // configuration, a late answer only delays its statistics
+        case MOTE_MAC_DEV_STATUS_ANS:
+        case MOTE_MAC_DUTY_CYCLE_ANS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint8_t ScheduleMacCommands( uint8_t* cmdBufIn, uint8_t length, uint8_t maxLength, uint8_t* cmdBufOut, uint8_t* cmdBufDeferred, uint8_t* deferredLength )
+{
+    uint8_t i = 0;
+    uint8_t cmdLen = 0;
+    uint8_t cmdCount = 0;
+    uint8_t pass = 0;
+
+    *deferredLength = 0;
+
+    // 1st pass: commands to send in the next uplink, 2nd pass: low priority commands
+    for( pass = 0; pass < 2; pass++ )
+    {
+        for( i = 0; i < length; i += cmdLen )
+        {
+            cmdLen = GetMacCommandLength( cmdBufIn[i] );
+            if( ( cmdLen == 0 ) || ( ( i + cmdLen ) > length ) )
+            {// Unknown or truncated command, the remaining buffer can't be parsed
+                break;
+            }
+            if( IsMacCommandLowPriority( cmdBufIn[i] ) != ( pass == 1 ) )
+            {
+                continue;
+            }
+            if( ( cmdCount + cmdLen ) <= maxLength )
+            {
+                memcpy1( &cmdBufOut[cmdCount], &cmdBufIn[i], cmdLen );
+                cmdCount += cmdLen;
+            }
+            else
+            {
+                memcpy1( &cmdBufDeferred[*deferredLength], &cmdBufIn[i], cmdLen );
+                *deferredLength += cmdLen;
+            }
+        }
+    }
+    return cmdCount;
+}
+
+static uint8_t MulticastTableHash( uint32_t address )
+{
+    // Fibonacci hashing, the addresses of a group range are often consecutive
+    return ( uint8_t )( ( uint32_t )( address * 2654435761UL ) >> ( 32 - LORAMAC_MULTICAST_TABLE_BITS ) );
+}
+
+static MulticastParams_t* MulticastTableFind( uint32_t address )
+{
+    uint8_t index = MulticastTableHash( address );
+
+    for( uint16_t i = 0; i < LORAMAC_MULTICAST_TABLE_SIZE; i++ )
+    {
+        MulticastParams_t *channel = MulticastTable[index];
+
+        if( channel == NULL )
+        {
+            break;
+        }
+        if( channel->Address == address )
+        {
+            return channel;
+        }
+        index = ( index + 1 ) & ( LORAMAC_MULTICAST_TABLE_SIZE - 1 );
+    }
+    return NULL;
+}
+
+static bool MulticastTableAdd( MulticastParams_t *channel )
+{
+    uint8_t index = MulticastTableHash( channel->Address );
+
+    for( uint16_t i = 0; i < LORAMAC_MULTICAST_TABLE_SIZE; i++ )
+    {
+        if( MulticastTable[index] == NULL )
+        {
+            MulticastTable[index] = channel;
+            return true;
+        }
+        if( MulticastTable[index]->Address == channel->Address )
+        {
+            return false;
+        }
+        index = ( index + 1 ) & ( LORAMAC_MULTICAST_TABLE_SIZE - 1 );
+    }
+    return false;
+}
+
+static void MulticastTableRemove( MulticastParams_t *channel )
+{
+    uint8_t hole = 0;
+    uint8_t index = 0;
+    uint16_t i = 0;
+
+    for( i = 0; i < LORAMAC_MULTICAST_KEY_CACHE_SIZE; i++ )
+    {
+        if( MulticastKeys[i].Channel == channel )
+        {
+            MulticastKeys[i].Channel = NULL;
+        }
+    }
+
+    for( i = 0; i < LORAMAC_MULTICAST_TABLE_SIZE; i++ )
+    {
+        if( MulticastTable[i] == channel )
+        {
+            break;
+        }
+    }
+    if( i == LORAMAC_MULTICAST_TABLE_SIZE )
+    {
+        return;
+    }
+
+    // Shift back the following entries of the probe sequence, so that no
+    // lookup stops on the hole
+    hole = i;
+    index = hole;
+    MulticastTable[hole] = NULL;
+    while( true )
+    {
+        uint8_t home = 0;
+
+        index = ( index + 1 ) & ( LORAMAC_MULTICAST_TABLE_SIZE - 1 );
+        if( MulticastTable[index] == NULL )
+        {
+            break;
+        }
+        home = MulticastTableHash( MulticastTable[index]->Address );
+        // Entries whose home slot lies cyclically in ( hole, index ] stay
+        if( ( hole <= index ) ? ( ( hole < home ) && ( home <= index ) ) : ( ( hole < home ) || ( home <= index ) ) )
+        {
+            continue;
+        }
+        MulticastTable[hole] = MulticastTable[index];
+        MulticastTable[index] = NULL;
+        hole = index;
+    }
+}
+
+static LoRaMacCryptoSessionKeys_t* MulticastGetKeys( MulticastParams_t *channel )
+{
+    MulticastKeys_t *keys = &MulticastKeys[0];
+
+    MulticastKeysClock++;
+    for( uint8_t i = 0; i < LORAMAC_MULTICAST_KEY_CACHE_SIZE; i++ )
+    {
+        if( MulticastKeys[i].Channel == channel )
+        {
+            MulticastKeys[i].LastUse = MulticastKeysClock;
+            return &MulticastKeys[i].Keys;
+        }
+        // Pick an unused entry, or else the least recently used one
+        if( ( keys->Channel != NULL ) &&
+            ( ( MulticastKeys[i].Channel == NULL ) || ( MulticastKeys[i].LastUse < keys->LastUse ) ) )
+        {
+            keys = &MulticastKeys[i];
+        }
+    }
+
+    LoRaMacCryptoSetSessionKeys( channel->NwkSKey, channel->AppSKey, &keys->Keys );
+    keys->Channel = channel;
+    keys->LastUse = MulticastKeysClock;
+    return &keys->Keys;
+}
+
+static int8_t GetDemodFloor( int8_t datarate )
+{
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+
+    getPhy.Attribute = PHY_DEMOD_FLOOR;
+    getPhy.Datarate = datarate;
+    getPhy.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+    phyParam = RegionGetPhyParam( LoRaMacRegion, &getPhy );
+
+    // The conversion rounds towards 0, which keeps the margins on the safe side
+    return ( int8_t )phyParam.fValue;
+}
+
+static void DeviceAdrReset( void )
+{
+    DeviceAdrHistoryIndex = 0;
+    DeviceAdrHistoryCount = 0;
+}
+
+static void DeviceAdrAddSample( int16_t snr, int16_t rssi, int16_t margin )
+{
+    DeviceAdrSample_t* sample = &DeviceAdrHistory[DeviceAdrHistoryIndex];
+
+    sample->Snr = ( int8_t )MIN( MAX( snr, INT8_MIN ), INT8_MAX );
+    sample->Rssi = rssi;
+    sample->Margin = ( int8_t )MIN( MAX( margin, INT8_MIN ), INT8_MAX );
+
+    DeviceAdrHistoryIndex = ( DeviceAdrHistoryIndex + 1 ) % LORAMAC_DEVICE_ADR_HISTORY_SIZE;
+    if( DeviceAdrHistoryCount < LORAMAC_DEVICE_ADR_HISTORY_SIZE )
+    {
+        DeviceAdrHistoryCount++;
+    }
+}
+
+static void DeviceAdrAddDownlinkSample( int16_t rssi, int8_t snr, int8_t datarate )
+{
+    int16_t linkSnr = snr / 4;
+    int16_t margin = linkSnr - GetDemodFloor( datarate );
+
+    if( linkSnr >= LORAMAC_DEVICE_ADR_SNR_SATURATION )
+    {// The SNR no longer grows with strong signals, the RSSI tells how far above the noise floor they are
+        linkSnr = MAX( linkSnr, rssi - LORAMAC_DEVICE_ADR_NOISE_FLOOR );
+    }
+    // The downlink SNR does not depend on the node TX power
+    DeviceAdrAddSample( linkSnr, rssi, margin );
+}
+
+static void DeviceAdrAddLinkCheckSample( uint8_t margin )
+{
+    // The gateways measured the margin on the last uplink
+    int16_t linkSnr = margin + GetDemodFloor( McpsConfirm.Datarate ) +
+                      LoRaMacParams.ChannelsTxPower * LORAMAC_DEVICE_ADR_TX_POWER_STEP;
+
+    DeviceAdrAddSample( linkSnr, McpsIndication.Rssi, margin );
+}
+
+static void DeviceAdrNext( int8_t* datarate, int8_t* txPower )
+{
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+    VerifyParams_t verify;
+    int16_t snr = 0;
+    int16_t margin = 0;
+    int8_t demodFloor = 0;
+    int8_t nextDemodFloor = 0;
+    int8_t dr = 0;
+    int8_t power = 0;
+    uint8_t i = 0;
+
+    if( DeviceAdrHistoryCount < LORAMAC_DEVICE_ADR_MIN_SAMPLES )
+    {
+        return;
+    }
+
+    // Best link SNR of the history, the target margin covers the fading
+    snr = DeviceAdrHistory[0].Snr;
+    for( i = 1; i < DeviceAdrHistoryCount; i++ )
+    {
+        snr = MAX( snr, DeviceAdrHistory[i].Snr );
+    }
+
+    // Keep the current settings while their margin stays within the hysteresis
+    margin = snr - GetDemodFloor( *datarate ) - *txPower * LORAMAC_DEVICE_ADR_TX_POWER_STEP - DeviceAdrMargin;
+    if( ( margin >= 0 ) && ( margin < LORAMAC_DEVICE_ADR_HYSTERESIS ) )
+    {
+        return;
+    }
+
+    // Fastest datarate keeping the target margin at the maximum TX power
+    getPhy.Attribute = PHY_MIN_TX_DR;
+    getPhy.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+    phyParam = RegionGetPhyParam( LoRaMacRegion, &getPhy );
+    dr = phyParam.Value;
+    demodFloor = GetDemodFloor( dr );
+
+    verify.DatarateParams.UplinkDwellTime = LoRaMacParams.UplinkDwellTime;
+    verify.DatarateParams.DownlinkDwellTime = LoRaMacParams.DownlinkDwellTime;
+    while( dr < DR_15 )
+    {
+        verify.DatarateParams.Datarate = dr + 1;
+        if( RegionVerify( LoRaMacRegion, &verify, PHY_TX_DR ) == false )
+        {
+            break;
+        }
+        nextDemodFloor = GetDemodFloor( dr + 1 );
+        // Only the spreading factors of the same bandwidth are stepped through
+        if( ( nextDemodFloor >= 0 ) || ( nextDemodFloor <= demodFloor ) ||
+            ( ( snr - nextDemodFloor - DeviceAdrMargin ) < 0 ) )
+        {
+            break;
+        }
+        dr++;
+        demodFloor = nextDemodFloor;
+    }
+
+    // Lowest TX power keeping the target margin at that datarate
+    margin = snr - demodFloor - DeviceAdrMargin;
+    while( margin >= ( ( power + 1 ) * LORAMAC_DEVICE_ADR_TX_POWER_STEP ) )
+    {
+        verify.TxPower = power + 1;
+        if( RegionVerify( LoRaMacRegion, &verify, PHY_TX_POWER ) == false )
+        {
+            break;
+        }
+        power++;
+    }
+
+    *datarate = dr;
+    *txPower = power;
+}
+
 static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, uint8_t snr )
 {
     uint8_t status = 0;
@@ -1793,6 +2734,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                 MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
                 MlmeConfirm.DemodMargin = payload[macIndex++];
                 MlmeConfirm.NbGateways = payload[macIndex++];
+                DeviceAdrAddLinkCheckSample( MlmeConfirm.DemodMargin );
                 break;
             case SRV_MAC_LINK_ADR_REQ:
                 {
@@ -1952,6 +2894,59 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     AddMacCommand( MOTE_MAC_DL_CHANNEL_ANS, status, 0 );
                 }
                 break;
+            case SRV_MAC_DEVICE_TIME_ANS:
+                {
+                    uint32_t seconds = 0;
+                    uint8_t fraction = 0;
+
+                    seconds = ( uint32_t )payload[macIndex++];
+                    seconds |= ( uint32_t )payload[macIndex++] << 8;
+                    seconds |= ( uint32_t )payload[macIndex++] << 16;
+                    seconds |= ( uint32_t )payload[macIndex++] << 24;
+                    fraction = payload[macIndex++];
+
+                    // The time is the one of the end of the uplink
+                    LoRaMacClassBSetGpsTime( seconds, fraction, AggregatedLastTxDoneTime );
+                    MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+                }
+                break;
+            case SRV_MAC_PING_SLOT_INFO_ANS:
+                LoRaMacClassBSetPingSlotInfo( PingSlotPeriodicity );
+                MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+                break;
+            case SRV_MAC_PING_SLOT_CHANNEL_REQ:
+                {
+                    VerifyParams_t verify;
+                    uint32_t frequency = 0;
+                    int8_t datarate = 0;
+                    status = 0x03;
+
+                    frequency = ( uint32_t )payload[macIndex++];
+                    frequency |= ( uint32_t )payload[macIndex++] << 8;
+                    frequency |= ( uint32_t )payload[macIndex++] << 16;
+                    frequency *= 100;
+                    datarate = payload[macIndex++] & 0x0F;
+
+                    // Frequency 0 selects the default channel
+                    if( ( frequency != 0 ) && ( Radio.CheckRfFrequency( frequency ) == false ) )
+                    {
+                        status &= 0xFE; // Channel frequency KO
+                    }
+
+                    verify.DatarateParams.Datarate = datarate;
+                    verify.DatarateParams.DownlinkDwellTime = LoRaMacParams.DownlinkDwellTime;
+                    if( RegionVerify( LoRaMacRegion, &verify, PHY_RX_DR ) == false )
+                    {
+                        status &= 0xFD; // Datarate KO
+                    }
+
+                    if( status == 0x03 )
+                    {
+                        LoRaMacClassBSetPingSlotChannel( frequency, datarate );
+                    }
+                    AddMacCommand( MOTE_MAC_PING_SLOT_CHANNEL_ANS, status, 0 );
+                }
+                break;
             default:
                 // Unknown command. ABORT MAC commands processing
                 return;
@@ -2021,6 +3016,10 @@ static LoRaMacStatus_t ScheduleTx( bool allowDelayedTx )
 
     if( status != LORAMAC_STATUS_OK )
     {
+        if( status == LORAMAC_STATUS_DUTYCYCLE_RESTRICTED )
+        {
+            DutyCycleWaitTime = dutyCycleTimeOff;
+        }
         if( ( status == LORAMAC_STATUS_DUTYCYCLE_RESTRICTED ) &&
             ( allowDelayedTx == true ) )
         {
@@ -2041,17 +3040,10 @@ static LoRaMacStatus_t ScheduleTx( bool allowDelayedTx )
     }
 
     // Compute Rx1 windows parameters
-    RegionComputeRxWindowParameters( LoRaMacRegion,
-                                     RegionApplyDrOffset( LoRaMacRegion, LoRaMacParams.DownlinkDwellTime, LoRaMacParams.ChannelsDatarate, LoRaMacParams.Rx1DrOffset ),
-                                     LoRaMacParams.MinRxSymbols,
-                                     LoRaMacParams.SystemMaxRxError,
-                                     &RxWindow1Config );
+    ComputeRxWindowParameters( RegionApplyDrOffset( LoRaMacRegion, LoRaMacParams.DownlinkDwellTime, LoRaMacParams.ChannelsDatarate, LoRaMacParams.Rx1DrOffset ),
+                               &RxWindow1Config );
     // Compute Rx2 windows parameters
-    RegionComputeRxWindowParameters( LoRaMacRegion,
-                                     LoRaMacParams.Rx2Channel.Datarate,
-                                     LoRaMacParams.MinRxSymbols,
-                                     LoRaMacParams.SystemMaxRxError,
-                                     &RxWindow2Config );
+    ComputeRxWindowParameters( LoRaMacParams.Rx2Channel.Datarate, &RxWindow2Config );
 
     if( IsLoRaMacNetworkJoined == false )
     {
@@ -2086,9 +3078,145 @@ static void CalculateBackOff( uint8_t channel )
     // Update regional back-off
     RegionCalcBackOff( LoRaMacRegion, &calcBackOff );
 
-    // Update aggregated time-off. This must be an assignment and no incremental
-    // update as we do only calculate the time-off based on the last transmission
-    AggregatedTimeOff = ( TxTimeOnAir * AggregatedDCycle - TxTimeOnAir );
+    // Update aggregated time-off. This must be an assignment and no incremental
+    // update as we do only calculate the time-off based on the last transmission
+    AggregatedTimeOff = ( TxTimeOnAir * AggregatedDCycle - TxTimeOnAir );
+}
+
+static void ComputeRxWindowParameters( int8_t datarate, RxConfigParams_t *rxConfigParams )
+{
+    RxWindowParams_t *params = NULL;
+
+    if( ( datarate >= 0 ) && ( datarate < LORAMAC_RX_WINDOW_CACHE_SIZE ) )
+    {
+        params = &RxWindowParamsCache[datarate];
+        if( params->Valid == true )
+        {
+            rxConfigParams->Datarate = params->Datarate;
+            rxConfigParams->Bandwidth = params->Bandwidth;
+            rxConfigParams->WindowTimeout = params->WindowTimeout;
+            rxConfigParams->WindowOffset = params->WindowOffset;
+            return;
+        }
+    }
+
+    RegionComputeRxWindowParameters( LoRaMacRegion,
+                                     datarate,
+                                     LoRaMacParams.MinRxSymbols,
+                                     LoRaMacParams.SystemMaxRxError,
+                                     rxConfigParams );
+
+    if( params != NULL )
+    {
+        params->Datarate = rxConfigParams->Datarate;
+        params->Bandwidth = rxConfigParams->Bandwidth;
+        params->WindowTimeout = rxConfigParams->WindowTimeout;
+        params->WindowOffset = rxConfigParams->WindowOffset;
+        params->Valid = true;
+    }
+}
+
+static void ResetRxWindowParameters( void )
+{
+    for( uint8_t i = 0; i < LORAMAC_RX_WINDOW_CACHE_SIZE; i++ )
+    {
+        RxWindowParamsCache[i].Valid = false;
+    }
+}
+
+static UplinkQueuePort_t* UplinkQueueGetPort( uint8_t fPort )
+{
+    for( uint8_t i = 0; i < LORAMAC_UPLINK_QUEUE_PORTS; i++ )
+    {
+        if( ( UplinkQueuePorts[i].Used == true ) && ( UplinkQueuePorts[i].fPort == fPort ) )
+        {
+            return &UplinkQueuePorts[i];
+        }
+    }
+    return NULL;
+}
+
+static UplinkQueueEntry_t* UplinkQueueGetNext( void )
+{
+    UplinkQueueEntry_t *next = NULL;
+
+    for( uint8_t i = 0; i < LORAMAC_UPLINK_QUEUE_SIZE; i++ )
+    {
+        UplinkQueueEntry_t *entry = &UplinkQueue[i];
+
+        if( entry->Used == false )
+        {
+            continue;
+        }
+        if( ( next == NULL ) || ( entry->Priority > next->Priority ) ||
+            ( ( entry->Priority == next->Priority ) && ( ( int16_t )( entry->Seq - next->Seq ) < 0 ) ) )
+        {
+            next = entry;
+        }
+    }
+    return next;
+}
+
+static void UplinkQueueDrain( void )
+{
+    UplinkQueueEntry_t *entry;
+    McpsReq_t mcpsReq;
+    LoRaMacStatus_t status;
+
+    if( ( UplinkQueueLocked == true ) || ( LoRaMacState != LORAMAC_IDLE ) )
+    {
+        return;
+    }
+    UplinkQueueLocked = true;
+
+    while( ( entry = UplinkQueueGetNext( ) ) != NULL )
+    {
+        mcpsReq.Type = entry->Type;
+        switch( entry->Type )
+        {
+            case MCPS_CONFIRMED:
+                mcpsReq.Req.Confirmed.fPort = entry->fPort;
+                mcpsReq.Req.Confirmed.fBuffer = entry->Buffer;
+                mcpsReq.Req.Confirmed.fBufferSize = entry->Size;
+                mcpsReq.Req.Confirmed.Datarate = entry->Datarate;
+                mcpsReq.Req.Confirmed.NbTrials = entry->NbTrials;
+                break;
+            case MCPS_PROPRIETARY:
+                mcpsReq.Req.Proprietary.fBuffer = entry->Buffer;
+                mcpsReq.Req.Proprietary.fBufferSize = entry->Size;
+                mcpsReq.Req.Proprietary.Datarate = entry->Datarate;
+                break;
+            case MCPS_UNCONFIRMED:
+            default:
+                mcpsReq.Req.Unconfirmed.fPort = entry->fPort;
+                mcpsReq.Req.Unconfirmed.fBuffer = ( entry->Size > 0 ) ? entry->Buffer : NULL;
+                mcpsReq.Req.Unconfirmed.fBufferSize = entry->Size;
+                mcpsReq.Req.Unconfirmed.Datarate = entry->Datarate;
+                break;
+        }
+
+        status = LoRaMacMcpsRequest( &mcpsReq );
+        if( status == LORAMAC_STATUS_DUTYCYCLE_RESTRICTED )
+        {// Try again once the duty cycle allows it
+            TimerSetValue( &UplinkQueueTimer, ( DutyCycleWaitTime > 0 ) ? DutyCycleWaitTime : 1 );
+            TimerStart( &UplinkQueueTimer );
+            break;
+        }
+        if( ( status == LORAMAC_STATUS_BUSY ) || ( status == LORAMAC_STATUS_NO_NETWORK_JOINED ) ||
+            ( status == LORAMAC_STATUS_DEVICE_OFF ) )
+        {// Try again when the MAC becomes idle
+            break;
+        }
+        // The payload has been copied by the MAC, or the uplink has been
+        // rejected and is dropped
+        entry->Used = false;
+        if( status == LORAMAC_STATUS_OK )
+        {
+            break;
+        }
+    }
+
+    UplinkQueueLocked = false;
 }
 
 static void ResetMacParameters( void )
@@ -2111,6 +3239,7 @@ static void ResetMacParameters( void )
 
     MacCommandsBufferIndex = 0;
     MacCommandsBufferToRepeatIndex = 0;
+    MacCommandsBufferDeferredIndex = 0;
 
     IsRxWindowsEnabled = true;
 
@@ -2158,6 +3287,101 @@ static void OpenContinuousRx2Window( void )
     RxSlot = RX_SLOT_WIN_CLASS_C;
 }
 
+static bool OpenClassBRxWindow( RxConfigParams_t *rxConfig )
+{
+    // The class A windows and the uplinks have the priority
+    if( ( LoRaMacState & ~LORAMAC_RX ) != LORAMAC_IDLE )
+    {
+        return false;
+    }
+
+    rxConfig->DownlinkDwellTime = LoRaMacParams.DownlinkDwellTime;
+    rxConfig->RepeaterSupport = RepeaterSupport;
+    if( RegionRxConfig( LoRaMacRegion, rxConfig, ( int8_t* )&McpsIndication.RxDatarate ) == false )
+    {
+        return false;
+    }
+    RxSlot = rxConfig->RxSlot;
+    RxWindowSetup( rxConfig->RxContinuous, LoRaMacParams.MaxRxWindow );
+    return true;
+}
+
+static void OnClassBAcquisitionDone( LoRaMacEventInfoStatus_t status )
+{
+    MlmeConfirm.Status = status;
+    LoRaMacFlags.Bits.MacDone = 1;
+
+    // Trig OnMacCheckTimerEvent call as soon as possible
+    TimerSetValue( &MacStateCheckTimer, 1 );
+    TimerStart( &MacStateCheckTimer );
+}
+
+static void OnClassBBeacon( Mlme_t indication, LoRaMacEventInfoStatus_t status, uint32_t beaconTime )
+{
+    if( ( indication == MLME_BEACON_LOST ) && ( LoRaMacDeviceClass == CLASS_B ) )
+    {
+        LoRaMacDeviceClass = CLASS_A;
+    }
+
+    MlmeIndication.MlmeIndication = indication;
+    MlmeIndication.Status = status;
+    MlmeIndication.BeaconTime = beaconTime;
+    LoRaMacFlags.Bits.MlmeInd = 1;
+
+    // Trig OnMacCheckTimerEvent call as soon as possible
+    TimerSetValue( &MacStateCheckTimer, 1 );
+    TimerStart( &MacStateCheckTimer );
+}
+
+#if defined( LORAMAC_NVM_SESSION )
+static void SaveSession( void )
+{
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+    uint8_t nbChannels;
+
+    if( LoRaMacNvmSessionOpen( LoRaMacDevAddr, LoRaMacNwkSKey, LoRaMacAppSKey ) == true )
+    {// New session, the counter slots take over from these counters
+        LORAMAC_NVM_SESSION_UPDATE( UpLinkCounter, &UpLinkCounter );
+        LORAMAC_NVM_SESSION_UPDATE( DownLinkCounter, &DownLinkCounter );
+    }
+    LORAMAC_NVM_SESSION_UPDATE( NetID, &LoRaMacNetID );
+    LORAMAC_NVM_SESSION_UPDATE( MacParams, &LoRaMacParams );
+    LORAMAC_NVM_SESSION_UPDATE( MaxDCycle, &MaxDCycle );
+    LORAMAC_NVM_SESSION_UPDATE( AggregatedDCycle, &AggregatedDCycle );
+
+    getPhy.Attribute = PHY_MAX_NB_CHANNELS;
+    phyParam = RegionGetPhyParam( LoRaMacRegion, &getPhy );
+    nbChannels = phyParam.Value;
+    if( nbChannels <= LORAMAC_NVM_MAX_CHANNELS )
+    {// Larger channel plans are fixed by the region
+        getPhy.Attribute = PHY_CHANNELS;
+        phyParam = RegionGetPhyParam( LoRaMacRegion, &getPhy );
+        LoRaMacNvmSessionUpdate( offsetof( LoRaMacNvmSession_t, Channels ), phyParam.Channels, nbChannels * sizeof( ChannelParams_t ) );
+    }
+    getPhy.Attribute = PHY_CHANNELS_MASK;
+    phyParam = RegionGetPhyParam( LoRaMacRegion, &getPhy );
+    LoRaMacNvmSessionUpdate( offsetof( LoRaMacNvmSession_t, ChannelsMask ), phyParam.ChannelsMask,
+                             MIN( ( nbChannels + 15 ) / 16, LORAMAC_NVM_CHANNELS_MASK_SIZE ) * sizeof( uint16_t ) );
+    LoRaMacNvmSessionCommit( );
+
+    // Downlink counter updated after the uplink
+    SaveCounters( UpLinkCounter, LastTxChannel );
+}
+
+static void SaveCounters( uint32_t upLinkCounter, uint8_t channel )
+{
+    LoRaMacNvmCounters_t counters;
+
+    counters.UpLinkCounter = upLinkCounter;
+    counters.DownLinkCounter = DownLinkCounter;
+    counters.TxTimeOnAir = MIN( TxTimeOnAir, UINT16_MAX );
+    counters.Channel = channel;
+    counters.Rfu = 0;
+    LoRaMacNvmSaveCounters( &counters );
+}
+#endif
+
 LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl, uint8_t fPort, void *fBuffer, uint16_t fBufferSize )
 {
     AdrNextParams_t adrNext;
@@ -2223,6 +3447,18 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
             fCtrl->Bits.AdrAckReq = RegionAdrNext( LoRaMacRegion, &adrNext,
                                                    &LoRaMacParams.ChannelsDatarate, &LoRaMacParams.ChannelsTxPower, &AdrAckCounter );
 
+            if( ( DeviceAdrOn == true ) && ( fCtrl->Bits.Adr == 1 ) )
+            {
+                if( fCtrl->Bits.AdrAckReq == 1 )
+                {// No downlink for a long time, the history no longer describes the link
+                    DeviceAdrReset( );
+                }
+                else
+                {
+                    DeviceAdrNext( &LoRaMacParams.ChannelsDatarate, &LoRaMacParams.ChannelsTxPower );
+                }
+            }
+
             if( SrvAckRequested == true )
             {
                 SrvAckRequested = false;
@@ -2239,26 +3475,52 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
             LoRaMacBuffer[pktHeaderLen++] = UpLinkCounter & 0xFF;
             LoRaMacBuffer[pktHeaderLen++] = ( UpLinkCounter >> 8 ) & 0xFF;
 
-            // Copy the MAC commands which must be re-send into the MAC command buffer
-            memcpy1( &MacCommandsBuffer[MacCommandsBufferIndex], MacCommandsBufferToRepeat, MacCommandsBufferToRepeatIndex );
-            MacCommandsBufferIndex += MacCommandsBufferToRepeatIndex;
-
-            if( ( payload != NULL ) && ( LoRaMacTxPayloadLen > 0 ) )
+            if( MacCommandsInNextTx == true )
             {
-                if( MacCommandsInNextTx == true )
-                {
-                    if( MacCommandsBufferIndex <= LORA_MAC_COMMAND_MAX_FOPTS_LENGTH )
+                uint8_t maxPayloadLen = GetMaxPayloadLength( LoRaMacParams.ChannelsDatarate );
+                uint8_t pendingLen = 0;
+
+                // Gather the deferred MAC commands, the new ones and the ones which must be re-send
+                memcpy1( MacCommandsBufferPending, MacCommandsBufferDeferred, MacCommandsBufferDeferredIndex );
+                pendingLen += MacCommandsBufferDeferredIndex;
+                memcpy1( &MacCommandsBufferPending[pendingLen], MacCommandsBuffer, MacCommandsBufferIndex );
+                pendingLen += MacCommandsBufferIndex;
+                memcpy1( &MacCommandsBufferPending[pendingLen], MacCommandsBufferToRepeat, MacCommandsBufferToRepeatIndex );
+                pendingLen += MacCommandsBufferToRepeatIndex;
+
+                if( ( payload != NULL ) && ( LoRaMacTxPayloadLen > 0 ) )
+                {// Piggyback as many MAC commands as possible, the others wait for the next uplink
+                    uint8_t maxFOptsLen = LORA_MAC_COMMAND_MAX_FOPTS_LENGTH;
+
+                    if( LoRaMacTxPayloadLen >= maxPayloadLen )
                     {
-                        fCtrl->Bits.FOptsLen += MacCommandsBufferIndex;
+                        maxFOptsLen = 0;
+                    }
+                    else if( ( maxPayloadLen - LoRaMacTxPayloadLen ) < maxFOptsLen )
+                    {
+                        maxFOptsLen = maxPayloadLen - LoRaMacTxPayloadLen;
+                    }
+                    MacCommandsBufferIndex = ScheduleMacCommands( MacCommandsBufferPending, pendingLen, maxFOptsLen,
+                                                                  MacCommandsBuffer, MacCommandsBufferDeferred, &MacCommandsBufferDeferredIndex );
+                    if( pendingLen > LORA_MAC_COMMAND_MAX_FOPTS_LENGTH )
+                    {// The MAC commands would have taken the place of the application payload
+                        MacCommandsUplinksSaved++;
+                    }
 
-                        // Update FCtrl field with new value of OptionsLength
-                        LoRaMacBuffer[0x05] = fCtrl->Value;
-                        for( i = 0; i < MacCommandsBufferIndex; i++ )
-                        {
-                            LoRaMacBuffer[pktHeaderLen++] = MacCommandsBuffer[i];
-                        }
+                    fCtrl->Bits.FOptsLen += MacCommandsBufferIndex;
+
+                    // Update FCtrl field with new value of OptionsLength
+                    LoRaMacBuffer[0x05] = fCtrl->Value;
+                    for( i = 0; i < MacCommandsBufferIndex; i++ )
+                    {
+                        LoRaMacBuffer[pktHeaderLen++] = MacCommandsBuffer[i];
                     }
-                    else
+                }
+                else
+                {// The uplink carries only MAC commands, send all of those which fit on port 0
+                    MacCommandsBufferIndex = ScheduleMacCommands( MacCommandsBufferPending, pendingLen, maxPayloadLen,
+                                                                  MacCommandsBuffer, MacCommandsBufferDeferred, &MacCommandsBufferDeferredIndex );
+                    if( MacCommandsBufferIndex > 0 )
                     {
                         LoRaMacTxPayloadLen = MacCommandsBufferIndex;
                         payload = MacCommandsBuffer;
@@ -2268,17 +3530,12 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
             }
             else
             {
-                if( ( MacCommandsBufferIndex > 0 ) && ( MacCommandsInNextTx == true ) )
-                {
-                    LoRaMacTxPayloadLen = MacCommandsBufferIndex;
-                    payload = MacCommandsBuffer;
-                    framePort = 0;
-                }
+                MacCommandsBufferIndex = 0;
             }
             MacCommandsInNextTx = false;
             // Store MAC commands which must be re-send in case the device does not receive a downlink anymore
             MacCommandsBufferToRepeatIndex = ParseMacCommandsToRepeat( MacCommandsBuffer, MacCommandsBufferIndex, MacCommandsBufferToRepeat );
-            if( MacCommandsBufferToRepeatIndex > 0 )
+            if( ( MacCommandsBufferToRepeatIndex > 0 ) || ( MacCommandsBufferDeferredIndex > 0 ) )
             {
                 MacCommandsInNextTx = true;
             }
@@ -2348,6 +3605,25 @@ LoRaMacStatus_t SendFrameOnChannel( uint8_t channel )
     McpsConfirm.TxTimeOnAir = TxTimeOnAir;
     MlmeConfirm.TxTimeOnAir = TxTimeOnAir;
 
+    // The uplink closes an open class B window
+    if( ( ( RxSlot == RX_SLOT_BEACON ) || ( RxSlot == RX_SLOT_WIN_PING_SLOT ) ) &&
+        ( Radio.GetStatus( ) == RF_RX_RUNNING ) )
+    {
+        Radio.Sleep( );
+        if( RxSlot == RX_SLOT_BEACON )
+        {
+            LoRaMacClassBBeaconRxFailed( );
+        }
+    }
+
+#if defined( LORAMAC_NVM_SESSION )
+    // Saved before the frame is on air, a reset must not reuse its counter
+    if( ( IsLoRaMacNetworkJoined == true ) && ( IsUpLinkCounterFixed == false ) )
+    {
+        SaveCounters( UpLinkCounter + 1, channel );
+    }
+#endif
+
     // Starts the MAC layer status check timer
     TimerSetValue( &MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT );
     TimerStart( &MacStateCheckTimer );
@@ -2503,6 +3779,7 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
 
     LoRaMacParams.SystemMaxRxError = LoRaMacParamsDefaults.SystemMaxRxError;
     LoRaMacParams.MinRxSymbols = LoRaMacParamsDefaults.MinRxSymbols;
+    ResetRxWindowParameters( );
     LoRaMacParams.MaxRxWindow = LoRaMacParamsDefaults.MaxRxWindow;
     LoRaMacParams.ReceiveDelay1 = LoRaMacParamsDefaults.ReceiveDelay1;
     LoRaMacParams.ReceiveDelay2 = LoRaMacParamsDefaults.ReceiveDelay2;
@@ -2517,10 +3794,20 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
     TimerSetValue( &MacStateCheckTimer, MAC_STATE_CHECK_TIMEOUT );
 
     TimerInit( &TxDelayedTimer, OnTxDelayedTimerEvent );
+    TimerInit( &UplinkQueueTimer, OnUplinkQueueTimerEvent );
     TimerInit( &RxWindowTimer1, OnRxWindow1TimerEvent );
     TimerInit( &RxWindowTimer2, OnRxWindow2TimerEvent );
     TimerInit( &AckTimeoutTimer, OnAckTimeoutTimerEvent );
 
+    ClassBCallbacks.OpenRxWindow = OpenClassBRxWindow;
+    ClassBCallbacks.OnAcquisitionDone = OnClassBAcquisitionDone;
+    ClassBCallbacks.OnBeacon = OnClassBBeacon;
+    LoRaMacClassBInit( LoRaMacRegion, &ClassBCallbacks );
+
+#if defined( LORAMAC_NVM_SESSION )
+    LoRaMacNvmInit( );
+#endif
+
     // Store the current initialization time
     LoRaMacInitializationTime = TimerGetCurrentTime( );
 
@@ -2594,6 +3881,7 @@ LoRaMacStatus_t LoRaMacQueryTxPossible( uint8_t size, LoRaMacTxInfo_t* txInfo )
         fOptLen = 0;
         MacCommandsBufferIndex = 0;
         MacCommandsBufferToRepeatIndex = 0;
+        MacCommandsBufferDeferredIndex = 0;
     }
 
     // Verify if the fOpts and the payload fit into the maximum payload
@@ -2632,6 +3920,16 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
             mibGet->Param.AdrEnable = AdrCtrlOn;
             break;
         }
+        case MIB_DEVICE_ADR:
+        {
+            mibGet->Param.DeviceAdrEnable = DeviceAdrOn;
+            break;
+        }
+        case MIB_DEVICE_ADR_MARGIN:
+        {
+            mibGet->Param.DeviceAdrMargin = DeviceAdrMargin;
+            break;
+        }
         case MIB_NET_ID:
         {
             mibGet->Param.NetID = LoRaMacNetID;
@@ -2781,6 +4079,11 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
             mibGet->Param.DefaultAntennaGain = LoRaMacParamsDefaults.AntennaGain;
             break;
         }
+        case MIB_MAC_COMMANDS_UPLINKS_SAVED:
+        {
+            mibGet->Param.MacCommandsUplinksSaved = MacCommandsUplinksSaved;
+            break;
+        }
         default:
             status = LORAMAC_STATUS_SERVICE_UNKNOWN;
             break;
@@ -2808,6 +4111,16 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
     {
         case MIB_DEVICE_CLASS:
         {
+            if( ( mibSet->Param.Class == CLASS_B ) && ( LoRaMacClassBIsReady( ) == false ) )
+            {
+                // A beacon must be locked and the ping slots announced first
+                status = LORAMAC_STATUS_PARAMETER_INVALID;
+                break;
+            }
+            if( ( LoRaMacDeviceClass == CLASS_B ) && ( mibSet->Param.Class != CLASS_B ) )
+            {
+                LoRaMacClassBStop( );
+            }
             LoRaMacDeviceClass = mibSet->Param.Class;
             switch( LoRaMacDeviceClass )
             {
@@ -2819,6 +4132,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
                 }
                 case CLASS_B:
                 {
+                    LoRaMacClassBStart( LoRaMacDevAddr );
                     break;
                 }
                 case CLASS_C:
@@ -2828,11 +4142,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
                     // Set the radio into sleep mode in case we are still in RX mode
                     Radio.Sleep( );
                     // Compute Rx2 windows parameters in case the RX2 datarate has changed
-                    RegionComputeRxWindowParameters( LoRaMacRegion,
-                                                     LoRaMacParams.Rx2Channel.Datarate,
-                                                     LoRaMacParams.MinRxSymbols,
-                                                     LoRaMacParams.SystemMaxRxError,
-                                                     &RxWindow2Config );
+                    ComputeRxWindowParameters( LoRaMacParams.Rx2Channel.Datarate, &RxWindow2Config );
                     OpenContinuousRx2Window( );
                     break;
                 }
@@ -2849,6 +4159,17 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
             AdrCtrlOn = mibSet->Param.AdrEnable;
             break;
         }
+        case MIB_DEVICE_ADR:
+        {
+            DeviceAdrOn = mibSet->Param.DeviceAdrEnable;
+            DeviceAdrReset( );
+            break;
+        }
+        case MIB_DEVICE_ADR_MARGIN:
+        {
+            DeviceAdrMargin = mibSet->Param.DeviceAdrMargin;
+            break;
+        }
         case MIB_NET_ID:
         {
             LoRaMacNetID = mibSet->Param.NetID;
@@ -2913,11 +4234,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
                     // Set the radio into sleep mode in case we are still in RX mode
                     Radio.Sleep( );
                     // Compute Rx2 windows parameters
-                    RegionComputeRxWindowParameters( LoRaMacRegion,
-                                                     LoRaMacParams.Rx2Channel.Datarate,
-                                                     LoRaMacParams.MinRxSymbols,
-                                                     LoRaMacParams.SystemMaxRxError,
-                                                     &RxWindow2Config );
+                    ComputeRxWindowParameters( LoRaMacParams.Rx2Channel.Datarate, &RxWindow2Config );
                     OpenContinuousRx2Window( );
                 }
             }
@@ -3072,11 +4389,13 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
         case MIB_SYSTEM_MAX_RX_ERROR:
         {
             LoRaMacParams.SystemMaxRxError = LoRaMacParamsDefaults.SystemMaxRxError = mibSet->Param.SystemMaxRxError;
+            ResetRxWindowParameters( );
             break;
         }
         case MIB_MIN_RX_SYMBOLS:
         {
             LoRaMacParams.MinRxSymbols = LoRaMacParamsDefaults.MinRxSymbols = mibSet->Param.MinRxSymbols;
+            ResetRxWindowParameters( );
             break;
         }
         case MIB_ANTENNA_GAIN:
@@ -3148,8 +4467,14 @@ LoRaMacStatus_t LoRaMacMulticastChannelLink( MulticastParams_t *channelParam )
         return LORAMAC_STATUS_BUSY;
     }
 
+    if( MulticastTableAdd( channelParam ) == false )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+
     // Reset downlink counter
     channelParam->DownLinkCounter = 0;
+    channelParam->Next = NULL;
 
     if( MulticastChannels == NULL )
     {
@@ -3183,6 +4508,8 @@ LoRaMacStatus_t LoRaMacMulticastChannelUnlink( MulticastParams_t *channelParam )
         return LORAMAC_STATUS_BUSY;
     }
 
+    MulticastTableRemove( channelParam );
+
     if( MulticastChannels != NULL )
     {
         if( MulticastChannels == channelParam )
@@ -3271,6 +4598,42 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t *mlmeRequest )
             status = AddMacCommand( MOTE_MAC_LINK_CHECK_REQ, 0, 0 );
             break;
         }
+        case MLME_DEVICE_TIME:
+        {
+            LoRaMacFlags.Bits.MlmeReq = 1;
+            // LoRaMac will send this command piggy-pack
+            MlmeConfirm.MlmeRequest = mlmeRequest->Type;
+
+            status = AddMacCommand( MOTE_MAC_DEVICE_TIME_REQ, 0, 0 );
+            break;
+        }
+        case MLME_PING_SLOT_INFO:
+        {
+            if( mlmeRequest->Req.PingSlotInfo.Periodicity > 7 )
+            {
+                return LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+            LoRaMacFlags.Bits.MlmeReq = 1;
+            // LoRaMac will send this command piggy-pack
+            MlmeConfirm.MlmeRequest = mlmeRequest->Type;
+            PingSlotPeriodicity = mlmeRequest->Req.PingSlotInfo.Periodicity;
+
+            status = AddMacCommand( MOTE_MAC_PING_SLOT_INFO_REQ, PingSlotPeriodicity, 0 );
+            break;
+        }
+        case MLME_BEACON_ACQUISITION:
+        {
+            LoRaMacFlags.Bits.MlmeReq = 1;
+            MlmeConfirm.MlmeRequest = mlmeRequest->Type;
+
+            status = LoRaMacClassBBeaconAcquisition( );
+            if( status == LORAMAC_STATUS_OK )
+            {
+                // No uplink during the acquisition
+                LoRaMacState |= LORAMAC_RX;
+            }
+            break;
+        }
         case MLME_TXCW:
         {
             MlmeConfirm.MlmeRequest = mlmeRequest->Type;
@@ -3416,6 +4779,235 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
     return status;
 }
 
+LoRaMacStatus_t LoRaMacQueueRequest( McpsReq_t *mcpsRequest )
+{
+    UplinkQueuePort_t *port;
+    UplinkQueueEntry_t *entry = NULL;
+    uint8_t fPort = 0;
+    void *fBuffer = NULL;
+    uint16_t fBufferSize = 0;
+    int8_t datarate = DR_0;
+    uint8_t nbTrials = 1;
+
+    if( mcpsRequest == NULL )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+
+    switch( mcpsRequest->Type )
+    {
+        case MCPS_UNCONFIRMED:
+            fPort = mcpsRequest->Req.Unconfirmed.fPort;
+            fBuffer = mcpsRequest->Req.Unconfirmed.fBuffer;
+            fBufferSize = mcpsRequest->Req.Unconfirmed.fBufferSize;
+            datarate = mcpsRequest->Req.Unconfirmed.Datarate;
+            break;
+        case MCPS_CONFIRMED:
+            fPort = mcpsRequest->Req.Confirmed.fPort;
+            fBuffer = mcpsRequest->Req.Confirmed.fBuffer;
+            fBufferSize = mcpsRequest->Req.Confirmed.fBufferSize;
+            datarate = mcpsRequest->Req.Confirmed.Datarate;
+            nbTrials = mcpsRequest->Req.Confirmed.NbTrials;
+            break;
+        case MCPS_PROPRIETARY:
+            fBuffer = mcpsRequest->Req.Proprietary.fBuffer;
+            fBufferSize = mcpsRequest->Req.Proprietary.fBufferSize;
+            datarate = mcpsRequest->Req.Proprietary.Datarate;
+            break;
+        default:
+            return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    }
+
+    if( ( IsFPortAllowed( fPort ) == false ) || ( ( fBuffer == NULL ) && ( fBufferSize > 0 ) ) )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+    if( fBufferSize > LORAMAC_UPLINK_QUEUE_MAX_PAYLOAD )
+    {
+        return LORAMAC_STATUS_LENGTH_ERROR;
+    }
+
+    UplinkQueueLocked = true;
+
+    port = UplinkQueueGetPort( fPort );
+    if( ( port != NULL ) && ( port->Coalesce == true ) && ( mcpsRequest->Type != MCPS_PROPRIETARY ) )
+    {// Look for a queued uplink to append the payload to
+        for( uint8_t i = 0; i < LORAMAC_UPLINK_QUEUE_SIZE; i++ )
+        {
+            UplinkQueueEntry_t *queued = &UplinkQueue[i];
+            uint16_t size = queued->Size + fBufferSize;
+
+            if( ( queued->Used == true ) && ( queued->Type == mcpsRequest->Type ) &&
+                ( queued->fPort == fPort ) && ( queued->Datarate == datarate ) &&
+                ( size <= LORAMAC_UPLINK_QUEUE_MAX_PAYLOAD ) &&
+                ( ValidatePayloadLength( size, ( AdrCtrlOn == true ) ? LoRaMacParams.ChannelsDatarate : datarate, GetPendingMacCommandsLength( ) ) == true ) )
+            {
+                memcpy1( queued->Buffer + queued->Size, ( uint8_t* )fBuffer, fBufferSize );
+                queued->Size = size;
+                queued->NbTrials = MAX( queued->NbTrials, nbTrials );
+                entry = queued;
+                break;
+            }
+        }
+    }
+
+    if( entry == NULL )
+    {
+        for( uint8_t i = 0; i < LORAMAC_UPLINK_QUEUE_SIZE; i++ )
+        {
+            if( UplinkQueue[i].Used == false )
+            {
+                entry = &UplinkQueue[i];
+                break;
+            }
+        }
+        if( entry == NULL )
+        {
+            UplinkQueueLocked = false;
+            return LORAMAC_STATUS_BUSY;
+        }
+
+        entry->Seq = UplinkQueueSeq++;
+        entry->Type = mcpsRequest->Type;
+        entry->fPort = fPort;
+        entry->Datarate = datarate;
+        entry->NbTrials = nbTrials;
+        entry->Priority = ( port != NULL ) ? port->Priority : 0;
+        entry->Size = fBufferSize;
+        memcpy1( entry->Buffer, ( uint8_t* )fBuffer, fBufferSize );
+        entry->Used = true;
+    }
+
+    UplinkQueueLocked = false;
+
+    UplinkQueueDrain( );
+    return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacQueueSetPortConfig( uint8_t fPort, uint8_t priority, bool coalesce )
+{
+    UplinkQueuePort_t *port = UplinkQueueGetPort( fPort );
+
+    if( port == NULL )
+    {
+        if( ( priority == 0 ) && ( coalesce == false ) )
+        {// Default configuration
+            return LORAMAC_STATUS_OK;
+        }
+        for( uint8_t i = 0; i < LORAMAC_UPLINK_QUEUE_PORTS; i++ )
+        {
+            if( UplinkQueuePorts[i].Used == false )
+            {
+                port = &UplinkQueuePorts[i];
+                break;
+            }
+        }
+        if( port == NULL )
+        {
+            return LORAMAC_STATUS_PARAMETER_INVALID;
+        }
+    }
+
+    port->fPort = fPort;
+    port->Priority = priority;
+    port->Coalesce = coalesce;
+    port->Used = ( priority != 0 ) || ( coalesce == true );
+    return LORAMAC_STATUS_OK;
+}
+
+uint8_t LoRaMacQueueGetCount( void )
+{
+    uint8_t count = 0;
+
+    for( uint8_t i = 0; i < LORAMAC_UPLINK_QUEUE_SIZE; i++ )
+    {
+        if( UplinkQueue[i].Used == true )
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void LoRaMacQueueFlush( void )
+{
+    UplinkQueueLocked = true;
+    TimerStop( &UplinkQueueTimer );
+    for( uint8_t i = 0; i < LORAMAC_UPLINK_QUEUE_SIZE; i++ )
+    {
+        UplinkQueue[i].Used = false;
+    }
+    UplinkQueueLocked = false;
+}
+
+LoRaMacStatus_t LoRaMacRestoreSession( void )
+{
+#if defined( LORAMAC_NVM_SESSION )
+    const LoRaMacNvmSession_t *session;
+    LoRaMacNvmCounters_t counters;
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+    ChannelAddParams_t channelAdd;
+    ChanMaskSetParams_t chanMaskSet;
+    SetBandTxDoneParams_t txDone;
+
+    if( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING )
+    {
+        return LORAMAC_STATUS_BUSY;
+    }
+    session = LoRaMacNvmRestore( &counters );
+    if( session == NULL )
+    {
+        return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    }
+
+    LoRaMacDevAddr = session->DevAddr;
+    memcpy1( LoRaMacNwkSKey, session->NwkSKey, sizeof( LoRaMacNwkSKey ) );
+    memcpy1( LoRaMacAppSKey, session->AppSKey, sizeof( LoRaMacAppSKey ) );
+    LoRaMacNetID = session->NetID;
+    UpLinkCounter = counters.UpLinkCounter;
+    DownLinkCounter = counters.DownLinkCounter;
+    LoRaMacParams = session->MacParams;
+    MaxDCycle = session->MaxDCycle;
+    AggregatedDCycle = session->AggregatedDCycle;
+
+    getPhy.Attribute = PHY_MAX_NB_CHANNELS;
+    phyParam = RegionGetPhyParam( LoRaMacRegion, &getPhy );
+    if( phyParam.Value <= LORAMAC_NVM_MAX_CHANNELS )
+    {
+        for( uint8_t i = 0; i < phyParam.Value; i++ )
+        {
+            if( session->Channels[i].Frequency != 0 )
+            {// The default channels are refused, they are already set
+                channelAdd.NewChannel = ( ChannelParams_t* )&session->Channels[i];
+                channelAdd.ChannelId = i;
+                RegionChannelAdd( LoRaMacRegion, &channelAdd );
+            }
+        }
+    }
+    chanMaskSet.ChannelsMaskIn = ( uint16_t* )session->ChannelsMask;
+    chanMaskSet.ChannelsMaskType = CHANNELS_MASK;
+    RegionChanMaskSet( LoRaMacRegion, &chanMaskSet );
+
+    if( ( counters.TxTimeOnAir != 0 ) && ( counters.Channel < phyParam.Value ) )
+    {// The time-off of the last uplink runs again from the reset
+        TxTimeOnAir = counters.TxTimeOnAir;
+        LastTxChannel = counters.Channel;
+        LastTxIsJoinRequest = false;
+        txDone.Channel = counters.Channel;
+        txDone.Joined = true;
+        txDone.LastTxDoneTime = TimerGetCurrentTime( );
+        RegionSetBandTxDone( LoRaMacRegion, &txDone );
+        AggregatedLastTxDoneTime = txDone.LastTxDoneTime;
+    }
+
+    IsLoRaMacNetworkJoined = true;
+    return LORAMAC_STATUS_OK;
+#else
+    return LORAMAC_STATUS_SERVICE_UNKNOWN;
+#endif
+}
+
 void LoRaMacTestRxWindowsOn( bool enable )
 {
     IsRxWindowsEnabled = enable;
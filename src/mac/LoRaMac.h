@@ -289,7 +289,11 @@ typedef enum eLoRaMacRxSlot
     /*!
      * LoRaMAC class b ping slot window
      */
-    RX_SLOT_WIN_PING_SLOT
+    RX_SLOT_WIN_PING_SLOT,
+    /*!
+     * LoRaMAC class b beacon window
+     */
+    RX_SLOT_BEACON
 }LoRaMacRxSlot_t;
 
 /*!
@@ -476,7 +480,25 @@ typedef enum eLoRaMacMoteCmd
     /*!
      * DlChannelAns
      */
-    MOTE_MAC_DL_CHANNEL_ANS          = 0x0A
+    MOTE_MAC_DL_CHANNEL_ANS          = 0x0A,
+    /*!
+     * DeviceTimeReq
+     *
+     * LoRaWAN Specification V1.0.3, chapter 5.9
+     */
+    MOTE_MAC_DEVICE_TIME_REQ         = 0x0D,
+    /*!
+     * PingSlotInfoReq
+     *
+     * LoRaWAN Specification V1.0.3, chapter 14.1
+     */
+    MOTE_MAC_PING_SLOT_INFO_REQ      = 0x10,
+    /*!
+     * PingSlotChannelAns
+     *
+     * LoRaWAN Specification V1.0.3, chapter 14.2
+     */
+    MOTE_MAC_PING_SLOT_CHANNEL_ANS   = 0x11
 }LoRaMacMoteCmd_t;
 
 /*!
@@ -522,6 +544,18 @@ typedef enum eLoRaMacSrvCmd
      * DlChannelReq
      */
     SRV_MAC_DL_CHANNEL_REQ           = 0x0A,
+    /*!
+     * DeviceTimeAns
+     */
+    SRV_MAC_DEVICE_TIME_ANS          = 0x0D,
+    /*!
+     * PingSlotInfoAns
+     */
+    SRV_MAC_PING_SLOT_INFO_ANS       = 0x10,
+    /*!
+     * PingSlotChannelReq
+     */
+    SRV_MAC_PING_SLOT_CHANNEL_REQ    = 0x11,
 }LoRaMacSrvCmd_t;
 
 /*!
@@ -677,6 +711,19 @@ typedef enum eLoRaMacEventInfoStatus
      * message integrity check failure
      */
     LORAMAC_EVENT_INFO_STATUS_MIC_FAIL,
+    /*!
+     * The node received a beacon and tracks the next ones
+     */
+    LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED,
+    /*!
+     * Beacon missed. With \ref MLME_BEACON_LOST: no beacon was received for
+     * more than two hours, the node went back to class A
+     */
+    LORAMAC_EVENT_INFO_STATUS_BEACON_LOST,
+    /*!
+     * The beacon acquisition did not receive any beacon
+     */
+    LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND,
 }LoRaMacEventInfoStatus_t;
 
 /*!
@@ -1003,6 +1050,11 @@ typedef struct sMcpsIndication
  * \ref MLME_LINK_CHECK         | YES     | NO         | NO       | YES
  * \ref MLME_TXCW               | YES     | NO         | NO       | YES
  * \ref MLME_SCHEDULE_UPLINK    | NO      | YES        | NO       | NO
+ * \ref MLME_DEVICE_TIME        | YES     | NO         | NO       | YES
+ * \ref MLME_BEACON_ACQUISITION | YES     | NO         | NO       | YES
+ * \ref MLME_PING_SLOT_INFO     | YES     | NO         | NO       | YES
+ * \ref MLME_BEACON             | NO      | YES        | NO       | NO
+ * \ref MLME_BEACON_LOST        | NO      | YES        | NO       | NO
  *
  * The following table provides links to the function implementations of the
  * related MLME primitives.
@@ -1043,7 +1095,36 @@ typedef enum eMlme
      * Indicates that the application shall perform an uplink as
      * soon as possible.
      */
-    MLME_SCHEDULE_UPLINK
+    MLME_SCHEDULE_UPLINK,
+    /*!
+     * DeviceTimeReq - Synchronizes the node on the GPS time of the network,
+     * needed to find the class B beacons without a full period of reception
+     *
+     * LoRaWAN Specification V1.0.3, chapter 5.9
+     */
+    MLME_DEVICE_TIME,
+    /*!
+     * Searches the class B beacon. The confirm reports
+     * LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED or
+     * LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND.
+     *
+     * LoRaWAN Specification V1.0.3, chapter 12.1
+     */
+    MLME_BEACON_ACQUISITION,
+    /*!
+     * PingSlotInfoReq - Announces the ping slot periodicity to the network
+     *
+     * LoRaWAN Specification V1.0.3, chapter 14.1
+     */
+    MLME_PING_SLOT_INFO,
+    /*!
+     * A beacon was received, or missed while the node keeps on tracking them
+     */
+    MLME_BEACON,
+    /*!
+     * The beacons are lost, the node went back to class A
+     */
+    MLME_BEACON_LOST
 }Mlme_t;
 
 /*!
@@ -1094,6 +1175,20 @@ typedef struct sMlmeReqTxCw
     uint8_t Power;
 }MlmeReqTxCw_t;
 
+/*!
+ * LoRaMAC MLME-Request for the ping slot info service
+ */
+typedef struct sMlmeReqPingSlotInfo
+{
+    /*!
+     * Ping slot periodicity, the node opens 2^( 7 - Periodicity ) ping slots
+     * every beacon period [0..7]
+     *
+     * LoRaWAN Specification V1.0.3, chapter 14.1
+     */
+    uint8_t Periodicity;
+}MlmeReqPingSlotInfo_t;
+
 /*!
  * LoRaMAC MLME-Request structure
  */
@@ -1117,6 +1212,10 @@ typedef struct sMlmeReq
          * MLME-Request parameters for Tx continuous mode request
          */
         MlmeReqTxCw_t TxCw;
+        /*!
+         * MLME-Request parameters for a ping slot info request
+         */
+        MlmeReqPingSlotInfo_t PingSlotInfo;
     }Req;
 }MlmeReq_t;
 
@@ -1157,6 +1256,16 @@ typedef struct sMlmeIndication
      * MLME-Indication type
      */
     Mlme_t MlmeIndication;
+    /*!
+     * Status of the beacon, for \ref MLME_BEACON and \ref MLME_BEACON_LOST
+     * [LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED: received, LORAMAC_EVENT_INFO_STATUS_BEACON_LOST:
+     * missed]
+     */
+    LoRaMacEventInfoStatus_t Status;
+    /*!
+     * GPS time of the beacon period start [s]
+     */
+    uint32_t BeaconTime;
 }MlmeIndication_t;
 
 /*!
@@ -1211,6 +1320,10 @@ typedef enum eMib
      * LoRaWAN device class
      *
      * LoRaWAN Specification V1.0.2
+     *
+     * \remark CLASS_B is refused until a beacon is locked, see
+     *         \ref MLME_BEACON_ACQUISITION, and the ping slot periodicity
+     *         is acknowledged, see \ref MLME_PING_SLOT_INFO.
      */
     MIB_DEVICE_CLASS,
     /*!
@@ -1227,6 +1340,19 @@ typedef enum eMib
      * [true: ADR enabled, false: ADR disabled]
      */
     MIB_ADR,
+    /*!
+     * Device side adaptive data rate, for networks which do not send
+     * LinkAdrReq. The node picks its datarate and TX power from the SNR of
+     * the downlinks and the LinkCheckAns margins. Only active when MIB_ADR
+     * is enabled. tools/adrsim.py compares its airtime with the network ADR.
+     *
+     * [true: device side ADR enabled, false: device side ADR disabled]
+     */
+    MIB_DEVICE_ADR,
+    /*!
+     * Margin kept above the demodulation floor by the device side ADR [dB]
+     */
+    MIB_DEVICE_ADR_MARGIN,
     /*!
      * Network identifier
      *
@@ -1409,7 +1535,12 @@ typedef enum eMib
      * The formula is:
      * radioTxPower = ( int8_t )floor( maxEirp - antennaGain )
      */
-    MIB_DEFAULT_ANTENNA_GAIN
+    MIB_DEFAULT_ANTENNA_GAIN,
+    /*!
+     * Number of uplinks saved by piggybacking the MAC commands on application
+     * payloads instead of sending them on port 0. Get only.
+     */
+    MIB_MAC_COMMANDS_UPLINKS_SAVED
 }Mib_t;
 
 /*!
@@ -1435,6 +1566,18 @@ typedef union uMibParam
      * Related MIB type: \ref MIB_ADR
      */
     bool AdrEnable;
+    /*!
+     * Activation state of the device side ADR
+     *
+     * Related MIB type: \ref MIB_DEVICE_ADR
+     */
+    bool DeviceAdrEnable;
+    /*!
+     * Margin of the device side ADR [dB]
+     *
+     * Related MIB type: \ref MIB_DEVICE_ADR_MARGIN
+     */
+    int8_t DeviceAdrMargin;
     /*!
      * Network identifier
      *
@@ -1603,6 +1746,12 @@ typedef union uMibParam
      * Related MIB type: \ref MIB_DEFAULT_ANTENNA_GAIN
      */
     float DefaultAntennaGain;
+    /*!
+     * Number of uplinks saved by piggybacking the MAC commands
+     *
+     * Related MIB type: \ref MIB_MAC_COMMANDS_UPLINKS_SAVED
+     */
+    uint32_t MacCommandsUplinksSaved;
 }MibParam_t;
 
 /*!
@@ -1883,10 +2032,30 @@ LoRaMacStatus_t LoRaMacChannelAdd( uint8_t id, ChannelParams_t params );
  */
 LoRaMacStatus_t LoRaMacChannelRemove( uint8_t id );
 
+/*!
+ * Number of bits of the multicast channels lookup table index. The table holds
+ * up to 2^LORAMAC_MULTICAST_TABLE_BITS multicast channels.
+ */
+#ifndef LORAMAC_MULTICAST_TABLE_BITS
+#define LORAMAC_MULTICAST_TABLE_BITS                5
+#endif
+
+/*!
+ * Number of multicast channels whose key schedules are kept. A frame of
+ * another channel computes them again, in place of the least recently used
+ * channel.
+ *
+ * \remark Each entry takes about 530 bytes of RAM.
+ */
+#ifndef LORAMAC_MULTICAST_KEY_CACHE_SIZE
+#define LORAMAC_MULTICAST_KEY_CACHE_SIZE            2
+#endif
+
 /*!
  * \brief   LoRaMAC multicast channel link service
  *
- * \details Links a multicast channel into the linked list.
+ * \details Links a multicast channel into the linked list and the lookup
+ *          table. The keys must not be changed while the channel is linked.
  *
  * \param   [IN] channelParam - Multicast channel parameters to link.
  *
@@ -2052,6 +2221,116 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t *mlmeRequest );
  */
 LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest );
 
+/*!
+ * Number of link quality measurements kept by the device side ADR
+ */
+#define LORAMAC_DEVICE_ADR_HISTORY_SIZE             8
+
+/*!
+ * Number of measurements needed before the device side ADR changes the
+ * datarate or the TX power
+ */
+#define LORAMAC_DEVICE_ADR_MIN_SAMPLES              4
+
+/*!
+ * Default margin kept above the demodulation floor by the device side ADR [dB]
+ */
+#define LORAMAC_DEVICE_ADR_DEFAULT_MARGIN           10
+
+/*!
+ * Margin excess tolerated before the device side ADR speeds up [dB]
+ */
+#define LORAMAC_DEVICE_ADR_HYSTERESIS               3
+
+/*!
+ * Maximum number of uplinks waiting in the LoRaMAC uplink queue
+ */
+#define LORAMAC_UPLINK_QUEUE_SIZE                   4
+
+/*!
+ * Maximum payload size of a queued uplink, coalesced payloads included
+ */
+#define LORAMAC_UPLINK_QUEUE_MAX_PAYLOAD            64
+
+/*!
+ * Maximum number of fPorts with a specific queue configuration
+ */
+#define LORAMAC_UPLINK_QUEUE_PORTS                  8
+
+/*!
+ * \brief   LoRaMAC queued MCPS-Request
+ *
+ * \details Copies the request into the uplink queue. Queued uplinks are sent
+ *          one after the other, as soon as the MAC is idle and the duty cycle
+ *          allows it, highest fPort priority first. Each of them results in
+ *          a regular MCPS-Confirm event.
+ *
+ *          When coalescing is enabled for the fPort, a payload is appended to
+ *          a queued uplink of the same fPort and type if the resulting frame
+ *          still fits the datarate. The application payloads must then be
+ *          self-delimiting.
+ *
+ * \remark  Uplinks rejected by the MAC when their turn comes, e.g. because
+ *          the datarate became too low for their size, are dropped.
+ *
+ * \param   [IN] mcpsRequest - MCPS-Request to queue. Refer to \ref McpsReq_t.
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY, the queue is full,
+ *          \ref LORAMAC_STATUS_SERVICE_UNKNOWN,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID,
+ *          \ref LORAMAC_STATUS_LENGTH_ERROR.
+ */
+LoRaMacStatus_t LoRaMacQueueRequest( McpsReq_t *mcpsRequest );
+
+/*!
+ * \brief   Configures the uplink queue handling of a fPort
+ *
+ * \param   [IN] fPort    - fPort to configure
+ * \param   [IN] priority - Queued uplinks of higher priority are sent first,
+ *                          unconfigured fPorts have priority 0
+ * \param   [IN] coalesce - Set to true, to append payloads of this fPort to
+ *                          a queued uplink
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID, too many fPorts configured.
+ */
+LoRaMacStatus_t LoRaMacQueueSetPortConfig( uint8_t fPort, uint8_t priority, bool coalesce );
+
+/*!
+ * \brief   Gets the number of uplinks waiting in the queue
+ *
+ * \retval  count Number of queued uplinks
+ */
+uint8_t LoRaMacQueueGetCount( void );
+
+/*!
+ * \brief   Removes all the uplinks waiting in the queue
+ */
+void LoRaMacQueueFlush( void );
+
+/*!
+ * \brief   Restores the session saved in the EEPROM
+ *
+ * \details Resumes the session of the last join or activation by personalization
+ *          without a network round trip: device address, session keys,
+ *          frame counters, MAC parameters and channels. The time-off of the
+ *          last uplink starts again. Built with LORAMAC_NVM_SESSION, the MAC
+ *          saves the session after each procedure.
+ *
+ * \remark  To be called after LoRaMacInitialization and the configuration of
+ *          the MAC, which it overrides. The node is joined on success.
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY,
+ *          \ref LORAMAC_STATUS_SERVICE_UNKNOWN, no session saved or built without
+ *          LORAMAC_NVM_SESSION.
+ */
+LoRaMacStatus_t LoRaMacRestoreSession( void );
+
 /*!
  * Automatically add the Region.h file at the end of LoRaMac.h file.
  * This is required because Region.h uses definitions from LoRaMac.h
@@ -0,0 +1,606 @@
+/*!
+ * \file      LoRaMacClassB.c
+ *
+ * \brief     LoRa MAC class B beacon tracking and ping slots
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include "utilities.h"
+#include "radio.h"
+#include "timer.h"
+#include "LoRaMac.h"
+#include "LoRaMacCrypto.h"
+#include "LoRaMacClassB.h"
+
+/*!
+ * Beacon period [s]
+ */
+#define CLASSB_BEACON_INTERVAL_S                    ( CLASSB_BEACON_INTERVAL / 1000 )
+
+/*!
+ * Number of beacon periods searched by an acquisition with network time
+ */
+#define CLASSB_ACQUISITION_TRIES                    3
+
+/*!
+ * Clock drift of the node, the windows are widened by it [ppm]
+ */
+#define CLASSB_DRIFT_PPM                            40
+
+/*!
+ * Timing error right after a beacon [ms]
+ */
+#define CLASSB_BEACON_SYNC_ERROR                    3
+
+/*!
+ * Timing error right after DeviceTimeAns, 1/256 s resolution and network
+ * latency [ms]
+ */
+#define CLASSB_DEVICE_TIME_SYNC_ERROR               20
+
+/*!
+ * Minimum number of symbols to detect a preamble
+ */
+#define CLASSB_MIN_RX_SYMBOLS                       6
+
+/*!
+ * Longest symbol timeout of the radio
+ */
+#define CLASSB_MAX_SYMBOL_TIMEOUT                   1023
+
+/*!
+ * Windows opening closer than this are skipped [ms]
+ */
+#define CLASSB_MIN_SCHEDULE_DELAY                   5
+
+/*!
+ * Beacon tracking states
+ */
+typedef enum eBeaconState
+{
+    /*!
+     * No beacon tracking
+     */
+    BEACON_STATE_IDLE,
+    /*!
+     * Beacon acquisition in progress
+     */
+    BEACON_STATE_ACQUISITION,
+    /*!
+     * A beacon window is opened every period
+     */
+    BEACON_STATE_LOCKED,
+}BeaconState_t;
+
+/*!
+ * Beacon tracking context
+ */
+typedef struct sBeaconCtx
+{
+    BeaconState_t State;
+    /*!
+     * The node is synchronized on the network time
+     */
+    bool TimeValid;
+    /*!
+     * Continuous reception of the acquisition without network time
+     */
+    bool Continuous;
+    uint8_t AcquisitionTries;
+    /*!
+     * GPS time [s] and local time [ms] of the start of the last period,
+     * received or extrapolated
+     */
+    uint32_t BeaconTime;
+    TimerTime_t BeaconStart;
+    /*!
+     * GPS time [s] and local time [ms] of the start of the period of the
+     * next beacon window
+     */
+    uint32_t WindowTime;
+    TimerTime_t WindowStart;
+    /*!
+     * Local time of the last synchronization and its error [ms]
+     */
+    TimerTime_t SyncTime;
+    uint32_t SyncError;
+    /*!
+     * Local time of the last beacon received [ms]
+     */
+    TimerTime_t LastBeaconTime;
+}BeaconCtx_t;
+
+/*!
+ * Ping slots context
+ */
+typedef struct sPingSlotCtx
+{
+    /*!
+     * Ping slots opened, the node is in class B
+     */
+    bool Enabled;
+    /*!
+     * The periodicity is acknowledged by the network
+     */
+    bool InfoValid;
+    uint8_t Periodicity;
+    uint32_t DevAddr;
+    /*!
+     * Channel of PingSlotChannelReq, Frequency 0 for the default channel
+     */
+    uint32_t Frequency;
+    int8_t Datarate;
+    /*!
+     * Slots of the current beacon period
+     */
+    uint32_t BeaconTime;
+    TimerTime_t BeaconStart;
+    uint16_t Offset;
+    uint16_t Period;
+    uint16_t Nb;
+    uint16_t Slot;
+}PingSlotCtx_t;
+
+static LoRaMacRegion_t ClassBRegion;
+
+static LoRaMacClassBCallbacks_t *ClassBCallbacks;
+
+static BeaconCtx_t BeaconCtx;
+
+static PingSlotCtx_t PingSlotCtx;
+
+/*!
+ * Beacon window timer, also ends the continuous acquisition
+ */
+static TimerEvent_t BeaconTimer;
+
+/*!
+ * Ping slot timer
+ */
+static TimerEvent_t PingSlotTimer;
+
+/*!
+ * Parameters of the next windows
+ */
+static RxConfigParams_t BeaconRxConfig;
+static RxConfigParams_t PingSlotRxConfig;
+
+/*!
+ * \brief Computes the beacon CRC, CRC-16 CCITT with 0 as initial value
+ *
+ * \param [IN] buffer Data
+ * \param [IN] size   Data size
+ * \retval crc        CRC
+ */
+static uint16_t BeaconCrc( const uint8_t *buffer, uint8_t size )
+{
+    uint16_t crc = 0;
+
+    for( uint8_t i = 0; i < size; i++ )
+    {
+        crc ^= ( uint16_t )buffer[i] << 8;
+        for( uint8_t j = 0; j < 8; j++ )
+        {
+            crc = ( crc & 0x8000 ) ? ( crc << 1 ) ^ 0x1021 : ( crc << 1 );
+        }
+    }
+    return crc;
+}
+
+/*!
+ * \brief Checks a beacon and reads its time field
+ *
+ * \param [IN]  payload    Frame
+ * \param [IN]  size       Frame size
+ * \param [OUT] beaconTime GPS time of the period start [s]
+ * \retval      valid      The frame is a beacon
+ */
+static bool BeaconParse( const uint8_t *payload, uint16_t size, uint32_t *beaconTime )
+{
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+    uint8_t index;
+
+    getPhy.Attribute = PHY_BEACON_FORMAT;
+    phyParam = RegionGetPhyParam( ClassBRegion, &getPhy );
+
+    if( ( payload == NULL ) || ( size != phyParam.BeaconFormat.BeaconSize ) )
+    {
+        return false;
+    }
+
+    // The first CRC covers RFU1 and the time, the gateway specific part is
+    // not needed
+    index = phyParam.BeaconFormat.Rfu1Size;
+    if( BeaconCrc( payload, index + 4 ) != ( ( uint16_t )payload[index + 4] | ( ( uint16_t )payload[index + 5] << 8 ) ) )
+    {
+        return false;
+    }
+
+    *beaconTime = ( uint32_t )payload[index];
+    *beaconTime |= ( uint32_t )payload[index + 1] << 8;
+    *beaconTime |= ( uint32_t )payload[index + 2] << 16;
+    *beaconTime |= ( uint32_t )payload[index + 3] << 24;
+    return true;
+}
+
+/*!
+ * \brief Window widening, the timing error since the last synchronization
+ *
+ * \retval error Timing error [ms]
+ */
+static uint32_t GetTimingError( void )
+{
+    uint32_t elapsed = TimerGetElapsedTime( BeaconCtx.SyncTime );
+
+    elapsed = MIN( elapsed, CLASSB_BEACON_LESS_PERIOD );
+    return BeaconCtx.SyncError + ( elapsed * CLASSB_DRIFT_PPM + 999999 ) / 1000000;
+}
+
+/*!
+ * \brief Computes the timeout and the offset of a window
+ *
+ * \param [IN]  datarate Datarate of the window
+ * \param [OUT] rxConfig Window parameters
+ */
+static void ComputeWindow( int8_t datarate, RxConfigParams_t *rxConfig )
+{
+    RegionComputeRxWindowParameters( ClassBRegion, datarate, CLASSB_MIN_RX_SYMBOLS, GetTimingError( ), rxConfig );
+    rxConfig->WindowTimeout = MIN( rxConfig->WindowTimeout, CLASSB_MAX_SYMBOL_TIMEOUT );
+    rxConfig->RxContinuous = false;
+}
+
+/*!
+ * \brief Starts a timer at a local time
+ *
+ * \param [IN] timer  Timer
+ * \param [IN] target Local time [ms]
+ * \retval     status false when the time is too close or in the past
+ */
+static bool StartTimerAt( TimerEvent_t *timer, TimerTime_t target )
+{
+    int32_t delay = ( int32_t )( target - TimerGetCurrentTime( ) );
+
+    if( delay < CLASSB_MIN_SCHEDULE_DELAY )
+    {
+        return false;
+    }
+    TimerSetValue( timer, delay );
+    TimerStart( timer );
+    return true;
+}
+
+/*!
+ * \brief Schedules the window of the next beacon
+ */
+static void ScheduleBeaconWindow( void )
+{
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+    uint32_t periods = TimerGetElapsedTime( BeaconCtx.BeaconStart ) / CLASSB_BEACON_INTERVAL + 1;
+
+    getPhy.Attribute = PHY_BEACON_CHANNEL_DR;
+    phyParam = RegionGetPhyParam( ClassBRegion, &getPhy );
+    ComputeWindow( phyParam.Value, &BeaconRxConfig );
+    BeaconRxConfig.RxSlot = RX_SLOT_BEACON;
+
+    do
+    {
+        BeaconCtx.WindowTime = BeaconCtx.BeaconTime + periods * CLASSB_BEACON_INTERVAL_S;
+        BeaconCtx.WindowStart = BeaconCtx.BeaconStart + periods * CLASSB_BEACON_INTERVAL;
+        periods++;
+    }while( StartTimerAt( &BeaconTimer, BeaconCtx.WindowStart + BeaconRxConfig.WindowOffset ) == false );
+
+    getPhy.Attribute = PHY_BEACON_CHANNEL_FREQ;
+    getPhy.BeaconTime = BeaconCtx.WindowTime;
+    phyParam = RegionGetPhyParam( ClassBRegion, &getPhy );
+    BeaconRxConfig.Frequency = phyParam.Value;
+}
+
+/*!
+ * \brief Schedules the next ping slot of the current beacon period
+ */
+static void SchedulePingSlot( void )
+{
+    TimerTime_t slotStart;
+
+    ComputeWindow( PingSlotCtx.Datarate, &PingSlotRxConfig );
+    PingSlotRxConfig.RxSlot = RX_SLOT_WIN_PING_SLOT;
+
+    while( PingSlotCtx.Slot < PingSlotCtx.Nb )
+    {
+        slotStart = PingSlotCtx.BeaconStart + CLASSB_BEACON_RESERVED +
+                    ( PingSlotCtx.Offset + PingSlotCtx.Slot * PingSlotCtx.Period ) * CLASSB_PING_SLOT_WINDOW;
+        if( StartTimerAt( &PingSlotTimer, slotStart + PingSlotRxConfig.WindowOffset ) == true )
+        {
+            return;
+        }
+        PingSlotCtx.Slot++;
+    }
+}
+
+/*!
+ * \brief Computes the ping slots of the current beacon period
+ */
+static void StartPingSlots( void )
+{
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+
+    TimerStop( &PingSlotTimer );
+    if( ( PingSlotCtx.Enabled == false ) || ( BeaconCtx.State != BEACON_STATE_LOCKED ) )
+    {
+        return;
+    }
+
+    PingSlotCtx.BeaconTime = BeaconCtx.BeaconTime;
+    PingSlotCtx.BeaconStart = BeaconCtx.BeaconStart;
+    PingSlotCtx.Nb = 1 << ( 7 - PingSlotCtx.Periodicity );
+    PingSlotCtx.Period = CLASSB_PING_SLOT_NB / PingSlotCtx.Nb;
+    PingSlotCtx.Offset = LoRaMacBeaconComputePingOffset( PingSlotCtx.BeaconTime, PingSlotCtx.DevAddr, PingSlotCtx.Period );
+    PingSlotCtx.Slot = 0;
+
+    if( PingSlotCtx.Frequency != 0 )
+    {
+        PingSlotRxConfig.Frequency = PingSlotCtx.Frequency;
+    }
+    else
+    {
+        getPhy.Attribute = PHY_PING_SLOT_CHANNEL_FREQ;
+        getPhy.BeaconTime = PingSlotCtx.BeaconTime;
+        getPhy.DevAddr = PingSlotCtx.DevAddr;
+        phyParam = RegionGetPhyParam( ClassBRegion, &getPhy );
+        PingSlotRxConfig.Frequency = phyParam.Value;
+    }
+
+    SchedulePingSlot( );
+}
+
+/*!
+ * \brief Ends the acquisition
+ *
+ * \param [IN] status LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED or
+ *                    LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND
+ */
+static void AcquisitionDone( LoRaMacEventInfoStatus_t status )
+{
+    BeaconCtx.Continuous = false;
+    if( status == LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED )
+    {
+        BeaconCtx.State = BEACON_STATE_LOCKED;
+    }
+    else
+    {
+        BeaconCtx.State = BEACON_STATE_IDLE;
+    }
+    ClassBCallbacks->OnAcquisitionDone( status );
+}
+
+static void OnBeaconTimerEvent( void )
+{
+    TimerStop( &BeaconTimer );
+
+    if( BeaconCtx.Continuous == true )
+    {// End of the continuous acquisition
+        Radio.Sleep( );
+        AcquisitionDone( LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND );
+        return;
+    }
+
+    if( ClassBCallbacks->OpenRxWindow( &BeaconRxConfig ) == false )
+    {
+        LoRaMacClassBBeaconRxFailed( );
+    }
+}
+
+static void OnPingSlotTimerEvent( void )
+{
+    TimerStop( &PingSlotTimer );
+
+    ClassBCallbacks->OpenRxWindow( &PingSlotRxConfig );
+
+    PingSlotCtx.Slot++;
+    SchedulePingSlot( );
+}
+
+void LoRaMacClassBInit( LoRaMacRegion_t region, LoRaMacClassBCallbacks_t *callbacks )
+{
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+
+    ClassBRegion = region;
+    ClassBCallbacks = callbacks;
+
+    memset1( ( uint8_t* )&BeaconCtx, 0, sizeof( BeaconCtx ) );
+    memset1( ( uint8_t* )&PingSlotCtx, 0, sizeof( PingSlotCtx ) );
+
+    getPhy.Attribute = PHY_PING_SLOT_CHANNEL_DR;
+    phyParam = RegionGetPhyParam( ClassBRegion, &getPhy );
+    PingSlotCtx.Datarate = phyParam.Value;
+
+    TimerInit( &BeaconTimer, OnBeaconTimerEvent );
+    TimerInit( &PingSlotTimer, OnPingSlotTimerEvent );
+}
+
+void LoRaMacClassBSetGpsTime( uint32_t seconds, uint8_t fraction, TimerTime_t localTime )
+{
+    uint32_t inPeriod = ( seconds % CLASSB_BEACON_INTERVAL_S ) * 1000 + ( ( uint32_t )fraction * 1000 ) / 256;
+
+    BeaconCtx.BeaconTime = seconds - ( seconds % CLASSB_BEACON_INTERVAL_S );
+    BeaconCtx.BeaconStart = localTime - inPeriod;
+    BeaconCtx.SyncTime = localTime;
+    BeaconCtx.SyncError = CLASSB_DEVICE_TIME_SYNC_ERROR;
+    BeaconCtx.TimeValid = true;
+}
+
+LoRaMacStatus_t LoRaMacClassBBeaconAcquisition( void )
+{
+    GetPhyParams_t getPhy;
+    PhyParam_t phyParam;
+
+    getPhy.Attribute = PHY_BEACON_CHANNEL_FREQ;
+    getPhy.BeaconTime = 0;
+    phyParam = RegionGetPhyParam( ClassBRegion, &getPhy );
+    if( phyParam.Value == 0 )
+    {
+        return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    }
+    if( BeaconCtx.State == BEACON_STATE_ACQUISITION )
+    {
+        return LORAMAC_STATUS_BUSY;
+    }
+
+    TimerStop( &BeaconTimer );
+    TimerStop( &PingSlotTimer );
+    BeaconCtx.AcquisitionTries = 0;
+
+    if( BeaconCtx.TimeValid == true )
+    {
+        BeaconCtx.State = BEACON_STATE_ACQUISITION;
+        ScheduleBeaconWindow( );
+        return LORAMAC_STATUS_OK;
+    }
+
+    // Without network time, listen during a whole period. The beacon
+    // channel is the one of the time 0, the regions with beacon channel
+    // hopping need DeviceTimeReq first.
+    BeaconRxConfig.Frequency = phyParam.Value;
+    getPhy.Attribute = PHY_BEACON_CHANNEL_DR;
+    phyParam = RegionGetPhyParam( ClassBRegion, &getPhy );
+    RegionComputeRxWindowParameters( ClassBRegion, phyParam.Value, CLASSB_MIN_RX_SYMBOLS, 0, &BeaconRxConfig );
+    BeaconRxConfig.RxSlot = RX_SLOT_BEACON;
+    BeaconRxConfig.RxContinuous = true;
+
+    if( ClassBCallbacks->OpenRxWindow( &BeaconRxConfig ) == false )
+    {
+        return LORAMAC_STATUS_BUSY;
+    }
+    BeaconCtx.State = BEACON_STATE_ACQUISITION;
+    BeaconCtx.Continuous = true;
+    TimerSetValue( &BeaconTimer, CLASSB_BEACON_INTERVAL + CLASSB_BEACON_RESERVED );
+    TimerStart( &BeaconTimer );
+    return LORAMAC_STATUS_OK;
+}
+
+void LoRaMacClassBBeaconRxDone( uint8_t *payload, uint16_t size, TimerTime_t rxTime )
+{
+    uint32_t beaconTime = 0;
+
+    if( ( BeaconCtx.State == BEACON_STATE_IDLE ) || ( BeaconParse( payload, size, &beaconTime ) == false ) )
+    {
+        LoRaMacClassBBeaconRxFailed( );
+        return;
+    }
+    TimerStop( &BeaconTimer );
+
+    // The beacon is sent at the period start, the reception ends after its
+    // time on air
+    BeaconCtx.BeaconTime = beaconTime;
+    BeaconCtx.BeaconStart = rxTime - Radio.TimeOnAir( MODEM_LORA, size );
+    BeaconCtx.SyncTime = BeaconCtx.BeaconStart;
+    BeaconCtx.SyncError = CLASSB_BEACON_SYNC_ERROR;
+    BeaconCtx.LastBeaconTime = BeaconCtx.BeaconStart;
+    BeaconCtx.TimeValid = true;
+
+    if( BeaconCtx.State == BEACON_STATE_ACQUISITION )
+    {
+        AcquisitionDone( LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED );
+    }
+    else
+    {
+        ClassBCallbacks->OnBeacon( MLME_BEACON, LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED, beaconTime );
+    }
+
+    ScheduleBeaconWindow( );
+    StartPingSlots( );
+}
+
+void LoRaMacClassBBeaconRxFailed( void )
+{
+    switch( BeaconCtx.State )
+    {
+        case BEACON_STATE_ACQUISITION:
+        {
+            if( BeaconCtx.Continuous == true )
+            {// Listen again until the end of the period
+                ClassBCallbacks->OpenRxWindow( &BeaconRxConfig );
+            }
+            else if( ++BeaconCtx.AcquisitionTries < CLASSB_ACQUISITION_TRIES )
+            {
+                ScheduleBeaconWindow( );
+            }
+            else
+            {
+                AcquisitionDone( LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND );
+            }
+            break;
+        }
+        case BEACON_STATE_LOCKED:
+        {
+            // Beacon-less operation, the period start is extrapolated
+            BeaconCtx.BeaconTime = BeaconCtx.WindowTime;
+            BeaconCtx.BeaconStart = BeaconCtx.WindowStart;
+
+            if( TimerGetElapsedTime( BeaconCtx.LastBeaconTime ) >= CLASSB_BEACON_LESS_PERIOD )
+            {
+                LoRaMacClassBStop( );
+                ClassBCallbacks->OnBeacon( MLME_BEACON_LOST, LORAMAC_EVENT_INFO_STATUS_BEACON_LOST, BeaconCtx.BeaconTime );
+                break;
+            }
+            ClassBCallbacks->OnBeacon( MLME_BEACON, LORAMAC_EVENT_INFO_STATUS_BEACON_LOST, BeaconCtx.BeaconTime );
+
+            ScheduleBeaconWindow( );
+            StartPingSlots( );
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void LoRaMacClassBSetPingSlotInfo( uint8_t periodicity )
+{
+    PingSlotCtx.Periodicity = MIN( periodicity, 7 );
+    PingSlotCtx.InfoValid = true;
+    StartPingSlots( );
+}
+
+void LoRaMacClassBSetPingSlotChannel( uint32_t frequency, int8_t datarate )
+{
+    PingSlotCtx.Frequency = frequency;
+    PingSlotCtx.Datarate = datarate;
+}
+
+bool LoRaMacClassBIsReady( void )
+{
+    return ( BeaconCtx.State == BEACON_STATE_LOCKED ) && ( PingSlotCtx.InfoValid == true );
+}
+
+void LoRaMacClassBStart( uint32_t devAddr )
+{
+    PingSlotCtx.DevAddr = devAddr;
+    PingSlotCtx.Enabled = true;
+    StartPingSlots( );
+}
+
+void LoRaMacClassBStop( void )
+{
+    TimerStop( &BeaconTimer );
+    TimerStop( &PingSlotTimer );
+    BeaconCtx.State = BEACON_STATE_IDLE;
+    BeaconCtx.Continuous = false;
+    PingSlotCtx.Enabled = false;
+}
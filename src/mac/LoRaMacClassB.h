@@ -0,0 +1,193 @@
+/*!
+ * \file      LoRaMacClassB.h
+ *
+ * \brief     LoRa MAC class B beacon tracking and ping slots
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * Beacon period, LoRaWAN Specification V1.0.3, chapter 12:
+ *
+ *     | reserved | ping slots 0 .. 4095, 30 ms each          | guard |
+ *     |  2120 ms |                 122880 ms                  | 3000  |
+ *     ^ beacon, BeaconTime = GPS time of the period start
+ *
+ * The node learns the GPS time with DeviceTimeAns or from a beacon received
+ * with a continuous reception, then only opens a short window around each
+ * beacon. The windows are widened by the clock drift accumulated since the
+ * last synchronization, up to two hours without beacon after which the node
+ * goes back to class A.
+ *
+ * The windows are opened by LoRaMac.c through LoRaMacClassBCallbacks_t, they
+ * are skipped while the MAC transmits or waits for its class A windows.
+ *
+ * \author    jkadbear( Tsinghua )
+ *
+ * \defgroup  LORAMACCLASSB LoRa MAC class B
+ * \{
+ */
+#ifndef __LORAMACCLASSB_H__
+#define __LORAMACCLASSB_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "timer.h"
+#include "LoRaMac.h"
+
+/*!
+ * Beacon period [ms]
+ */
+#define CLASSB_BEACON_INTERVAL                      128000
+
+/*!
+ * Beacon reserved time, at the start of the period [ms]
+ */
+#define CLASSB_BEACON_RESERVED                      2120
+
+/*!
+ * Beacon guard time, at the end of the period [ms]
+ */
+#define CLASSB_BEACON_GUARD                         3000
+
+/*!
+ * Number of ping slots of a beacon period
+ */
+#define CLASSB_PING_SLOT_NB                         4096
+
+/*!
+ * Ping slot length [ms]
+ */
+#define CLASSB_PING_SLOT_WINDOW                     30
+
+/*!
+ * Longest time without beacon before the node goes back to class A [ms]
+ */
+#define CLASSB_BEACON_LESS_PERIOD                   7200000
+
+/*!
+ * Callbacks of the MAC layer
+ */
+typedef struct sLoRaMacClassBCallbacks
+{
+    /*!
+     * \brief Opens a reception window
+     *
+     * \param [IN] rxConfig Window parameters, RxSlot is RX_SLOT_BEACON or
+     *                      RX_SLOT_WIN_PING_SLOT
+     * \retval status       false when the MAC or the radio is busy, the
+     *                      window is skipped
+     */
+    bool ( *OpenRxWindow )( RxConfigParams_t *rxConfig );
+    /*!
+     * \brief End of a beacon acquisition, see \ref MLME_BEACON_ACQUISITION
+     *
+     * \param [IN] status LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED or
+     *                    LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND
+     */
+    void ( *OnAcquisitionDone )( LoRaMacEventInfoStatus_t status );
+    /*!
+     * \brief Beacon received or missed while tracking
+     *
+     * \param [IN] indication MLME_BEACON, or MLME_BEACON_LOST once the
+     *                        tracking stopped
+     * \param [IN] status     LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED or
+     *                        LORAMAC_EVENT_INFO_STATUS_BEACON_LOST
+     * \param [IN] beaconTime GPS time of the beacon period start [s]
+     */
+    void ( *OnBeacon )( Mlme_t indication, LoRaMacEventInfoStatus_t status, uint32_t beaconTime );
+}LoRaMacClassBCallbacks_t;
+
+/*!
+ * \brief Initializes the class B module, all tracking stopped
+ *
+ * \param [IN] region    Region of the MAC
+ * \param [IN] callbacks MAC callbacks
+ */
+void LoRaMacClassBInit( LoRaMacRegion_t region, LoRaMacClassBCallbacks_t *callbacks );
+
+/*!
+ * \brief Synchronizes on the network time, from DeviceTimeAns
+ *
+ * \param [IN] seconds   GPS time [s]
+ * \param [IN] fraction  GPS time fractional part [1/256 s]
+ * \param [IN] localTime Local time the GPS time refers to, the end of the
+ *                       uplink which carried DeviceTimeReq [ms]
+ */
+void LoRaMacClassBSetGpsTime( uint32_t seconds, uint8_t fraction, TimerTime_t localTime );
+
+/*!
+ * \brief Starts a beacon acquisition, ended by OnAcquisitionDone
+ *
+ * Without network time the radio listens continuously during a beacon
+ * period, else a window is opened at the expected beacon time during up to
+ * CLASSB_ACQUISITION_TRIES periods.
+ *
+ * \retval status LORAMAC_STATUS_SERVICE_UNKNOWN when the region has no beacon,
+ *                LORAMAC_STATUS_BUSY during an acquisition
+ */
+LoRaMacStatus_t LoRaMacClassBBeaconAcquisition( void );
+
+/*!
+ * \brief Processes a frame received in a beacon window
+ *
+ * \param [IN] payload Frame
+ * \param [IN] size    Frame size
+ * \param [IN] rxTime  Time of the end of the reception [ms]
+ */
+void LoRaMacClassBBeaconRxDone( uint8_t *payload, uint16_t size, TimerTime_t rxTime );
+
+/*!
+ * \brief A beacon window closed without beacon: timeout, error or aborted
+ *        by an uplink
+ */
+void LoRaMacClassBBeaconRxFailed( void );
+
+/*!
+ * \brief Sets the ping slot periodicity acknowledged by PingSlotInfoAns
+ *
+ * \param [IN] periodicity 2^( 7 - periodicity ) ping slots per beacon period
+ */
+void LoRaMacClassBSetPingSlotInfo( uint8_t periodicity );
+
+/*!
+ * \brief Sets the ping slot channel of PingSlotChannelReq
+ *
+ * \param [IN] frequency Frequency [Hz], 0 for the default channel of the region
+ * \param [IN] datarate  Datarate
+ */
+void LoRaMacClassBSetPingSlotChannel( uint32_t frequency, int8_t datarate );
+
+/*!
+ * \brief Checks if the node can switch to class B
+ *
+ * \retval ready true once a beacon is locked and the ping slot periodicity
+ *               acknowledged
+ */
+bool LoRaMacClassBIsReady( void );
+
+/*!
+ * \brief Starts the ping slots, on the switch to class B
+ *
+ * \param [IN] devAddr Device address, the ping slot offsets depend on it
+ */
+void LoRaMacClassBStart( uint32_t devAddr );
+
+/*!
+ * \brief Stops the ping slots and the beacon tracking, on the switch to an
+ *        other class. The network time is kept for the next acquisition.
+ */
+void LoRaMacClassBStop( void );
+
+/*! \} defgroup LORAMACCLASSB */
+
+#endif // __LORAMACCLASSB_H__
@@ -0,0 +1,183 @@
+/*!
+ * \file      LoRaMacClassBSwitch.c
+ *
+ * \brief     Switch of the application to class B
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <stdbool.h>
+#include "timer.h"
+#include "LoRaMacClassBSwitch.h"
+
+/*!
+ * Ping slot periodicity requested by the switch
+ */
+static uint8_t PingSlotPeriodicity;
+
+/*!
+ * Indicates if the switch is in progress
+ */
+static bool SwitchRunning = false;
+
+/*!
+ * Number of consecutive failed steps
+ */
+static uint8_t SwitchFailures;
+
+/*!
+ * Step requested again by the retry timer
+ */
+static Mlme_t RetryRequest;
+
+/*!
+ * Timer requesting the failed step again
+ */
+static TimerEvent_t RetryTimer;
+
+/*!
+ * \brief Requests a step of the switch, a request the MAC refuses counts as a
+ *        failed step
+ *
+ * \param [IN] type MLME_DEVICE_TIME, MLME_BEACON_ACQUISITION or
+ *                  MLME_PING_SLOT_INFO
+ */
+static void SwitchRequest( Mlme_t type );
+
+/*!
+ * \brief Arms the retry of a failed step, or gives up after
+ *        LORAMAC_CLASSB_SWITCH_MAX_FAILURES
+ *
+ * \param [IN] type Step to request again
+ */
+static void SwitchRetry( Mlme_t type );
+
+static void OnRetryTimerEvent( void )
+{
+    TimerStop( &RetryTimer );
+    if( SwitchRunning == true )
+    {
+        SwitchRequest( RetryRequest );
+    }
+}
+
+static void SwitchRequest( Mlme_t type )
+{
+    MlmeReq_t mlmeReq;
+
+    mlmeReq.Type = type;
+    mlmeReq.Req.PingSlotInfo.Periodicity = PingSlotPeriodicity;
+    if( LoRaMacMlmeRequest( &mlmeReq ) != LORAMAC_STATUS_OK )
+    {
+        SwitchRetry( type );
+    }
+}
+
+static void SwitchRetry( Mlme_t type )
+{
+    SwitchFailures++;
+    if( SwitchFailures > LORAMAC_CLASSB_SWITCH_MAX_FAILURES )
+    {// Stay in class A until the application starts the switch again
+        SwitchRunning = false;
+        return;
+    }
+    RetryRequest = type;
+    TimerSetValue( &RetryTimer, ( uint32_t )LORAMAC_CLASSB_SWITCH_RETRY_DELAY << ( SwitchFailures - 1 ) );
+    TimerStart( &RetryTimer );
+}
+
+void LoRaMacClassBSwitchInit( uint8_t periodicity )
+{
+    PingSlotPeriodicity = periodicity;
+    SwitchRunning = false;
+    TimerInit( &RetryTimer, OnRetryTimerEvent );
+}
+
+void LoRaMacClassBSwitchStart( void )
+{
+    TimerStop( &RetryTimer );
+    SwitchRunning = true;
+    SwitchFailures = 0;
+    SwitchRequest( MLME_DEVICE_TIME );
+}
+
+void LoRaMacClassBSwitchOnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+    if( SwitchRunning == false )
+    {
+        return;
+    }
+
+    switch( mlmeConfirm->MlmeRequest )
+    {
+        case MLME_DEVICE_TIME:
+        {// The network time is known, search the beacon
+            if( mlmeConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK )
+            {
+                SwitchRequest( MLME_BEACON_ACQUISITION );
+            }
+            else
+            {
+                SwitchRetry( MLME_DEVICE_TIME );
+            }
+            break;
+        }
+        case MLME_BEACON_ACQUISITION:
+        {
+            if( mlmeConfirm->Status == LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED )
+            {
+                SwitchRequest( MLME_PING_SLOT_INFO );
+            }
+            else
+            {
+                SwitchRetry( MLME_DEVICE_TIME );
+            }
+            break;
+        }
+        case MLME_PING_SLOT_INFO:
+        {
+            if( mlmeConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK )
+            {
+                MibRequestConfirm_t mibReq;
+
+                mibReq.Type = MIB_DEVICE_CLASS;
+                mibReq.Param.Class = CLASS_B;
+                if( LoRaMacMibSetRequestConfirm( &mibReq ) == LORAMAC_STATUS_OK )
+                {
+                    SwitchRunning = false;
+                }
+                else
+                {// The beacon has been lost meanwhile
+                    SwitchRetry( MLME_DEVICE_TIME );
+                }
+            }
+            else
+            {
+                SwitchRetry( MLME_PING_SLOT_INFO );
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void LoRaMacClassBSwitchOnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+    if( mlmeIndication->MlmeIndication == MLME_BEACON_LOST )
+    {// The node is back in class A, synchronize again
+        LoRaMacClassBSwitchStart( );
+    }
+}
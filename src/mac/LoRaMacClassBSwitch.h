@@ -0,0 +1,90 @@
+/*!
+ * \file      LoRaMacClassBSwitch.h
+ *
+ * \brief     Switch of the application to class B
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * The switch chains the MLME requests:
+ *
+ *     MLME_DEVICE_TIME -> MLME_BEACON_ACQUISITION -> MLME_PING_SLOT_INFO -> CLASS_B
+ *
+ * A failed device time or beacon acquisition restarts the chain from the
+ * device time, a failed ping slot info is requested again. The failed steps
+ * are requested again by a timer, the delay doubling with every consecutive
+ * failure. After LORAMAC_CLASSB_SWITCH_MAX_FAILURES the node stays in class
+ * A until the application starts the switch again. MLME_BEACON_LOST starts
+ * it again.
+ *
+ * The application forwards its MLME confirms and indications, the other
+ * requests are ignored.
+ *
+ * \author    jkadbear( Tsinghua )
+ *
+ * \defgroup  LORAMACCLASSBSWITCH Switch to class B
+ * \{
+ */
+#ifndef __LORAMACCLASSBSWITCH_H__
+#define __LORAMACCLASSBSWITCH_H__
+
+#include <stdint.h>
+#include "LoRaMac.h"
+
+/*!
+ * Delay before the first retry of a failed step [ms]
+ */
+#ifndef LORAMAC_CLASSB_SWITCH_RETRY_DELAY
+#define LORAMAC_CLASSB_SWITCH_RETRY_DELAY           16000
+#endif
+
+/*!
+ * Number of consecutive failures after which the switch gives up, the last
+ * retry waits LORAMAC_CLASSB_SWITCH_RETRY_DELAY * 2^( failures - 1 )
+ */
+#ifndef LORAMAC_CLASSB_SWITCH_MAX_FAILURES
+#define LORAMAC_CLASSB_SWITCH_MAX_FAILURES          8
+#endif
+
+/*!
+ * \brief Initializes the switch, the MAC has to be initialized
+ *
+ * \param [IN] periodicity Ping slot periodicity, 2^( 7 - periodicity ) ping
+ *                         slots every beacon period
+ */
+void LoRaMacClassBSwitchInit( uint8_t periodicity );
+
+/*!
+ * \brief Starts the switch to class B, the node has to be joined
+ *
+ * \remark A switch in progress restarts, its failures are forgotten
+ */
+void LoRaMacClassBSwitchStart( void );
+
+/*!
+ * \brief Steps the switch on a MLME confirm
+ *
+ * \param [IN] mlmeConfirm MLME confirm of the MAC
+ */
+void LoRaMacClassBSwitchOnMlmeConfirm( MlmeConfirm_t *mlmeConfirm );
+
+/*!
+ * \brief Starts the switch again when the beacon is lost
+ *
+ * \param [IN] mlmeIndication MLME indication of the MAC
+ */
+void LoRaMacClassBSwitchOnMlmeIndication( MlmeIndication_t *mlmeIndication );
+
+/*! \} defgroup LORAMACCLASSBSWITCH */
+
+#endif // __LORAMACCLASSBSWITCH_H__
@@ -85,7 +85,18 @@ static AES_CMAC_CTX AesCmacCtx[1];
  * \param [IN]  sequenceCounter Frame sequence counter
  * \param [OUT] mic Computed MIC field
  */
-void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
+/*!
+ * \brief Computes the LoRaMAC frame MIC field with a keyed CMAC context
+ *
+ * \param [IN]  buffer          Data buffer
+ * \param [IN]  size            Data buffer size
+ * \param [IN]  ctx             CMAC context, keyed and initialized
+ * \param [IN]  address         Frame address
+ * \param [IN]  dir             Frame direction [0: uplink, 1: downlink]
+ * \param [IN]  sequenceCounter Frame sequence counter
+ * \param [OUT] mic Computed MIC field
+ */
+static void ComputeMic( const uint8_t *buffer, uint16_t size, AES_CMAC_CTX *ctx, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
 {
     MicBlockB0[5] = dir;
     
@@ -101,28 +112,32 @@ void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key
 
     MicBlockB0[15] = size & 0xFF;
 
-    AES_CMAC_Init( AesCmacCtx );
-
-    AES_CMAC_SetKey( AesCmacCtx, key );
-
-    AES_CMAC_Update( AesCmacCtx, MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE );
+    AES_CMAC_Update( ctx, MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE );
     
-    AES_CMAC_Update( AesCmacCtx, buffer, size & 0xFF );
+    AES_CMAC_Update( ctx, buffer, size & 0xFF );
     
-    AES_CMAC_Final( Mic, AesCmacCtx );
+    AES_CMAC_Final( Mic, ctx );
     
     *mic = ( uint32_t )( ( uint32_t )Mic[3] << 24 | ( uint32_t )Mic[2] << 16 | ( uint32_t )Mic[1] << 8 | ( uint32_t )Mic[0] );
 }
 
-void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
+/*!
+ * \brief Computes the LoRaMAC payload encryption with a key schedule
+ *
+ * \param [IN]  buffer          Data buffer
+ * \param [IN]  size            Data buffer size
+ * \param [IN]  ctx             AES key schedule
+ * \param [IN]  address         Frame address
+ * \param [IN]  dir             Frame direction [0: uplink, 1: downlink]
+ * \param [IN]  sequenceCounter Frame sequence counter
+ * \param [OUT] encBuffer       Encrypted buffer
+ */
+static void PayloadEncrypt( const uint8_t *buffer, uint16_t size, const aes_context *ctx, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
 {
     uint16_t i;
     uint8_t bufferIndex = 0;
     uint16_t ctr = 1;
 
-    memset1( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
-
     aBlock[5] = dir;
 
     aBlock[6] = ( address ) & 0xFF;
@@ -139,7 +154,7 @@ void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t
     {
         aBlock[15] = ( ( ctr ) & 0xFF );
         ctr++;
-        aes_encrypt( aBlock, sBlock, &AesContext );
+        aes_encrypt( aBlock, sBlock, ctx );
         for( i = 0; i < 16; i++ )
         {
             encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
@@ -151,7 +166,7 @@ void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t
     if( size > 0 )
     {
         aBlock[15] = ( ( ctr ) & 0xFF );
-        aes_encrypt( aBlock, sBlock, &AesContext );
+        aes_encrypt( aBlock, sBlock, ctx );
         for( i = 0; i < size; i++ )
         {
             encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
@@ -159,11 +174,51 @@ void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t
     }
 }
 
+void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
+{
+    AES_CMAC_Init( AesCmacCtx );
+
+    AES_CMAC_SetKey( AesCmacCtx, key );
+
+    ComputeMic( buffer, size, AesCmacCtx, address, dir, sequenceCounter, mic );
+}
+
+void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
+{
+    memset1( AesContext.ksch, '\0', 240 );
+    aes_set_key( key, 16, &AesContext );
+
+    PayloadEncrypt( buffer, size, &AesContext, address, dir, sequenceCounter, encBuffer );
+}
+
 void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer )
 {
     LoRaMacPayloadEncrypt( buffer, size, key, address, dir, sequenceCounter, decBuffer );
 }
 
+void LoRaMacCryptoSetSessionKeys( const uint8_t *nwkSKey, const uint8_t *appSKey, LoRaMacCryptoSessionKeys_t *keys )
+{
+    AES_CMAC_Init( &keys->NwkSKey );
+    AES_CMAC_SetKey( &keys->NwkSKey, nwkSKey );
+
+    memset1( ( uint8_t* )&keys->AppSKey, '\0', sizeof( keys->AppSKey ) );
+    aes_set_key( appSKey, 16, &keys->AppSKey );
+}
+
+void LoRaMacComputeMicPrekeyed( const uint8_t *buffer, uint16_t size, LoRaMacCryptoSessionKeys_t *keys, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
+{
+    // Same as AES_CMAC_Init, except that the key schedule is kept
+    memset1( keys->NwkSKey.X, 0, sizeof( keys->NwkSKey.X ) );
+    keys->NwkSKey.M_n = 0;
+
+    ComputeMic( buffer, size, &keys->NwkSKey, address, dir, sequenceCounter, mic );
+}
+
+void LoRaMacPayloadDecryptPrekeyed( const uint8_t *buffer, uint16_t size, const aes_context *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer )
+{
+    PayloadEncrypt( buffer, size, key, address, dir, sequenceCounter, decBuffer );
+}
+
 void LoRaMacJoinComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic )
 {
     AES_CMAC_Init( AesCmacCtx );
@@ -209,3 +264,27 @@ void LoRaMacJoinComputeSKeys( const uint8_t *key, const uint8_t *appNonce, uint1
     memcpy1( nonce + 7, pDevNonce, 2 );
     aes_encrypt( nonce, appSKey, &AesContext );
 }
+
+uint16_t LoRaMacBeaconComputePingOffset( uint32_t beaconTime, uint32_t address, uint16_t pingPeriod )
+{
+    uint8_t key[16];
+    uint8_t buffer[16];
+    uint8_t rand[16];
+
+    memset1( key, 0, sizeof( key ) );
+    memset1( AesContext.ksch, '\0', 240 );
+    aes_set_key( key, 16, &AesContext );
+
+    memset1( buffer, 0, sizeof( buffer ) );
+    buffer[0] = beaconTime & 0xFF;
+    buffer[1] = ( beaconTime >> 8 ) & 0xFF;
+    buffer[2] = ( beaconTime >> 16 ) & 0xFF;
+    buffer[3] = ( beaconTime >> 24 ) & 0xFF;
+    buffer[4] = address & 0xFF;
+    buffer[5] = ( address >> 8 ) & 0xFF;
+    buffer[6] = ( address >> 16 ) & 0xFF;
+    buffer[7] = ( address >> 24 ) & 0xFF;
+    aes_encrypt( buffer, rand, &AesContext );
+
+    return ( ( uint16_t )rand[0] + ( ( uint16_t )rand[1] << 8 ) ) % pingPeriod;
+}
@@ -37,6 +37,24 @@
 #define __LORAMAC_CRYPTO_H__
 
 #include <stdint.h>
+#include "aes.h"
+#include "cmac.h"
+
+/*!
+ * Key schedules of a session key pair, computed once for frames which are
+ * processed again and again with the same keys
+ */
+typedef struct sLoRaMacCryptoSessionKeys
+{
+    /*!
+     * CMAC context keyed with the network session key
+     */
+    AES_CMAC_CTX NwkSKey;
+    /*!
+     * AES context keyed with the application session key
+     */
+    aes_context AppSKey;
+}LoRaMacCryptoSessionKeys_t;
 
 /*!
  * Computes the LoRaMAC frame MIC field
@@ -77,6 +95,42 @@ void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t
  */
 void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer );
 
+/*!
+ * Computes the key schedules of a session key pair
+ *
+ * \param [IN]  nwkSKey         - Network session key
+ * \param [IN]  appSKey         - Application session key
+ * \param [OUT] keys            - Key schedules
+ */
+void LoRaMacCryptoSetSessionKeys( const uint8_t *nwkSKey, const uint8_t *appSKey, LoRaMacCryptoSessionKeys_t *keys );
+
+/*!
+ * Computes the LoRaMAC frame MIC field with the precomputed network session
+ * key schedule
+ *
+ * \param [IN]  buffer          - Data buffer
+ * \param [IN]  size            - Data buffer size
+ * \param [IN]  keys            - Session key schedules
+ * \param [IN]  address         - Frame address
+ * \param [IN]  dir             - Frame direction [0: uplink, 1: downlink]
+ * \param [IN]  sequenceCounter - Frame sequence counter
+ * \param [OUT] mic             - Computed MIC field
+ */
+void LoRaMacComputeMicPrekeyed( const uint8_t *buffer, uint16_t size, LoRaMacCryptoSessionKeys_t *keys, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic );
+
+/*!
+ * Computes the LoRaMAC payload decryption with a precomputed key schedule
+ *
+ * \param [IN]  buffer          - Data buffer
+ * \param [IN]  size            - Data buffer size
+ * \param [IN]  key             - AES key schedule to be used
+ * \param [IN]  address         - Frame address
+ * \param [IN]  dir             - Frame direction [0: uplink, 1: downlink]
+ * \param [IN]  sequenceCounter - Frame sequence counter
+ * \param [OUT] decBuffer       - Decrypted buffer
+ */
+void LoRaMacPayloadDecryptPrekeyed( const uint8_t *buffer, uint16_t size, const aes_context *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer );
+
 /*!
  * Computes the LoRaMAC Join Request frame MIC field
  *
@@ -108,6 +162,18 @@ void LoRaMacJoinDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *ke
  */
 void LoRaMacJoinComputeSKeys( const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey );
 
+/*!
+ * Computes the class B ping slot offset of a beacon period
+ *
+ * LoRaWAN Specification V1.0.3, chapter 13.2
+ *
+ * \param [IN]  beaconTime      - GPS time of the beacon period start [s]
+ * \param [IN]  address         - Device or multicast group address
+ * \param [IN]  pingPeriod      - Ping period [slots]
+ * \retval      pingOffset      - Offset of the first ping slot [slots]
+ */
+uint16_t LoRaMacBeaconComputePingOffset( uint32_t beaconTime, uint32_t address, uint16_t pingPeriod );
+
 /*! \} defgroup LORAMAC */
 
 #endif // __LORAMAC_CRYPTO_H__
@@ -0,0 +1,273 @@
+/*!
+ * \file      LoRaMacNvm.c
+ *
+ * \brief     LoRa MAC session persistence in the EEPROM
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#if defined( LORAMAC_NVM_SESSION )
+
+#include <string.h>
+#include "utilities.h"
+#include "eeprom.h"
+#include "LoRaMacNvm.h"
+
+/*!
+ * Header magic, "LMS1"
+ */
+#define LORAMAC_NVM_MAGIC                           0x31534D4C
+
+/*!
+ * Image header
+ */
+typedef struct sLoRaMacNvmHeader
+{
+    uint32_t Magic;
+    /*!
+     * Incremented by each new session, the counter slots of the previous
+     * sessions are ignored
+     */
+    uint16_t SessionId;
+    /*!
+     * CRC of the session
+     */
+    uint16_t Crc;
+}LoRaMacNvmHeader_t;
+
+/*!
+ * Counter slot
+ */
+typedef struct sLoRaMacNvmSlot
+{
+    LoRaMacNvmCounters_t Counters;
+    uint16_t SessionId;
+    /*!
+     * CRC of the fields above
+     */
+    uint16_t Crc;
+}LoRaMacNvmSlot_t;
+
+/*!
+ * EEPROM image
+ */
+typedef struct sLoRaMacNvmImage
+{
+    LoRaMacNvmHeader_t Header;
+    LoRaMacNvmSession_t Session;
+    LoRaMacNvmSlot_t Slots[LORAMAC_NVM_COUNTER_SLOTS];
+}LoRaMacNvmImage_t;
+
+/*!
+ * Copy of the EEPROM content
+ */
+static LoRaMacNvmImage_t NvmImage;
+
+/*!
+ * Header to commit
+ */
+static LoRaMacNvmHeader_t NvmHeader;
+
+/*!
+ * The session of NvmHeader is committed or being updated
+ */
+static bool NvmSessionValid = false;
+
+/*!
+ * Index of the last counter slot of the session, -1 when none
+ */
+static int8_t NvmSlotIndex = -1;
+
+/*!
+ * \brief Computes a CRC-16 CCITT, 0xFFFF initial value
+ *
+ * \param [IN] buffer Data
+ * \param [IN] size   Data size
+ * \retval crc        CRC
+ */
+static uint16_t NvmCrc( const void *buffer, uint16_t size )
+{
+    const uint8_t *data = buffer;
+    uint16_t crc = 0xFFFF;
+
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        crc ^= ( uint16_t )data[i] << 8;
+        for( uint8_t j = 0; j < 8; j++ )
+        {
+            crc = ( crc & 0x8000 ) ? ( crc << 1 ) ^ 0x1021 : ( crc << 1 );
+        }
+    }
+    return crc;
+}
+
+/*!
+ * \brief Writes the bytes of the image which differ from the EEPROM copy
+ *
+ * \param [IN] offset Offset in the image
+ * \param [IN] data   New value
+ * \param [IN] size   Size of the value
+ */
+static void NvmWrite( uint16_t offset, const void *data, uint16_t size )
+{
+    uint8_t *copy = ( uint8_t* )&NvmImage + offset;
+    const uint8_t *src = data;
+    uint16_t start;
+    uint16_t i = 0;
+
+    while( i < size )
+    {
+        if( copy[i] == src[i] )
+        {
+            i++;
+            continue;
+        }
+        start = i;
+        while( ( i < size ) && ( copy[i] != src[i] ) )
+        {
+            copy[i] = src[i];
+            i++;
+        }
+        EepromWriteBuffer( LORAMAC_NVM_ADDR + offset + start, copy + start, i - start );
+    }
+}
+
+/*!
+ * \brief Checks a counter slot
+ *
+ * \param [IN] slot  Counter slot
+ * \retval     valid The slot was completely written during the session
+ */
+static bool NvmSlotIsValid( const LoRaMacNvmSlot_t *slot )
+{
+    return ( slot->SessionId == NvmHeader.SessionId ) &&
+           ( slot->Crc == NvmCrc( slot, offsetof( LoRaMacNvmSlot_t, Crc ) ) );
+}
+
+void LoRaMacNvmInit( void )
+{
+    EepromReadBuffer( LORAMAC_NVM_ADDR, ( uint8_t* )&NvmImage, sizeof( NvmImage ) );
+
+    NvmHeader = NvmImage.Header;
+    NvmSessionValid = ( NvmImage.Header.Magic == LORAMAC_NVM_MAGIC ) &&
+                      ( NvmImage.Header.Crc == NvmCrc( &NvmImage.Session, sizeof( NvmImage.Session ) ) );
+    NvmSlotIndex = -1;
+
+    if( NvmSessionValid == false )
+    {
+        return;
+    }
+    // The last slot holds the largest counters, the downlink counter only
+    // changes between the uplinks
+    for( int8_t i = 0; i < LORAMAC_NVM_COUNTER_SLOTS; i++ )
+    {
+        const LoRaMacNvmCounters_t *counters = &NvmImage.Slots[i].Counters;
+
+        if( NvmSlotIsValid( &NvmImage.Slots[i] ) == false )
+        {
+            continue;
+        }
+        if( ( NvmSlotIndex < 0 ) ||
+            ( counters->UpLinkCounter > NvmImage.Slots[NvmSlotIndex].Counters.UpLinkCounter ) ||
+            ( ( counters->UpLinkCounter == NvmImage.Slots[NvmSlotIndex].Counters.UpLinkCounter ) &&
+              ( counters->DownLinkCounter > NvmImage.Slots[NvmSlotIndex].Counters.DownLinkCounter ) ) )
+        {
+            NvmSlotIndex = i;
+        }
+    }
+}
+
+const LoRaMacNvmSession_t* LoRaMacNvmRestore( LoRaMacNvmCounters_t *counters )
+{
+    if( NvmSessionValid == false )
+    {
+        return NULL;
+    }
+
+    memset1( ( uint8_t* )counters, 0, sizeof( LoRaMacNvmCounters_t ) );
+    counters->UpLinkCounter = NvmImage.Session.UpLinkCounter;
+    counters->DownLinkCounter = NvmImage.Session.DownLinkCounter;
+    if( NvmSlotIndex >= 0 )
+    {
+        *counters = NvmImage.Slots[NvmSlotIndex].Counters;
+        counters->UpLinkCounter = MAX( counters->UpLinkCounter, NvmImage.Session.UpLinkCounter );
+        counters->DownLinkCounter = MAX( counters->DownLinkCounter, NvmImage.Session.DownLinkCounter );
+    }
+    return &NvmImage.Session;
+}
+
+bool LoRaMacNvmSessionOpen( uint32_t devAddr, const uint8_t *nwkSKey, const uint8_t *appSKey )
+{
+    if( ( NvmSessionValid == true ) &&
+        ( NvmImage.Session.DevAddr == devAddr ) &&
+        ( memcmp( NvmImage.Session.NwkSKey, nwkSKey, 16 ) == 0 ) &&
+        ( memcmp( NvmImage.Session.AppSKey, appSKey, 16 ) == 0 ) )
+    {
+        return false;
+    }
+
+    NvmHeader.Magic = LORAMAC_NVM_MAGIC;
+    NvmHeader.SessionId++;
+    NvmSessionValid = true;
+    NvmSlotIndex = -1;
+
+    LORAMAC_NVM_SESSION_UPDATE( DevAddr, &devAddr );
+    LORAMAC_NVM_SESSION_UPDATE( NwkSKey, nwkSKey );
+    LORAMAC_NVM_SESSION_UPDATE( AppSKey, appSKey );
+    return true;
+}
+
+void LoRaMacNvmSessionUpdate( uint16_t offset, const void *data, uint16_t size )
+{
+    if( NvmSessionValid == false )
+    {
+        return;
+    }
+    NvmWrite( offsetof( LoRaMacNvmImage_t, Session ) + offset, data, size );
+}
+
+void LoRaMacNvmSessionCommit( void )
+{
+    if( NvmSessionValid == false )
+    {
+        return;
+    }
+    // Written last, a session partially written before a reset fails the CRC
+    NvmHeader.Crc = NvmCrc( &NvmImage.Session, sizeof( NvmImage.Session ) );
+    NvmWrite( offsetof( LoRaMacNvmImage_t, Header ), &NvmHeader, sizeof( NvmHeader ) );
+}
+
+void LoRaMacNvmSaveCounters( const LoRaMacNvmCounters_t *counters )
+{
+    LoRaMacNvmSlot_t slot;
+
+    if( NvmSessionValid == false )
+    {
+        return;
+    }
+    if( ( NvmSlotIndex >= 0 ) &&
+        ( memcmp( &NvmImage.Slots[NvmSlotIndex].Counters, counters, sizeof( LoRaMacNvmCounters_t ) ) == 0 ) )
+    {
+        return;
+    }
+
+    NvmSlotIndex = ( NvmSlotIndex + 1 ) % LORAMAC_NVM_COUNTER_SLOTS;
+    slot.Counters = *counters;
+    slot.SessionId = NvmHeader.SessionId;
+    slot.Crc = NvmCrc( &slot, offsetof( LoRaMacNvmSlot_t, Crc ) );
+    NvmWrite( offsetof( LoRaMacNvmImage_t, Slots ) + NvmSlotIndex * sizeof( LoRaMacNvmSlot_t ), &slot, sizeof( slot ) );
+}
+
+#endif // LORAMAC_NVM_SESSION
@@ -0,0 +1,174 @@
+/*!
+ * \file      LoRaMacNvm.h
+ *
+ * \brief     LoRa MAC session persistence in the EEPROM
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * EEPROM layout, from LORAMAC_NVM_ADDR:
+ *
+ *     | header | session                    | counter slots 0 .. N-1 |
+ *     | 8      | LoRaMacNvmSession_t        | 16 bytes each           |
+ *
+ * The header holds the CRC of the session. The frame counters change on
+ * every uplink, they are appended to a ring of slots instead of rewriting the
+ * session, each slot carries the session id and its own CRC so a write
+ * interrupted by a reset is ignored. The session itself is only rewritten
+ * when a MAC command or a join changes it, and only its changed bytes.
+ *
+ * The whole image is read once at initialization and kept in RAM to find the
+ * changed bytes.
+ *
+ * \author    jkadbear( Tsinghua )
+ *
+ * \defgroup  LORAMACNVM LoRa MAC session persistence
+ * \{
+ */
+#ifndef __LORAMACNVM_H__
+#define __LORAMACNVM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "LoRaMac.h"
+
+/*!
+ * EEPROM address of the image
+ */
+#ifndef LORAMAC_NVM_ADDR
+#define LORAMAC_NVM_ADDR                            0
+#endif
+
+/*!
+ * Number of counter slots, each slot is written once every
+ * LORAMAC_NVM_COUNTER_SLOTS uplinks
+ */
+#ifndef LORAMAC_NVM_COUNTER_SLOTS
+#define LORAMAC_NVM_COUNTER_SLOTS                   16
+#endif
+
+/*!
+ * Channels saved, regions with more channels have a fixed channel plan and
+ * only their channels mask is saved
+ */
+#define LORAMAC_NVM_MAX_CHANNELS                    16
+
+/*!
+ * Channels mask size, 96 channels
+ */
+#define LORAMAC_NVM_CHANNELS_MASK_SIZE              6
+
+/*!
+ * Session saved
+ */
+typedef struct sLoRaMacNvmSession
+{
+    uint32_t DevAddr;
+    uint8_t NwkSKey[16];
+    uint8_t AppSKey[16];
+    uint32_t NetID;
+    /*!
+     * Frame counters at the start of the session, the counter slots hold the
+     * current ones
+     */
+    uint32_t UpLinkCounter;
+    uint32_t DownLinkCounter;
+    LoRaMacParams_t MacParams;
+    uint8_t MaxDCycle;
+    uint16_t AggregatedDCycle;
+    ChannelParams_t Channels[LORAMAC_NVM_MAX_CHANNELS];
+    uint16_t ChannelsMask[LORAMAC_NVM_CHANNELS_MASK_SIZE];
+}LoRaMacNvmSession_t;
+
+/*!
+ * Frame counters and last uplink, saved in a counter slot
+ */
+typedef struct sLoRaMacNvmCounters
+{
+    /*!
+     * First uplink counter the node may use after a reset
+     */
+    uint32_t UpLinkCounter;
+    uint32_t DownLinkCounter;
+    /*!
+     * Time on air of the last uplink [ms], its band time-off is applied again
+     * after a reset
+     */
+    uint16_t TxTimeOnAir;
+    /*!
+     * Channel of the last uplink
+     */
+    uint8_t Channel;
+    uint8_t Rfu;
+}LoRaMacNvmCounters_t;
+
+/*!
+ * \brief Updates a field of the session
+ *
+ * \param [IN] field Field of LoRaMacNvmSession_t
+ * \param [IN] data  New value
+ */
+#define LORAMAC_NVM_SESSION_UPDATE( field, data ) \
+    LoRaMacNvmSessionUpdate( offsetof( LoRaMacNvmSession_t, field ), ( data ), sizeof( ( ( LoRaMacNvmSession_t* )0 )->field ) )
+
+/*!
+ * \brief Reads the image from the EEPROM
+ */
+void LoRaMacNvmInit( void );
+
+/*!
+ * \brief Gets the saved session
+ *
+ * \param [OUT] counters Current frame counters and last uplink, TxTimeOnAir
+ *                       is 0 when no uplink was saved
+ * \retval      session  Session, NULL when no valid session is saved
+ */
+const LoRaMacNvmSession_t* LoRaMacNvmRestore( LoRaMacNvmCounters_t *counters );
+
+/*!
+ * \brief Starts a new session unless the saved one has the same address and
+ *        keys. The session is valid once committed.
+ *
+ * \param [IN] devAddr Device address
+ * \param [IN] nwkSKey Network session key
+ * \param [IN] appSKey Application session key
+ * \retval     status  true for a new session, its fields must all be updated
+ */
+bool LoRaMacNvmSessionOpen( uint32_t devAddr, const uint8_t *nwkSKey, const uint8_t *appSKey );
+
+/*!
+ * \brief Writes the changed bytes of a part of the session
+ *
+ * \param [IN] offset Offset in LoRaMacNvmSession_t
+ * \param [IN] data   New value
+ * \param [IN] size   Size of the value
+ */
+void LoRaMacNvmSessionUpdate( uint16_t offset, const void *data, uint16_t size );
+
+/*!
+ * \brief Writes the header of the session if it changed
+ */
+void LoRaMacNvmSessionCommit( void );
+
+/*!
+ * \brief Appends the frame counters to the next slot, unless they did not
+ *        change since the last slot
+ *
+ * \param [IN] counters Frame counters and last uplink
+ */
+void LoRaMacNvmSaveCounters( const LoRaMacNvmCounters_t *counters );
+
+/*! \} defgroup LORAMACNVM */
+
+#endif // __LORAMACNVM_H__
@@ -650,7 +650,31 @@ typedef enum ePhyAttribute
     /*!
      * Next lower datarate.
      */
-    PHY_NEXT_LOWER_TX_DR
+    PHY_NEXT_LOWER_TX_DR,
+    /*!
+     * Lowest SNR at which a datarate can be demodulated [dB].
+     */
+    PHY_DEMOD_FLOOR,
+    /*!
+     * Class B beacon channel frequency, 0 when the region has no beacon.
+     */
+    PHY_BEACON_CHANNEL_FREQ,
+    /*!
+     * Class B beacon datarate.
+     */
+    PHY_BEACON_CHANNEL_DR,
+    /*!
+     * Class B beacon frame format.
+     */
+    PHY_BEACON_FORMAT,
+    /*!
+     * Class B default ping slot channel frequency.
+     */
+    PHY_PING_SLOT_CHANNEL_FREQ,
+    /*!
+     * Class B default ping slot datarate.
+     */
+    PHY_PING_SLOT_CHANNEL_DR
 }PhyAttribute_t;
 
 /*!
@@ -686,6 +710,28 @@ typedef enum eChannelsMask
     CHANNELS_DEFAULT_MASK
 }ChannelsMask_t;
 
+/*!
+ * Class B beacon frame format
+ *
+ * | RFU1 | Time | CRC | GwSpecific | RFU2 | CRC |
+ * |  x   |  4   |  2  |      7     |  y   |  2  |
+ */
+typedef struct sBeaconFormat
+{
+    /*!
+     * Size of the beacon frame
+     */
+    uint8_t BeaconSize;
+    /*!
+     * Size of the first RFU field
+     */
+    uint8_t Rfu1Size;
+    /*!
+     * Size of the second RFU field
+     */
+    uint8_t Rfu2Size;
+}BeaconFormat_t;
+
 /*!
  * Union for the structure uGetPhyParams
  */
@@ -707,6 +753,10 @@ typedef union uPhyParam
      * Pointer to the channels.
      */
     ChannelParams_t* Channels;
+    /*!
+     * Class B beacon frame format.
+     */
+    BeaconFormat_t BeaconFormat;
 }PhyParam_t;
 
 /*!
@@ -736,6 +786,18 @@ typedef struct sGetPhyParams
      * PHY_MIN_RX_DR, PHY_MAX_PAYLOAD, PHY_MAX_PAYLOAD_REPEATER.
      */
     uint8_t DownlinkDwellTime;
+    /*!
+     * GPS time of the beacon period start [s].
+     * The parameter is needed for the following queries:
+     * PHY_BEACON_CHANNEL_FREQ, PHY_PING_SLOT_CHANNEL_FREQ.
+     */
+    uint32_t BeaconTime;
+    /*!
+     * Device address.
+     * The parameter is needed for the following queries:
+     * PHY_PING_SLOT_CHANNEL_FREQ.
+     */
+    uint32_t DevAddr;
 }GetPhyParams_t;
 
 /*!
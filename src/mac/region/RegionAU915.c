@@ -271,6 +271,11 @@ PhyParam_t RegionAU915GetPhyParam( GetPhyParams_t* getPhy )
             phyParam.fValue = AU915_DEFAULT_ANTENNA_GAIN;
             break;
         }
+        case PHY_DEMOD_FLOOR:
+        {
+            phyParam.fValue = RegionCommonComputeDemodFloorLoRa( DataratesAU915[getPhy->Datarate] );
+            break;
+        }
         default:
         {
             break;
@@ -485,7 +490,7 @@ bool RegionAU915AdrNext( AdrNextParams_t* adrNext, int8_t* drOut, int8_t* txPowO
 
 void RegionAU915ComputeRxWindowParameters( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams )
 {
-    double tSymbol = 0.0;
+    uint32_t tSymbol = 0;
 
     // Get the datarate, perform a boundary check
     rxConfigParams->Datarate = MIN( datarate, AU915_RX_MAX_DATARATE );
@@ -271,6 +271,38 @@ PhyParam_t RegionCN470GetPhyParam( GetPhyParams_t* getPhy )
             phyParam.fValue = CN470_DEFAULT_ANTENNA_GAIN;
             break;
         }
+        case PHY_DEMOD_FLOOR:
+        {
+            phyParam.fValue = RegionCommonComputeDemodFloorLoRa( DataratesCN470[getPhy->Datarate] );
+            break;
+        }
+        case PHY_BEACON_CHANNEL_FREQ:
+        {
+            phyParam.Value = CN470_BEACON_CHANNEL_FREQ + ( ( getPhy->BeaconTime / CN470_BEACON_INTERVAL ) % CN470_BEACON_NB_CHANNELS ) * CN470_BEACON_CHANNEL_STEPWIDTH;
+            break;
+        }
+        case PHY_BEACON_CHANNEL_DR:
+        {
+            phyParam.Value = CN470_BEACON_CHANNEL_DR;
+            break;
+        }
+        case PHY_BEACON_FORMAT:
+        {
+            phyParam.BeaconFormat.BeaconSize = CN470_BEACON_SIZE;
+            phyParam.BeaconFormat.Rfu1Size = CN470_RFU1_SIZE;
+            phyParam.BeaconFormat.Rfu2Size = CN470_RFU2_SIZE;
+            break;
+        }
+        case PHY_PING_SLOT_CHANNEL_FREQ:
+        {
+            phyParam.Value = CN470_BEACON_CHANNEL_FREQ + ( ( getPhy->DevAddr + ( getPhy->BeaconTime / CN470_BEACON_INTERVAL ) ) % CN470_BEACON_NB_CHANNELS ) * CN470_BEACON_CHANNEL_STEPWIDTH;
+            break;
+        }
+        case PHY_PING_SLOT_CHANNEL_DR:
+        {
+            phyParam.Value = CN470_PING_SLOT_CHANNEL_DR;
+            break;
+        }
         default:
         {
             break;
@@ -471,7 +503,7 @@ bool RegionCN470AdrNext( AdrNextParams_t* adrNext, int8_t* drOut, int8_t* txPowO
 
 void RegionCN470ComputeRxWindowParameters( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams )
 {
-    double tSymbol = 0.0;
+    uint32_t tSymbol = 0;
 
     // Get the datarate, perform a boundary check
     rxConfigParams->Datarate = MIN( datarate, CN470_RX_MAX_DATARATE );
@@ -505,6 +537,14 @@ bool RegionCN470RxConfig( RxConfigParams_t* rxConfig, int8_t* datarate )
 
     Radio.SetChannel( frequency );
 
+    if( rxConfig->RxSlot == RX_SLOT_BEACON )
+    {
+        // Beacons: implicit header without CRC, IQ not inverted
+        Radio.SetRxConfig( MODEM_LORA, rxConfig->Bandwidth, phyDr, 1, 0, 10, rxConfig->WindowTimeout, true, CN470_BEACON_SIZE, false, 0, 0, false, rxConfig->RxContinuous );
+        *datarate = ( uint8_t ) dr;
+        return true;
+    }
+
     // Radio configuration
     Radio.SetRxConfig( MODEM_LORA, rxConfig->Bandwidth, phyDr, 1, 0, 8, rxConfig->WindowTimeout, false, 0, false, 0, 0, true, rxConfig->RxContinuous );
 
@@ -172,6 +172,33 @@
  */
 #define CN470_RX_WND_2_DR                           DR_0
 
+/*!
+ * Class B beacon channels, hopping every beacon period: the channel is
+ * ( beacon time / CN470_BEACON_INTERVAL ) modulo CN470_BEACON_NB_CHANNELS
+ */
+#define CN470_BEACON_CHANNEL_FREQ                   508300000
+#define CN470_BEACON_CHANNEL_STEPWIDTH              200000
+#define CN470_BEACON_NB_CHANNELS                    8
+#define CN470_BEACON_INTERVAL                       128
+
+/*!
+ * Class B beacon channel datarate definition.
+ */
+#define CN470_BEACON_CHANNEL_DR                     DR_2
+
+/*!
+ * Class B beacon frame format: size, size of RFU 1 and of RFU 2
+ */
+#define CN470_BEACON_SIZE                           19
+#define CN470_RFU1_SIZE                             3
+#define CN470_RFU2_SIZE                             1
+
+/*!
+ * Class B default ping slot channel datarate definition. The ping slots
+ * use the beacon channels, offset by the device address.
+ */
+#define CN470_PING_SLOT_CHANNEL_DR                  DR_2
+
 /*!
  * LoRaMac maximum number of bands
  */
@@ -288,6 +288,11 @@ PhyParam_t RegionCN779GetPhyParam( GetPhyParams_t* getPhy )
             phyParam.fValue = CN779_DEFAULT_ANTENNA_GAIN;
             break;
         }
+        case PHY_DEMOD_FLOOR:
+        {
+            phyParam.fValue = RegionCommonComputeDemodFloorLoRa( DataratesCN779[getPhy->Datarate] );
+            break;
+        }
         default:
         {
             break;
@@ -504,7 +509,7 @@ bool RegionCN779AdrNext( AdrNextParams_t* adrNext, int8_t* drOut, int8_t* txPowO
 
 void RegionCN779ComputeRxWindowParameters( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams )
 {
-    double tSymbol = 0.0;
+    uint32_t tSymbol = 0;
 
     // Get the datarate, perform a boundary check
     rxConfigParams->Datarate = MIN( datarate, CN779_RX_MAX_DATARATE );
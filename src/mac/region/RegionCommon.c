@@ -291,20 +291,52 @@ uint8_t RegionCommonLinkAdrReqVerifyParams( RegionCommonLinkAdrReqVerifyParams_t
     return status;
 }
 
-double RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth )
+float RegionCommonComputeDemodFloorLoRa( uint8_t phyDr )
 {
-    return ( ( double )( 1 << phyDr ) / ( double )bandwidth ) * 1000;
+    if( ( phyDr < 6 ) || ( phyDr > 12 ) )
+    {
+        return 0;
+    }
+    // SX1276 datasheet: -5 dB at SF6, 2.5 dB lower per spreading factor
+    return -5.0f - 2.5f * ( phyDr - 6 );
+}
+
+uint32_t RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth )
+{
+    if( bandwidth == 0 )
+    {
+        return 0;
+    }
+    // Exact for the LoRa bandwidths, fits 32 bits up to SF12
+    return ( ( uint32_t )( 1 << phyDr ) * 1000000 ) / bandwidth;
 }
 
-double RegionCommonComputeSymbolTimeFsk( uint8_t phyDr )
+uint32_t RegionCommonComputeSymbolTimeFsk( uint8_t phyDr )
 {
-    return ( 8.0 / ( double )phyDr ); // 1 symbol equals 1 byte
+    if( phyDr == 0 )
+    {
+        return 0;
+    }
+    return ( 8000 / ( uint32_t )phyDr ); // 1 symbol equals 1 byte
 }
 
-void RegionCommonComputeRxWindowParameters( double tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t* windowTimeout, int32_t* windowOffset )
+void RegionCommonComputeRxWindowParameters( uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t* windowTimeout, int32_t* windowOffset )
 {
-    *windowTimeout = MAX( ( uint32_t )ceil( ( ( 2 * minRxSymbols - 8 ) * tSymbol + 2 * rxError ) / tSymbol ), minRxSymbols ); // Computed number of symbols
-    *windowOffset = ( int32_t )ceil( ( 4.0 * tSymbol ) - ( ( *windowTimeout * tSymbol ) / 2.0 ) - wakeUpTime );
+    int32_t timeout = minRxSymbols;
+    int32_t offset = 0;
+
+    if( tSymbol != 0 )
+    {
+        // Computed number of symbols, rxError is in ms and tSymbol in us
+        timeout = ( 2 * minRxSymbols - 8 ) + ( int32_t )( ( 2 * rxError * 1000 + tSymbol - 1 ) / tSymbol );
+        timeout = MAX( timeout, ( int32_t )minRxSymbols );
+    }
+    *windowTimeout = ( uint32_t )timeout;
+
+    // Twice the offset in us: 8 * tSymbol - windowTimeout * tSymbol - 2 * wakeUpTime
+    offset = ( int32_t )( ( 8 - timeout ) * ( int32_t )tSymbol ) - ( int32_t )( wakeUpTime * 2000 );
+    // Rounded up to the next ms
+    *windowOffset = ( offset >= 0 ) ? ( ( offset + 1999 ) / 2000 ) : -( -offset / 2000 );
 }
 
 int8_t RegionCommonComputeTxPower( int8_t txPowerIndex, float maxEirp, float antennaGain )
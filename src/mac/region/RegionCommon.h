@@ -304,6 +304,15 @@ uint8_t RegionCommonParseLinkAdrReq( uint8_t* payload, RegionCommonLinkAdrParams
  */
 uint8_t RegionCommonLinkAdrReqVerifyParams( RegionCommonLinkAdrReqVerifyParams_t* verifyParams, int8_t* dr, int8_t* txPow, uint8_t* nbRep );
 
+/*!
+ * \brief Computes the lowest SNR at which a LoRa frame can be demodulated.
+ *
+ * \param [IN] phyDr Physical datarate to use.
+ *
+ * \retval Returns the demodulation floor in dB, 0 for a non LoRa datarate.
+ */
+float RegionCommonComputeDemodFloorLoRa( uint8_t phyDr );
+
 /*!
  * \brief Computes the symbol time for LoRa modulation.
  *
@@ -311,25 +320,23 @@ uint8_t RegionCommonLinkAdrReqVerifyParams( RegionCommonLinkAdrReqVerifyParams_t
  *
  * \param [IN] bandwidth Bandwidth to use.
  *
- * \retval Returns the symbol time.
+ * \retval Returns the symbol time in microseconds.
  */
-double RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth );
+uint32_t RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidth );
 
 /*!
  * \brief Computes the symbol time for FSK modulation.
  *
- * \param [IN] phyDr Physical datarate to use.
- *
- * \param [IN] bandwidth Bandwidth to use.
+ * \param [IN] phyDr Physical datarate to use, in kbps.
  *
- * \retval Returns the symbol time.
+ * \retval Returns the symbol time in microseconds.
  */
-double RegionCommonComputeSymbolTimeFsk( uint8_t phyDr );
+uint32_t RegionCommonComputeSymbolTimeFsk( uint8_t phyDr );
 
 /*!
  * \brief Computes the RX window timeout and the RX window offset.
  *
- * \param [IN] tSymbol Symbol timeout.
+ * \param [IN] tSymbol Symbol time in microseconds.
  *
  * \param [IN] minRxSymbols Minimum required number of symbols to detect an Rx frame.
  *
@@ -342,7 +349,7 @@ double RegionCommonComputeSymbolTimeFsk( uint8_t phyDr );
  *
  * \param [OUT] windowOffset RX window time offset to be applied to the RX delay.
  */
-void RegionCommonComputeRxWindowParameters( double tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t* windowTimeout, int32_t* windowOffset );
+void RegionCommonComputeRxWindowParameters( uint32_t tSymbol, uint8_t minRxSymbols, uint32_t rxError, uint32_t wakeUpTime, uint32_t* windowTimeout, int32_t* windowOffset );
 
 /*!
  * \brief Computes the txPower, based on the max EIRP and the antenna gain.
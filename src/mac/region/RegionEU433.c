@@ -288,6 +288,11 @@ PhyParam_t RegionEU433GetPhyParam( GetPhyParams_t* getPhy )
             phyParam.fValue = EU433_DEFAULT_ANTENNA_GAIN;
             break;
         }
+        case PHY_DEMOD_FLOOR:
+        {
+            phyParam.fValue = RegionCommonComputeDemodFloorLoRa( DataratesEU433[getPhy->Datarate] );
+            break;
+        }
         default:
         {
             break;
@@ -504,7 +509,7 @@ bool RegionEU433AdrNext( AdrNextParams_t* adrNext, int8_t* drOut, int8_t* txPowO
 
 void RegionEU433ComputeRxWindowParameters( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams )
 {
-    double tSymbol = 0.0;
+    uint32_t tSymbol = 0;
 
     // Get the datarate, perform a boundary check
     rxConfigParams->Datarate = MIN( datarate, EU433_RX_MAX_DATARATE );
@@ -317,6 +317,38 @@ PhyParam_t RegionEU868GetPhyParam( GetPhyParams_t* getPhy )
             phyParam.fValue = EU868_DEFAULT_ANTENNA_GAIN;
             break;
         }
+        case PHY_DEMOD_FLOOR:
+        {
+            phyParam.fValue = RegionCommonComputeDemodFloorLoRa( DataratesEU868[getPhy->Datarate] );
+            break;
+        }
+        case PHY_BEACON_CHANNEL_FREQ:
+        {
+            phyParam.Value = EU868_BEACON_CHANNEL_FREQ;
+            break;
+        }
+        case PHY_BEACON_CHANNEL_DR:
+        {
+            phyParam.Value = EU868_BEACON_CHANNEL_DR;
+            break;
+        }
+        case PHY_BEACON_FORMAT:
+        {
+            phyParam.BeaconFormat.BeaconSize = EU868_BEACON_SIZE;
+            phyParam.BeaconFormat.Rfu1Size = EU868_RFU1_SIZE;
+            phyParam.BeaconFormat.Rfu2Size = EU868_RFU2_SIZE;
+            break;
+        }
+        case PHY_PING_SLOT_CHANNEL_FREQ:
+        {
+            phyParam.Value = EU868_PING_SLOT_CHANNEL_FREQ;
+            break;
+        }
+        case PHY_PING_SLOT_CHANNEL_DR:
+        {
+            phyParam.Value = EU868_PING_SLOT_CHANNEL_DR;
+            break;
+        }
         default:
         {
             break;
@@ -533,7 +565,7 @@ bool RegionEU868AdrNext( AdrNextParams_t* adrNext, int8_t* drOut, int8_t* txPowO
 
 void RegionEU868ComputeRxWindowParameters( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams )
 {
-    double tSymbol = 0.0;
+    uint32_t tSymbol = 0;
 
     // Get the datarate, perform a boundary check
     rxConfigParams->Datarate = MIN( datarate, EU868_RX_MAX_DATARATE );
@@ -580,6 +612,14 @@ bool RegionEU868RxConfig( RxConfigParams_t* rxConfig, int8_t* datarate )
 
     Radio.SetChannel( frequency );
 
+    if( rxConfig->RxSlot == RX_SLOT_BEACON )
+    {
+        // Beacons: implicit header without CRC, IQ not inverted
+        Radio.SetRxConfig( MODEM_LORA, rxConfig->Bandwidth, phyDr, 1, 0, 10, rxConfig->WindowTimeout, true, EU868_BEACON_SIZE, false, 0, 0, false, rxConfig->RxContinuous );
+        *datarate = ( uint8_t ) dr;
+        return true;
+    }
+
     // Radio configuration
     if( dr == DR_7 )
     {
@@ -186,6 +186,33 @@
  */
 #define EU868_RX_WND_2_DR                           DR_0
 
+/*!
+ * Class B beacon channel frequency definition.
+ */
+#define EU868_BEACON_CHANNEL_FREQ                   869525000
+
+/*!
+ * Class B beacon channel datarate definition.
+ */
+#define EU868_BEACON_CHANNEL_DR                     DR_3
+
+/*!
+ * Class B beacon frame format: size, size of RFU 1 and of RFU 2
+ */
+#define EU868_BEACON_SIZE                           17
+#define EU868_RFU1_SIZE                             2
+#define EU868_RFU2_SIZE                             0
+
+/*!
+ * Class B default ping slot channel frequency definition.
+ */
+#define EU868_PING_SLOT_CHANNEL_FREQ                869525000
+
+/*!
+ * Class B default ping slot channel datarate definition.
+ */
+#define EU868_PING_SLOT_CHANNEL_DR                  DR_3
+
 /*!
  * Maximum number of bands
  */
@@ -91,6 +91,15 @@ typedef struct
      * \param [IN] channelDetected    Channel Activity detected during the CAD
      */
     void ( *CadDone ) ( bool channelActivityDetected );
+    /*!
+     * \brief Time of the radio interrupt which raised the event being
+     *        reported [ms], on the TimerGetCurrentTime time base
+     *
+     * \remark Set by the driver before calling one of the callbacks above.
+     *         Captured at the DIO edge on boards timestamping their GPIO
+     *         interrupts, when the driver gets the interrupt otherwise.
+     */
+    uint32_t IrqTime;
 }RadioEvents_t;
 
 /*!
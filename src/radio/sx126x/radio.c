@@ -412,6 +412,11 @@ uint8_t RadioRxPayload[255];
 
 bool IrqFired = false;
 
+/*!
+ * Time of the DIO interrupt, reported with the events of RadioIrqProcess
+ */
+static uint32_t IrqTime = 0;
+
 /*
  * SX126x DIO IRQ callback functions prototype
  */
@@ -1048,6 +1053,7 @@ void RadioOnTxTimeoutIrq( void )
 {
     if( ( RadioEvents != NULL ) && ( RadioEvents->TxTimeout != NULL ) )
     {
+        RadioEvents->IrqTime = TimerGetCurrentTime( );
         RadioEvents->TxTimeout( );
     }
 }
@@ -1056,12 +1062,14 @@ void RadioOnRxTimeoutIrq( void )
 {
     if( ( RadioEvents != NULL ) && ( RadioEvents->RxTimeout != NULL ) )
     {
+        RadioEvents->IrqTime = TimerGetCurrentTime( );
         RadioEvents->RxTimeout( );
     }
 }
 
 void RadioOnDioIrq( void )
 {
+    IrqTime = TimerGetCurrentTime( );
     IrqFired = true;
 }
 
@@ -1076,6 +1084,11 @@ void RadioIrqProcess( void )
         uint16_t irqRegs = SX126xGetIrqStatus( );
         SX126xClearIrqStatus( IRQ_RADIO_ALL );
 
+        if( RadioEvents != NULL )
+        {
+            RadioEvents->IrqTime = IrqTime;
+        }
+
         if( ( irqRegs & IRQ_TX_DONE ) == IRQ_TX_DONE )
         {
             TimerStop( &TxTimeoutTimer );
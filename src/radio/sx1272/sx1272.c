@@ -1189,8 +1189,23 @@ uint32_t SX1272GetWakeupTime( void )
     return SX1272GetBoardTcxoWakeupTime( ) + RADIO_WAKEUP_TIME;
 }
 
+/*!
+ * \brief Sets the time of the event about to be reported
+ *
+ * \param [IN] time Interrupt time [ms]
+ */
+static void SX1272SetIrqTime( uint32_t time )
+{
+    if( RadioEvents != NULL )
+    {
+        RadioEvents->IrqTime = time;
+    }
+}
+
 void SX1272OnTimeoutIrq( void )
 {
+    SX1272SetIrqTime( TimerGetCurrentTime( ) );
+
     switch( SX1272.Settings.State )
     {
     case RF_RX_RUNNING:
@@ -1265,6 +1280,8 @@ void SX1272OnDio0Irq( void )
 {
     volatile uint8_t irqFlags = 0;
 
+    SX1272SetIrqTime( TimerGetCurrentTime( ) );
+
     switch( SX1272.Settings.State )
     {
         case RF_RX_RUNNING:
@@ -1449,6 +1466,8 @@ void SX1272OnDio0Irq( void )
 
 void SX1272OnDio1Irq( void )
 {
+    SX1272SetIrqTime( TimerGetCurrentTime( ) );
+
     switch( SX1272.Settings.State )
     {
         case RF_RX_RUNNING:
@@ -1526,6 +1545,8 @@ void SX1272OnDio1Irq( void )
 
 void SX1272OnDio2Irq( void )
 {
+    SX1272SetIrqTime( TimerGetCurrentTime( ) );
+
     switch( SX1272.Settings.State )
     {
         case RF_RX_RUNNING:
@@ -1596,6 +1617,8 @@ void SX1272OnDio2Irq( void )
 
 void SX1272OnDio3Irq( void )
 {
+    SX1272SetIrqTime( TimerGetCurrentTime( ) );
+
     switch( SX1272.Settings.Modem )
     {
     case MODEM_FSK:
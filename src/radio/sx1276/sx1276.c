@@ -34,6 +34,7 @@
 #include "sx1276.h"
 #include "sx1276-board.h"
 #include "serialio.h"
+#include "energy.h"
 
 /*
  * Local types definition
@@ -299,7 +300,7 @@ bool SX1276IsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh
     while( TimerGetElapsedTime( carrierSenseTime ) < maxCarrierSenseTime )
     {
         rssi = SX1276ReadRssi( modem );
-        printf("Radio.RSSI is %d\n", rssi);
+        log_debug("Radio.RSSI is %d\n", rssi);
 
         if( rssi > rssiThresh )
         {
@@ -1218,6 +1219,30 @@ void SX1276SetOpMode( uint8_t opMode )
         SX1276SetAntSw( opMode );
     }
     SX1276Write( REG_OPMODE, ( SX1276Read( REG_OPMODE ) & RF_OPMODE_MASK ) | opMode );
+
+    switch( opMode )
+    {
+        case RF_OPMODE_SLEEP:
+            EnergySetRadioState( ENERGY_RADIO_SLEEP, 0 );
+            break;
+        case RF_OPMODE_SYNTHESIZER_TX:
+        case RF_OPMODE_SYNTHESIZER_RX:
+            EnergySetRadioState( ENERGY_RADIO_SYNTH, 0 );
+            break;
+        case RF_OPMODE_TRANSMITTER:
+            EnergySetRadioState( ENERGY_RADIO_TX, ( SX1276.Settings.Modem == MODEM_LORA ) ? SX1276.Settings.LoRa.Power : SX1276.Settings.Fsk.Power );
+            break;
+        case RF_OPMODE_RECEIVER:
+        case RFLR_OPMODE_RECEIVER_SINGLE:
+            EnergySetRadioState( ENERGY_RADIO_RX, 0 );
+            break;
+        case RFLR_OPMODE_CAD:
+            EnergySetRadioState( ENERGY_RADIO_CAD, 0 );
+            break;
+        default:
+            EnergySetRadioState( ENERGY_RADIO_STANDBY, 0 );
+            break;
+    }
 }
 
 void SX1276SetModem( RadioModems_t modem )
@@ -1348,13 +1373,60 @@ void SX1276SetPublicNetwork( bool enable )
     }
 }
 
+void SX1276SetLoRaPacketFormat( uint16_t preambleLen, bool fixLen, uint8_t payloadLen, bool crcOn )
+{
+    if( SX1276.Settings.LoRa.PreambleLen != preambleLen )
+    {
+        SX1276.Settings.LoRa.PreambleLen = preambleLen;
+        SX1276Write( REG_LR_PREAMBLEMSB, ( uint8_t )( ( preambleLen >> 8 ) & 0xFF ) );
+        SX1276Write( REG_LR_PREAMBLELSB, ( uint8_t )( preambleLen & 0xFF ) );
+    }
+    if( SX1276.Settings.LoRa.FixLen != fixLen )
+    {
+        SX1276.Settings.LoRa.FixLen = fixLen;
+        SX1276Write( REG_LR_MODEMCONFIG1,
+                     ( SX1276Read( REG_LR_MODEMCONFIG1 ) &
+                       RFLR_MODEMCONFIG1_IMPLICITHEADER_MASK ) |
+                       ( fixLen ? RFLR_MODEMCONFIG1_IMPLICITHEADER_ON : RFLR_MODEMCONFIG1_IMPLICITHEADER_OFF ) );
+    }
+    if( SX1276.Settings.LoRa.CrcOn != crcOn )
+    {
+        SX1276.Settings.LoRa.CrcOn = crcOn;
+        SX1276Write( REG_LR_MODEMCONFIG2,
+                     ( SX1276Read( REG_LR_MODEMCONFIG2 ) &
+                       RFLR_MODEMCONFIG2_RXPAYLOADCRC_MASK ) |
+                       ( crcOn ? RFLR_MODEMCONFIG2_RXPAYLOADCRC_ON : RFLR_MODEMCONFIG2_RXPAYLOADCRC_OFF ) );
+    }
+    if( fixLen == true )
+    {
+        // Also written by SX1276Send, always set for the receptions
+        SX1276.Settings.LoRa.PayloadLen = payloadLen;
+        SX1276Write( REG_LR_PAYLOADLENGTH, payloadLen );
+    }
+}
+
 uint32_t SX1276GetWakeupTime( void )
 {
     return SX1276GetBoardTcxoWakeupTime( ) + RADIO_WAKEUP_TIME;
 }
 
+/*!
+ * \brief Sets the time of the event about to be reported
+ *
+ * \param [IN] time Interrupt time [ms]
+ */
+static void SX1276SetIrqTime( uint32_t time )
+{
+    if( RadioEvents != NULL )
+    {
+        RadioEvents->IrqTime = time;
+    }
+}
+
 void SX1276OnTimeoutIrq( void )
 {
+    SX1276SetIrqTime( TimerGetCurrentTime( ) );
+
     switch( SX1276.Settings.State )
     {
     case RF_RX_RUNNING:
@@ -1432,6 +1504,8 @@ void SX1276OnDio0Irq( void )
 {
     volatile uint8_t irqFlags = 0;
 
+    SX1276SetIrqTime( SX1276GetDioIrqTime( ) );
+
     switch( SX1276.Settings.State )
     {
         case RF_RX_RUNNING:
@@ -1457,6 +1531,7 @@ void SX1276OnDio0Irq( void )
                         {
                             TimerStop( &RxTimeoutSyncWord );
                             SX1276.Settings.State = RF_IDLE;
+                            EnergySetRadioState( ENERGY_RADIO_STANDBY, 0 );
                         }
                         else
                         {
@@ -1503,6 +1578,7 @@ void SX1276OnDio0Irq( void )
                 {
                     SX1276.Settings.State = RF_IDLE;
                     TimerStop( &RxTimeoutSyncWord );
+                    EnergySetRadioState( ENERGY_RADIO_STANDBY, 0 );
                 }
                 else
                 {
@@ -1536,6 +1612,7 @@ void SX1276OnDio0Irq( void )
                         if( SX1276.Settings.LoRa.RxContinuous == false )
                         {
                             SX1276.Settings.State = RF_IDLE;
+                            EnergySetRadioState( ENERGY_RADIO_STANDBY, 0 );
                         }
                         TimerStop( &RxTimeoutTimer );
 
@@ -1592,6 +1669,7 @@ void SX1276OnDio0Irq( void )
                     if( SX1276.Settings.LoRa.RxContinuous == false )
                     {
                         SX1276.Settings.State = RF_IDLE;
+                        EnergySetRadioState( ENERGY_RADIO_STANDBY, 0 );
                     }
                     TimerStop( &RxTimeoutTimer );
 
@@ -1617,6 +1695,7 @@ void SX1276OnDio0Irq( void )
             case MODEM_FSK:
             default:
                 SX1276.Settings.State = RF_IDLE;
+                EnergySetRadioState( ENERGY_RADIO_STANDBY, 0 );
                 if( ( RadioEvents != NULL ) && ( RadioEvents->TxDone != NULL ) )
                 {
                     RadioEvents->TxDone( );
@@ -1631,6 +1710,8 @@ void SX1276OnDio0Irq( void )
 
 void SX1276OnDio1Irq( void )
 {
+    SX1276SetIrqTime( SX1276GetDioIrqTime( ) );
+
     switch( SX1276.Settings.State )
     {
         case RF_RX_RUNNING:
@@ -1669,6 +1750,7 @@ void SX1276OnDio1Irq( void )
                 SX1276Write( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_RXTIMEOUT );
 
                 SX1276.Settings.State = RF_IDLE;
+                EnergySetRadioState( ENERGY_RADIO_STANDBY, 0 );
                 if( ( RadioEvents != NULL ) && ( RadioEvents->RxTimeout != NULL ) )
                 {
                     RadioEvents->RxTimeout( );
@@ -1708,6 +1790,8 @@ void SX1276OnDio1Irq( void )
 
 void SX1276OnDio2Irq( void )
 {
+    SX1276SetIrqTime( SX1276GetDioIrqTime( ) );
+
     switch( SX1276.Settings.State )
     {
         case RF_RX_RUNNING:
@@ -1778,11 +1862,15 @@ void SX1276OnDio2Irq( void )
 
 void SX1276OnDio3Irq( void )
 {
+    SX1276SetIrqTime( SX1276GetDioIrqTime( ) );
+
     switch( SX1276.Settings.Modem )
     {
     case MODEM_FSK:
         break;
     case MODEM_LORA:
+        // CAD done, the radio is back in standby
+        EnergySetRadioState( ENERGY_RADIO_STANDBY, 0 );
         if( ( SX1276Read( REG_LR_IRQFLAGS ) & RFLR_IRQFLAGS_CADDETECTED ) == RFLR_IRQFLAGS_CADDETECTED )
         {
             // Clear Irq
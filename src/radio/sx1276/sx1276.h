@@ -416,6 +416,21 @@ void SX1276SetMaxPayloadLength( RadioModems_t modem, uint8_t max );
  */
 void SX1276SetPublicNetwork( bool enable );
 
+/*!
+ * \brief Changes the LoRa packet format set by SX1276SetTxConfig and
+ *        SX1276SetRxConfig, the modulation is kept
+ *
+ * \remark Only the registers of the changed fields are written, switching
+ *         between two formats takes a few SPI accesses instead of a full
+ *         configuration. The radio must be in sleep or standby mode.
+ *
+ * \param [IN] preambleLen Preamble length [symbols]
+ * \param [IN] fixLen      Fixed length packets [0: variable, 1: fixed]
+ * \param [IN] payloadLen  Payload length when fixed length is used
+ * \param [IN] crcOn       Enables/Disables the CRC [0: OFF, 1: ON]
+ */
+void SX1276SetLoRaPacketFormat( uint16_t preambleLen, bool fixLen, uint8_t payloadLen, bool crcOn );
+
 /*!
  * \brief Gets the time required for the board plus radio to get out of sleep.[ms]
  *
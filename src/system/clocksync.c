@@ -0,0 +1,168 @@
+/*!
+ * \file      clocksync.c
+ *
+ * \brief     RTC discipline on the GPS PPS signal
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include "board.h"
+#include "clocksync.h"
+
+/*!
+ * PPS edge kept for the frequency error estimation
+ */
+typedef struct sClockSyncEdge
+{
+    TimerTime_t Time;       //! Timer time of the edge
+    uint32_t Second;        //! Number of seconds since the first edge
+}ClockSyncEdge_t;
+
+static ClockSyncEdge_t History[CLOCKSYNC_HISTORY_SIZE];
+static uint8_t HistoryHead = 0;     //! Index of the newest edge
+static uint8_t HistoryCount = 0;
+
+/*!
+ * Latest PPS edge
+ */
+static ClockSyncEdge_t LastEdge;
+static bool LastEdgeValid = false;
+
+static bool Locked = false;
+static int32_t DriftPpb = 0;
+static int32_t OffsetUs = 0;
+
+/*!
+ * \brief Forgets the kept edges, the frequency error estimate is kept
+ */
+static void ClockSyncRestartHistory( TimerTime_t ppsTime )
+{
+    LastEdge.Time = ppsTime;
+    LastEdge.Second = 0;
+    LastEdgeValid = true;
+
+    History[0] = LastEdge;
+    HistoryHead = 0;
+    HistoryCount = 1;
+    OffsetUs = 0;
+}
+
+void ClockSyncInit( void )
+{
+    BoardDisableIrq( );
+    LastEdgeValid = false;
+    HistoryCount = 0;
+    Locked = false;
+    DriftPpb = 0;
+    OffsetUs = 0;
+    BoardEnableIrq( );
+}
+
+void ClockSyncOnPps( TimerTime_t ppsTime )
+{
+    uint32_t elapsed;
+    uint32_t seconds;
+    int32_t residual;
+    ClockSyncEdge_t *oldest;
+    uint32_t baseline;
+
+    if( LastEdgeValid == false )
+    {
+        ClockSyncRestartHistory( ppsTime );
+        return;
+    }
+
+    elapsed = ppsTime - LastEdge.Time;
+    seconds = ( elapsed + 500 ) / 1000;
+    if( seconds == 0 )
+    {   // glitch on the PPS line
+        return;
+    }
+
+    // Deviation from the time predicted with the current frequency error
+    residual = ( int32_t )( elapsed - seconds * 1000 ) - ( int32_t )( ( ( int64_t )seconds * DriftPpb ) / 1000000 );
+    if( ( residual > CLOCKSYNC_MAX_JITTER ) || ( residual < -CLOCKSYNC_MAX_JITTER ) )
+    {
+        ClockSyncRestartHistory( ppsTime );
+        return;
+    }
+    OffsetUs += ( residual * 1000 - OffsetUs ) / ( 1 << CLOCKSYNC_FILTER_SHIFT );
+
+    LastEdge.Time = ppsTime;
+    LastEdge.Second += seconds;
+
+    if( ( LastEdge.Second - History[HistoryHead].Second ) >= CLOCKSYNC_HISTORY_STEP )
+    {
+        HistoryHead = ( HistoryHead + 1 ) % CLOCKSYNC_HISTORY_SIZE;
+        History[HistoryHead] = LastEdge;
+        if( HistoryCount < CLOCKSYNC_HISTORY_SIZE )
+        {
+            HistoryCount++;
+        }
+    }
+
+    oldest = &History[( HistoryHead + CLOCKSYNC_HISTORY_SIZE + 1 - HistoryCount ) % CLOCKSYNC_HISTORY_SIZE];
+    baseline = LastEdge.Second - oldest->Second;
+    if( baseline >= CLOCKSYNC_MIN_BASELINE )
+    {
+        // error [ms] over baseline [s] gives the frequency error [ppm * 1000]
+        int32_t error = ( int32_t )( ( LastEdge.Time - oldest->Time ) - baseline * 1000 );
+        int32_t estimate = ( int32_t )( ( ( int64_t )error * 1000000 ) / baseline );
+
+        if( Locked == false )
+        {
+            DriftPpb = estimate;
+            Locked = true;
+        }
+        else
+        {
+            DriftPpb += ( estimate - DriftPpb ) / ( 1 << CLOCKSYNC_FILTER_SHIFT );
+        }
+    }
+}
+
+bool ClockSyncIsLocked( void )
+{
+    return Locked;
+}
+
+int32_t ClockSyncGetDrift( void )
+{
+    return DriftPpb;
+}
+
+int32_t ClockSyncGetOffset( void )
+{
+    return OffsetUs;
+}
+
+TimerTime_t ClockSyncCorrectTimeout( TimerTime_t timeout )
+{
+    int64_t correction;
+
+    if( Locked == false )
+    {
+        return timeout;
+    }
+    // Rounded to the nearest ms
+    correction = ( int64_t )timeout * DriftPpb;
+    correction += ( correction >= 0 ) ? 500000000 : -500000000;
+    correction /= 1000000000;
+    if( ( correction < 0 ) && ( ( TimerTime_t )( -correction ) >= timeout ) )
+    {
+        return 1;
+    }
+    return timeout + ( int32_t )correction;
+}
@@ -0,0 +1,105 @@
+/*!
+ * \file      clocksync.h
+ *
+ * \brief     RTC discipline on the GPS PPS signal
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * Every PPS edge is timestamped with the RTC. The frequency error of the RTC
+ * is estimated over a baseline of up to CLOCKSYNC_HISTORY_SIZE *
+ * CLOCKSYNC_HISTORY_STEP seconds, which hides the millisecond resolution of
+ * the timestamps, and smoothed by a first order filter. Once locked, the
+ * timeouts given to TimerSetValue are corrected by the estimated error, and
+ * the correction is kept when the PPS is lost.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __CLOCKSYNC_H__
+#define __CLOCKSYNC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+
+/*!
+ * Number of PPS edges kept to estimate the frequency error
+ */
+#define CLOCKSYNC_HISTORY_SIZE                      16
+
+/*!
+ * Number of seconds between two kept PPS edges
+ */
+#define CLOCKSYNC_HISTORY_STEP                      64
+
+/*!
+ * Shortest baseline giving a usable frequency error [s]
+ */
+#define CLOCKSYNC_MIN_BASELINE                      64
+
+/*!
+ * Largest deviation of a PPS edge from its predicted time [ms]
+ *
+ * \remark Larger deviations restart the estimation, e.g. after the PPS
+ *         trigger edge has been inverted.
+ */
+#define CLOCKSYNC_MAX_JITTER                        5
+
+/*!
+ * Weight of a new estimate in the filter, 1 / 2^CLOCKSYNC_FILTER_SHIFT
+ */
+#define CLOCKSYNC_FILTER_SHIFT                      2
+
+/*!
+ * \brief Restarts the clock discipline, the frequency error is forgotten
+ */
+void ClockSyncInit( void );
+
+/*!
+ * \brief Feeds a PPS edge to the clock discipline
+ *
+ * \param [IN] ppsTime Timer time of the edge
+ */
+void ClockSyncOnPps( TimerTime_t ppsTime );
+
+/*!
+ * \brief Indicates if a frequency error estimate is available
+ *
+ * \retval locked
+ */
+bool ClockSyncIsLocked( void );
+
+/*!
+ * \brief Gets the frequency error of the RTC
+ *
+ * \retval drift Frequency error [ppb], positive when the RTC runs fast
+ */
+int32_t ClockSyncGetDrift( void );
+
+/*!
+ * \brief Gets the filtered phase offset of the PPS edges from their
+ *        predicted time
+ *
+ * \retval offset Offset [us], positive when the edges come late
+ */
+int32_t ClockSyncGetOffset( void );
+
+/*!
+ * \brief Converts a duration into the RTC time it takes
+ *
+ * \param [IN] timeout Duration [ms]
+ * \retval timeout     Duration measured by the RTC [ms]
+ */
+TimerTime_t ClockSyncCorrectTimeout( TimerTime_t timeout );
+
+#endif // __CLOCKSYNC_H__
@@ -0,0 +1,384 @@
+/*!
+ * \file      deltapatch.c
+ *
+ * \brief     In-place delta patch applier of the firmware image
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include "utilities.h"
+#include "deltapatch.h"
+
+/*!
+ * Progress words
+ */
+#define PROGRESS_STATE                              0   // magic, state and step
+#define PROGRESS_OFFSET                             1   // operation of the block, PROGRESS_IDLE
+#define PROGRESS_NEXT_OFFSET                        2   // operation of the next block, PROGRESS_SCRATCH
+
+#define PROGRESS_MAGIC                              0xA5
+
+/*!
+ * Progress states
+ */
+#define PROGRESS_IDLE                               1   // the block of the step is to be built
+#define PROGRESS_SCRATCH                            2   // the block of the step is in the scratch area
+
+#define PROGRESS_STATE_WORD( state, step )          ( ( ( uint32_t )PROGRESS_MAGIC << 24 ) | ( ( uint32_t )( state ) << 16 ) | ( step ) )
+
+/*!
+ * Patch header
+ */
+typedef struct sDeltaPatchHeader
+{
+    uint32_t Magic;
+    uint32_t PatchSize;
+    uint32_t PatchCrc;
+    uint32_t OldSize;
+    uint32_t OldCrc;
+    uint32_t NewSize;
+    uint32_t NewCrc;
+    uint16_t BlockSize;
+    uint16_t Flags;
+}DeltaPatchHeader_t;
+
+/*!
+ * Block operation result
+ */
+typedef enum eDeltaPatchOpStatus
+{
+    OP_OK = 0,
+    OP_INVALID,
+    OP_IO_ERROR,
+}DeltaPatchOpStatus_t;
+
+static DeltaPatchCallbacks_t *Callbacks;
+static DeltaPatchHeader_t Header;
+static uint8_t Block[DELTA_PATCH_BLOCK_SIZE];
+
+uint32_t DeltaPatchCrc32( uint32_t crc, const uint8_t *data, uint32_t size )
+{
+    crc = ~crc;
+    while( size-- )
+    {
+        crc ^= *data++;
+        for( uint8_t i = 0; i < 8; i++ )
+        {
+            crc = ( crc >> 1 ) ^ ( 0xEDB88320 & -( crc & 0x01 ) );
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t GetLe( const uint8_t *buffer, uint8_t size )
+{
+    uint32_t value = 0;
+
+    while( size-- )
+    {
+        value = ( value << 8 ) | buffer[size];
+    }
+    return value;
+}
+
+static bool ReadHeader( void )
+{
+    uint8_t buffer[DELTA_PATCH_HEADER_SIZE];
+
+    Header.Magic = 0;
+    if( Callbacks->PatchRead( 0, buffer, DELTA_PATCH_HEADER_SIZE ) != 0 )
+    {
+        return false;
+    }
+    Header.Magic = GetLe( buffer, 4 );
+    Header.PatchSize = GetLe( buffer + 4, 4 );
+    Header.PatchCrc = GetLe( buffer + 8, 4 );
+    Header.OldSize = GetLe( buffer + 12, 4 );
+    Header.OldCrc = GetLe( buffer + 16, 4 );
+    Header.NewSize = GetLe( buffer + 20, 4 );
+    Header.NewCrc = GetLe( buffer + 24, 4 );
+    Header.BlockSize = GetLe( buffer + 28, 2 );
+    Header.Flags = GetLe( buffer + 30, 2 );
+
+    return ( Header.Magic == DELTA_PATCH_MAGIC ) &&
+           ( Header.BlockSize == DELTA_PATCH_BLOCK_SIZE ) &&
+           ( Header.OldSize <= Callbacks->ImageMaxSize ) &&
+           ( Header.NewSize <= Callbacks->ImageMaxSize ) &&
+           ( Header.NewSize > 0 ) &&
+           ( ( ( Header.NewSize + DELTA_PATCH_BLOCK_SIZE - 1 ) / DELTA_PATCH_BLOCK_SIZE ) <= 0xFFFF );
+}
+
+static uint16_t GetNbBlocks( void )
+{
+    return ( Header.NewSize + DELTA_PATCH_BLOCK_SIZE - 1 ) / DELTA_PATCH_BLOCK_SIZE;
+}
+
+/*!
+ * \brief Gets the block rebuilt by an update step
+ */
+static uint16_t GetBlock( uint16_t step )
+{
+    if( ( Header.Flags & DELTA_PATCH_FLAG_DESCENDING ) != 0 )
+    {
+        return GetNbBlocks( ) - 1 - step;
+    }
+    return step;
+}
+
+/*!
+ * \brief Computes the CRC32 of a memory by chunks of Block
+ */
+static bool ComputeCrc( int8_t ( *read )( uint32_t offset, uint8_t *data, uint32_t size ),
+                        uint32_t offset, uint32_t size, uint32_t *crc )
+{
+    uint32_t chunk;
+
+    *crc = 0;
+    while( size > 0 )
+    {
+        chunk = MIN( size, DELTA_PATCH_BLOCK_SIZE );
+        if( read( offset, Block, chunk ) != 0 )
+        {
+            return false;
+        }
+        *crc = DeltaPatchCrc32( *crc, Block, chunk );
+        offset += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+/*!
+ * \brief Reads the bytes of an operation, checking the patch bounds
+ */
+static DeltaPatchOpStatus_t ReadOp( uint32_t *offset, uint8_t *data, uint32_t size )
+{
+    if( ( *offset + size ) > ( DELTA_PATCH_HEADER_SIZE + Header.PatchSize ) )
+    {
+        return OP_INVALID;
+    }
+    if( ( data != NULL ) && ( Callbacks->PatchRead( *offset, data, size ) != 0 ) )
+    {
+        return OP_IO_ERROR;
+    }
+    *offset += size;
+    return OP_OK;
+}
+
+/*!
+ * \brief Builds a new block from its operation
+ *
+ * \param [IN]    block  Index of the new block
+ * \param [INOUT] offset Offset of the operation in the patch, updated to the next one
+ * \param [OUT]   data   Block content, NULL to only check the operation
+ */
+static DeltaPatchOpStatus_t BuildBlock( uint16_t block, uint32_t *offset, uint8_t *data )
+{
+    DeltaPatchOpStatus_t status;
+    uint8_t buffer[3];
+    uint32_t src;
+    uint16_t pos = 0;
+    uint8_t op;
+    uint8_t nbRuns;
+
+    if( ( status = ReadOp( offset, &op, 1 ) ) != OP_OK )
+    {
+        return status;
+    }
+
+    if( op == DELTA_PATCH_OP_LITERAL )
+    {
+        return ReadOp( offset, data, DELTA_PATCH_BLOCK_SIZE );
+    }
+    if( ( op != DELTA_PATCH_OP_COPY ) && ( op != DELTA_PATCH_OP_DIFF ) )
+    {
+        return OP_INVALID;
+    }
+
+    if( ( status = ReadOp( offset, buffer, 3 ) ) != OP_OK )
+    {
+        return status;
+    }
+    src = GetLe( buffer, 3 );
+    // the source must not have been overwritten by the previous blocks
+    if( ( Header.Flags & DELTA_PATCH_FLAG_DESCENDING ) != 0 )
+    {
+        if( src > ( ( uint32_t )block * DELTA_PATCH_BLOCK_SIZE ) )
+        {
+            return OP_INVALID;
+        }
+    }
+    else if( src < ( ( uint32_t )block * DELTA_PATCH_BLOCK_SIZE ) )
+    {
+        return OP_INVALID;
+    }
+    if( ( src + DELTA_PATCH_BLOCK_SIZE ) > Header.OldSize )
+    {
+        return OP_INVALID;
+    }
+    if( ( data != NULL ) && ( Callbacks->ImageRead( src, data, DELTA_PATCH_BLOCK_SIZE ) != 0 ) )
+    {
+        return OP_IO_ERROR;
+    }
+
+    if( op == DELTA_PATCH_OP_COPY )
+    {
+        return OP_OK;
+    }
+
+    if( ( status = ReadOp( offset, &nbRuns, 1 ) ) != OP_OK )
+    {
+        return status;
+    }
+    while( nbRuns-- )
+    {
+        if( ( status = ReadOp( offset, buffer, 2 ) ) != OP_OK )
+        {
+            return status;
+        }
+        pos += buffer[0];
+        if( ( pos + buffer[1] ) > DELTA_PATCH_BLOCK_SIZE )
+        {
+            return OP_INVALID;
+        }
+        if( ( status = ReadOp( offset, ( data != NULL ) ? data + pos : NULL, buffer[1] ) ) != OP_OK )
+        {
+            return status;
+        }
+        pos += buffer[1];
+    }
+    return OP_OK;
+}
+
+/*!
+ * \brief Checks the patch applies to the running image before touching it
+ */
+static bool CheckPatch( void )
+{
+    uint32_t offset = DELTA_PATCH_HEADER_SIZE;
+    uint32_t crc;
+
+    if( ( ComputeCrc( Callbacks->PatchRead, DELTA_PATCH_HEADER_SIZE, Header.PatchSize, &crc ) == false ) ||
+        ( crc != Header.PatchCrc ) )
+    {
+        return false;
+    }
+    if( ( ComputeCrc( Callbacks->ImageRead, 0, Header.OldSize, &crc ) == false ) ||
+        ( crc != Header.OldCrc ) )
+    {
+        return false;
+    }
+    for( uint16_t step = 0; step < GetNbBlocks( ); step++ )
+    {
+        if( BuildBlock( GetBlock( step ), &offset, NULL ) != OP_OK )
+        {
+            return false;
+        }
+    }
+    return offset == ( DELTA_PATCH_HEADER_SIZE + Header.PatchSize );
+}
+
+static bool WriteProgress( uint8_t state, uint16_t step, uint8_t offsetIndex, uint32_t offset )
+{
+    // the offset is not used in the current state, the state word commits
+    return ( Callbacks->ProgressWrite( offsetIndex, offset ) == 0 ) &&
+           ( Callbacks->ProgressWrite( PROGRESS_STATE, PROGRESS_STATE_WORD( state, step ) ) == 0 );
+}
+
+static DeltaPatchStatus_t Finish( DeltaPatchStatus_t status )
+{
+    Callbacks->ProgressWrite( PROGRESS_STATE, 0 );
+    Callbacks->PatchClear( );
+    return status;
+}
+
+DeltaPatchStatus_t DeltaPatchApply( DeltaPatchCallbacks_t *callbacks )
+{
+    uint32_t state;
+    uint16_t step = 0;
+    uint32_t offset = DELTA_PATCH_HEADER_SIZE;
+    uint32_t next;
+    uint32_t crc;
+
+    Callbacks = callbacks;
+    state = Callbacks->ProgressRead( PROGRESS_STATE );
+
+    if( ( state >> 24 ) == PROGRESS_MAGIC )
+    { // interrupted update
+        if( ReadHeader( ) == false )
+        {
+            return Finish( DELTA_PATCH_ERROR_IMAGE );
+        }
+        step = state & 0xFFFF;
+        if( ( ( state >> 16 ) & 0xFF ) == PROGRESS_SCRATCH )
+        {
+            next = Callbacks->ProgressRead( PROGRESS_NEXT_OFFSET );
+            if( ( Callbacks->ScratchRead( Block, DELTA_PATCH_BLOCK_SIZE ) != 0 ) ||
+                ( Callbacks->ImageWrite( ( uint32_t )GetBlock( step ) * DELTA_PATCH_BLOCK_SIZE, Block, DELTA_PATCH_BLOCK_SIZE ) != 0 ) ||
+                ( WriteProgress( PROGRESS_IDLE, step + 1, PROGRESS_OFFSET, next ) == false ) )
+            {
+                return DELTA_PATCH_ERROR_IMAGE;
+            }
+            step++;
+        }
+        offset = Callbacks->ProgressRead( PROGRESS_OFFSET );
+    }
+    else
+    {
+        if( ReadHeader( ) == false )
+        {
+            return ( Header.Magic == DELTA_PATCH_MAGIC ) ? Finish( DELTA_PATCH_ERROR_PATCH ) : DELTA_PATCH_NONE;
+        }
+        if( CheckPatch( ) == false )
+        {
+            return Finish( DELTA_PATCH_ERROR_PATCH );
+        }
+        if( WriteProgress( PROGRESS_IDLE, 0, PROGRESS_OFFSET, offset ) == false )
+        {
+            return DELTA_PATCH_ERROR_IMAGE;
+        }
+    }
+
+    for( ; step < GetNbBlocks( ); step++ )
+    {
+        next = offset;
+        switch( BuildBlock( GetBlock( step ), &next, Block ) )
+        {
+            case OP_OK:
+                break;
+            case OP_INVALID:
+                return Finish( DELTA_PATCH_ERROR_IMAGE );
+            default:
+                return DELTA_PATCH_ERROR_IMAGE;
+        }
+        if( ( Callbacks->ScratchWrite( Block, DELTA_PATCH_BLOCK_SIZE ) != 0 ) ||
+            ( WriteProgress( PROGRESS_SCRATCH, step, PROGRESS_NEXT_OFFSET, next ) == false ) ||
+            ( Callbacks->ImageWrite( ( uint32_t )GetBlock( step ) * DELTA_PATCH_BLOCK_SIZE, Block, DELTA_PATCH_BLOCK_SIZE ) != 0 ) ||
+            ( WriteProgress( PROGRESS_IDLE, step + 1, PROGRESS_OFFSET, next ) == false ) )
+        {
+            return DELTA_PATCH_ERROR_IMAGE;
+        }
+        offset = next;
+    }
+
+    if( ( ComputeCrc( Callbacks->ImageRead, 0, Header.NewSize, &crc ) == false ) ||
+        ( crc != Header.NewCrc ) )
+    {
+        return Finish( DELTA_PATCH_ERROR_IMAGE );
+    }
+    return Finish( DELTA_PATCH_DONE );
+}
@@ -0,0 +1,173 @@
+/*!
+ * \file      deltapatch.h
+ *
+ * \brief     In-place delta patch applier of the firmware image
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * The new image is described block by block, DELTA_PATCH_BLOCK_SIZE bytes
+ * each, as a function of the running image. All values are little endian.
+ *
+ * Header, DELTA_PATCH_HEADER_SIZE bytes:
+ *
+ *     Magic     uint32  DELTA_PATCH_MAGIC
+ *     PatchSize uint32  size of the operations following the header
+ *     PatchCrc  uint32  CRC32 of the operations
+ *     OldSize   uint32  size of the image the patch applies to
+ *     OldCrc    uint32  CRC32 of that image
+ *     NewSize   uint32  size of the patched image
+ *     NewCrc    uint32  CRC32 of the patched image
+ *     BlockSize uint16  DELTA_PATCH_BLOCK_SIZE
+ *     Flags     uint16  DELTA_PATCH_FLAG_*
+ *
+ * Then one operation per new block i, in increasing order of i, or decreasing
+ * with DELTA_PATCH_FLAG_DESCENDING:
+ *
+ *     DELTA_PATCH_OP_COPY    Src uint24                  old bytes Src to Src + BlockSize
+ *     DELTA_PATCH_OP_LITERAL Data[BlockSize]
+ *     DELTA_PATCH_OP_DIFF    Src uint24, NbRuns uint8,   old bytes Src to Src + BlockSize,
+ *                            NbRuns * { Skip uint8,      Len bytes replaced Skip bytes after
+ *                                       Len uint8,       the end of the previous run
+ *                                       Data[Len] }
+ *
+ * The new block i overwrites the old block i, so Src must be at least
+ * i * BlockSize, or at most i * BlockSize in decreasing order: the bytes an
+ * operation reads are never overwritten before. Code moved towards the end of
+ * the image, after an insertion, is rebuilt in decreasing order. The
+ * generator, tools/deltapatch.py, picks the order giving the smallest patch.
+ *
+ * Every block is first written to a scratch area, then to the image. The
+ * progress is recorded in 3 words of non volatile memory, each step ending
+ * with a single word write, so the update resumes where it stopped after a
+ * reset or a power failure.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __DELTAPATCH_H__
+#define __DELTAPATCH_H__
+
+#include <stdint.h>
+
+/*!
+ * Size of an image block [bytes], the flash page size
+ */
+#ifndef DELTA_PATCH_BLOCK_SIZE
+#define DELTA_PATCH_BLOCK_SIZE                      256
+#endif
+
+#define DELTA_PATCH_MAGIC                           0x31504C44  // "DLP1"
+#define DELTA_PATCH_HEADER_SIZE                     32
+
+/*!
+ * The blocks are rebuilt from the last one
+ */
+#define DELTA_PATCH_FLAG_DESCENDING                 0x0001
+
+/*!
+ * Block operations
+ */
+#define DELTA_PATCH_OP_COPY                         0x00
+#define DELTA_PATCH_OP_LITERAL                      0x01
+#define DELTA_PATCH_OP_DIFF                         0x02
+
+/*!
+ * Number of progress words
+ */
+#define DELTA_PATCH_PROGRESS_SIZE                   3
+
+/*!
+ * Update result
+ */
+typedef enum eDeltaPatchStatus
+{
+    /*!
+     * No patch pending
+     */
+    DELTA_PATCH_NONE = 0,
+    /*!
+     * The image has been patched
+     */
+    DELTA_PATCH_DONE,
+    /*!
+     * The patch is corrupted or doesn't apply to the image, which is untouched
+     */
+    DELTA_PATCH_ERROR_PATCH,
+    /*!
+     * The image could not be written or doesn't match the expected CRC
+     */
+    DELTA_PATCH_ERROR_IMAGE,
+}DeltaPatchStatus_t;
+
+/*!
+ * Memories used by the update, all functions return 0 on success
+ */
+typedef struct sDeltaPatchCallbacks
+{
+    /*!
+     * Maximum image size [bytes]
+     */
+    uint32_t ImageMaxSize;
+    /*!
+     * \brief Reads the patch, header included
+     */
+    int8_t ( *PatchRead )( uint32_t offset, uint8_t *data, uint32_t size );
+    /*!
+     * \brief Invalidates the patch once applied or rejected
+     */
+    int8_t ( *PatchClear )( void );
+    /*!
+     * \brief Reads the image
+     */
+    int8_t ( *ImageRead )( uint32_t offset, uint8_t *data, uint32_t size );
+    /*!
+     * \brief Erases and writes an image block
+     */
+    int8_t ( *ImageWrite )( uint32_t offset, uint8_t *data, uint32_t size );
+    /*!
+     * \brief Erases and writes the scratch block
+     */
+    int8_t ( *ScratchWrite )( uint8_t *data, uint32_t size );
+    /*!
+     * \brief Reads the scratch block
+     */
+    int8_t ( *ScratchRead )( uint8_t *data, uint32_t size );
+    /*!
+     * \brief Reads a progress word, 0 when never written
+     */
+    uint32_t ( *ProgressRead )( uint8_t index );
+    /*!
+     * \brief Writes a progress word, the write of a word must be atomic
+     */
+    int8_t ( *ProgressWrite )( uint8_t index, uint32_t value );
+}DeltaPatchCallbacks_t;
+
+/*!
+ * \brief Applies the pending patch, or resumes an interrupted update
+ *
+ * \param [IN] callbacks Memories used by the update
+ * \retval status        Update result
+ */
+DeltaPatchStatus_t DeltaPatchApply( DeltaPatchCallbacks_t *callbacks );
+
+/*!
+ * \brief Computes the CRC32 used by the patch, IEEE 802.3 polynomial
+ *
+ * \param [IN] crc  CRC of the previous data, 0 to start
+ * \param [IN] data Data
+ * \param [IN] size Data size
+ * \retval crc      Updated CRC
+ */
+uint32_t DeltaPatchCrc32( uint32_t crc, const uint8_t *data, uint32_t size );
+
+#endif // __DELTAPATCH_H__
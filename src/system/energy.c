@@ -0,0 +1,217 @@
+/*!
+ * \file      energy.c
+ *
+ * \brief     Per-state energy accounting
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <stdio.h>
+#include "board.h"
+#include "utilities.h"
+#include "energy.h"
+
+/*
+ * Default currents [uA], typical STM32L0 and SX1276 datasheet values, used
+ * when EnergyInit gets no profile.
+ */
+#ifndef ENERGY_CURRENT_BASE
+#define ENERGY_CURRENT_BASE                         0
+#endif
+#ifndef ENERGY_CURRENT_MCU_RUN
+#define ENERGY_CURRENT_MCU_RUN                      4500
+#endif
+#ifndef ENERGY_CURRENT_MCU_SLEEP
+#define ENERGY_CURRENT_MCU_SLEEP                    1000
+#endif
+#ifndef ENERGY_CURRENT_MCU_STOP
+#define ENERGY_CURRENT_MCU_STOP                     1
+#endif
+#ifndef ENERGY_CURRENT_RADIO_SLEEP
+#define ENERGY_CURRENT_RADIO_SLEEP                  0
+#endif
+#ifndef ENERGY_CURRENT_RADIO_STANDBY
+#define ENERGY_CURRENT_RADIO_STANDBY                1600
+#endif
+#ifndef ENERGY_CURRENT_RADIO_SYNTH
+#define ENERGY_CURRENT_RADIO_SYNTH                  5800
+#endif
+#ifndef ENERGY_CURRENT_RADIO_RX
+#define ENERGY_CURRENT_RADIO_RX                     11500
+#endif
+#ifndef ENERGY_CURRENT_RADIO_CAD
+#define ENERGY_CURRENT_RADIO_CAD                    11500
+#endif
+#ifndef ENERGY_CURRENT_RADIO_TX
+#define ENERGY_CURRENT_RADIO_TX                     { { 7, 20000 }, { 13, 29000 }, { 17, 87000 }, { 20, 120000 } }
+#endif
+
+static const EnergyTxLevel_t DefaultTxLevels[] = ENERGY_CURRENT_RADIO_TX;
+
+static const EnergyProfile_t DefaultProfile =
+{
+    .Base = ENERGY_CURRENT_BASE,
+    .Mcu = { ENERGY_CURRENT_MCU_RUN, ENERGY_CURRENT_MCU_SLEEP, ENERGY_CURRENT_MCU_STOP },
+    .Radio = { ENERGY_CURRENT_RADIO_SLEEP, ENERGY_CURRENT_RADIO_STANDBY, ENERGY_CURRENT_RADIO_SYNTH,
+               ENERGY_CURRENT_RADIO_RX, ENERGY_CURRENT_RADIO_CAD, 0 },
+    .TxLevels = DefaultTxLevels,
+    .TxLevelsCount = sizeof( DefaultTxLevels ) / sizeof( EnergyTxLevel_t ),
+};
+
+static const EnergyProfile_t *Profile = &DefaultProfile;
+static EnergyStats_t Stats;
+static TimerTime_t StartTime = 0;
+static TimerTime_t LastUpdate = 0;
+static EnergyMcuState_t McuState = ENERGY_MCU_RUN;
+static EnergyRadioState_t RadioState = ENERGY_RADIO_SLEEP;
+static uint32_t RadioStateCurrent = ENERGY_CURRENT_RADIO_SLEEP;
+
+static uint32_t EnergyGetTxCurrent( int8_t power )
+{
+    if( Profile->TxLevelsCount == 0 )
+    {
+        return 0;
+    }
+    for( uint8_t i = 0; i < Profile->TxLevelsCount; i++ )
+    {
+        if( power <= Profile->TxLevels[i].Power )
+        {
+            return Profile->TxLevels[i].Current;
+        }
+    }
+    return Profile->TxLevels[Profile->TxLevelsCount - 1].Current;
+}
+
+/*!
+ * \brief Accounts the time elapsed in the current states
+ *
+ * \remark Called with the interrupts disabled
+ */
+static void EnergyUpdate( void )
+{
+    TimerTime_t now = TimerGetCurrentTime( );
+    TimerTime_t elapsed = now - LastUpdate;
+
+    LastUpdate = now;
+    Stats.Elapsed = now - StartTime;
+    Stats.McuTime[McuState] += elapsed;
+    Stats.McuCharge[McuState] += ( uint64_t )elapsed * Profile->Mcu[McuState];
+    Stats.RadioTime[RadioState] += elapsed;
+    Stats.RadioCharge[RadioState] += ( uint64_t )elapsed * RadioStateCurrent;
+    Stats.BaseCharge += ( uint64_t )elapsed * Profile->Base;
+}
+
+static uint64_t EnergyGetTotalCharge( const EnergyStats_t *stats )
+{
+    uint64_t charge = stats->BaseCharge;
+
+    for( uint8_t i = 0; i < ENERGY_MCU_STATE_COUNT; i++ )
+    {
+        charge += stats->McuCharge[i];
+    }
+    for( uint8_t i = 0; i < ENERGY_RADIO_STATE_COUNT; i++ )
+    {
+        charge += stats->RadioCharge[i];
+    }
+    return charge;
+}
+
+void EnergyInit( const EnergyProfile_t *profile )
+{
+    BoardDisableIrq( );
+    Profile = ( profile != NULL ) ? profile : &DefaultProfile;
+    memset1( ( uint8_t* )&Stats, 0, sizeof( Stats ) );
+    StartTime = TimerGetCurrentTime( );
+    LastUpdate = StartTime;
+    McuState = ENERGY_MCU_RUN;
+    RadioState = ENERGY_RADIO_SLEEP;
+    RadioStateCurrent = Profile->Radio[ENERGY_RADIO_SLEEP];
+    BoardEnableIrq( );
+}
+
+void EnergySetMcuState( EnergyMcuState_t state )
+{
+    BoardDisableIrq( );
+    EnergyUpdate( );
+    McuState = state;
+    BoardEnableIrq( );
+}
+
+void EnergySetRadioState( EnergyRadioState_t state, int8_t power )
+{
+    BoardDisableIrq( );
+    EnergyUpdate( );
+    RadioState = state;
+    RadioStateCurrent = ( state == ENERGY_RADIO_TX ) ? EnergyGetTxCurrent( power ) : Profile->Radio[state];
+    BoardEnableIrq( );
+}
+
+void EnergyGetStats( EnergyStats_t *stats )
+{
+    BoardDisableIrq( );
+    EnergyUpdate( );
+    *stats = Stats;
+    BoardEnableIrq( );
+}
+
+uint32_t EnergyGetAverageCurrent( void )
+{
+    EnergyStats_t stats;
+
+    EnergyGetStats( &stats );
+    if( stats.Elapsed == 0 )
+    {
+        return 0;
+    }
+    return ( uint32_t )( EnergyGetTotalCharge( &stats ) / stats.Elapsed );
+}
+
+uint32_t EnergyGetLifetime( uint32_t capacity )
+{
+    uint32_t current = EnergyGetAverageCurrent( );
+
+    if( current == 0 )
+    {
+        return 0;
+    }
+    // capacity [mAh] * 1000 / current [uA] gives hours
+    return ( uint32_t )( ( ( uint64_t )capacity * 1000 ) / current );
+}
+
+void EnergyPrintStats( void )
+{
+    static const char *mcuNames[ENERGY_MCU_STATE_COUNT] = { "run", "sleep", "stop" };
+    static const char *radioNames[ENERGY_RADIO_STATE_COUNT] = { "sleep", "stdby", "synth", "rx", "cad", "tx" };
+    EnergyStats_t stats;
+    uint64_t total;
+
+    EnergyGetStats( &stats );
+    total = EnergyGetTotalCharge( &stats );
+
+    // charges are printed in uAh
+    printf( "energy %lums %luuAh avg %luuA\n", ( unsigned long )stats.Elapsed,
+            ( unsigned long )( total / 3600000 ),
+            ( unsigned long )( ( stats.Elapsed > 0 ) ? total / stats.Elapsed : 0 ) );
+    for( uint8_t i = 0; i < ENERGY_MCU_STATE_COUNT; i++ )
+    {
+        printf( " mcu %s %lums %luuAh\n", mcuNames[i], ( unsigned long )stats.McuTime[i],
+                ( unsigned long )( stats.McuCharge[i] / 3600000 ) );
+    }
+    for( uint8_t i = 0; i < ENERGY_RADIO_STATE_COUNT; i++ )
+    {
+        printf( " radio %s %lums %luuAh\n", radioNames[i], ( unsigned long )stats.RadioTime[i],
+                ( unsigned long )( stats.RadioCharge[i] / 3600000 ) );
+    }
+}
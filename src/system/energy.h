@@ -0,0 +1,150 @@
+/*!
+ * \file      energy.h
+ *
+ * \brief     Per-state energy accounting
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * The radio driver reports its operating mode changes and the low power
+ * handler reports the MCU mode changes. The time spent in each state is
+ * multiplied by the current drawn in that state, which gives the charge used
+ * by the node. The currents are given by the application to EnergyInit,
+ * usually from the ENERGY_CURRENT_* definitions of its board-config.h, the
+ * defaults are typical STM32L0 and SX1276 values.
+ *
+ * tools/energyproj.py projects the battery life of other output powers,
+ * spreading factors and duty cycles from the ledger of EnergyPrintStats.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __ENERGY_H__
+#define __ENERGY_H__
+
+#include <stdint.h>
+#include "timer.h"
+
+/*!
+ * MCU states
+ */
+typedef enum eEnergyMcuState
+{
+    ENERGY_MCU_RUN = 0,
+    ENERGY_MCU_SLEEP,
+    ENERGY_MCU_STOP,
+    ENERGY_MCU_STATE_COUNT,
+}EnergyMcuState_t;
+
+/*!
+ * Radio states
+ */
+typedef enum eEnergyRadioState
+{
+    ENERGY_RADIO_SLEEP = 0,
+    ENERGY_RADIO_STANDBY,
+    ENERGY_RADIO_SYNTH,
+    ENERGY_RADIO_RX,
+    ENERGY_RADIO_CAD,
+    ENERGY_RADIO_TX,
+    ENERGY_RADIO_STATE_COUNT,
+}EnergyRadioState_t;
+
+/*!
+ * Current drawn while transmitting at a given power
+ */
+typedef struct sEnergyTxLevel
+{
+    int8_t Power;       //! Output power [dBm]
+    uint32_t Current;   //! Current [uA]
+}EnergyTxLevel_t;
+
+/*!
+ * Currents drawn in every state [uA]
+ */
+typedef struct sEnergyProfile
+{
+    uint32_t Base;                                  //! Always drawn by the board
+    uint32_t Mcu[ENERGY_MCU_STATE_COUNT];
+    uint32_t Radio[ENERGY_RADIO_STATE_COUNT];       //! ENERGY_RADIO_TX given by TxLevels
+    /*!
+     * TX current table, sorted by increasing power. A power is accounted with
+     * the first entry at or above it.
+     */
+    const EnergyTxLevel_t *TxLevels;
+    uint8_t TxLevelsCount;
+}EnergyProfile_t;
+
+/*!
+ * Time spent and charge used in every state since EnergyInit
+ */
+typedef struct sEnergyStats
+{
+    TimerTime_t Elapsed;                            //! [ms]
+    TimerTime_t McuTime[ENERGY_MCU_STATE_COUNT];    //! [ms]
+    TimerTime_t RadioTime[ENERGY_RADIO_STATE_COUNT];//! [ms]
+    uint64_t McuCharge[ENERGY_MCU_STATE_COUNT];     //! [uA.ms]
+    uint64_t RadioCharge[ENERGY_RADIO_STATE_COUNT]; //! [uA.ms]
+    uint64_t BaseCharge;                            //! [uA.ms]
+}EnergyStats_t;
+
+/*!
+ * \brief Restarts the accounting, the MCU is running and the radio sleeping
+ *
+ * \param [IN] profile Currents of the board, kept by the accounting. NULL
+ *                     for the default ones.
+ */
+void EnergyInit( const EnergyProfile_t *profile );
+
+/*!
+ * \brief Reports an MCU state change
+ *
+ * \param [IN] state New MCU state
+ */
+void EnergySetMcuState( EnergyMcuState_t state );
+
+/*!
+ * \brief Reports a radio state change
+ *
+ * \param [IN] state New radio state
+ * \param [IN] power Output power [dBm], only used by ENERGY_RADIO_TX
+ */
+void EnergySetRadioState( EnergyRadioState_t state, int8_t power );
+
+/*!
+ * \brief Gets the accounting up to now
+ *
+ * \param [OUT] stats Time and charge of every state
+ */
+void EnergyGetStats( EnergyStats_t *stats );
+
+/*!
+ * \brief Gets the average current drawn since EnergyInit
+ *
+ * \retval current Average current [uA]
+ */
+uint32_t EnergyGetAverageCurrent( void );
+
+/*!
+ * \brief Projects the battery life at the average current drawn so far
+ *
+ * \param [IN] capacity Battery capacity [mAh]
+ * \retval lifetime     Battery life [h], 0 when nothing has been measured yet
+ */
+uint32_t EnergyGetLifetime( uint32_t capacity );
+
+/*!
+ * \brief Prints the time and charge of every state on the serial port
+ */
+void EnergyPrintStats( void );
+
+#endif // __ENERGY_H__
@@ -0,0 +1,376 @@
+/*!
+ * \file      fragdecoder.c
+ *
+ * \brief     Erasure decoder of the fragmented data block transport
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <stddef.h>
+#include "utilities.h"
+#include "fragdecoder.h"
+
+#define FRAG_DECODER_BITMAP_SIZE                    ( ( FRAG_DECODER_MAX_NB_FRAGMENTS + 7 ) / 8 )
+
+#define FRAG_DECODER_MATRIX_ROW_SIZE                ( ( FRAG_DECODER_MAX_REDUNDANCY + 7 ) / 8 )
+
+/*!
+ * Data block being decoded
+ */
+static uint16_t FragNb;
+static uint8_t FragSize;
+static FragDecoderCallbacks_t *Callbacks = NULL;
+
+/*!
+ * Uncoded fragments received, frozen once the coded fragments start
+ */
+static uint8_t FragReceived[FRAG_DECODER_BITMAP_SIZE];
+static uint16_t FragNbRxUncoded;
+static bool CodingStarted;
+
+/*!
+ * Missing fragment of each matrix column, in increasing order
+ */
+static uint16_t MissingIndex[FRAG_DECODER_MAX_REDUNDANCY];
+
+/*!
+ * Row of the matrix whose leading bit is column c, valid when bit c of
+ * MatrixRows is set. The row data is stored at the place of MissingIndex[c].
+ */
+static uint8_t Matrix[FRAG_DECODER_MAX_REDUNDANCY][FRAG_DECODER_MATRIX_ROW_SIZE];
+static uint8_t MatrixRows[FRAG_DECODER_MATRIX_ROW_SIZE];
+static uint16_t MatrixRank;
+
+static uint8_t ParityRow[FRAG_DECODER_BITMAP_SIZE];
+static uint8_t RowBits[FRAG_DECODER_MATRIX_ROW_SIZE];
+static uint8_t RowData[FRAG_DECODER_MAX_FRAGMENT_SIZE];
+static uint8_t PivotData[FRAG_DECODER_MAX_FRAGMENT_SIZE];
+
+static FragDecoderStatus_t Status;
+static int32_t Result;
+
+static bool BitGet( const uint8_t *bits, uint16_t i )
+{
+    return ( bits[i >> 3] & ( 1 << ( i & 0x07 ) ) ) != 0;
+}
+
+static void BitSet( uint8_t *bits, uint16_t i )
+{
+    bits[i >> 3] |= 1 << ( i & 0x07 );
+}
+
+static void XorBuffer( uint8_t *dst, const uint8_t *src, uint16_t size )
+{
+    while( size-- )
+    {
+        *dst++ ^= *src++;
+    }
+}
+
+/*!
+ * \brief Pseudo random generator of the parity matrix
+ */
+static uint32_t Prbs23( uint32_t x )
+{
+    uint32_t b0 = x & 0x01;
+    uint32_t b1 = ( x & 0x20 ) >> 5;
+
+    return ( x >> 1 ) + ( ( b0 ^ b1 ) << 22 );
+}
+
+static bool IsPowerOfTwo( uint32_t x )
+{
+    return ( x != 0 ) && ( ( x & ( x - 1 ) ) == 0 );
+}
+
+void FragDecoderGetParityMatrixRow( uint16_t n, uint16_t fragNb, uint8_t *row )
+{
+    uint32_t m = IsPowerOfTwo( fragNb ) ? 1 : 0;
+    uint32_t x = 1 + ( 1001 * ( uint32_t )n );
+    uint32_t r;
+
+    memset1( row, 0, ( fragNb + 7 ) / 8 );
+    for( uint16_t nbCoeff = 0; nbCoeff < ( fragNb / 2 ); nbCoeff++ )
+    {
+        r = 1UL << 16;
+        while( r >= fragNb )
+        {
+            x = Prbs23( x );
+            r = x % ( fragNb + m );
+        }
+        BitSet( row, r );
+    }
+}
+
+static int32_t FragDecoderFinish( int32_t result )
+{
+    Result = result;
+    return Result;
+}
+
+/*!
+ * \brief Freezes the received uncoded fragments and sizes the matrix
+ *
+ * \retval status FRAG_DECODER_ONGOING while the matrix has to be solved
+ */
+static int32_t FragDecoderStartCoding( void )
+{
+    CodingStarted = true;
+    Status.FragNbLost = FragNb - FragNbRxUncoded;
+    Status.FragNbMissing = Status.FragNbLost;
+
+    if( Status.FragNbLost == 0 )
+    {
+        return FragDecoderFinish( 0 );
+    }
+    if( Status.FragNbLost > FRAG_DECODER_MAX_REDUNDANCY )
+    {
+        Status.MatrixError = true;
+        return FragDecoderFinish( FRAG_DECODER_ERROR );
+    }
+
+    for( uint16_t i = 0, c = 0; i < FragNb; i++ )
+    {
+        if( BitGet( FragReceived, i ) == false )
+        {
+            MissingIndex[c++] = i;
+        }
+    }
+    return FRAG_DECODER_ONGOING;
+}
+
+/*!
+ * \brief Solves the missing fragments once the matrix has full rank
+ *
+ * \remark Matrix is upper triangular, each row is cleared of the columns
+ *         above its pivot starting from the last one.
+ */
+static int32_t FragDecoderSolve( void )
+{
+    uint32_t addr;
+
+    for( int16_t c = Status.FragNbLost - 1; c >= 0; c-- )
+    {
+        addr = ( uint32_t )MissingIndex[c] * FragSize;
+        if( Callbacks->Read( addr, RowData, FragSize ) != 0 )
+        {
+            return FragDecoderFinish( FRAG_DECODER_ERROR );
+        }
+        for( uint16_t j = c + 1; j < Status.FragNbLost; j++ )
+        {
+            if( BitGet( Matrix[c], j ) == true )
+            {
+                if( Callbacks->Read( ( uint32_t )MissingIndex[j] * FragSize, PivotData, FragSize ) != 0 )
+                {
+                    return FragDecoderFinish( FRAG_DECODER_ERROR );
+                }
+                XorBuffer( RowData, PivotData, FragSize );
+            }
+        }
+        if( Callbacks->Write( addr, RowData, FragSize ) != 0 )
+        {
+            return FragDecoderFinish( FRAG_DECODER_ERROR );
+        }
+    }
+    Status.FragNbMissing = 0;
+    return FragDecoderFinish( Status.FragNbLost );
+}
+
+/*!
+ * \brief Adds the row held by RowBits and RowData to the matrix
+ */
+static int32_t FragDecoderAddRow( void )
+{
+    uint16_t c;
+
+    // forward elimination, the row only keeps columns without pivot
+    for( c = 0; c < Status.FragNbLost; c++ )
+    {
+        if( ( BitGet( RowBits, c ) == false ) || ( BitGet( MatrixRows, c ) == false ) )
+        {
+            continue;
+        }
+        if( Callbacks->Read( ( uint32_t )MissingIndex[c] * FragSize, PivotData, FragSize ) != 0 )
+        {
+            return FragDecoderFinish( FRAG_DECODER_ERROR );
+        }
+        XorBuffer( RowData, PivotData, FragSize );
+        XorBuffer( RowBits, Matrix[c], FRAG_DECODER_MATRIX_ROW_SIZE );
+    }
+
+    for( c = 0; c < Status.FragNbLost; c++ )
+    {
+        if( BitGet( RowBits, c ) == true )
+        {
+            break;
+        }
+    }
+    if( c == Status.FragNbLost )
+    { // linearly dependent, nothing new
+        return FRAG_DECODER_ONGOING;
+    }
+
+    if( Callbacks->Write( ( uint32_t )MissingIndex[c] * FragSize, RowData, FragSize ) != 0 )
+    {
+        return FragDecoderFinish( FRAG_DECODER_ERROR );
+    }
+    memcpy1( Matrix[c], RowBits, FRAG_DECODER_MATRIX_ROW_SIZE );
+    BitSet( MatrixRows, c );
+    MatrixRank++;
+    Status.FragNbMissing = Status.FragNbLost - MatrixRank;
+
+    if( MatrixRank == Status.FragNbLost )
+    {
+        return FragDecoderSolve( );
+    }
+    return FRAG_DECODER_ONGOING;
+}
+
+/*!
+ * \brief Turns a coded fragment into a row over the missing fragments
+ */
+static int32_t FragDecoderProcessCoded( uint16_t n, uint8_t *rawData )
+{
+    uint16_t c = 0;
+
+    FragDecoderGetParityMatrixRow( n, FragNb, ParityRow );
+    memcpy1( RowData, rawData, FragSize );
+    memset1( RowBits, 0, FRAG_DECODER_MATRIX_ROW_SIZE );
+
+    for( uint16_t i = 0; i < FragNb; i++ )
+    {
+        if( BitGet( FragReceived, i ) == false )
+        {
+            if( BitGet( ParityRow, i ) == true )
+            {
+                BitSet( RowBits, c );
+            }
+            c++;
+        }
+        else if( BitGet( ParityRow, i ) == true )
+        {
+            if( Callbacks->Read( ( uint32_t )i * FragSize, PivotData, FragSize ) != 0 )
+            {
+                return FragDecoderFinish( FRAG_DECODER_ERROR );
+            }
+            XorBuffer( RowData, PivotData, FragSize );
+        }
+    }
+    return FragDecoderAddRow( );
+}
+
+/*!
+ * \brief Turns an uncoded fragment received late into a unit row
+ */
+static int32_t FragDecoderProcessLate( uint16_t index, uint8_t *rawData )
+{
+    uint16_t c;
+
+    for( c = 0; c < Status.FragNbLost; c++ )
+    {
+        if( MissingIndex[c] == index )
+        {
+            break;
+        }
+    }
+    if( c == Status.FragNbLost )
+    { // already received before the coded fragments
+        return FRAG_DECODER_ONGOING;
+    }
+    memcpy1( RowData, rawData, FragSize );
+    memset1( RowBits, 0, FRAG_DECODER_MATRIX_ROW_SIZE );
+    BitSet( RowBits, c );
+    return FragDecoderAddRow( );
+}
+
+bool FragDecoderInit( uint16_t fragNb, uint8_t fragSize, FragDecoderCallbacks_t *callbacks )
+{
+    if( ( fragNb == 0 ) || ( fragNb > FRAG_DECODER_MAX_NB_FRAGMENTS ) ||
+        ( fragSize == 0 ) || ( fragSize > FRAG_DECODER_MAX_FRAGMENT_SIZE ) ||
+        ( callbacks == NULL ) || ( callbacks->Read == NULL ) || ( callbacks->Write == NULL ) )
+    {
+        Callbacks = NULL;
+        return false;
+    }
+
+    FragNb = fragNb;
+    FragSize = fragSize;
+    Callbacks = callbacks;
+
+    memset1( FragReceived, 0, sizeof( FragReceived ) );
+    memset1( MatrixRows, 0, sizeof( MatrixRows ) );
+    memset1( ( uint8_t* )&Status, 0, sizeof( Status ) );
+    FragNbRxUncoded = 0;
+    CodingStarted = false;
+    MatrixRank = 0;
+    Status.FragNbMissing = fragNb;
+    Result = FRAG_DECODER_ONGOING;
+    return true;
+}
+
+int32_t FragDecoderProcess( uint16_t fragCounter, uint8_t *rawData )
+{
+    uint16_t index = fragCounter - 1;
+
+    if( ( Callbacks == NULL ) || ( fragCounter == 0 ) )
+    {
+        return FRAG_DECODER_ERROR;
+    }
+    if( Result != FRAG_DECODER_ONGOING )
+    {
+        return Result;
+    }
+
+    Status.FragNbRx++;
+    Status.FragNbLastRx = fragCounter;
+
+    if( fragCounter > FragNb )
+    {
+        if( CodingStarted == false )
+        {
+            if( FragDecoderStartCoding( ) != FRAG_DECODER_ONGOING )
+            {
+                return Result;
+            }
+        }
+        return FragDecoderProcessCoded( fragCounter - FragNb, rawData );
+    }
+
+    if( CodingStarted == true )
+    {
+        return FragDecoderProcessLate( index, rawData );
+    }
+    if( BitGet( FragReceived, index ) == true )
+    {
+        return FRAG_DECODER_ONGOING;
+    }
+    if( Callbacks->Write( ( uint32_t )index * FragSize, rawData, FragSize ) != 0 )
+    {
+        return FragDecoderFinish( FRAG_DECODER_ERROR );
+    }
+    BitSet( FragReceived, index );
+    FragNbRxUncoded++;
+    Status.FragNbMissing = FragNb - FragNbRxUncoded;
+    if( FragNbRxUncoded == FragNb )
+    {
+        return FragDecoderFinish( 0 );
+    }
+    return FRAG_DECODER_ONGOING;
+}
+
+FragDecoderStatus_t FragDecoderGetStatus( void )
+{
+    return Status;
+}
@@ -0,0 +1,152 @@
+/*!
+ * \file      fragdecoder.h
+ *
+ * \brief     Erasure decoder of the fragmented data block transport
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * A data block of N fragments is sent as the N uncoded fragments followed by
+ * coded fragments, each one the XOR of about N/2 uncoded fragments picked by
+ * the parity matrix of the LoRaWAN fragmented data block transport
+ * specification. Any N received fragments, plus a few more, rebuild the block.
+ *
+ * The uncoded fragments are written to their place in the storage. Once the
+ * coded fragments start, the missing ones are solved by a Gaussian
+ * elimination over GF(2) run fragment by fragment. The elimination matrix only
+ * spans the missing fragments, and the row data is kept in the storage at the
+ * place of the missing fragments, so the RAM used is bounded by
+ * FRAG_DECODER_MAX_REDUNDANCY^2 / 8 bytes plus two fragment buffers,
+ * whatever the block size.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __FRAGDECODER_H__
+#define __FRAGDECODER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Maximum number of fragments of a data block
+ */
+#ifndef FRAG_DECODER_MAX_NB_FRAGMENTS
+#define FRAG_DECODER_MAX_NB_FRAGMENTS               512
+#endif
+
+/*!
+ * Maximum size of a fragment [bytes]
+ */
+#ifndef FRAG_DECODER_MAX_FRAGMENT_SIZE
+#define FRAG_DECODER_MAX_FRAGMENT_SIZE              64
+#endif
+
+/*!
+ * Maximum number of lost uncoded fragments which can be rebuilt
+ */
+#ifndef FRAG_DECODER_MAX_REDUNDANCY
+#define FRAG_DECODER_MAX_REDUNDANCY                 32
+#endif
+
+/*!
+ * FragDecoderProcess return value while the data block is not complete
+ */
+#define FRAG_DECODER_ONGOING                        ( -1 )
+
+/*!
+ * FragDecoderProcess return value when the data block can't be rebuilt
+ */
+#define FRAG_DECODER_ERROR                          ( -2 )
+
+/*!
+ * Storage of the data block
+ *
+ * \remark The fragments are written at their final place, a missing fragment
+ *         place is used as scratch area until the fragment is solved.
+ */
+typedef struct sFragDecoderCallbacks
+{
+    /*!
+     * \brief Writes data to the storage
+     *
+     * \param [IN] addr Offset in the data block
+     * \param [IN] data Data to write
+     * \param [IN] size Number of bytes
+     * \retval status   0 on success
+     */
+    int8_t ( *Write )( uint32_t addr, uint8_t *data, uint32_t size );
+    /*!
+     * \brief Reads data from the storage
+     *
+     * \param [IN]  addr Offset in the data block
+     * \param [OUT] data Read data
+     * \param [IN]  size Number of bytes
+     * \retval status    0 on success
+     */
+    int8_t ( *Read )( uint32_t addr, uint8_t *data, uint32_t size );
+}FragDecoderCallbacks_t;
+
+/*!
+ * Decoding progress
+ */
+typedef struct sFragDecoderStatus
+{
+    uint16_t FragNbRx;          //! Number of fragments received, coded ones included
+    uint16_t FragNbLastRx;      //! Counter of the last fragment received
+    uint16_t FragNbLost;        //! Number of uncoded fragments lost
+    uint16_t FragNbMissing;     //! Number of uncoded fragments not rebuilt yet
+    bool MatrixError;           //! Too many fragments lost for the matrix memory
+}FragDecoderStatus_t;
+
+/*!
+ * \brief Starts the decoding of a data block
+ *
+ * \param [IN] fragNb    Number of uncoded fragments
+ * \param [IN] fragSize  Size of a fragment [bytes]
+ * \param [IN] callbacks Storage of the data block
+ * \retval status        false when the block does not fit the decoder limits
+ */
+bool FragDecoderInit( uint16_t fragNb, uint8_t fragSize, FragDecoderCallbacks_t *callbacks );
+
+/*!
+ * \brief Feeds a fragment to the decoder
+ *
+ * \param [IN] fragCounter Fragment counter, 1 to fragNb for the uncoded
+ *                         fragments, above for the coded ones
+ * \param [IN] rawData     Fragment data, fragSize bytes
+ * \retval status          FRAG_DECODER_ONGOING, FRAG_DECODER_ERROR or, once
+ *                         the block is complete, the number of uncoded
+ *                         fragments which were lost
+ */
+int32_t FragDecoderProcess( uint16_t fragCounter, uint8_t *rawData );
+
+/*!
+ * \brief Gets the decoding progress
+ *
+ * \retval status Decoding progress
+ */
+FragDecoderStatus_t FragDecoderGetStatus( void );
+
+/*!
+ * \brief Computes a row of the parity matrix
+ *
+ * \remark The encoder XORs the uncoded fragments whose bit is set to build
+ *         the coded fragment fragNb + n.
+ *
+ * \param [IN]  n      Index of the coded fragment, from 1
+ * \param [IN]  fragNb Number of uncoded fragments
+ * \param [OUT] row    Bit i set when fragment i + 1 is used, ( fragNb + 7 ) / 8 bytes
+ */
+void FragDecoderGetParityMatrixRow( uint16_t n, uint16_t fragNb, uint8_t *row );
+
+#endif // __FRAGDECODER_H__
@@ -0,0 +1,258 @@
+/*!
+ * \file      fragsession.c
+ *
+ * \brief     Fragmented data block transport session
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include "utilities.h"
+#include "fragsession.h"
+
+/*!
+ * Fragmentation package identifier and version
+ */
+#define FRAG_SESSION_PACKAGE_ID                     3
+#define FRAG_SESSION_PACKAGE_VERSION                1
+
+/*!
+ * Fragmentation package commands
+ */
+#define FRAG_SESSION_PACKAGE_VERSION_REQ            0x00
+#define FRAG_SESSION_STATUS_REQ                     0x01
+#define FRAG_SESSION_SETUP_REQ                      0x02
+#define FRAG_SESSION_DELETE_REQ                     0x03
+#define FRAG_SESSION_DATA_FRAGMENT                  0x08
+
+/*!
+ * FragSessionSetupAns status bits
+ */
+#define FRAG_SESSION_SETUP_ENCODING_UNSUPPORTED     0x01
+#define FRAG_SESSION_SETUP_NOT_ENOUGH_MEMORY        0x02
+#define FRAG_SESSION_SETUP_INDEX_UNSUPPORTED        0x04
+
+/*!
+ * FragSessionDeleteAns status bits
+ */
+#define FRAG_SESSION_DELETE_NO_SESSION              0x04
+
+/*!
+ * FragSessionStatusAns status bits
+ */
+#define FRAG_SESSION_STATUS_NOT_ENOUGH_MEMORY       0x01
+
+/*!
+ * Only supported fragmentation matrix
+ */
+#define FRAG_SESSION_MATRIX_PARITY                  0
+
+static FragDecoderCallbacks_t *Callbacks = NULL;
+static void ( *OnDone )( FragSessionStatus_t status, uint32_t size ) = NULL;
+
+/*!
+ * Session parameters
+ */
+static bool SessionActive = false;
+static bool SessionDone = false;
+static uint8_t SessionIndex;
+static uint16_t SessionNbFrag;
+static uint8_t SessionFragSize;
+static uint8_t SessionPadding;
+
+static void FragSessionDone( int32_t result )
+{
+    SessionDone = true;
+    if( OnDone != NULL )
+    {
+        if( result < 0 )
+        {
+            OnDone( FRAG_SESSION_STATUS_ERROR, 0 );
+        }
+        else
+        {
+            OnDone( FRAG_SESSION_STATUS_OK, ( uint32_t )SessionNbFrag * SessionFragSize - SessionPadding );
+        }
+    }
+}
+
+void FragSessionInit( FragDecoderCallbacks_t *callbacks, void ( *onDone )( FragSessionStatus_t status, uint32_t size ) )
+{
+    Callbacks = callbacks;
+    OnDone = onDone;
+    SessionActive = false;
+    SessionDone = false;
+}
+
+uint8_t FragSessionProcess( const uint8_t *buffer, uint8_t size, uint8_t *answer, uint8_t maxAnswerSize )
+{
+    uint8_t index = 0;
+    uint8_t answerSize = 0;
+
+    while( index < size )
+    {
+        switch( buffer[index++] )
+        {
+            case FRAG_SESSION_PACKAGE_VERSION_REQ:
+            {
+                if( ( answerSize + 3 ) <= maxAnswerSize )
+                {
+                    answer[answerSize++] = FRAG_SESSION_PACKAGE_VERSION_REQ;
+                    answer[answerSize++] = FRAG_SESSION_PACKAGE_ID;
+                    answer[answerSize++] = FRAG_SESSION_PACKAGE_VERSION;
+                }
+                break;
+            }
+            case FRAG_SESSION_STATUS_REQ:
+            {
+                FragDecoderStatus_t status;
+                bool allParticipants;
+                uint8_t fragIndex;
+
+                if( ( index + 1 ) > size )
+                {
+                    return answerSize;
+                }
+                allParticipants = ( buffer[index] & 0x01 ) != 0;
+                fragIndex = ( buffer[index] >> 1 ) & 0x03;
+                index++;
+
+                if( ( SessionActive == false ) || ( fragIndex != SessionIndex ) )
+                {
+                    break;
+                }
+                status = FragDecoderGetStatus( );
+                if( ( allParticipants == false ) && ( status.FragNbMissing == 0 ) )
+                {
+                    break;
+                }
+                if( ( answerSize + 5 ) <= maxAnswerSize )
+                {
+                    answer[answerSize++] = FRAG_SESSION_STATUS_REQ;
+                    answer[answerSize++] = status.FragNbRx & 0xFF;
+                    answer[answerSize++] = ( ( status.FragNbRx >> 8 ) & 0x3F ) | ( fragIndex << 6 );
+                    answer[answerSize++] = MIN( status.FragNbMissing, 255 );
+                    answer[answerSize++] = ( status.MatrixError == true ) ? FRAG_SESSION_STATUS_NOT_ENOUGH_MEMORY : 0;
+                }
+                break;
+            }
+            case FRAG_SESSION_SETUP_REQ:
+            {
+                uint8_t fragIndex;
+                uint16_t nbFrag;
+                uint8_t fragSize;
+                uint8_t control;
+                uint8_t status = 0;
+
+                // FragSession, NbFrag, FragSize, Control, Padding, Descriptor
+                if( ( index + 10 ) > size )
+                {
+                    return answerSize;
+                }
+                fragIndex = ( buffer[index] >> 4 ) & 0x03;
+                nbFrag = ( uint16_t )buffer[index + 1] | ( ( uint16_t )buffer[index + 2] << 8 );
+                fragSize = buffer[index + 3];
+                control = buffer[index + 4];
+
+                if( fragIndex != 0 )
+                {
+                    status |= FRAG_SESSION_SETUP_INDEX_UNSUPPORTED;
+                }
+                if( ( ( control >> 3 ) & 0x07 ) != FRAG_SESSION_MATRIX_PARITY )
+                {
+                    status |= FRAG_SESSION_SETUP_ENCODING_UNSUPPORTED;
+                }
+                if( ( status == 0 ) && ( FragDecoderInit( nbFrag, fragSize, Callbacks ) == false ) )
+                {
+                    status |= FRAG_SESSION_SETUP_NOT_ENOUGH_MEMORY;
+                }
+                if( status == 0 )
+                {
+                    SessionActive = true;
+                    SessionDone = false;
+                    SessionIndex = fragIndex;
+                    SessionNbFrag = nbFrag;
+                    SessionFragSize = fragSize;
+                    SessionPadding = buffer[index + 5];
+                }
+                index += 10;
+
+                if( ( answerSize + 2 ) <= maxAnswerSize )
+                {
+                    answer[answerSize++] = FRAG_SESSION_SETUP_REQ;
+                    answer[answerSize++] = status | ( fragIndex << 6 );
+                }
+                break;
+            }
+            case FRAG_SESSION_DELETE_REQ:
+            {
+                uint8_t fragIndex;
+                uint8_t status = 0;
+
+                if( ( index + 1 ) > size )
+                {
+                    return answerSize;
+                }
+                fragIndex = buffer[index++] & 0x03;
+
+                if( ( SessionActive == false ) || ( fragIndex != SessionIndex ) )
+                {
+                    status |= FRAG_SESSION_DELETE_NO_SESSION;
+                }
+                else
+                {
+                    SessionActive = false;
+                }
+                if( ( answerSize + 2 ) <= maxAnswerSize )
+                {
+                    answer[answerSize++] = FRAG_SESSION_DELETE_REQ;
+                    answer[answerSize++] = status | fragIndex;
+                }
+                break;
+            }
+            case FRAG_SESSION_DATA_FRAGMENT:
+            {
+                uint16_t indexAndN;
+                int32_t result;
+
+                // the fragment takes the rest of the payload
+                if( ( index + 2 ) > size )
+                {
+                    return answerSize;
+                }
+                indexAndN = ( uint16_t )buffer[index] | ( ( uint16_t )buffer[index + 1] << 8 );
+                index += 2;
+
+                if( ( SessionActive == true ) && ( SessionDone == false ) &&
+                    ( ( indexAndN >> 14 ) == SessionIndex ) && ( ( size - index ) >= SessionFragSize ) )
+                {
+                    result = FragDecoderProcess( indexAndN & 0x3FFF, ( uint8_t* )&buffer[index] );
+                    if( result != FRAG_DECODER_ONGOING )
+                    {
+                        FragSessionDone( result );
+                    }
+                }
+                return answerSize;
+            }
+            default:
+            {
+                // unknown command, the rest can't be parsed
+                return answerSize;
+            }
+        }
+    }
+    return answerSize;
+}
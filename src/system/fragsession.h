@@ -0,0 +1,87 @@
+/*!
+ * \file      fragsession.h
+ *
+ * \brief     Fragmented data block transport session
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *               _______ _____ _____ _   _  _____ _    _ _    _
+ *              |__   __/ ____|_   _| \ | |/ ____| |  | | |  | |  /\
+ *                 | | | (___   | | |  \| | |  __| |__| | |  | | /  \
+ *                 | |  \___ \  | | | . ` | | |_ |  __  | |  | |/ /\ \
+ *                 | |  ____) |_| |_| |\  | |__| | |  | | |__| / ____ \
+ *                 |_| |_____/|_____|_| \_|\_____|_|  |_|\____/_/    \_\
+ *              (C)2017-2018 Tsinghua
+ *
+ * \endcode
+ *
+ * Commands of the LoRaWAN fragmented data block transport package on
+ * FRAG_SESSION_PORT. The server sets up a session with a unicast
+ * FragSessionSetupReq, then sends the data fragments, usually on a Class C
+ * multicast channel, see LoRaMacMulticastChannelLink. The fragments are fed
+ * to the erasure decoder of fragdecoder.h, so the block is rebuilt without
+ * asking for the lost fragments again.
+ *
+ * Usage, from the McpsIndication callback of the application:
+ *
+ * \code
+ * if( ( mcpsIndication->RxData == true ) && ( mcpsIndication->Port == FRAG_SESSION_PORT ) )
+ * {
+ *     AppDataSize = FragSessionProcess( mcpsIndication->Buffer, mcpsIndication->BufferSize,
+ *                                       AppData, LORAWAN_APP_DATA_MAX_SIZE );
+ *     // AppDataSize > 0: send AppData on FRAG_SESSION_PORT
+ * }
+ * \endcode
+ *
+ * \remark Only one session, FragIndex 0, is supported.
+ *
+ * \author    jkadbear( Tsinghua )
+ */
+#ifndef __FRAGSESSION_H__
+#define __FRAGSESSION_H__
+
+#include <stdint.h>
+#include "fragdecoder.h"
+
+/*!
+ * Application port of the fragmentation package
+ */
+#define FRAG_SESSION_PORT                           201
+
+/*!
+ * Status of a finished session
+ */
+typedef enum eFragSessionStatus
+{
+    /*!
+     * The data block is complete
+     */
+    FRAG_SESSION_STATUS_OK = 0,
+    /*!
+     * The data block can't be rebuilt, too many fragments lost or storage error
+     */
+    FRAG_SESSION_STATUS_ERROR,
+}FragSessionStatus_t;
+
+/*!
+ * \brief Initializes the fragmentation package
+ *
+ * \param [IN] callbacks Storage of the data block
+ * \param [IN] onDone    Called once a session is finished, with the data block
+ *                       size [bytes], padding removed
+ */
+void FragSessionInit( FragDecoderCallbacks_t *callbacks, void ( *onDone )( FragSessionStatus_t status, uint32_t size ) );
+
+/*!
+ * \brief Processes a downlink of FRAG_SESSION_PORT
+ *
+ * \param [IN]  buffer        Downlink payload
+ * \param [IN]  size          Downlink payload size
+ * \param [OUT] answer        Answers to send on FRAG_SESSION_PORT
+ * \param [IN]  maxAnswerSize Size of the answer buffer
+ * \retval size               Answers size, 0 when nothing has to be sent
+ */
+uint8_t FragSessionProcess( const uint8_t *buffer, uint8_t size, uint8_t *answer, uint8_t maxAnswerSize );
+
+#endif // __FRAGSESSION_H__
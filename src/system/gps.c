@@ -22,7 +22,6 @@
  */
 #include <stdint.h>
 #include <stdlib.h>
-#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include "utilities.h"
@@ -30,14 +29,14 @@
 #include "rtc-board.h"
 #include "gps-board.h"
 #include "gps.h"
+#include "clocksync.h"
 
 #define TRIGGER_GPS_CNT                             10
 
-/* Various type of NMEA data we can receive with the Gps */
-const char NmeaDataTypeGPGGA[] = "GPGGA";
-const char NmeaDataTypeGPGSA[] = "GPGSA";
-const char NmeaDataTypeGPGSV[] = "GPGSV";
-const char NmeaDataTypeGPRMC[] = "GPRMC";
+/*!
+ * Maximum number of integer digits accepted in a numerical NMEA field
+ */
+#define NMEA_MAX_INTEGER_DIGITS                     9
 
 /* Value used for the conversion of the position from DMS to decimal */
 const int32_t MaxNorthPosition = 8388607;       // 2^23 - 1
@@ -45,23 +44,84 @@ const int32_t MaxSouthPosition = 8388608;       // -2^23
 const int32_t MaxEastPosition = 8388607;        // 2^23 - 1
 const int32_t MaxWestPosition = 8388608;        // -2^23
 
+/*!
+ * Scaling applied to a fractional field depending on the number of received
+ * digits in order to express it with NMEA_FRACTION_DIGITS digits
+ */
+static const uint32_t NmeaFractionScale[NMEA_FRACTION_DIGITS + 1] = { 100000, 10000, 1000, 100, 10, 1 };
+
+/*!
+ * Streaming NMEA parser states
+ */
+typedef enum eNmeaParserState
+{
+    NMEA_PARSER_WAIT_START = 0,
+    NMEA_PARSER_ADDRESS,
+    NMEA_PARSER_FIELDS,
+    NMEA_PARSER_CHECKSUM_HIGH,
+    NMEA_PARSER_CHECKSUM_LOW,
+}NmeaParserState_t;
+
+/*!
+ * Streaming NMEA parser context
+ */
+typedef struct sNmeaParser
+{
+    NmeaParserState_t State;
+    uint8_t Checksum;           //! Running XOR of the characters between '$' and '*'
+    uint8_t RxChecksum;         //! Checksum received at the end of the sentence
+    uint8_t Field;              //! Index of the field being received
+    uint8_t AddressSize;
+    char Address[5];            //! Talker and sentence identifiers
+    uint32_t IntPart;           //! Integer part of the numerical field being received
+    uint32_t FracPart;          //! Fractional part of the numerical field being received
+    uint8_t IntDigits;
+    uint8_t FracDigits;
+    bool InFraction;
+    bool Negative;
+    char Flag;                  //! First character of a character field
+    bool LineStarted;           //! A '$' has been received since the last end of line
+    NmeaGpsData_t Work;         //! Data decoded from the sentence being received
+}NmeaParser_t;
+
+static NmeaParser_t NmeaParser;
+
 NmeaGpsData_t NmeaGpsData;
 
-static double HasFix = false;
-static double Latitude = 0;
-static double Longitude = 0;
+static bool HasFix = false;
 
 static int32_t LatitudeBinary = 0;
 static int32_t LongitudeBinary = 0;
 
-static int16_t Altitude = 0xFFFF;
-
 static uint32_t PpsCnt = 0;
 
 bool PpsDetected = false;
 
+/*!
+ * Timer time of the latest PPS edge
+ */
+static TimerTime_t PpsTime = 0;
+static bool PpsTimeValid = false;
+
+/*!
+ * UTC second of day marked by the latest PPS edge
+ */
+static uint32_t PpsUtcSeconds = 0;
+static bool PpsUtcValid = false;
+
 void GpsPpsHandler( bool *parseData )
 {
+    TimerTime_t now = RtcGetTimerValue( );
+
+    if( PpsUtcValid == true )
+    {
+        // One edge per second, missed edges are recovered from the elapsed time
+        PpsUtcSeconds = ( PpsUtcSeconds + ( ( now - PpsTime + 500 ) / 1000 ) ) % 86400;
+    }
+    PpsTime = now;
+    PpsTimeValid = true;
+    ClockSyncOnPps( now );
+
     PpsDetected = true;
     PpsCnt++;
     *parseData = false;
@@ -77,6 +137,9 @@ void GpsPpsHandler( bool *parseData )
 void GpsInit( void )
 {
     PpsDetected = false;
+    NmeaParser.State = NMEA_PARSER_WAIT_START;
+    NmeaParser.LineStarted = false;
+    ClockSyncInit( );
     GpsMcuInit( );
 }
 
@@ -111,80 +174,46 @@ bool GpsHasFix( void )
     return HasFix;
 }
 
-void GpsConvertPositionIntoBinary( void )
+uint8_t GpsGetLatestPps( TimerTime_t *ppsTime, uint32_t *utcSeconds )
 {
-    long double temp;
-
-    if( Latitude >= 0 ) // North
-    {
-        temp = Latitude * MaxNorthPosition;
-        LatitudeBinary = temp / 90;
-    }
-    else                // South
-    {
-        temp = Latitude * MaxSouthPosition;
-        LatitudeBinary = temp / 90;
-    }
+    uint8_t status = FAIL;
 
-    if( Longitude >= 0 ) // East
-    {
-        temp = Longitude * MaxEastPosition;
-        LongitudeBinary = temp / 180;
-    }
-    else                // West
+    BoardDisableIrq( );
+    if( PpsUtcValid == true )
     {
-        temp = Longitude * MaxWestPosition;
-        LongitudeBinary = temp / 180;
+        *ppsTime = PpsTime;
+        *utcSeconds = PpsUtcSeconds;
+        status = SUCCESS;
     }
+    BoardEnableIrq( );
+    return status;
 }
 
-void GpsConvertPositionFromStringToNumerical( void )
+void GpsConvertPositionIntoBinary( void )
 {
-    int i;
+    int64_t temp;
 
-    double valueTmp1;
-    double valueTmp2;
-    double valueTmp3;
-    double valueTmp4;
-
-    // Convert the latitude from ASCII to uint8_t values
-    for( i = 0 ; i < 10 ; i++ )
+    if( NmeaGpsData.Latitude >= 0 ) // North
     {
-        NmeaGpsData.NmeaLatitude[i] = NmeaGpsData.NmeaLatitude[i] & 0xF;
+        temp = ( int64_t )NmeaGpsData.Latitude * MaxNorthPosition;
     }
-    // Convert latitude from degree/minute/second (DMS) format into decimal
-    valueTmp1 = ( double )NmeaGpsData.NmeaLatitude[0] * 10.0 + ( double )NmeaGpsData.NmeaLatitude[1];
-    valueTmp2 = ( double )NmeaGpsData.NmeaLatitude[2] * 10.0 + ( double )NmeaGpsData.NmeaLatitude[3];
-    valueTmp3 = ( double )NmeaGpsData.NmeaLatitude[5] * 1000.0 + ( double )NmeaGpsData.NmeaLatitude[6] * 100.0 +
-                ( double )NmeaGpsData.NmeaLatitude[7] * 10.0 + ( double )NmeaGpsData.NmeaLatitude[8];
-
-    Latitude = valueTmp1 + ( ( valueTmp2 + ( valueTmp3 * 0.0001 ) ) / 60.0 );
-
-    if( NmeaGpsData.NmeaLatitudePole[0] == 'S' )
+    else                            // South
     {
-        Latitude *= -1;
+        temp = ( int64_t )NmeaGpsData.Latitude * MaxSouthPosition;
     }
+    LatitudeBinary = temp / ( 90 * 10000000LL );
 
-    // Convert the longitude from ASCII to uint8_t values
-    for( i = 0 ; i < 10 ; i++ )
+    if( NmeaGpsData.Longitude >= 0 ) // East
     {
-        NmeaGpsData.NmeaLongitude[i] = NmeaGpsData.NmeaLongitude[i] & 0xF;
+        temp = ( int64_t )NmeaGpsData.Longitude * MaxEastPosition;
     }
-    // Convert longitude from degree/minute/second (DMS) format into decimal
-    valueTmp1 = ( double )NmeaGpsData.NmeaLongitude[0] * 100.0 + ( double )NmeaGpsData.NmeaLongitude[1] * 10.0 + ( double )NmeaGpsData.NmeaLongitude[2];
-    valueTmp2 = ( double )NmeaGpsData.NmeaLongitude[3] * 10.0 + ( double )NmeaGpsData.NmeaLongitude[4];
-    valueTmp3 = ( double )NmeaGpsData.NmeaLongitude[6] * 1000.0 + ( double )NmeaGpsData.NmeaLongitude[7] * 100;
-    valueTmp4 = ( double )NmeaGpsData.NmeaLongitude[8] * 10.0 + ( double )NmeaGpsData.NmeaLongitude[9];
-
-    Longitude = valueTmp1 + ( valueTmp2 / 60.0 ) + ( ( ( valueTmp3 + valueTmp4 ) * 0.0001 ) / 60.0 );
-
-    if( NmeaGpsData.NmeaLongitudePole[0] == 'W' )
+    else                             // West
     {
-        Longitude *= -1;
+        temp = ( int64_t )NmeaGpsData.Longitude * MaxWestPosition;
     }
+    LongitudeBinary = temp / ( 180 * 10000000LL );
 }
 
-
 uint8_t GpsGetLatestGpsPositionDouble( double *lati, double *longi )
 {
     uint8_t status = FAIL;
@@ -196,8 +225,8 @@ uint8_t GpsGetLatestGpsPositionDouble( double *lati, double *longi )
     {
         GpsResetPosition( );
     }
-    *lati = Latitude;
-    *longi = Longitude;
+    *lati = ( double )NmeaGpsData.Latitude / 10000000.0;
+    *longi = ( double )NmeaGpsData.Longitude / 10000000.0;
     return status;
 }
 
@@ -209,6 +238,7 @@ uint8_t GpsGetLatestGpsPositionBinary( int32_t *latiBin, int32_t *longiBin )
     if( HasFix == true )
     {
         status = SUCCESS;
+        GpsConvertPositionIntoBinary( );
     }
     else
     {
@@ -222,438 +252,419 @@ uint8_t GpsGetLatestGpsPositionBinary( int32_t *latiBin, int32_t *longiBin )
 
 int16_t GpsGetLatestGpsAltitude( void )
 {
+    int16_t altitude;
+
     BoardDisableIrq( );
     if( HasFix == true )
     {
-        Altitude = atoi( NmeaGpsData.NmeaAltitude );
+        altitude = NmeaGpsData.Altitude;
     }
     else
     {
-        Altitude = 0xFFFF;
+        altitude = 0xFFFF;
     }
     BoardEnableIrq( );
 
-    return Altitude;
+    return altitude;
+}
+
+void GpsGetLatestGpsData( NmeaGpsData_t *data )
+{
+    BoardDisableIrq( );
+    *data = NmeaGpsData;
+    BoardEnableIrq( );
 }
 
 /*!
- * Calculates the checksum for a NMEA sentence
- *
- * Skip the first '$' if necessary and calculate checksum until '*' character is
- * reached (or buffSize exceeded).
+ * Converts an hexadecimal character into its value
  *
- * \retval chkPosIdx Position of the checksum in the sentence
+ * \retval value Nibble value or -1 if the character is not hexadecimal
  */
-int32_t GpsNmeaChecksum( int8_t *nmeaStr, int32_t nmeaStrSize, int8_t * checksum )
+static int8_t GpsNmeaHexCharToNibble( uint8_t c )
 {
-    int i = 0;
-    uint8_t checkNum = 0;
-
-    // Check input parameters
-    if( ( nmeaStr == NULL ) || ( checksum == NULL ) || ( nmeaStrSize <= 1 ) )
+    if( ( c >= '0' ) && ( c <= '9' ) )
     {
-        return -1;
+        return c - '0';
     }
-
-    // Skip the first '$' if necessary
-    if( nmeaStr[i] == '$' )
+    if( ( c >= 'A' ) && ( c <= 'F' ) )
     {
-        i += 1;
+        return c - 'A' + 10;
     }
-
-    // XOR until '*' or max length is reached
-    while( nmeaStr[i] != '*' )
+    if( ( c >= 'a' ) && ( c <= 'f' ) )
     {
-        checkNum ^= nmeaStr[i];
-        i += 1;
-        if( i >= nmeaStrSize )
-        {
-            return -1;
-        }
+        return c - 'a' + 10;
     }
+    return -1;
+}
+
+/*!
+ * Returns the fractional part of the current field with NMEA_FRACTION_DIGITS digits
+ */
+static uint32_t GpsNmeaFieldFraction( NmeaParser_t *parser )
+{
+    return parser->FracPart * NmeaFractionScale[parser->FracDigits];
+}
 
-    // Convert checksum value to 2 hexadecimal characters
-    checksum[0] = Nibble2HexChar( checkNum / 16 ); // upper nibble
-    checksum[1] = Nibble2HexChar( checkNum % 16 ); // lower nibble
+/*!
+ * Returns the current field value multiplied by 100, used for dilution values
+ */
+static uint16_t GpsNmeaFieldCentiValue( NmeaParser_t *parser )
+{
+    uint32_t value = parser->IntPart * 100 + GpsNmeaFieldFraction( parser ) / 1000;
 
-    return i + 1;
+    return ( value > UINT16_MAX ) ? UINT16_MAX : value;
 }
 
 /*!
- * Calculate the checksum of a NMEA frame and compare it to the checksum that is
- * present at the end of it.
- * Return true if it matches
+ * Converts the current "(d)ddmm.mmmmm" field into 1e-7 degree units
  */
-static bool GpsNmeaValidateChecksum( int8_t *serialBuff, int32_t buffSize )
+static int32_t GpsNmeaFieldCoordinate( NmeaParser_t *parser )
 {
-    int32_t checksumIndex;
-    int8_t checksum[2]; // 2 characters to calculate NMEA checksum
+    uint32_t degrees = parser->IntPart / 100;
+    uint32_t minutes = ( parser->IntPart % 100 ) * 100000 + GpsNmeaFieldFraction( parser );
 
-    checksumIndex = GpsNmeaChecksum( serialBuff, buffSize, checksum );
+    // 1e-5 minute to 1e-7 degree: * 100 / 60
+    return ( int32_t )( degrees * 10000000 + ( minutes * 5 ) / 3 );
+}
 
-    // could we calculate a verification checksum ?
-    if( checksumIndex < 0 )
+/*!
+ * Stores the field which has just been received into the working data
+ */
+static void GpsNmeaFieldDone( NmeaParser_t *parser )
+{
+    NmeaGpsData_t *work = &parser->Work;
+
+    switch( work->Sentence )
     {
-        return false;
+    case NMEA_SENTENCE_GGA:
+        switch( parser->Field )
+        {
+        case 1:
+            work->UtcTime = parser->IntPart;
+            break;
+        case 2:
+            work->Latitude = GpsNmeaFieldCoordinate( parser );
+            break;
+        case 3:
+            work->Latitude = ( parser->Flag == 'S' ) ? -work->Latitude : work->Latitude;
+            break;
+        case 4:
+            work->Longitude = GpsNmeaFieldCoordinate( parser );
+            break;
+        case 5:
+            work->Longitude = ( parser->Flag == 'W' ) ? -work->Longitude : work->Longitude;
+            break;
+        case 6:
+            work->FixQuality = parser->IntPart;
+            break;
+        case 7:
+            work->SatelliteTracked = parser->IntPart;
+            break;
+        case 8:
+            work->HorizontalDilution = GpsNmeaFieldCentiValue( parser );
+            break;
+        case 9:
+            work->Altitude = ( parser->Negative == true ) ? -( int16_t )parser->IntPart : ( int16_t )parser->IntPart;
+            break;
+        default:
+            break;
+        }
+        break;
+    case NMEA_SENTENCE_RMC:
+        switch( parser->Field )
+        {
+        case 1:
+            work->UtcTime = parser->IntPart;
+            break;
+        case 2:
+            work->DataValid = ( parser->Flag == 'A' ) ? true : false;
+            break;
+        case 3:
+            work->Latitude = GpsNmeaFieldCoordinate( parser );
+            break;
+        case 4:
+            work->Latitude = ( parser->Flag == 'S' ) ? -work->Latitude : work->Latitude;
+            break;
+        case 5:
+            work->Longitude = GpsNmeaFieldCoordinate( parser );
+            break;
+        case 6:
+            work->Longitude = ( parser->Flag == 'W' ) ? -work->Longitude : work->Longitude;
+            break;
+        case 9:
+            work->Date = parser->IntPart;
+            break;
+        default:
+            break;
+        }
+        break;
+    case NMEA_SENTENCE_GSA:
+        switch( parser->Field )
+        {
+        case 2:
+            work->FixType = parser->IntPart;
+            break;
+        case 15:
+            work->PositionDilution = GpsNmeaFieldCentiValue( parser );
+            break;
+        case 16:
+            work->HorizontalDilution = GpsNmeaFieldCentiValue( parser );
+            break;
+        default:
+            break;
+        }
+        break;
+    default:
+        break;
     }
 
-    // check if there are enough char in the serial buffer to read checksum
-    if( checksumIndex >= ( buffSize - 2 ) )
+    parser->Field++;
+    parser->IntPart = 0;
+    parser->FracPart = 0;
+    parser->IntDigits = 0;
+    parser->FracDigits = 0;
+    parser->InFraction = false;
+    parser->Negative = false;
+    parser->Flag = 0;
+}
+
+/*!
+ * Identifies the sentence from its address field. The talker identifier is
+ * ignored so that GP, GN and GL sentences are all accepted.
+ */
+static NmeaSentence_t GpsNmeaSentenceType( NmeaParser_t *parser )
+{
+    if( parser->AddressSize != 5 )
     {
-        return false;
+        return NMEA_SENTENCE_NONE;
     }
-
-    // check the checksum
-    if( ( serialBuff[checksumIndex] == checksum[0] ) && ( serialBuff[checksumIndex + 1] == checksum[1] ) )
+    if( strncmp( &parser->Address[2], "GGA", 3 ) == 0 )
     {
-        return true;
+        return NMEA_SENTENCE_GGA;
     }
-    else
+    if( strncmp( &parser->Address[2], "RMC", 3 ) == 0 )
+    {
+        return NMEA_SENTENCE_RMC;
+    }
+    if( strncmp( &parser->Address[2], "GSA", 3 ) == 0 )
     {
-        return false;
+        return NMEA_SENTENCE_GSA;
     }
+    return NMEA_SENTENCE_NONE;
 }
 
-uint8_t GpsParseGpsData( int8_t *rxBuffer, int32_t rxBufferSize )
+/*!
+ * Publishes the fields of a sentence whose checksum has been validated
+ */
+static void GpsNmeaSentenceDone( NmeaParser_t *parser )
 {
-    uint8_t i = 1;
-    uint8_t j = 0;
-    uint8_t fieldSize = 0;
+    NmeaGpsData_t *work = &parser->Work;
 
-    if( rxBuffer[0] != '$' )
+    NmeaGpsData.Sentence = work->Sentence;
+    switch( work->Sentence )
     {
-        GpsMcuInvertPpsTrigger( );
-        return FAIL;
+    case NMEA_SENTENCE_GGA:
+        NmeaGpsData.UtcTime = work->UtcTime;
+        NmeaGpsData.Latitude = work->Latitude;
+        NmeaGpsData.Longitude = work->Longitude;
+        NmeaGpsData.FixQuality = work->FixQuality;
+        NmeaGpsData.SatelliteTracked = work->SatelliteTracked;
+        NmeaGpsData.HorizontalDilution = work->HorizontalDilution;
+        NmeaGpsData.Altitude = work->Altitude;
+        HasFix = ( work->FixQuality > 0 ) ? true : false;
+        break;
+    case NMEA_SENTENCE_RMC:
+        NmeaGpsData.UtcTime = work->UtcTime;
+        NmeaGpsData.DataValid = work->DataValid;
+        NmeaGpsData.Latitude = work->Latitude;
+        NmeaGpsData.Longitude = work->Longitude;
+        NmeaGpsData.Date = work->Date;
+        HasFix = work->DataValid;
+        break;
+    case NMEA_SENTENCE_GSA:
+        NmeaGpsData.FixType = work->FixType;
+        NmeaGpsData.PositionDilution = work->PositionDilution;
+        NmeaGpsData.HorizontalDilution = work->HorizontalDilution;
+        // No time in a GSA, the PPS keeps its association
+        return;
+    default:
+        return;
     }
 
-    if( GpsNmeaValidateChecksum( rxBuffer, rxBufferSize ) == false )
+    // The sentence reports the time of the edge which preceded it
+    if( ( HasFix == true ) && ( PpsTimeValid == true ) )
     {
-        return FAIL;
+        PpsUtcSeconds = ( work->UtcTime / 10000 ) * 3600 + ( ( work->UtcTime / 100 ) % 100 ) * 60 + work->UtcTime % 100;
+        PpsUtcValid = true;
     }
-
-    fieldSize = 0;
-    while( rxBuffer[i + fieldSize++] != ',' )
+    else
     {
-        if( fieldSize > 6 )
-        {
-            return FAIL;
-        }
+        PpsUtcValid = false;
     }
-    for( j = 0; j < fieldSize; j++, i++ )
+}
+
+/*!
+ * Restarts the parser on a new sentence
+ */
+static void GpsNmeaSentenceStart( NmeaParser_t *parser )
+{
+    parser->State = NMEA_PARSER_ADDRESS;
+    parser->Checksum = 0;
+    parser->AddressSize = 0;
+    parser->Field = 0;
+    parser->IntPart = 0;
+    parser->FracPart = 0;
+    parser->IntDigits = 0;
+    parser->FracDigits = 0;
+    parser->InFraction = false;
+    parser->Negative = false;
+    parser->Flag = 0;
+    memset1( ( uint8_t* )&parser->Work, 0, sizeof( NmeaGpsData_t ) );
+}
+
+uint8_t GpsParseGpsByte( uint8_t data )
+{
+    NmeaParser_t *parser = &NmeaParser;
+    int8_t nibble;
+
+    if( data == '$' )
     {
-        NmeaGpsData.NmeaDataType[j] = rxBuffer[i];
+        parser->LineStarted = true;
+        GpsNmeaSentenceStart( parser );
+        return FAIL;
     }
-    // Parse the GPGGA data
-    if( strncmp( ( const char* )NmeaGpsData.NmeaDataType, ( const char* )NmeaDataTypeGPGGA, 5 ) == 0 )
+    if( ( data == '\r' ) || ( data == '\n' ) )
     {
-        // NmeaUtcTime
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
+        if( ( data == '\n' ) && ( parser->LineStarted == false ) )
         {
-            if( fieldSize > 11 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaUtcTime[j] = rxBuffer[i];
+            // A whole line without start delimiter, we are sampling on the wrong PPS edge
+            GpsMcuInvertPpsTrigger( );
         }
-        // NmeaLatitude
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
+        if( data == '\n' )
         {
-            if( fieldSize > 10 )
-            {
-                return FAIL;
-            }
+            parser->LineStarted = false;
         }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaLatitude[j] = rxBuffer[i];
-        }
-        // NmeaLatitudePole
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 2 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaLatitudePole[j] = rxBuffer[i];
-        }
-        // NmeaLongitude
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 11 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaLongitude[j] = rxBuffer[i];
-        }
-        // NmeaLongitudePole
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 2 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaLongitudePole[j] = rxBuffer[i];
-        }
-        // NmeaFixQuality
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 2 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaFixQuality[j] = rxBuffer[i];
-        }
-        // NmeaSatelliteTracked
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 3 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaSatelliteTracked[j] = rxBuffer[i];
-        }
-        // NmeaHorizontalDilution
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 6 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaHorizontalDilution[j] = rxBuffer[i];
-        }
-        // NmeaAltitude
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 8 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaAltitude[j] = rxBuffer[i];
-        }
-        // NmeaAltitudeUnit
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 2 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaAltitudeUnit[j] = rxBuffer[i];
-        }
-        // NmeaHeightGeoid
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 8 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaHeightGeoid[j] = rxBuffer[i];
-        }
-        // NmeaHeightGeoidUnit
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 2 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaHeightGeoidUnit[j] = rxBuffer[i];
-        }
-
-        GpsFormatGpsData( );
-        return SUCCESS;
+        parser->State = NMEA_PARSER_WAIT_START;
+        return FAIL;
     }
-    else if ( strncmp( ( const char* )NmeaGpsData.NmeaDataType, ( const char* )NmeaDataTypeGPRMC, 5 ) == 0 )
+
+    switch( parser->State )
     {
-        // NmeaUtcTime
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
+    case NMEA_PARSER_ADDRESS:
+        parser->Checksum ^= data;
+        if( data == ',' )
         {
-            if( fieldSize > 11 )
+            parser->Work.Sentence = GpsNmeaSentenceType( parser );
+            if( parser->Work.Sentence == NMEA_SENTENCE_NONE )
             {
-                return FAIL;
+                parser->State = NMEA_PARSER_WAIT_START;
+                break;
             }
+            parser->Field = 1;
+            parser->State = NMEA_PARSER_FIELDS;
         }
-        for( j = 0; j < fieldSize; j++, i++ )
+        else if( parser->AddressSize < sizeof( parser->Address ) )
         {
-            NmeaGpsData.NmeaUtcTime[j] = rxBuffer[i];
+            parser->Address[parser->AddressSize++] = data;
         }
-        // NmeaDataStatus
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
+        else
         {
-            if( fieldSize > 2 )
-            {
-                return FAIL;
-            }
+            parser->State = NMEA_PARSER_WAIT_START;
         }
-        for( j = 0; j < fieldSize; j++, i++ )
+        break;
+    case NMEA_PARSER_FIELDS:
+        if( data == '*' )
         {
-            NmeaGpsData.NmeaDataStatus[j] = rxBuffer[i];
+            GpsNmeaFieldDone( parser );
+            parser->State = NMEA_PARSER_CHECKSUM_HIGH;
+            break;
         }
-        // NmeaLatitude
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
+        parser->Checksum ^= data;
+        if( data == ',' )
         {
-            if( fieldSize > 10 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaLatitude[j] = rxBuffer[i];
+            GpsNmeaFieldDone( parser );
         }
-        // NmeaLatitudePole
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
+        else if( ( data >= '0' ) && ( data <= '9' ) )
         {
-            if( fieldSize > 2 )
+            if( parser->InFraction == false )
             {
-                return FAIL;
+                if( parser->IntDigits++ >= NMEA_MAX_INTEGER_DIGITS )
+                {
+                    parser->State = NMEA_PARSER_WAIT_START;
+                    break;
+                }
+                parser->IntPart = parser->IntPart * 10 + ( data - '0' );
             }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaLatitudePole[j] = rxBuffer[i];
-        }
-        // NmeaLongitude
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 11 )
+            else if( parser->FracDigits < NMEA_FRACTION_DIGITS )
             {
-                return FAIL;
+                parser->FracPart = parser->FracPart * 10 + ( data - '0' );
+                parser->FracDigits++;
             }
         }
-        for( j = 0; j < fieldSize; j++, i++ )
+        else if( data == '.' )
         {
-            NmeaGpsData.NmeaLongitude[j] = rxBuffer[i];
+            parser->InFraction = true;
         }
-        // NmeaLongitudePole
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
+        else if( data == '-' )
         {
-            if( fieldSize > 2 )
-            {
-                return FAIL;
-            }
+            parser->Negative = true;
         }
-        for( j = 0; j < fieldSize; j++, i++ )
+        else if( parser->Flag == 0 )
         {
-            NmeaGpsData.NmeaLongitudePole[j] = rxBuffer[i];
+            parser->Flag = data;
         }
-        // NmeaSpeed
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
+        break;
+    case NMEA_PARSER_CHECKSUM_HIGH:
+        nibble = GpsNmeaHexCharToNibble( data );
+        if( nibble < 0 )
         {
-            if( fieldSize > 8 )
-            {
-                return FAIL;
-            }
+            parser->State = NMEA_PARSER_WAIT_START;
+            break;
         }
-        for( j = 0; j < fieldSize; j++, i++ )
+        parser->RxChecksum = nibble << 4;
+        parser->State = NMEA_PARSER_CHECKSUM_LOW;
+        break;
+    case NMEA_PARSER_CHECKSUM_LOW:
+        nibble = GpsNmeaHexCharToNibble( data );
+        parser->State = NMEA_PARSER_WAIT_START;
+        if( ( nibble < 0 ) || ( ( parser->RxChecksum | nibble ) != parser->Checksum ) )
         {
-            NmeaGpsData.NmeaSpeed[j] = rxBuffer[i];
+            break;
         }
-        // NmeaDetectionAngle
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 8 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaDetectionAngle[j] = rxBuffer[i];
-        }
-        // NmeaDate
-        fieldSize = 0;
-        while( rxBuffer[i + fieldSize++] != ',' )
-        {
-            if( fieldSize > 8 )
-            {
-                return FAIL;
-            }
-        }
-        for( j = 0; j < fieldSize; j++, i++ )
-        {
-            NmeaGpsData.NmeaDate[j] = rxBuffer[i];
-        }
-
-        GpsFormatGpsData( );
+        GpsNmeaSentenceDone( parser );
         return SUCCESS;
+    case NMEA_PARSER_WAIT_START:
+    default:
+        break;
     }
-    else
-    {
-        return FAIL;
-    }
+    return FAIL;
 }
 
-void GpsFormatGpsData( void )
+uint8_t GpsParseGpsData( int8_t *rxBuffer, int32_t rxBufferSize )
 {
-    if( strncmp( ( const char* )NmeaGpsData.NmeaDataType, ( const char* )NmeaDataTypeGPGGA, 5 ) == 0 )
+    uint8_t status = FAIL;
+
+    if( rxBuffer[0] != '$' )
     {
-        HasFix = ( NmeaGpsData.NmeaFixQuality[0] > 0x30 ) ? true : false;
+        GpsMcuInvertPpsTrigger( );
+        return FAIL;
     }
-    else if ( strncmp( ( const char* )NmeaGpsData.NmeaDataType, ( const char* )NmeaDataTypeGPRMC, 5 ) == 0 )
+
+    for( int32_t i = 0; ( i < rxBufferSize ) && ( rxBuffer[i] != '\0' ); i++ )
     {
-        HasFix = ( NmeaGpsData.NmeaDataStatus[0] == 0x41 ) ? true : false;
+        if( GpsParseGpsByte( ( uint8_t )rxBuffer[i] ) == SUCCESS )
+        {
+            status = SUCCESS;
+        }
     }
-    GpsConvertPositionFromStringToNumerical( );
-    GpsConvertPositionIntoBinary( );
+    return status;
 }
 
 void GpsResetPosition( void )
 {
-    Altitude = 0xFFFF;
-    Latitude = 0;
-    Longitude = 0;
+    NmeaGpsData.Altitude = 0xFFFF;
+    NmeaGpsData.Latitude = 0;
+    NmeaGpsData.Longitude = 0;
     LatitudeBinary = 0;
     LongitudeBinary = 0;
 }
@@ -25,27 +25,39 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "timer.h"
 
-/* Structure to handle the GPS parsed data in ASCII */
+/*!
+ * Number of fractional digits kept by the NMEA parser for decimal fields
+ */
+#define NMEA_FRACTION_DIGITS                        5
+
+/*!
+ * NMEA sentences decoded by the streaming parser
+ */
+typedef enum eNmeaSentence
+{
+    NMEA_SENTENCE_NONE = 0,
+    NMEA_SENTENCE_GGA,
+    NMEA_SENTENCE_RMC,
+    NMEA_SENTENCE_GSA,
+}NmeaSentence_t;
+
+/* Structure to handle the GPS parsed data in fixed-point format */
 typedef struct
 {
-    char NmeaDataType[6];
-    char NmeaUtcTime[11];
-    char NmeaDataStatus[2];
-    char NmeaLatitude[10];
-    char NmeaLatitudePole[2];
-    char NmeaLongitude[11];
-    char NmeaLongitudePole[2];
-    char NmeaFixQuality[2];
-    char NmeaSatelliteTracked[3];
-    char NmeaHorizontalDilution[6];
-    char NmeaAltitude[8];
-    char NmeaAltitudeUnit[2];
-    char NmeaHeightGeoid[8];
-    char NmeaHeightGeoidUnit[2];
-    char NmeaSpeed[8];
-    char NmeaDetectionAngle[8];
-    char NmeaDate[8];
+    NmeaSentence_t Sentence;        //! Last decoded sentence type
+    uint32_t UtcTime;               //! hhmmss
+    uint32_t Date;                  //! ddmmyy
+    int32_t Latitude;               //! 1e-7 degree, negative towards South
+    int32_t Longitude;              //! 1e-7 degree, negative towards West
+    int16_t Altitude;               //! m above mean sea level
+    uint8_t FixQuality;             //! GGA fix quality [0: invalid, 1: GPS, 2: DGPS, ...]
+    uint8_t FixType;                //! GSA fix type [1: none, 2: 2D, 3: 3D]
+    uint8_t SatelliteTracked;       //! Number of satellites in use
+    uint16_t HorizontalDilution;    //! HDOP x 100
+    uint16_t PositionDilution;      //! PDOP x 100
+    bool DataValid;                 //! RMC status [true: 'A', false: 'V']
 }NmeaGpsData_t;
 
 /*!
@@ -88,16 +100,20 @@ bool GpsGetPpsDetectedState( void );
 bool GpsHasFix( void );
 
 /*!
- * \brief Converts the latest Position (latitude and longitude) into a binary
- *        number
+ * \brief Gets the time of the latest PPS edge and the UTC time it marks
+ *
+ * \param [OUT] ppsTime    Timer time of the edge [ms]
+ * \param [OUT] utcSeconds UTC second of day marked by the edge
+ *
+ * \retval status [SUCCESS, FAIL] FAIL until a fix has dated the PPS edges
  */
-void GpsConvertPositionIntoBinary( void );
+uint8_t GpsGetLatestPps( TimerTime_t *ppsTime, uint32_t *utcSeconds );
 
 /*!
- * \brief Converts the latest Position (latitude and Longitude) from ASCII into
- *        DMS numerical format
+ * \brief Converts the latest Position (latitude and longitude) into a binary
+ *        number
  */
-void GpsConvertPositionFromStringToNumerical( void );
+void GpsConvertPositionIntoBinary( void );
 
 /*!
  * \brief Gets the latest Position (latitude and Longitude) as two double values
@@ -124,7 +140,8 @@ uint8_t GpsGetLatestGpsPositionBinary ( int32_t *latiBin, int32_t *longiBin );
 /*!
  * \brief Parses the NMEA sentence.
  *
- * \remark Only parses GPGGA and GPRMC sentences
+ * \remark Feeds the buffer to the streaming parser. Only parses GGA, RMC and
+ *         GSA sentences
  *
  * \param [IN] rxBuffer Data buffer to be parsed
  * \param [IN] rxBufferSize Size of data buffer
@@ -134,16 +151,32 @@ uint8_t GpsGetLatestGpsPositionBinary ( int32_t *latiBin, int32_t *longiBin );
 uint8_t GpsParseGpsData( int8_t *rxBuffer, int32_t rxBufferSize );
 
 /*!
- * \brief Returns the latest altitude from the parsed NMEA sentence
+ * \brief Feeds one byte received from the GPS to the streaming NMEA parser.
  *
- * \retval altitude
+ * \remark The checksum is accumulated and the numerical fields are converted
+ *         while the bytes arrive. The decoded data is only published once the
+ *         checksum of the sentence has been validated, hence this function
+ *         can be called directly from the UART IRQ.
+ *
+ * \param [IN] data Byte received from the GPS
+ *
+ * \retval status [SUCCESS: a valid sentence has just been decoded, FAIL otherwise]
  */
-int16_t GpsGetLatestGpsAltitude( void );
+uint8_t GpsParseGpsByte( uint8_t data );
+
+/*!
+ * \brief Gets a copy of the latest decoded NMEA data
+ *
+ * \param [OUT] data Latest decoded data
+ */
+void GpsGetLatestGpsData( NmeaGpsData_t *data );
 
 /*!
- * \brief Format GPS data into numeric and binary formats
+ * \brief Returns the latest altitude from the parsed NMEA sentence
+ *
+ * \retval altitude
  */
-void GpsFormatGpsData( void );
+int16_t GpsGetLatestGpsAltitude( void );
 
 /*!
  * \brief Resets the GPS position variables
@@ -19,9 +19,187 @@
  * \author    jkadbear( Tsinghua )
  */
 #include <stdio.h>
+#include <string.h>
+#include "board.h"
 #include "serialio.h"
 #include "serialio-board.h"
 
+#if defined(SERIALIO_DEFERRED)
+/*!
+ * Ring of records: Size uint8, Id uint16, Payload[Size]
+ */
+static uint8_t LogBuffer[SERIALIO_LOG_BUFFER_SIZE];
+static uint16_t LogBegin = 0;
+static uint16_t LogCount = 0;
+static uint32_t LogDropped = 0;
+
+static bool SerialioLogWrite(uint16_t id, const uint8_t *payload, uint8_t size, bool countDropped)
+{
+    uint16_t end;
+
+    BoardDisableIrq();
+    if ((LogCount + 3 + size) > SERIALIO_LOG_BUFFER_SIZE)
+    {
+        if (countDropped)
+        {
+            LogDropped += 1;
+        }
+        BoardEnableIrq();
+        return false;
+    }
+    end = (LogBegin + LogCount) % SERIALIO_LOG_BUFFER_SIZE;
+    LogBuffer[end] = size;
+    end = (end + 1) % SERIALIO_LOG_BUFFER_SIZE;
+    LogBuffer[end] = id & 0xFF;
+    end = (end + 1) % SERIALIO_LOG_BUFFER_SIZE;
+    LogBuffer[end] = (id >> 8) & 0xFF;
+    for (uint8_t i = 0; i < size; i++)
+    {
+        end = (end + 1) % SERIALIO_LOG_BUFFER_SIZE;
+        LogBuffer[end] = payload[i];
+    }
+    LogCount += 3 + size;
+    BoardEnableIrq();
+    return true;
+}
+
+/*!
+ * \brief UART bytes needed by the next record, 0 when none
+ *
+ * \remark Called with the interrupts disabled
+ */
+static uint16_t SerialioNextFrameSize(void)
+{
+    if (LogDropped != 0)
+    {
+        return 2 + 4 + 2;
+    }
+    if (LogCount == 0)
+    {
+        return 0;
+    }
+    // COBS overhead and delimiter, records are shorter than 254 bytes
+    return 2 + LogBuffer[LogBegin] + 2;
+}
+
+/*!
+ * \brief COBS encodes a record and pushes it to the UART FIFO
+ */
+static void SerialioSendFrame(const uint8_t *record, uint8_t size)
+{
+    uint8_t frame[2 + SERIALIO_LOG_MAX_ARGS * 4 + 2];
+    uint8_t codeInd = 0;
+    uint8_t n = 1;
+
+    for (uint8_t i = 0; i < size; i++)
+    {
+        if (record[i] == 0)
+        {
+            frame[codeInd] = n - codeInd;
+            codeInd = n++;
+        }
+        else
+        {
+            frame[n++] = record[i];
+        }
+    }
+    frame[codeInd] = n - codeInd;
+    frame[n++] = 0;
+
+    for (uint8_t i = 0; i < n; i++)
+    {
+        SerialioMcuPutChar(frame[i]);
+    }
+}
+
+void SerialioLog(const char *format, const uint32_t *args, uint8_t nbArgs)
+{
+    if (nbArgs > SERIALIO_LOG_MAX_ARGS)
+    {
+        nbArgs = SERIALIO_LOG_MAX_ARGS;
+    }
+    // the target is little endian, like the records
+    SerialioLogWrite((uint16_t)(uintptr_t)format, (const uint8_t *)args, nbArgs * 4, true);
+}
+
+bool SerialioRecord(const void *payload, uint8_t size)
+{
+    if (size > SERIALIO_RECORD_MAX)
+    {
+        size = SERIALIO_RECORD_MAX;
+    }
+    return SerialioLogWrite(SERIALIO_LOG_ID_RECORD, (const uint8_t *)payload, size, false);
+}
+
+void SerialioProcess(void)
+{
+    uint8_t record[2 + SERIALIO_LOG_MAX_ARGS * 4];
+    uint8_t size;
+
+    while (1)
+    {
+        BoardDisableIrq();
+        size = SerialioNextFrameSize();
+        if ((size == 0) || (SerialioMcuGetTxFree() < size))
+        {
+            BoardEnableIrq();
+            return;
+        }
+        if (LogDropped != 0)
+        {
+            record[0] = SERIALIO_LOG_ID_DROPPED & 0xFF;
+            record[1] = (SERIALIO_LOG_ID_DROPPED >> 8) & 0xFF;
+            memcpy(&record[2], &LogDropped, 4);
+            size = 6;
+            LogDropped = 0;
+        }
+        else
+        {
+            size = 2 + LogBuffer[LogBegin];
+            for (uint8_t i = 0; i < size; i++)
+            {
+                record[i] = LogBuffer[(LogBegin + 1 + i) % SERIALIO_LOG_BUFFER_SIZE];
+            }
+            LogBegin = (LogBegin + 1 + size) % SERIALIO_LOG_BUFFER_SIZE;
+            LogCount -= 1 + size;
+        }
+        BoardEnableIrq();
+
+        SerialioSendFrame(record, size);
+    }
+}
+
+bool SerialioHasPendingLog(void)
+{
+    uint16_t size = SerialioNextFrameSize();
+
+    return (size != 0) && (SerialioMcuGetTxFree() >= size);
+}
+#else
+void SerialioProcess(void)
+{
+}
+
+bool SerialioHasPendingLog(void)
+{
+    return false;
+}
+
+void SerialioLog(const char *format, const uint32_t *args, uint8_t nbArgs)
+{
+    (void)format;
+    (void)args;
+    (void)nbArgs;
+}
+
+bool SerialioRecord(const void *payload, uint8_t size)
+{
+    (void)payload;
+    (void)size;
+    return true;
+}
+#endif
+
 void SerialioInit(void)
 {
     SerialioMcuInit();
@@ -30,8 +208,17 @@ void SerialioInit(void)
 // redirect stdout
 int _write (int fd, char *pBuffer, int size)
 {
+#if defined(SERIALIO_DEFERRED)
+    // text records, so that printf doesn't break the binary stream
+    for (int i = 0; i < size; i += SERIALIO_LOG_TEXT_MAX)
+    {
+        int len = ((size - i) > SERIALIO_LOG_TEXT_MAX) ? SERIALIO_LOG_TEXT_MAX : (size - i);
+        SerialioLogWrite(SERIALIO_LOG_ID_TEXT, (uint8_t *)&pBuffer[i], len, true);
+    }
+#else
     for (int i = 0; i < size; i++)
         SerialioMcuPutChar(pBuffer[i]);
+#endif
     return size;
 }
 
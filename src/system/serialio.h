@@ -22,6 +22,7 @@
 #define __SERIALIO_H__
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <stdint.h>
 /*!
  * FIFO buffers size
@@ -49,26 +50,89 @@ void SerialioInit(void);
 #define LOGLEVEL LOG_ERR
 #endif
 
+/*!
+ * With SERIALIO_DEFERRED the log macros don't format anything: the format
+ * string is stored in the .logfmt section, which is not loaded on the target,
+ * and only its address, the format id, and the arguments are copied to a ring
+ * buffer. SerialioProcess, called from the main loop, sends the records once
+ * the UART FIFO has room for them. printf output goes through the same ring
+ * as text records. tools/logdecode.py rebuilds the text from the ELF file.
+ *
+ * The arguments must be integers, SERIALIO_LOG_MAX_ARGS at most, they are
+ * sent as 32 bits values.
+ *
+ * Each record is COBS encoded and ends with a 0x00 byte:
+ *
+ *     Id       uint16  format address in .logfmt, or SERIALIO_LOG_ID_*
+ *     Payload          arguments, little endian uint32 each, or text, or a
+ *                      binary record of SerialioRecord
+ */
+#define SERIALIO_LOG_BUFFER_SIZE                256
+#define SERIALIO_LOG_MAX_ARGS                   8
+#define SERIALIO_LOG_TEXT_MAX                   32
+#define SERIALIO_LOG_ID_TEXT                    0xFFFF
+#define SERIALIO_LOG_ID_DROPPED                 0xFFFE  // payload: number of records lost on a full ring
+#define SERIALIO_LOG_ID_RECORD                  0xFFFD  // payload: binary record, its first byte is its type
+#define SERIALIO_RECORD_MAX                     (SERIALIO_LOG_MAX_ARGS * 4)
+
+/*!
+ * \brief Sends the pending log records which fit in the UART FIFO
+ */
+void SerialioProcess(void);
+
+/*!
+ * \brief Checks if SerialioProcess has a record to send now, to be called
+ *        with the interrupts disabled
+ */
+bool SerialioHasPendingLog(void);
+
+/*!
+ * \brief Queues a log record, use the log macros instead
+ */
+void SerialioLog(const char *format, const uint32_t *args, uint8_t nbArgs);
+
+/*!
+ * \brief Queues a binary record, SERIALIO_RECORD_MAX bytes at most. The
+ *        caller keeps the record and retries later when the ring is full, it
+ *        is not counted as dropped. Without SERIALIO_DEFERRED the record is
+ *        discarded.
+ *
+ * \retval status false when the ring has no room for the record
+ */
+bool SerialioRecord(const void *payload, uint8_t size);
+
+#if defined(SERIALIO_DEFERRED)
+#define SERIALIO_PRINT(prefix, format, ...)                                                                 \
+    do                                                                                                      \
+    {                                                                                                       \
+        static const char logFormat[] __attribute__((section(".logfmt"), used)) = prefix format;           \
+        const uint32_t logArgs[] = { 0, ##__VA_ARGS__ };                                                    \
+        SerialioLog(logFormat, &logArgs[1], (sizeof(logArgs) / sizeof(logArgs[0])) - 1);                  \
+    } while(0)
+#else
+#define SERIALIO_PRINT(prefix, format, ...) printf(prefix format, ##__VA_ARGS__)
+#endif
+
 #if (defined(SERIALIO) && (LOGLEVEL >= LOG_ERR))
-#define log_err(format, ...) printf("ERR:");printf(format, ##__VA_ARGS__)
+#define log_err(format, ...) SERIALIO_PRINT("ERR:", format, ##__VA_ARGS__)
 #else
 #define log_err(format, ...)
 #endif
 
 #if (defined(SERIALIO) && (LOGLEVEL >= LOG_WARN))
-#define log_warn(format, ...) printf("WARN:");printf(format, ##__VA_ARGS__)
+#define log_warn(format, ...) SERIALIO_PRINT("WARN:", format, ##__VA_ARGS__)
 #else
 #define log_warn(format, ...)
 #endif
 
 #if (defined(SERIALIO) && (LOGLEVEL >= LOG_INFO))
-#define log_info(format, ...) printf("INFO:");printf(format, ##__VA_ARGS__)
+#define log_info(format, ...) SERIALIO_PRINT("INFO:", format, ##__VA_ARGS__)
 #else
 #define log_info(format, ...)
 #endif
 
 #if (defined(SERIALIO) && (LOGLEVEL >= LOG_DEBUG))
-#define log_debug(format, ...) printf("DBG:");printf(format, ##__VA_ARGS__)
+#define log_debug(format, ...) SERIALIO_PRINT("DBG:", format, ##__VA_ARGS__)
 #else
 #define log_debug(format, ...)
 #endif
@@ -23,6 +23,7 @@
 #include "board.h"
 #include "rtc-board.h"
 #include "timer.h"
+#include "clocksync.h"
 
 /*!
  * This flag is used to loop through the main several times in order to be sure
@@ -362,6 +363,10 @@ void TimerReset( TimerEvent_t *obj )
 void TimerSetValue( TimerEvent_t *obj, uint32_t value )
 {
     TimerStop( obj );
+
+    // Compensates the RTC frequency error once disciplined on the GPS PPS
+    value = ClockSyncCorrectTimeout( value );
+
     obj->Timestamp = value;
     obj->ReloadValue = value;
 }
@@ -393,6 +398,25 @@ static void TimerSetTimeout( TimerEvent_t *obj )
     RtcSetTimeout( obj->Timestamp );
 }
 
+TimerTime_t TimerGetNextEventTime( void )
+{
+    TimerTime_t remainingTime = TIMER_NO_EVENT;
+    uint32_t elapsedTime = 0;
+
+    BoardDisableIrq( );
+    if( TimerListHead != NULL )
+    {
+        remainingTime = TimerListHead->Timestamp;
+        if( TimerListHead->IsRunning == true )
+        {
+            elapsedTime = TimerGetValue( );
+            remainingTime = ( elapsedTime >= TimerListHead->Timestamp ) ? 0 : TimerListHead->Timestamp - elapsedTime;
+        }
+    }
+    BoardEnableIrq( );
+    return remainingTime;
+}
+
 void TimerLowPowerHandler( void )
 {
     if( ( TimerListHead != NULL ) && ( TimerListHead->IsRunning == true ) )
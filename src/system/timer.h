@@ -46,6 +46,11 @@ typedef struct TimerEvent_s
 typedef uint32_t TimerTime_t;
 #endif
 
+/*!
+ * Returned by TimerGetNextEventTime when no timer is running
+ */
+#define TIMER_NO_EVENT                              0xFFFFFFFF
+
 /*!
  * \brief Initializes the timer object
  *
@@ -86,6 +91,9 @@ void TimerReset( TimerEvent_t *obj );
 /*!
  * \brief Set timer new timeout value
  *
+ * \remark The value is corrected by the RTC frequency error estimated by
+ *         the clock discipline, see clocksync.h
+ *
  * \param [IN] obj   Structure containing the timer object parameters
  * \param [IN] value New timer timeout value
  */
@@ -114,6 +122,13 @@ TimerTime_t TimerGetElapsedTime( TimerTime_t savedTime );
  */
 TimerTime_t TimerGetFutureTime( TimerTime_t eventInFuture );
 
+/*!
+ * \brief Return the time remaining before the next timer expires
+ *
+ * \retval time Remaining time [ms], TIMER_NO_EVENT when no timer is running
+ */
+TimerTime_t TimerGetNextEventTime( void );
+
 /*!
  * \brief Manages the entry into ARM cortex deep-sleep mode
  */
@@ -0,0 +1,207 @@
+#!/usr/bin/env python3
+#
+# Uplink airtime of the device side ADR against the network server ADR, see
+# DeviceAdrNext in src/mac/LoRaMac.c. CN470 datarates, DR0 (SF12) to DR5
+# (SF7), TX power indexes 2 dB apart.
+#
+#   adrsim.py                                  (synthetic links at 15, 5, -5 and -15 dB)
+#   adrsim.py --snr 0 --fading 6 --downlinks 0.05
+#   adrsim.py trace1.txt trace2.txt            (link SNR of each uplink [dB], one per line)
+#
+# A trace gives the link SNR of each uplink at the maximum TX power, the same
+# on the downlinks. An uplink is received when its SNR, lowered by the TX
+# power reduction, is above the demodulation floor of its datarate; a
+# received uplink gets a downlink with the probability --downlinks, always
+# when it carries ADRACKReq. Every mode runs the standard ADR back-off of the
+# node.
+#
+#   none     the network never sends LinkAdrReq
+#   network  the network server sends LinkAdrReq from the best SNR of the
+#            last 20 uplinks, 3 dB per step, in the next downlink
+#   device   the node picks its datarate and TX power from the downlink SNR,
+#            like DeviceAdrNext, and the network sends no LinkAdrReq
+#
+import argparse
+import math
+import random
+import sys
+
+from classsim import time_on_air
+
+MIN_DR = 0
+MAX_DR = 5
+MAX_POWER_INDEX = 7
+TX_POWER_STEP = 2
+ADR_ACK_LIMIT = 64
+ADR_ACK_DELAY = 32
+# LoRaMac.h
+DEVICE_ADR_HISTORY_SIZE = 8
+DEVICE_ADR_MIN_SAMPLES = 4
+DEVICE_ADR_HYSTERESIS = 3
+# usual network server settings
+NETWORK_ADR_HISTORY_SIZE = 20
+NETWORK_ADR_STEP = 3
+
+
+def spreading_factor(dr):
+    return 12 - dr
+
+
+def demod_floor(dr):
+    """RegionCommonComputeDemodFloorLoRa, rounded towards 0 like GetDemodFloor [dB]."""
+    return int(-5.0 - 2.5 * (spreading_factor(dr) - 6))
+
+
+class Node:
+    def __init__(self, mode, margin):
+        self.mode = mode
+        self.margin = margin
+        self.dr = MIN_DR
+        self.power = 0
+        self.adr_ack_counter = 0
+        self.history = []           # device side, link SNR of the downlinks
+        self.network_history = []   # network side, SNR of the uplinks
+
+    def adr_next(self):
+        """RegionCN470AdrNext then DeviceAdrNext, returns ADRACKReq."""
+        adr_ack_req = False
+        if self.dr == MIN_DR:
+            self.adr_ack_counter = 0
+        else:
+            if self.adr_ack_counter >= ADR_ACK_LIMIT:
+                adr_ack_req = True
+                self.power = 0
+            if self.adr_ack_counter >= ADR_ACK_LIMIT + ADR_ACK_DELAY and \
+                    self.adr_ack_counter % ADR_ACK_DELAY == 1:
+                self.dr -= 1
+                if self.dr == MIN_DR:
+                    adr_ack_req = False
+        if self.mode == 'device':
+            if adr_ack_req:
+                self.history = []
+            else:
+                self.device_adr_next()
+        return adr_ack_req
+
+    def device_adr_next(self):
+        if len(self.history) < DEVICE_ADR_MIN_SAMPLES:
+            return
+        snr = max(self.history)
+        margin = snr - demod_floor(self.dr) - self.power * TX_POWER_STEP - self.margin
+        if 0 <= margin < DEVICE_ADR_HYSTERESIS:
+            return
+        dr = MIN_DR
+        while dr < MAX_DR and snr - demod_floor(dr + 1) - self.margin >= 0:
+            dr += 1
+        margin = snr - demod_floor(dr) - self.margin
+        power = 0
+        while power < MAX_POWER_INDEX and margin >= (power + 1) * TX_POWER_STEP:
+            power += 1
+        self.dr = dr
+        self.power = power
+
+    def downlink(self, snr):
+        self.adr_ack_counter = 0
+        if self.mode == 'device':
+            self.history = (self.history + [snr])[-DEVICE_ADR_HISTORY_SIZE:]
+
+    def network_adr(self, snr):
+        """Network server side, True when it sends a LinkAdrReq."""
+        self.network_history = (self.network_history + [snr])[-NETWORK_ADR_HISTORY_SIZE:]
+        if self.mode != 'network' or len(self.network_history) < NETWORK_ADR_HISTORY_SIZE:
+            return False
+        steps = math.floor((max(self.network_history) - demod_floor(self.dr) - self.margin) / NETWORK_ADR_STEP)
+        dr, power = self.dr, self.power
+        while steps > 0 and dr < MAX_DR:
+            dr += 1
+            steps -= 1
+        while steps > 0 and power < MAX_POWER_INDEX:
+            power += 1
+            steps -= 1
+        while steps < 0 and power > 0:
+            power -= 1
+            steps += 1
+        if (dr, power) == (self.dr, self.power):
+            return False
+        self.pending = (dr, power)
+        return True
+
+
+def simulate(trace, mode, args, seed):
+    rng = random.Random(seed)
+    node = Node(mode, args.margin)
+    airtime = 0.0
+    received = 0
+    for link_snr in trace:
+        adr_ack_req = node.adr_next()
+        airtime += time_on_air(args.size + 13, spreading_factor(node.dr))
+        node.adr_ack_counter += 1
+        snr = link_snr - node.power * TX_POWER_STEP
+        if snr < demod_floor(node.dr):
+            continue
+        received += 1
+        link_adr_req = node.network_adr(snr)
+        if not (adr_ack_req or link_adr_req or rng.random() < args.downlinks):
+            continue
+        # RX1 on the uplink datarate, the gateway at full power
+        if link_snr < demod_floor(node.dr):
+            continue
+        if link_adr_req:
+            node.dr, node.power = node.pending
+            node.network_history = []
+        node.downlink(link_snr)
+    return airtime, received
+
+
+def synthetic_trace(mean, args, seed):
+    """Slow shadowing, first order autoregressive, plus Rayleigh fading [dB]."""
+    rng = random.Random(seed)
+    shadow = 0.0
+    trace = []
+    for _ in range(args.uplinks):
+        shadow = 0.95 * shadow + rng.gauss(0, args.shadowing * math.sqrt(1 - 0.95 ** 2))
+        fading = 10 * math.log10(max(rng.expovariate(1.0), 1e-6)) if args.fading else 0.0
+        trace.append(mean + shadow + min(fading, args.fading))
+    return trace
+
+
+def read_trace(path):
+    with open(path) as f:
+        return [float(line.split()[0]) for line in f if line.strip() and not line.startswith('#')]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='device side against network server ADR airtime')
+    parser.add_argument('traces', nargs='*', help='link SNR traces [dB], synthetic links without')
+    parser.add_argument('--snr', type=float, nargs='+', default=[15, 5, -5, -15],
+                        help='mean link SNR of the synthetic links [dB]')
+    parser.add_argument('--shadowing', type=float, default=4, help='shadowing deviation [dB]')
+    parser.add_argument('--fading', type=float, default=3, help='highest fading gain, 0 for none [dB]')
+    parser.add_argument('--uplinks', type=int, default=2000, help='uplinks of a synthetic link')
+    parser.add_argument('--size', type=int, default=16, help='application payload [bytes]')
+    parser.add_argument('--margin', type=int, default=10, help='ADR margin [dB], MIB_DEVICE_ADR_MARGIN')
+    parser.add_argument('--downlinks', type=float, default=0.1,
+                        help='share of the received uplinks which get a downlink')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    if args.traces:
+        links = [(path, read_trace(path)) for path in args.traces]
+    else:
+        links = [('%+g dB' % mean, synthetic_trace(mean, args, args.seed + i)) for i, mean in enumerate(args.snr)]
+
+    print('link          uplinks  mode     airtime[s]  per uplink[ms]  received[%]  vs network')
+    for name, trace in links:
+        if not trace:
+            print('%s: empty trace' % name, file=sys.stderr)
+            return 1
+        results = {mode: simulate(trace, mode, args, args.seed) for mode in ('none', 'network', 'device')}
+        for mode, (airtime, received) in results.items():
+            print('%-12s  %7d  %-7s  %10.1f  %14.1f  %11.1f  %9.0f%%' % (
+                name, len(trace), mode, airtime, 1e3 * airtime / len(trace), 100.0 * received / len(trace),
+                100.0 * airtime / results['network'][0]))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+#
+# Compares two results of the host benchmark, see src/benchmark/benchmark.c.
+#
+#   cmake -S . -B build-bench -DBENCHMARK=ON && cmake --build build-bench
+#   build-bench/src/benchmark/benchmark > new.json
+#   benchcmp.py base.json new.json                 (fails on a kernel 10% slower)
+#   benchcmp.py --threshold 25 base.json new.json
+#
+# Both results must come from the same host. The kernels missing from one of
+# the results are listed but do not fail the comparison.
+#
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        results = json.load(f)
+    return {(b['name'], b['param']): b['ns_per_op'] for b in results['benchmarks']}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='host benchmark comparison')
+    parser.add_argument('base', help='reference result')
+    parser.add_argument('new', help='result to check')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='slowdown which fails the comparison [%%]')
+    args = parser.parse_args()
+
+    base = load(args.base)
+    new = load(args.new)
+    regressions = 0
+    print('%-28s %-14s %12s %12s %8s' % ('kernel', 'param', 'base[ns]', 'new[ns]', 'change'))
+    for key in sorted(set(base) | set(new)):
+        name, param = key
+        if key not in base or key not in new:
+            print('%-28s %-14s %s' % (name, param, 'only in ' + ('new' if key in new else 'base')))
+            continue
+        change = (new[key] - base[key]) * 100.0 / base[key]
+        mark = ''
+        if change > args.threshold:
+            mark = '  SLOWER'
+            regressions += 1
+        print('%-28s %-14s %12.1f %12.1f %+7.1f%%%s' % (name, param, base[key], new[key], change, mark))
+    if regressions:
+        print('%d kernel(s) more than %.0f%% slower' % (regressions, args.threshold), file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+#
+# Energy and downlink latency of the LoRaWAN device classes A, B and C, see
+# src/mac/LoRaMacClassB.h for the class B timings.
+#
+#   classsim.py                          (defaults: CN470, SF12 uplinks every 10 min)
+#   classsim.py --uplink 3600 --periodicity 3 --sf 9
+#
+# The reception windows are sized like the MAC sizes them: 6 symbols plus
+# twice the timing error, the error of a class B window grows with the drift
+# since the last beacon. Downlinks reach the network server at random times,
+# their latency is the wait for the next window the node opens.
+#
+import argparse
+import math
+import random
+import sys
+
+BEACON_INTERVAL = 128.0
+BEACON_RESERVED = 2.120
+PING_SLOT_NB = 4096
+PING_SLOT_WINDOW = 0.030
+BEACON_SIZE = 19                # CN470, 17 in EU868
+BEACON_SF = 10                  # CN470 DR2, SF9 in EU868
+BEACON_SYNC_ERROR = 0.003
+DRIFT_PPM = 40
+MIN_RX_SYMBOLS = 6
+RX1_DELAY = 1.0
+RX2_SF = 12
+
+
+def symbol_time(sf, bandwidth=125e3):
+    return (1 << sf) / bandwidth
+
+
+def time_on_air(size, sf, implicit=False, crc=True, preamble=8):
+    """LoRa time on air [s], coding rate 4/5."""
+    tsym = symbol_time(sf)
+    ldro = 1 if tsym > 0.016 else 0
+    bits = 8 * size - 4 * sf + 28 + (16 if crc else 0) - (20 if implicit else 0)
+    payload = 8 + max(math.ceil(bits / (4 * (sf - 2 * ldro))) * 5, 0)
+    return (preamble + 4.25 + payload) * tsym
+
+
+def window_time(sf, error):
+    """Length of a reception window which receives no preamble [s]."""
+    tsym = symbol_time(sf)
+    symbols = max(math.ceil(((2 * MIN_RX_SYMBOLS - 8) * tsym + 2 * error) / tsym), MIN_RX_SYMBOLS)
+    return symbols * tsym
+
+
+class Model:
+    def __init__(self, args):
+        self.args = args
+        self.uplink_air = time_on_air(args.size + 13, args.sf)
+        self.downlink_air = time_on_air(args.size + 13, args.sf)
+        # RX1 on the uplink datarate, RX2 on its default datarate
+        self.rx_windows = window_time(args.sf, 0.002) + window_time(RX2_SF, 0.002)
+
+    def class_a(self):
+        """Average current [A]."""
+        a = self.args
+        charge = self.uplink_air * a.tx_current + self.rx_windows * a.rx_current
+        return charge / a.uplink + a.sleep_current
+
+    def class_b(self):
+        a = self.args
+        current = self.class_a()
+        # beacon window widened by the drift of one period, the radio listens
+        # half of it before the preamble then receives the beacon
+        beacon_error = BEACON_SYNC_ERROR + BEACON_INTERVAL * DRIFT_PPM * 1e-6
+        beacon = window_time(BEACON_SF, beacon_error) / 2 + \
+            time_on_air(BEACON_SIZE, BEACON_SF, implicit=True, crc=False, preamble=10)
+        slots = 1 << (7 - a.periodicity)
+        ping_error = BEACON_SYNC_ERROR + BEACON_INTERVAL * DRIFT_PPM * 1e-6
+        ping = window_time(a.ping_sf, ping_error)
+        charge = (beacon + slots * ping) * a.rx_current
+        return current + charge / BEACON_INTERVAL
+
+    def class_c(self):
+        a = self.args
+        rx = a.uplink - self.uplink_air
+        charge = self.uplink_air * a.tx_current + rx * a.rx_current
+        return charge / a.uplink
+
+    def latency(self, kind, rng):
+        """Latency of a downlink queued at a random time [s]."""
+        a = self.args
+        if kind == 'A':
+            return rng.uniform(0, a.uplink) + RX1_DELAY + self.downlink_air
+        if kind == 'C':
+            return self.downlink_air
+        # ping slots every period, at a random offset after the beacon reserved time
+        period = PING_SLOT_NB // (1 << (7 - a.periodicity)) * PING_SLOT_WINDOW
+        t = rng.uniform(0, BEACON_INTERVAL)
+        offset = rng.randrange(PING_SLOT_NB // (1 << (7 - a.periodicity))) * PING_SLOT_WINDOW
+        slot = BEACON_RESERVED + offset
+        while slot < t:
+            slot += period
+        if slot >= BEACON_INTERVAL - 3.0:
+            # no ping slot in the guard time, first slot of the next period
+            slot = BEACON_INTERVAL + BEACON_RESERVED + offset
+        return slot - t + time_on_air(a.size + 13, a.ping_sf)
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p * len(values)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='class A / B / C energy and latency model')
+    parser.add_argument('--uplink', type=float, default=600, help='uplink period [s]')
+    parser.add_argument('--size', type=int, default=16, help='application payload [bytes]')
+    parser.add_argument('--sf', type=int, default=12, help='uplink spreading factor')
+    parser.add_argument('--ping-sf', type=int, default=12, help='ping slot spreading factor')
+    parser.add_argument('--periodicity', type=int, default=5, choices=range(8),
+                        help='ping slot periodicity, a slot every 2^periodicity s')
+    parser.add_argument('--tx-current', type=float, default=0.029, help='[A]')
+    parser.add_argument('--rx-current', type=float, default=0.0115, help='[A]')
+    parser.add_argument('--sleep-current', type=float, default=2e-6, help='[A]')
+    parser.add_argument('--battery', type=float, default=2400, help='battery capacity [mAh]')
+    parser.add_argument('--downlinks', type=int, default=20000, help='simulated downlinks')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    model = Model(args)
+    rng = random.Random(args.seed)
+    print('class  current[uA]  life[days]  latency mean / p95 / max [s]')
+    for kind, current in (('A', model.class_a()), ('B', model.class_b()), ('C', model.class_c())):
+        latencies = [model.latency(kind, rng) for _ in range(args.downlinks)]
+        life = args.battery * 1e-3 / current / 24
+        print('  %s    %10.1f  %10.1f  %8.2f / %8.2f / %8.2f' % (
+            kind, current * 1e6, life, sum(latencies) / len(latencies),
+            percentile(latencies, 0.95), max(latencies)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+#
+# Delta patch generator and checker of the firmware image, see
+# src/system/deltapatch.h for the format.
+#
+#   deltapatch.py make old.bin new.bin patch.bin
+#   deltapatch.py verify old.bin patch.bin new.bin
+#
+# verify applies the patch in place like the bootloader does, block after
+# block over the old image, and compares the result with the new image.
+#
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = 0x31504C44
+HEADER_SIZE = 32
+OP_COPY = 0x00
+OP_LITERAL = 0x01
+OP_DIFF = 0x02
+FLAG_DESCENDING = 0x0001
+
+# length of the substrings indexed to find where a new block comes from
+ANCHOR_SIZE = 8
+# number of positions of the new block looked up in the index
+ANCHOR_TRIES = 8
+
+
+def crc32(data):
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+def pad(data, block_size):
+    if len(data) % block_size:
+        data += b'\xff' * (block_size - len(data) % block_size)
+    return data
+
+
+def diff_runs(src, dst):
+    """(skip, bytes) runs turning src into dst, or None when too long."""
+    runs = []
+    pos = 0
+    last = 0
+    while pos < len(dst):
+        if src[pos] == dst[pos]:
+            pos += 1
+            continue
+        start = pos
+        # a run goes on over short equal stretches, a new run costs 2 bytes
+        while pos < len(dst) and pos - start < 255:
+            if src[pos] != dst[pos]:
+                pos += 1
+            elif dst[pos:pos + 3] != src[pos:pos + 3] and pos + 1 < len(dst):
+                pos += 1
+            else:
+                break
+        skip = start - last
+        while skip > 255:
+            runs.append((255, b''))
+            skip -= 255
+        runs.append((skip, dst[start:pos]))
+        last = pos
+        if len(runs) > 255:
+            return None
+    return runs
+
+
+def diff_size(runs):
+    return 5 + sum(2 + len(data) for _, data in runs)
+
+
+def index_image(old):
+    index = {}
+    for pos in range(len(old) - ANCHOR_SIZE + 1):
+        index.setdefault(old[pos:pos + ANCHOR_SIZE], []).append(pos)
+    return index
+
+
+def source_allowed(src, block_start, flags):
+    """The bytes of the old image not overwritten yet by the previous blocks."""
+    if flags & FLAG_DESCENDING:
+        return src <= block_start
+    return src >= block_start
+
+
+def candidates(old, index, new_block, block_start, block_size, flags):
+    """Old offsets a new block may be built from."""
+    found = [block_start]
+    step = max(1, (block_size - ANCHOR_SIZE) // ANCHOR_TRIES)
+    for at in range(0, block_size - ANCHOR_SIZE + 1, step):
+        for pos in index.get(new_block[at:at + ANCHOR_SIZE], [])[:16]:
+            found.append(pos - at)
+    return [src for src in dict.fromkeys(found)
+            if src >= 0 and source_allowed(src, block_start, flags) and src + block_size <= len(old)]
+
+
+def block_order(nb_blocks, flags):
+    if flags & FLAG_DESCENDING:
+        return range(nb_blocks - 1, -1, -1)
+    return range(nb_blocks)
+
+
+def make(old, new, block_size, flags, index):
+    new = pad(new, block_size)
+    ops = bytearray()
+    stats = {OP_COPY: 0, OP_LITERAL: 0, OP_DIFF: 0}
+    for block in block_order(len(new) // block_size, flags):
+        start = block * block_size
+        dst = new[start:start + block_size]
+        best = (1 + block_size, bytes([OP_LITERAL]) + dst, OP_LITERAL)
+        for src in candidates(old, index, dst, start, block_size, flags):
+            ref = old[src:src + block_size]
+            if ref == dst:
+                best = (4, bytes([OP_COPY]) + struct.pack('<I', src)[:3], OP_COPY)
+                break
+            runs = diff_runs(ref, dst)
+            if runs is not None and diff_size(runs) < best[0]:
+                op = bytearray([OP_DIFF]) + struct.pack('<I', src)[:3] + bytes([len(runs)])
+                for skip, data in runs:
+                    op += bytes([skip, len(data)]) + data
+                best = (len(op), bytes(op), OP_DIFF)
+        ops += best[1]
+        stats[best[2]] += 1
+    return ops, stats
+
+
+def header(old, new, ops, block_size, flags):
+    return struct.pack('<IIIIIIIHH', MAGIC, len(ops), crc32(ops), len(old), crc32(old),
+                       len(new), crc32(new), block_size, flags)
+
+
+def apply(old, patch, block_size):
+    """In place application, enforcing the bootloader rules."""
+    (magic, patch_size, patch_crc, old_size, old_crc, new_size, new_crc,
+     size, flags) = struct.unpack('<IIIIIIIHH', patch[:HEADER_SIZE])
+    ops = patch[HEADER_SIZE:HEADER_SIZE + patch_size]
+    if magic != MAGIC or size != block_size or len(ops) != patch_size:
+        raise ValueError('bad header')
+    if crc32(ops) != patch_crc or len(old) != old_size or crc32(old) != old_crc:
+        raise ValueError('patch does not apply to this image')
+    image = bytearray(pad(old, block_size))
+    image += b'\xff' * max(0, len(pad(b'\0' * new_size, block_size)) - len(image))
+    pos = 0
+    for block in block_order((new_size + block_size - 1) // block_size, flags):
+        op = ops[pos]
+        pos += 1
+        if op == OP_LITERAL:
+            data = ops[pos:pos + block_size]
+            pos += block_size
+        else:
+            src = ops[pos] | ops[pos + 1] << 8 | ops[pos + 2] << 16
+            pos += 3
+            if not source_allowed(src, block * block_size, flags) or src + block_size > old_size:
+                raise ValueError('block %d reads overwritten or missing bytes' % block)
+            data = bytearray(image[src:src + block_size])
+            if op == OP_DIFF:
+                at = 0
+                for _ in range(ops[pos]):
+                    skip, length = ops[pos + 1], ops[pos + 2]
+                    at += skip
+                    data[at:at + length] = ops[pos + 3:pos + 3 + length]
+                    at += length
+                    pos += 2 + length
+                pos += 1
+            elif op != OP_COPY:
+                raise ValueError('block %d unknown operation %d' % (block, op))
+        image[block * block_size:(block + 1) * block_size] = data
+    if pos != patch_size:
+        raise ValueError('trailing operations')
+    image = bytes(image[:new_size])
+    if crc32(image) != new_crc:
+        raise ValueError('patched image CRC mismatch')
+    return image
+
+
+def main():
+    parser = argparse.ArgumentParser(description="firmware delta patch tool")
+    parser.add_argument('--block-size', type=int, default=256)
+    sub = parser.add_subparsers(dest='command', required=True)
+    cmd = sub.add_parser('make', help='generate a patch')
+    cmd.add_argument('old')
+    cmd.add_argument('new')
+    cmd.add_argument('patch')
+    cmd = sub.add_parser('verify', help='check a patch rebuilds the new image')
+    cmd.add_argument('old')
+    cmd.add_argument('patch')
+    cmd.add_argument('new')
+    args = parser.parse_args()
+
+    old = open(args.old, 'rb').read()
+    if args.command == 'make':
+        new = open(args.new, 'rb').read()
+        index = index_image(old)
+        patches = []
+        for flags in (0, FLAG_DESCENDING):
+            ops, stats = make(old, new, args.block_size, flags, index)
+            patches.append((len(ops), header(old, new, ops, args.block_size, flags) + ops, flags, stats))
+        _, patch, flags, stats = min(patches, key=lambda p: p[0])
+        apply(old, patch, args.block_size)
+        open(args.patch, 'wb').write(patch)
+        print('%d bytes -> %d bytes (%.1f%%), %s, copy %d diff %d literal %d' %
+              (len(new), len(patch), 100.0 * len(patch) / max(1, len(new)),
+               'descending' if flags & FLAG_DESCENDING else 'ascending',
+               stats[OP_COPY], stats[OP_DIFF], stats[OP_LITERAL]))
+    else:
+        patch = open(args.patch, 'rb').read()
+        new = open(args.new, 'rb').read()
+        try:
+            ok = apply(old, patch, args.block_size) == new
+        except ValueError as error:
+            print('patch rejected: %s' % error)
+            return 1
+        print('patch ok' if ok else 'patch does not rebuild the new image')
+        return 0 if ok else 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
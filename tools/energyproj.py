@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+# Battery life projection from the energy ledger of a node, see
+# src/system/energy.h.
+#
+#   energyproj.py node.log                                  (Handsome currents)
+#   energyproj.py --board src/boards/Handsome/board-config.h --sf 7 9 12 --duty 5 10 node.log
+#   logdecode.py firmware.elf capture.bin | energyproj.py -
+#
+# The last ledger printed by EnergyPrintStats in the log gives the time spent
+# in every MCU and radio state, measured at --measured-power, --measured-sf
+# and the duty cycle of the run. The currents of every state are the
+# ENERGY_CURRENT_* of the board-config.h, the defaults of energy.c for the
+# ones it does not define, the ones EnergyInit gets as EnergyProfile_t.
+#
+# For each configuration, the transmissions keep their number and their time
+# on air follows the spreading factor. The listening states, MCU run and
+# sleep included, follow the duty cycle, the radio listening this share of
+# the time. The MCU sleeps in STOP and the radio in SLEEP for the rest.
+#
+import argparse
+import math
+import os
+import re
+import sys
+
+MCU_STATES = ('run', 'sleep', 'stop')
+RADIO_STATES = ('sleep', 'stdby', 'synth', 'rx', 'cad', 'tx')
+# ENERGY_CURRENT_* of each state
+CURRENT_NAMES = {
+    ('mcu', 'run'): 'MCU_RUN', ('mcu', 'sleep'): 'MCU_SLEEP', ('mcu', 'stop'): 'MCU_STOP',
+    ('radio', 'sleep'): 'RADIO_SLEEP', ('radio', 'stdby'): 'RADIO_STANDBY',
+    ('radio', 'synth'): 'RADIO_SYNTH', ('radio', 'rx'): 'RADIO_RX', ('radio', 'cad'): 'RADIO_CAD',
+}
+# states which follow the duty cycle
+LISTENING = (('mcu', 'run'), ('mcu', 'sleep'), ('radio', 'stdby'), ('radio', 'synth'),
+             ('radio', 'rx'), ('radio', 'cad'))
+ENERGY_C = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'src', 'system', 'energy.c')
+BOARD_CONFIG = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'src', 'boards', 'Handsome',
+                            'board-config.h')
+
+
+def read_currents(path, currents):
+    """Updates currents with the ENERGY_CURRENT_* definitions of a C file."""
+    with open(path) as f:
+        text = f.read().replace('\\\n', ' ')
+    for name, value in re.findall(r'#define\s+ENERGY_CURRENT_(\w+)\s+([^\n]+)', text):
+        if name == 'RADIO_TX':
+            currents['TX'] = [(int(p), int(c)) for p, c in re.findall(r'\{\s*(-?\d+)\s*,\s*(\d+)\s*\}', value)]
+        else:
+            currents[name] = int(value.split()[0])
+
+
+def tx_current(levels, power):
+    """Current at an output power, the first entry at or above it [uA]."""
+    for level, current in levels:
+        if power <= level:
+            return current
+    return levels[-1][1]
+
+
+def read_ledger(f):
+    """Times of the last ledger of the log [ms]."""
+    ledger = None
+    for line in f:
+        m = re.match(r'\s*energy (\d+)ms', line)
+        if m:
+            ledger = {'elapsed': int(m.group(1))}
+            continue
+        m = re.match(r'\s*(mcu|radio) (\w+) (\d+)ms', line)
+        if m and ledger is not None:
+            ledger[(m.group(1), m.group(2))] = int(m.group(3))
+    if ledger is None:
+        raise ValueError('no energy ledger in the log')
+    for state in [('mcu', s) for s in MCU_STATES] + [('radio', s) for s in RADIO_STATES]:
+        if state not in ledger:
+            raise ValueError('ledger without the %s %s time' % state)
+    return ledger
+
+
+def time_on_air(size, sf, bandwidth=125e3):
+    """LoRa time on air [s], coding rate 4/5, explicit header and CRC."""
+    tsym = (1 << sf) / bandwidth
+    ldro = 1 if tsym > 0.016 else 0
+    payload = 8 + max(math.ceil((8 * size - 4 * sf + 44) / (4 * (sf - 2 * ldro))) * 5, 0)
+    return (8 + 4.25 + payload) * tsym
+
+
+def project(ledger, currents, args, power, sf, duty):
+    """Average current [uA] of a configuration."""
+    elapsed = ledger['elapsed']
+    listen_scale = duty / args.measured_duty if args.measured_duty > 0 else 0
+    times = {}
+    for state in LISTENING:
+        times[state] = ledger[state] * listen_scale
+    times[('radio', 'tx')] = ledger[('radio', 'tx')] * time_on_air(args.size, sf) / \
+        time_on_air(args.size, args.measured_sf)
+    # the MCU runs while the radio transmits, it only stops for the rest
+    times[('mcu', 'stop')] = max(elapsed - times[('mcu', 'run')] - times[('mcu', 'sleep')], 0)
+    radio_busy = sum(times[('radio', s)] for s in RADIO_STATES if s != 'sleep')
+    times[('radio', 'sleep')] = max(elapsed - radio_busy, 0)
+
+    charge = currents['BASE'] * elapsed
+    for state, time in times.items():
+        if state == ('radio', 'tx'):
+            charge += time * tx_current(currents['TX'], power)
+        else:
+            charge += time * currents[CURRENT_NAMES[state]]
+    return charge / elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description='battery life projection from the energy ledger')
+    parser.add_argument('log', help='log with the output of EnergyPrintStats, - for stdin')
+    parser.add_argument('--board', default=BOARD_CONFIG, help='board-config.h with the currents')
+    parser.add_argument('--battery', type=float, default=2400, help='battery capacity [mAh]')
+    parser.add_argument('--size', type=int, default=32, help='frame size [bytes]')
+    parser.add_argument('--measured-power', type=int, default=2, help='output power of the run [dBm]')
+    parser.add_argument('--measured-sf', type=int, default=7, help='spreading factor of the run')
+    parser.add_argument('--power', type=int, nargs='+', help='output powers [dBm], the TX table ones by default')
+    parser.add_argument('--sf', type=int, nargs='+', help='spreading factors, the measured one by default')
+    parser.add_argument('--duty', type=float, nargs='+',
+                        help='radio listening time [%%], the measured one by default')
+    args = parser.parse_args()
+
+    currents = {'BASE': 0}
+    read_currents(ENERGY_C, currents)
+    if args.board:
+        read_currents(args.board, currents)
+
+    try:
+        if args.log == '-':
+            ledger = read_ledger(sys.stdin)
+        else:
+            with open(args.log, errors='replace') as f:
+                ledger = read_ledger(f)
+    except ValueError as e:
+        print('%s: %s' % (args.log, e), file=sys.stderr)
+        return 1
+    if ledger['elapsed'] == 0:
+        print('%s: empty ledger' % args.log, file=sys.stderr)
+        return 1
+
+    args.measured_duty = 100.0 * (ledger[('radio', 'rx')] + ledger[('radio', 'cad')]) / ledger['elapsed']
+    powers = args.power or [p for p, _ in currents['TX']]
+    sfs = args.sf or [args.measured_sf]
+    duties = args.duty or [args.measured_duty]
+
+    print('measured %.1f h, listening %.2f%%, %s' % (ledger['elapsed'] / 3.6e6, args.measured_duty,
+                                                   os.path.basename(args.board) if args.board else 'energy.c'))
+    print('power[dBm]  sf  listen[%]  current[uA]  life[days]')
+    for power in powers:
+        for sf in sfs:
+            for duty in duties:
+                current = project(ledger, currents, args, power, sf, duty)
+                life = args.battery * 1e3 / current / 24 if current > 0 else float('inf')
+                print('%10d  %2d  %9.2f  %11.1f  %10.1f' % (power, sf, duty, current, life))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
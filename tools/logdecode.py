@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+#
+# Decoder of the deferred serial log, see src/system/serialio.h for the
+# record format.
+#
+#   logdecode.py firmware.elf /dev/ttyUSB0     (port set up with stty before)
+#   logdecode.py firmware.elf capture.bin
+#   logdecode.py firmware.elf - < capture.bin
+#
+# The format strings are read from the .logfmt section of the ELF file the
+# target runs. The binary records of SerialioRecord are printed with the
+# fields of RECORDS, see apps/multi-hop/Handsome/sinkstats.h.
+#
+import argparse
+import re
+import struct
+import sys
+
+ID_TEXT = 0xFFFF
+ID_DROPPED = 0xFFFE
+ID_RECORD = 0xFFFD
+
+# type: (name, struct layout, fields, name of the uint16 values which follow)
+RECORDS = {
+    1: ('sink packet', '<BBBBHhbB', ('src', 'seq', 'flags', 'hops', 'delay', 'rssi', 'snr', 'size'), 'stamps'),
+    2: ('sink window', '<BHHHIHHBhb', ('src', 'rx', 'lost', 'dup', 'bytes', 'delay', 'delay_max', 'hops',
+                                       'rssi', 'snr'), None),
+    3: ('sink summary', '<IIHHHIBHH', ('time', 'duration', 'rx', 'lost', 'dup', 'bytes', 'sources',
+                                       'records_lost', 'unknown'), None),
+}
+
+CONVERSION = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z|j|t)?([diouxXc%])')
+
+
+def read_section(path, name):
+    """(address, data) of a section of a little endian ELF file, ELF64 for host builds."""
+    elf = open(path, 'rb').read()
+    if elf[:4] != b'\x7fELF' or elf[4] not in (1, 2) or elf[5] != 1:
+        raise ValueError('%s is not a little endian ELF file' % path)
+    if elf[4] == 1:
+        shoff, = struct.unpack_from('<I', elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x2E)
+        layout = '<IIIIII'
+    else:
+        shoff, = struct.unpack_from('<Q', elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x3A)
+        layout = '<IIQQQQ'
+
+    def header(index):
+        # sh_name, sh_type, sh_flags, sh_addr, sh_offset, sh_size
+        return struct.unpack_from(layout, elf, shoff + index * shentsize)
+
+    strtab = header(shstrndx)
+    for index in range(shnum):
+        sh_name, _, _, sh_addr, sh_offset, sh_size = header(index)
+        start = strtab[4] + sh_name
+        if elf[start:elf.index(b'\0', start)].decode() == name:
+            return sh_addr, elf[sh_offset:sh_offset + sh_size]
+    raise ValueError('%s has no %s section, is the firmware built with USE_DEFERRED_LOG?' % (path, name))
+
+
+def cobs_decode(frame):
+    data = bytearray()
+    pos = 0
+    while pos < len(frame):
+        code = frame[pos]
+        if code == 0 or pos + code > len(frame) + 1:
+            raise ValueError('bad COBS frame')
+        data += frame[pos + 1:pos + code]
+        pos += code
+        if pos < len(frame):
+            data.append(0)
+    return bytes(data)
+
+
+def render_record(payload):
+    """One line of the fields of a binary record."""
+    if not payload or payload[0] not in RECORDS:
+        return '<unknown binary record>\n'
+    name, layout, fields, rest = RECORDS[payload[0]]
+    size = struct.calcsize(layout)
+    if len(payload) - 1 < size:
+        return '<short %s record>\n' % name
+    values = struct.unpack_from(layout, payload, 1)
+    line = name + ' ' + ' '.join('%s=%d' % item for item in zip(fields, values))
+    if rest:
+        tail = payload[1 + size:]
+        line += ' %s=%s' % (rest, ','.join(str(v) for v in struct.unpack('<%dH' % (len(tail) // 2), tail[:len(tail) & ~1])))
+    return line + '\n'
+
+
+def render(fmt, args):
+    """printf of integer arguments, sent as 32 bits values."""
+    args = list(args)
+
+    def convert(match):
+        flags, kind = match.groups()
+        if kind == '%':
+            return '%'
+        value = args.pop(0) if args else 0
+        if kind in 'di' and value >= 0x80000000:
+            value -= 0x100000000
+        if kind == 'c':
+            return chr(value & 0xFF)
+        return ('%' + flags + kind.replace('u', 'd')) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+class Decoder:
+    def __init__(self, elf):
+        self.base, self.formats = read_section(elf, '.logfmt')
+
+    def format_of(self, ident):
+        offset = (ident - self.base) & 0xFFFF
+        if offset >= len(self.formats):
+            return None
+        end = self.formats.index(b'\0', offset)
+        return self.formats[offset:end].decode('ascii', 'replace')
+
+    def record(self, frame):
+        try:
+            data = cobs_decode(frame)
+        except ValueError:
+            return '<corrupted record>\n'
+        if len(data) < 2:
+            return '<short record>\n'
+        ident, payload = struct.unpack_from('<H', data)[0], data[2:]
+        if ident == ID_TEXT:
+            return payload.decode('ascii', 'replace')
+        if ident == ID_DROPPED:
+            return '<%d records dropped>\n' % struct.unpack('<I', payload[:4])[0]
+        if ident == ID_RECORD:
+            return render_record(payload)
+        fmt = self.format_of(ident)
+        if fmt is None or len(payload) % 4:
+            return '<unknown record 0x%04x>\n' % ident
+        return render(fmt, struct.unpack('<%dI' % (len(payload) // 4), payload))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='deferred serial log decoder')
+    parser.add_argument('elf', help='firmware running on the target')
+    parser.add_argument('input', help='serial port or capture file, - for stdin')
+    args = parser.parse_args()
+
+    decoder = Decoder(args.elf)
+    stream = sys.stdin.buffer if args.input == '-' else open(args.input, 'rb', buffering=0)
+    frame = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            break
+        if chunk[0] != 0:
+            frame += chunk
+            continue
+        if frame:
+            sys.stdout.write(decoder.record(bytes(frame)))
+            sys.stdout.flush()
+        frame.clear()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())